@@ -0,0 +1,99 @@
+#pragma once
+
+// Tiny benchmark harness for the SoftRender modules.
+// Every bench_*.cpp registers one entry point in bench_main.cpp.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+
+namespace bench
+{
+
+class timer
+{
+public:
+   timer() : start_(std::chrono::steady_clock::now()) {}
+
+   void reset() { start_ = std::chrono::steady_clock::now(); }
+
+   double elapsed_ms() const
+   {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+   }
+
+private:
+   std::chrono::steady_clock::time_point start_;
+};
+
+// Runs fn() `runs` times and returns the fastest run in milliseconds
+template<class F>
+double best_of(int runs, F&& fn)
+{
+   double best = 1e30;
+   for (int i = 0; i < runs; i++)
+   {
+      timer t;
+      fn();
+      const double ms = t.elapsed_ms();
+      best = ms < best ? ms : best;
+   }
+   return best;
+}
+
+// Deterministic xorshift so every run draws the same scene
+class rng
+{
+public:
+   explicit rng(uint32_t seed = 0x12345678u) : state_(seed ? seed : 1u) {}
+
+   uint32_t next()
+   {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 17;
+      state_ ^= state_ << 5;
+      return state_;
+   }
+
+   // [0, 1)
+   float unit() { return (float)(next() >> 8) * (1.0f / 16777216.0f); }
+   float range(float lo, float hi) { return lo + (hi - lo) * unit(); }
+
+private:
+   uint32_t state_;
+};
+
+// Defeats dead-code elimination of benchmark results
+void consume(uint64_t value);
+
+// For benchmarks that gate a replacement on accuracy or speed: the run
+// carries on, but exits with status 2
+void gate_failed();
+
+void run_depth();
+void run_vertex();
+void run_clip();
+void run_blend();
+void run_msaa();
+void run_path();
+void run_realize();
+void run_scene();
+void run_gradient();
+void run_pattern();
+void run_text();
+void run_resources();
+void run_tiles();
+void run_stroke();
+void run_layers();
+void run_math();
+void run_simd_math();
+void run_hierarchy();
+void run_cull();
+void run_d3dmath();
+void run_quantize();
+void run_mesh();
+void run_sprite();
+void run_upload();
+
+}
@@ -0,0 +1,338 @@
+// Blend states: every factor/op combination checked against a double
+// precision reference, then 4K layer throughput against the raw memory
+// bandwidth of a read-read-write loop (which is what blending has to move).
+// With SIMD the states Test1 and Test5 use must reach min_roof of it
+
+#include "bench.h"
+#include "sr_blend.h"
+#include "sr_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+namespace bench
+{
+
+static const sr::blend_factor s_factors[] =
+{
+   sr::blend_factor::zero, sr::blend_factor::one,
+   sr::blend_factor::src_color, sr::blend_factor::inv_src_color,
+   sr::blend_factor::src_alpha, sr::blend_factor::inv_src_alpha,
+   sr::blend_factor::dest_alpha, sr::blend_factor::inv_dest_alpha,
+   sr::blend_factor::dest_color, sr::blend_factor::inv_dest_color,
+   sr::blend_factor::src_alpha_sat,
+   sr::blend_factor::blend_factor, sr::blend_factor::inv_blend_factor,
+   sr::blend_factor::src1_color, sr::blend_factor::inv_src1_color,
+   sr::blend_factor::src1_alpha, sr::blend_factor::inv_src1_alpha,
+};
+
+static const sr::blend_op s_ops[] =
+{
+   sr::blend_op::add, sr::blend_op::subtract, sr::blend_op::rev_subtract, sr::blend_op::min, sr::blend_op::max,
+};
+
+static const float s_blend_factor[4] = { 0.25f, 0.5f, 0.75f, 0.6f };
+
+// D3D11 functional spec, one channel at a time
+static double ref_factor(sr::blend_factor f, int c, const double* s, const double* d, const double* s1)
+{
+   switch (f)
+   {
+   case sr::blend_factor::zero: return 0.0;
+   case sr::blend_factor::one: return 1.0;
+   case sr::blend_factor::src_color: return s[c];
+   case sr::blend_factor::inv_src_color: return 1.0 - s[c];
+   case sr::blend_factor::src_alpha: return s[3];
+   case sr::blend_factor::inv_src_alpha: return 1.0 - s[3];
+   case sr::blend_factor::dest_alpha: return d[3];
+   case sr::blend_factor::inv_dest_alpha: return 1.0 - d[3];
+   case sr::blend_factor::dest_color: return d[c];
+   case sr::blend_factor::inv_dest_color: return 1.0 - d[c];
+   case sr::blend_factor::src_alpha_sat: return c == 3 ? 1.0 : (s[3] < 1.0 - d[3] ? s[3] : 1.0 - d[3]);
+   case sr::blend_factor::blend_factor: return s_blend_factor[c];
+   case sr::blend_factor::inv_blend_factor: return 1.0 - s_blend_factor[c];
+   case sr::blend_factor::src1_color: return s1[c];
+   case sr::blend_factor::inv_src1_color: return 1.0 - s1[c];
+   case sr::blend_factor::src1_alpha: return s1[3];
+   case sr::blend_factor::inv_src1_alpha: return 1.0 - s1[3];
+   }
+   return 0.0;
+}
+
+static void ref_blend(const sr::render_target_blend_desc& desc, const double* s, const double* d, const double* s1, double* out)
+{
+   for (int c = 0; c < 4; c++)
+   {
+      if (!(desc.write_mask & (1 << c)))
+      {
+         out[c] = d[c];
+         continue;
+      }
+      if (!desc.blend_enable)
+      {
+         out[c] = s[c];
+         continue;
+      }
+      const double fs = ref_factor(c == 3 ? desc.src_blend_alpha : desc.src_blend, c, s, d, s1);
+      const double fd = ref_factor(c == 3 ? desc.dest_blend_alpha : desc.dest_blend, c, s, d, s1);
+      switch (c == 3 ? desc.op_alpha : desc.op)
+      {
+      case sr::blend_op::add: out[c] = s[c] * fs + d[c] * fd; break;
+      case sr::blend_op::subtract: out[c] = s[c] * fs - d[c] * fd; break;
+      case sr::blend_op::rev_subtract: out[c] = d[c] * fd - s[c] * fs; break;
+      case sr::blend_op::min: out[c] = s[c] < d[c] ? s[c] : d[c]; break;
+      case sr::blend_op::max: out[c] = s[c] > d[c] ? s[c] : d[c]; break;
+      }
+   }
+}
+
+static void unpack(uint32_t p, double* out)
+{
+   for (int c = 0; c < 4; c++)
+      out[c] = ((p >> (c * 8)) & 0xff) / 255.0;
+}
+
+// Random pixels with plenty of exact 0 and 255 alphas; premultiplied when asked
+static void fill_pixels(rng& r, uint32_t* p, size_t count, bool premultiplied)
+{
+   for (size_t i = 0; i < count; i++)
+   {
+      uint32_t a = r.next() & 0xff;
+      const uint32_t pick = r.next() & 7;
+      a = pick == 0 ? 0 : pick == 1 ? 255 : a;
+      uint32_t v = a << 24;
+      for (int c = 0; c < 24; c += 8)
+      {
+         uint32_t x = r.next() & 0xff;
+         if (premultiplied)
+            x = x * a / 255;
+         v |= x << c;
+      }
+      p[i] = v;
+   }
+}
+
+// Returns the number of channel values off by more than `tolerance` units of 1/255
+static int check_rgba8(const sr::render_target_blend_desc& desc, const uint32_t* src, const uint32_t* dst, const uint32_t* src1, size_t count, int tolerance)
+{
+   sr::blend_state state(desc);
+   state.set_blend_factor(s_blend_factor);
+   std::vector<uint32_t> out(dst, dst + count);
+   state.blend_rgba8(out.data(), src, count, src1);
+
+   int bad = 0;
+   for (size_t i = 0; i < count; i++)
+   {
+      double s[4], d[4], s1[4], r[4];
+      unpack(src[i], s); unpack(dst[i], d); unpack(src1[i], s1);
+      ref_blend(desc, s, d, s1, r);
+      for (int c = 0; c < 4; c++)
+      {
+         const double clamped = r[c] < 0.0 ? 0.0 : (r[c] > 1.0 ? 1.0 : r[c]);
+         const int expect = (int)floor(clamped * 255.0 + 0.5);
+         const int got = (int)((out[i] >> (c * 8)) & 0xff);
+         bad += abs(got - expect) > tolerance;
+      }
+   }
+   return bad;
+}
+
+static int check_rgba32f(const sr::render_target_blend_desc& desc, const uint32_t* src8, const uint32_t* dst8, const uint32_t* src18, size_t count)
+{
+   std::vector<float> src(count * 4), dst(count * 4), src1(count * 4);
+   for (size_t i = 0; i < count * 4; i++)
+   {
+      src[i] = ((src8[i / 4] >> ((i & 3) * 8)) & 0xff) / 255.0f;
+      dst[i] = ((dst8[i / 4] >> ((i & 3) * 8)) & 0xff) / 255.0f;
+      src1[i] = ((src18[i / 4] >> ((i & 3) * 8)) & 0xff) / 255.0f;
+   }
+
+   sr::blend_state state(desc);
+   state.set_blend_factor(s_blend_factor);
+   std::vector<float> out = dst;
+   state.blend_rgba32f(out.data(), src.data(), count, src1.data());
+
+   int bad = 0;
+   for (size_t i = 0; i < count; i++)
+   {
+      double s[4], d[4], s1[4], r[4];
+      for (int c = 0; c < 4; c++)
+      {
+         s[c] = src[i * 4 + c]; d[c] = dst[i * 4 + c]; s1[c] = src1[i * 4 + c];
+      }
+      ref_blend(desc, s, d, s1, r);
+      for (int c = 0; c < 4; c++)
+         bad += fabs(out[i * 4 + c] - r[c]) > 1e-5;
+   }
+   return bad;
+}
+
+static void run_correctness()
+{
+   // Odd count so the vector tails are exercised as well
+   const size_t count = 1027;
+   rng r(7);
+   std::vector<uint32_t> src(count), dst(count), src1(count), premul(count);
+   fill_pixels(r, src.data(), count, false);
+   fill_pixels(r, dst.data(), count, false);
+   fill_pixels(r, src1.data(), count, false);
+   fill_pixels(r, premul.data(), count, true);
+
+   int states = 0, bad8 = 0, bad32 = 0;
+   for (sr::blend_factor fs : s_factors)
+   {
+      for (sr::blend_factor fd : s_factors)
+      {
+         for (sr::blend_op op : s_ops)
+         {
+            sr::render_target_blend_desc desc;
+            desc.blend_enable = true;
+            desc.src_blend = fs;
+            desc.dest_blend = fd;
+            desc.op = op;
+            // Alpha takes the mirrored factors so both halves get coverage
+            desc.src_blend_alpha = fd;
+            desc.dest_blend_alpha = fs;
+            desc.op_alpha = s_ops[(states + 1) % 5];
+            desc.write_mask = (uint8_t)((states % 15) + 1);
+            bad8 += check_rgba8(desc, src.data(), dst.data(), src1.data(), count, 1);
+            bad32 += check_rgba32f(desc, src.data(), dst.data(), src1.data(), count);
+            states++;
+         }
+      }
+   }
+   printf("generic kernels: %d blend states, %d rgba8 and %d float channel mismatches\n", states, bad8, bad32);
+
+   // Fast paths and the descriptions the samples use, every write mask
+   struct named_desc { const char* name; sr::blend_factor s, d, sa, da; bool premul; };
+   const named_desc named[] =
+   {
+      { "premultiplied over", sr::blend_factor::one, sr::blend_factor::inv_src_alpha, sr::blend_factor::one, sr::blend_factor::inv_src_alpha, true },
+      { "alpha lerp (Test5)", sr::blend_factor::src_alpha, sr::blend_factor::inv_src_alpha, sr::blend_factor::src_alpha, sr::blend_factor::inv_src_alpha, false },
+      { "additive", sr::blend_factor::one, sr::blend_factor::one, sr::blend_factor::one, sr::blend_factor::one, false },
+      { "dest alpha (Test1)", sr::blend_factor::dest_alpha, sr::blend_factor::inv_dest_alpha, sr::blend_factor::one, sr::blend_factor::zero, false },
+   };
+   for (const named_desc& n : named)
+   {
+      int bad = 0;
+      sr::blend_path path = sr::blend_path::generic;
+      for (int mask = 0; mask <= 15; mask++)
+      {
+         sr::render_target_blend_desc desc;
+         desc.blend_enable = true;
+         desc.src_blend = n.s; desc.dest_blend = n.d;
+         desc.src_blend_alpha = n.sa; desc.dest_blend_alpha = n.da;
+         desc.write_mask = (uint8_t)mask;
+         path = sr::blend_state(desc).path();
+         bad += check_rgba8(desc, n.premul ? premul.data() : src.data(), dst.data(), src1.data(), count, 1);
+      }
+      printf("  %-20s -> %-18s %d mismatch(es)\n", n.name, sr::blend_path_name(path), bad);
+   }
+
+   int bad_copy = 0;
+   for (int mask = 0; mask <= 15; mask++)
+   {
+      sr::render_target_blend_desc desc;
+      desc.write_mask = (uint8_t)mask;
+      bad_copy += check_rgba8(desc, src.data(), dst.data(), src1.data(), count, 0);
+      bad_copy += check_rgba32f(desc, src.data(), dst.data(), src1.data(), count);
+   }
+   printf("  %-20s -> %-18s %d mismatch(es)\n", "blending disabled", "copy / masked copy", bad_copy);
+}
+
+// Share of the read+read+write roof the 8-bit paths of the samples' states
+// must reach; the scalar build only reports
+static const double min_roof = 0.30;
+
+// The bandwidth ceiling for blending: read two streams, write one
+static void stream_rrw(uint32_t* dst, const uint32_t* src, size_t count)
+{
+   for (size_t i = 0; i < count; i++)
+      dst[i] = dst[i] ^ src[i];
+}
+
+static void run_throughput()
+{
+   const int width = 3840, height = 2160;
+   const size_t count = (size_t)width * height;
+   rng r(11);
+   std::vector<uint32_t> src(count), premul(count), dst(count);
+   fill_pixels(r, src.data(), count, false);
+   fill_pixels(r, premul.data(), count, true);
+   fill_pixels(r, dst.data(), count, false);
+
+   const int layers = 4;
+   const double bytes = (double)count * 4 * 3 * layers;
+   const double roof_ms = best_of(5, [&] { for (int l = 0; l < layers; l++) stream_rrw(dst.data(), src.data(), count); });
+   const double roof_gbs = bytes / roof_ms * 1e-6;
+   const double copy_ms = best_of(5, [&] { for (int l = 0; l < layers; l++) memcpy(dst.data(), src.data(), count * 4); });
+   printf("4K, %d layers | read+read+write roof %.2f ms (%.1f GB/s)  memcpy %.2f ms (%.1f GB/s)  gate %.0f%% for Test1 and Test5\n",
+      layers, roof_ms, roof_gbs, copy_ms, (double)count * 8 * layers / copy_ms * 1e-6, 100.0 * min_roof);
+
+   struct config { const char* name; sr::render_target_blend_desc desc; bool premul; bool gated = false; };
+   std::vector<config> configs;
+   {
+      sr::render_target_blend_desc d;
+      d.blend_enable = true;
+      d.src_blend = d.src_blend_alpha = sr::blend_factor::one;
+      d.dest_blend = d.dest_blend_alpha = sr::blend_factor::inv_src_alpha;
+      configs.push_back({ "premultiplied over", d, true });
+      d.write_mask = sr::color_write_red | sr::color_write_green | sr::color_write_blue;
+      configs.push_back({ "premul over, RGB mask", d, true });
+      d.write_mask = sr::color_write_all;
+      d.src_blend = d.src_blend_alpha = sr::blend_factor::src_alpha;
+      configs.push_back({ "alpha lerp (Test5)", d, false, true });
+      d.src_blend = d.src_blend_alpha = sr::blend_factor::one;
+      d.dest_blend = d.dest_blend_alpha = sr::blend_factor::one;
+      configs.push_back({ "additive", d, false });
+      d.src_blend = sr::blend_factor::dest_alpha;
+      d.dest_blend = sr::blend_factor::inv_dest_alpha;
+      d.dest_blend_alpha = sr::blend_factor::zero;
+      configs.push_back({ "dest alpha (Test1)", d, false, true });
+      sr::render_target_blend_desc off;
+      off.write_mask = sr::color_write_red | sr::color_write_alpha;
+      configs.push_back({ "disabled, RA mask", off, false });
+   }
+
+   for (const config& c : configs)
+   {
+      const sr::blend_state state(c.desc);
+      const uint32_t* s = c.premul ? premul.data() : src.data();
+      const double ms = best_of(5, [&] { for (int l = 0; l < layers; l++) state.blend_rgba8(dst.data(), s, count); });
+      const double gbs = bytes / ms * 1e-6;
+      const bool slow = c.gated && gbs < min_roof * roof_gbs;
+      printf("  %-22s %-18s %7.2f ms  %5.1f GB/s  %3.0f%% of roof%s\n", c.name, sr::blend_path_name(state.path()), ms, gbs,
+         100.0 * gbs / roof_gbs, slow ? "  (below the gate)" : "");
+#if defined(SR_HAS_SSE2)
+      if (slow)
+         gate_failed();
+#endif
+   }
+   consume(dst[count / 2]);
+
+   // R32G32B32A32_FLOAT at 4K is 133 MB per surface
+   std::vector<float> srcf(count * 4), dstf(count * 4);
+   for (size_t i = 0; i < count * 4; i++)
+   {
+      srcf[i] = r.unit();
+      dstf[i] = r.unit();
+   }
+   const double roof_f = best_of(3, [&] { stream_rrw((uint32_t*)dstf.data(), (const uint32_t*)srcf.data(), count * 4); });
+   sr::blend_state state(configs[2].desc);
+   const double lerp_ms = best_of(3, [&] { state.blend_rgba32f(dstf.data(), srcf.data(), count); });
+   state = sr::blend_state(configs[4].desc);
+   const double dest_ms = best_of(3, [&] { state.blend_rgba32f(dstf.data(), srcf.data(), count); });
+   printf("4K float, 1 layer | roof %.2f ms  alpha lerp %.2f ms (%3.0f%%)  dest alpha %.2f ms (%3.0f%%)\n",
+      roof_f, lerp_ms, 100.0 * roof_f / lerp_ms, dest_ms, 100.0 * roof_f / dest_ms);
+   consume((uint64_t)dstf[count]);
+}
+
+void run_blend()
+{
+   run_correctness();
+   run_throughput();
+}
+
+}
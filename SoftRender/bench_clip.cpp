@@ -0,0 +1,192 @@
+// Clipper: guard band + SIMD classification vs full frustum clipping of every triangle,
+// plus a pass over pathological triangles that checks the output stays inside the clip volume
+
+#include "bench.h"
+#include "sr_clip.h"
+#include "sr_constexpr.h"
+
+#include <math.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// Reference: Sutherland-Hodgman against all six frustum planes for every triangle
+static size_t clip_full_frustum(const sr::clip_vertices& in, const std::vector<uint32_t>& indices, std::vector<sr::float4>& out)
+{
+   static const float planes[6][4] =
+   {
+      { 0, 0, 1, 0 }, { 0, 0, -1, 1 }, { 1, 0, 0, 1 }, { -1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, -1, 0, 1 },
+   };
+
+   out.clear();
+   size_t tris = 0;
+   for (size_t t = 0; t + 2 < indices.size(); t += 3)
+   {
+      sr::float4 a[9], b[9];
+      a[0] = in.get(indices[t]); a[1] = in.get(indices[t + 1]); a[2] = in.get(indices[t + 2]);
+      int n = 3;
+      for (int p = 0; p < 6 && n; p++)
+      {
+         int m = 0;
+         for (int i = 0; i < n; i++)
+         {
+            const sr::float4& u = a[i];
+            const sr::float4& v = a[(i + 1) % n];
+            const float du = planes[p][0] * u.x + planes[p][1] * u.y + planes[p][2] * u.z + planes[p][3] * u.w;
+            const float dv = planes[p][0] * v.x + planes[p][1] * v.y + planes[p][2] * v.z + planes[p][3] * v.w;
+            if (du >= 0)
+               b[m++] = u;
+            if ((du >= 0) != (dv >= 0))
+            {
+               const float s = du / (du - dv);
+               b[m++] = { u.x + (v.x - u.x) * s, u.y + (v.y - u.y) * s, u.z + (v.z - u.z) * s, u.w + (v.w - u.w) * s };
+            }
+         }
+         n = m;
+         for (int i = 0; i < n; i++)
+            a[i] = b[i];
+      }
+      for (int i = 1; i + 1 < n; i++)
+      {
+         out.push_back(a[0]); out.push_back(a[i]); out.push_back(a[i + 1]);
+         tris++;
+      }
+   }
+   return tris;
+}
+
+// Triangles around a camera flying through a field of cubes: most are
+// inside, some straddle the screen edges and some cross the near plane
+static void make_scene(float near_fraction, size_t count, sr::clip_vertices& verts, std::vector<uint32_t>& indices)
+{
+   rng r(99);
+   constexpr sr::float4x4 proj = sr::cx::perspective_fov_lh(3.14159265f / 4.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+   verts.resize(count * 3);
+   indices.resize(count * 3);
+   for (size_t t = 0; t < count; t++)
+   {
+      const bool near_crossing = r.unit() < near_fraction;
+      const float cz = near_crossing ? r.range(-0.5f, 0.6f) : r.range(1.0f, 60.0f);
+      const float spread = cz * 0.6f + 0.5f;
+      const float cx = r.range(-spread, spread), cy = r.range(-spread, spread);
+      const float size = r.range(0.05f, 1.0f);
+      for (int k = 0; k < 3; k++)
+      {
+         const sr::float4 c = sr::transform_point({ cx + r.range(-size, size), cy + r.range(-size, size), cz + r.range(-size, size) }, proj);
+         const size_t i = t * 3 + k;
+         verts.x[i] = c.x; verts.y[i] = c.y; verts.z[i] = c.z; verts.w[i] = c.w;
+         indices[i] = (uint32_t)i;
+      }
+   }
+}
+
+static void run_throughput(float near_fraction)
+{
+   const size_t count = 1000000;
+   sr::clip_vertices verts;
+   std::vector<uint32_t> indices;
+   make_scene(near_fraction, count, verts, indices);
+
+   std::vector<sr::float4> ref_out;
+   size_t ref_tris = 0;
+   const double ref_ms = best_of(3, [&] { ref_tris = clip_full_frustum(verts, indices, ref_out); });
+
+   sr::clipper clip(1920, 1080);
+   sr::clip_output out;
+   const double gb_ms = best_of(3, [&] { clip.reset_stats(); clip.clip_triangles(verts, indices.data(), count, out); });
+   consume(ref_tris + out.indices.size());
+
+   const sr::clip_stats& s = clip.stats();
+   // At ~28 bytes of vertex + index data per triangle the guard band path is
+   // close to memory bandwidth; the full clipper is compute bound
+   printf("near-crossing %4.1f%% | full frustum %6.2f ms (%5.1f ns/tri)  guard band %6.2f ms (%5.1f ns/tri)  %.2fx | accepted %.1f%%  rejected %.1f%%  clipped %.2f%% (x/y %.3f%%)\n",
+      100.0f * near_fraction, ref_ms, ref_ms * 1e6 / count, gb_ms, gb_ms * 1e6 / count, ref_ms / gb_ms,
+      100.0 * s.trivially_accepted / count, 100.0 * s.trivially_rejected / count,
+      100.0 * s.clipped / count, 100.0 * s.clipped_guard_band / count);
+}
+
+struct pathological_case
+{
+   const char* name;
+   sr::float4 v[3];
+   int expect_min;   // minimum triangles that must survive
+   int expect_max;
+};
+
+static void run_pathological()
+{
+   const float inf = INFINITY;
+   const pathological_case cases[] =
+   {
+      { "inside",                    { { -0.5f, -0.5f, 0.5f, 1 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 1, 1 },
+      { "vertex on near plane",      { { -0.5f, -0.5f, 0, 1 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 1, 1 },
+      { "lies in near plane",        { { -0.5f, -0.5f, 0, 1 }, { 0.5f, -0.5f, 0, 1 }, { 0, 0.5f, 0, 1 } }, 1, 1 },
+      { "crosses near, one behind",  { { -0.5f, -0.5f, -0.2f, 0.1f }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 2, 2 },
+      { "crosses near, two behind",  { { -0.5f, -0.5f, -0.2f, 0.1f }, { 0.5f, -0.5f, -0.3f, 0.05f }, { 0, 0.5f, 0.5f, 1 } }, 1, 1 },
+      { "behind the eye (w < 0)",    { { -0.5f, -0.5f, -2, -1 }, { 0.5f, -0.5f, -2, -1 }, { 0, 0.5f, -2, -1 } }, 0, 0 },
+      { "vertex at w = 0",           { { 0.3f, 0.2f, -0.1f, 0 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 1, 3 },
+      { "beyond far",                { { -0.5f, -0.5f, 2, 1 }, { 0.5f, -0.5f, 2, 1 }, { 0, 0.5f, 2, 1 } }, 0, 0 },
+      { "crosses far",               { { -0.5f, -0.5f, 2, 1 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 2, 2 },
+      { "huge, inside guard band",   { { -10, -10, 0.5f, 1 }, { 10, -10, 0.5f, 1 }, { 0, 10, 0.5f, 1 } }, 1, 1 },
+      { "huge, beyond guard band",   { { -1e6f, -1e6f, 0.5f, 1 }, { 1e6f, -1e6f, 0.5f, 1 }, { 0, 1e6f, 0.5f, 1 } }, 1, 7 },
+      { "outside left",              { { -3, -0.5f, 0.5f, 1 }, { -2, -0.5f, 0.5f, 1 }, { -2.5f, 0.5f, 0.5f, 1 } }, 0, 0 },
+      { "sliver along near plane",   { { -100, 0, -1e-7f, 1 }, { 100, 0, 1e-7f, 1 }, { 0, 1e-6f, 0, 1 } }, 0, 7 },
+      { "degenerate (collinear)",    { { -0.5f, 0, 0.5f, 1 }, { 0, 0, 0.5f, 1 }, { 0.5f, 0, 0.5f, 1 } }, 1, 1 },
+      { "infinite coordinate",       { { -inf, 0, 0.5f, 1 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 0, 0 },
+      { "NaN coordinate",            { { NAN, 0, 0.5f, 1 }, { 0.5f, -0.5f, 0.5f, 1 }, { 0, 0.5f, 0.5f, 1 } }, 0, 0 },
+   };
+
+   sr::clipper clip(1920, 1080);
+   const float gx = clip.guard_band_x(), gy = clip.guard_band_y();
+   int failures = 0;
+
+   for (const pathological_case& c : cases)
+   {
+      sr::clip_vertices in;
+      in.resize(3);
+      for (int k = 0; k < 3; k++)
+      {
+         in.x[k] = c.v[k].x; in.y[k] = c.v[k].y; in.z[k] = c.v[k].z; in.w[k] = c.v[k].w;
+      }
+      const uint32_t idx[3] = { 0, 1, 2 };
+      sr::clip_output out;
+      clip.clip_triangles(in, idx, 1, out);
+
+      // Every surviving vertex must be inside near/far and the guard band,
+      // and must survive the viewport transform without producing garbage
+      bool ok = true;
+      const int tris = (int)out.indices.size() / 3;
+      for (uint32_t i : out.indices)
+      {
+         const sr::float4 v = out.vertex(in, i);
+         const float eps = 1e-5f * fabsf(v.w) + 1e-7f;
+         ok = ok && v.z >= -eps && v.z <= v.w + eps;
+         ok = ok && fabsf(v.x) <= gx * v.w + eps * gx && fabsf(v.y) <= gy * v.w + eps * gy;
+      }
+      for (int t = 0; t < tris && ok; t++)
+      {
+         sr::raster_triangle rt;
+         const sr::screen_vertex a = clip.to_screen(out.vertex(in, out.indices[t * 3]));
+         const sr::screen_vertex b = clip.to_screen(out.vertex(in, out.indices[t * 3 + 1]));
+         const sr::screen_vertex d = clip.to_screen(out.vertex(in, out.indices[t * 3 + 2]));
+         if (sr::setup_triangle(a, b, d, 1920, 1080, sr::cull_mode::none, rt))
+            ok = rt.min_x >= 0 && rt.max_x <= 1920 && rt.min_y >= 0 && rt.max_y <= 1080;
+      }
+      ok = ok && tris >= c.expect_min && tris <= c.expect_max;
+      failures += !ok;
+      printf("  %-28s -> %d triangle(s)  %s\n", c.name, tris, ok ? "ok" : "FAILED");
+   }
+   printf("pathological cases: %d failure(s)\n", failures);
+}
+
+void run_clip()
+{
+   run_pathological();
+   run_throughput(0.0f);
+   run_throughput(0.01f);
+   run_throughput(0.1f);
+}
+
+}
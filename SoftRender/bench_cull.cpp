@@ -0,0 +1,149 @@
+// Culling: a million boxes scattered over a city-sized ground plane, the
+// camera near the ground looking along it, the view and projection built
+// like the samples' d3dmath.h camera. Frustum culling of boxes and of their
+// bounding spheres, a scalar per-instance loop against cull_frustum(), then
+// the frustum survivors against an occlusion buffer of a few large
+// buildings in front of the camera.
+
+#include "bench.h"
+#include "sr_cull.h"
+
+#include <math.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct instance_bounds
+{
+   sr::float3 lo, hi;
+};
+
+// Reference: each instance on its own, out at the first plane it is behind
+static size_t scalar_frustum(const sr::frustum& f, const std::vector<instance_bounds>& boxes, std::vector<uint32_t>& visible)
+{
+   visible.clear();
+   for (size_t i = 0; i < boxes.size(); i++)
+   {
+      const instance_bounds& b = boxes[i];
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; p++)
+      {
+         const sr::float4& q = f.planes[p];
+         const float x = q.x >= 0.0f ? b.hi.x : b.lo.x;
+         const float y = q.y >= 0.0f ? b.hi.y : b.lo.y;
+         const float z = q.z >= 0.0f ? b.hi.z : b.lo.z;
+         inside = q.x * x + q.y * y + q.z * z + q.w >= 0.0f;
+      }
+      if (inside)
+         visible.push_back((uint32_t)i);
+   }
+   return visible.size();
+}
+
+static size_t scalar_frustum(const sr::frustum& f, const std::vector<sr::float4>& spheres, std::vector<uint32_t>& visible)
+{
+   visible.clear();
+   for (size_t i = 0; i < spheres.size(); i++)
+   {
+      const sr::float4& s = spheres[i];
+      bool inside = true;
+      for (int p = 0; p < 6 && inside; p++)
+      {
+         const sr::float4& q = f.planes[p];
+         inside = q.x * s.x + q.y * s.y + q.z * s.z + q.w >= -s.w;
+      }
+      if (inside)
+         visible.push_back((uint32_t)i);
+   }
+   return visible.size();
+}
+
+static int count_differences(const std::vector<uint32_t>& a, const uint32_t* b, size_t b_count)
+{
+   int diff = (int)(a.size() > b_count ? a.size() - b_count : b_count - a.size());
+   for (size_t i = 0; i < a.size() && i < b_count; i++)
+      diff += a[i] != b[i];
+   return diff;
+}
+
+void run_cull()
+{
+   const size_t count = 1000000;
+   const float extent = 2000.0f;
+   rng r(45);
+
+   std::vector<instance_bounds> aos(count);
+   std::vector<sr::float4> spheres_aos(count);
+   sr::cull_aabbs boxes;
+   sr::cull_spheres spheres;
+   boxes.resize(count);
+   spheres.resize(count);
+   for (size_t i = 0; i < count; i++)
+   {
+      const float x = r.range(-extent, extent), z = r.range(-extent, extent);
+      const sr::float3 size = { r.range(0.5f, 4.0f), r.range(0.5f, 8.0f), r.range(0.5f, 4.0f) };
+      const sr::float3 lo = { x, 0.0f, z }, hi = { x + size.x, size.y, z + size.z };
+      aos[i] = { lo, hi };
+      boxes.set(i, lo, hi);
+      const sr::float3 center = sr::scale(sr::add(lo, hi), 0.5f);
+      const float radius = 0.5f * sqrtf(sr::length_sq(size));
+      spheres_aos[i] = { center.x, center.y, center.z, radius };
+      spheres.set(i, center, radius);
+   }
+
+   const sr::float4x4 view = sr::look_at_lh({ 0.0f, 6.0f, 0.0f }, { 0.0f, 4.0f, 100.0f }, { 0.0f, 1.0f, 0.0f });
+   const sr::float4x4 proj = sr::perspective_fov_lh(3.14159265f / 3.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+   const sr::float4x4 view_proj = sr::mul(view, proj);
+   const sr::frustum f = sr::frustum_from_matrix(view_proj);
+
+   std::vector<uint32_t> reference, visible(count);
+   size_t n = 0;
+   const int rounds = 5;
+
+   double scalar_ms = best_of(rounds, [&] { scalar_frustum(f, aos, reference); });
+   double simd_ms = best_of(rounds, [&] { n = sr::cull_frustum(f, boxes, visible.data()); });
+   printf("  %zu boxes:   scalar %6.2f ms | cull_frustum %6.2f ms (%4.1fx) | %zu visible, %d differ\n", count, scalar_ms, simd_ms,
+      scalar_ms / simd_ms, n, count_differences(reference, visible.data(), n));
+
+   scalar_ms = best_of(rounds, [&] { scalar_frustum(f, spheres_aos, reference); });
+   simd_ms = best_of(rounds, [&] { n = sr::cull_frustum(f, spheres, visible.data()); });
+   printf("  %zu spheres: scalar %6.2f ms | cull_frustum %6.2f ms (%4.1fx) | %zu visible, %d differ\n", count, scalar_ms, simd_ms,
+      scalar_ms / simd_ms, n, count_differences(reference, visible.data(), n));
+
+   // Buildings along the view, from 20 to 200 units out, a street left open
+   // down the middle
+   std::vector<instance_bounds> occluders;
+   for (int i = 0; i < 24; i++)
+   {
+      const float z = 20.0f + 8.0f * i;
+      const float side = i & 1 ? 1.0f : -1.0f;
+      const float x0 = side * r.range(3.0f, 6.0f);
+      const float x1 = x0 + side * r.range(30.0f, 60.0f);
+      occluders.push_back({ { x0 < x1 ? x0 : x1, 0.0f, z }, { x0 < x1 ? x1 : x0, r.range(15.0f, 40.0f), z + r.range(4.0f, 8.0f) } });
+   }
+   occluders.push_back({ { -40.0f, 0.0f, 240.0f }, { 40.0f, 60.0f, 250.0f } });
+
+   n = sr::cull_frustum(f, boxes, visible.data());
+   std::vector<uint32_t> survivors(n);
+   size_t left = 0;
+   sr::occlusion_buffer occlusion;
+   const double raster_ms = best_of(rounds, [&] {
+      occlusion.begin(view_proj);
+      for (const instance_bounds& o : occluders)
+         occlusion.add_occluder(o.lo, o.hi);
+   });
+   const double test_ms = best_of(rounds, [&] {
+      survivors.assign(visible.begin(), visible.begin() + n);
+      occlusion.reset_stats();
+      left = occlusion.cull(boxes, survivors.data(), n);
+   });
+   const sr::occlusion_stats& st = occlusion.stats();
+   printf("  occlusion %dx%d, %zu occluders: %.3f ms to draw, %.3f ms to test %zu boxes | %zu left, %llu occluded, %llu at the near plane\n",
+      occlusion.width(), occlusion.height(), occluders.size(), raster_ms, test_ms, n, left, (unsigned long long)st.occluded,
+      (unsigned long long)st.near_plane);
+   consume(left + n);
+}
+
+}
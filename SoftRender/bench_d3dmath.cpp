@@ -0,0 +1,708 @@
+// d3dmath.h harness: every helper the samples use, the d3dmath.h code and
+// its sr_math.h replacement side by side, against double precision over
+// typical and adversarial inputs, then the degenerate inputs cameras and
+// normals meet in practice, then ns per call.
+//
+// The last line is a gate for the replacement: within 1 ULP of d3dmath.h's
+// worst error on every row, the same kind of result on every degenerate
+// input and at most 25% more time per call, or the run exits with status 2.
+// Another replacement (a SIMD one, say) is checked by adding a struct like
+// sr_math_impl and gating it the same way in run_d3dmath().
+//
+// Errors are in ULPs of a scale that ignores cancellation: the sum of the
+// magnitudes of the products for dot, cross and length_sq, the largest
+// element of the row for matrices, the exact result otherwise.
+
+#include "bench.h"
+#include "bench_d3dx.h"
+#include "sr_math.h"
+
+#include <float.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+static const d3dx::D3DXVECTOR3* dx(const sr::float3& v)
+{
+   return (const d3dx::D3DXVECTOR3*)&v;
+}
+
+static sr::float4x4 from_dx(const d3dx::D3DXMATRIX& m)
+{
+   sr::float4x4 r;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         r.m[i][j] = m.m[i][j];
+   return r;
+}
+
+struct d3dmath_impl
+{
+   static const char* name() { return "d3dmath.h"; }
+
+   static sr::float4x4 rotation_y(float angle)
+   {
+      d3dx::D3DXMATRIX m;
+      return from_dx(*d3dx::D3DMatrixRotationY(&m, angle));
+   }
+
+   static sr::float3 subtract(const sr::float3& a, const sr::float3& b)
+   {
+      d3dx::D3DXVECTOR3 r;
+      d3dx::D3DVec3Subtract(&r, dx(a), dx(b));
+      return { r.x, r.y, r.z };
+   }
+
+   static float length_sq(const sr::float3& a) { return d3dx::D3DVec3LengthSq(dx(a)); }
+
+   static sr::float3 normalize(const sr::float3& a)
+   {
+      d3dx::D3DXVECTOR3 r;
+      d3dx::D3DVec3Normalize(&r, dx(a));
+      return { r.x, r.y, r.z };
+   }
+
+   static sr::float3 cross(const sr::float3& a, const sr::float3& b)
+   {
+      d3dx::D3DXVECTOR3 r;
+      d3dx::D3DVec3Cross(&r, dx(a), dx(b));
+      return { r.x, r.y, r.z };
+   }
+
+   static float dot(const sr::float3& a, const sr::float3& b) { return d3dx::D3DVec3Dot(dx(a), dx(b)); }
+
+   static sr::float4x4 look_at_lh(const sr::float3& eye, const sr::float3& at, const sr::float3& up)
+   {
+      d3dx::D3DXMATRIX m;
+      return from_dx(*d3dx::D3DMatrixLookAtLH(&m, dx(eye), dx(at), dx(up)));
+   }
+
+   static sr::float4x4 perspective_fov_lh(float fovy, float aspect, float zn, float zf)
+   {
+      d3dx::D3DXMATRIX m;
+      return from_dx(*d3dx::D3DMatrixPerspectiveFovLH(&m, fovy, aspect, zn, zf));
+   }
+};
+
+struct sr_math_impl
+{
+   static const char* name() { return "sr_math.h"; }
+   static sr::float4x4 rotation_y(float angle) { return sr::rotation_y(angle); }
+   static sr::float3 subtract(const sr::float3& a, const sr::float3& b) { return sr::sub(a, b); }
+   static float length_sq(const sr::float3& a) { return sr::length_sq(a); }
+   static sr::float3 normalize(const sr::float3& a) { return sr::normalize(a); }
+   static sr::float3 cross(const sr::float3& a, const sr::float3& b) { return sr::cross(a, b); }
+   static float dot(const sr::float3& a, const sr::float3& b) { return sr::dot(a, b); }
+
+   static sr::float4x4 look_at_lh(const sr::float3& eye, const sr::float3& at, const sr::float3& up)
+   {
+      return sr::look_at_lh(eye, at, up);
+   }
+
+   static sr::float4x4 perspective_fov_lh(float fovy, float aspect, float zn, float zf)
+   {
+      return sr::perspective_fov_lh(fovy, aspect, zn, zf);
+   }
+};
+
+enum math_function
+{
+   fn_rotation_y,
+   fn_subtract,
+   fn_length_sq,
+   fn_normalize,
+   fn_cross,
+   fn_dot,
+   fn_look_at,
+   fn_perspective,
+   fn_count,
+};
+
+static const char* const s_function_names[fn_count] = {
+   "rotation_y", "subtract", "length_sq", "normalize", "cross", "dot", "look_at_lh", "perspective_fov_lh",
+};
+
+// Vectors a, b, c and scalars s: the arguments in order, whichever apply
+struct math_input
+{
+   sr::float3 a, b, c;
+   float s[4];
+};
+
+// ---------------------------------------------------------------------------
+// Double-precision references
+
+struct double3
+{
+   double x, y, z;
+};
+
+static double3 to_double(const sr::float3& v)
+{
+   return { v.x, v.y, v.z };
+}
+
+static double3 sub(const double3& a, const double3& b)
+{
+   return { a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static double3 cross(const double3& a, const double3& b)
+{
+   return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static double dot(const double3& a, const double3& b)
+{
+   return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static double3 normalize(const double3& a)
+{
+   const double l = sqrt(dot(a, a));
+   return { a.x / l, a.y / l, a.z / l };
+}
+
+// Columns x, y, z and the translation row, as D3DMatrixLookAtLH lays them out
+static void look_at_double(const sr::float3& eye, const sr::float3& at, const sr::float3& up, double m[4][3])
+{
+   const double3 e = to_double(eye);
+   const double3 z = normalize(sub(to_double(at), e));
+   const double3 x = normalize(cross(to_double(up), z));
+   const double3 y = cross(z, x);
+   const double3 axes[3] = { x, y, z };
+   for (int c = 0; c < 3; c++)
+   {
+      m[0][c] = axes[c].x;
+      m[1][c] = axes[c].y;
+      m[2][c] = axes[c].z;
+      m[3][c] = -dot(axes[c], e);
+   }
+}
+
+// Spacing of floats at |scale|, denormals included
+static double ulp_of(double scale)
+{
+   int e;
+   frexp(fabs(scale), &e);
+   return ldexp(1.0, (e < -125 ? -125 : e) - 24);
+}
+
+// |got - ref| in ULPs of `scale`; a non-finite result where the reference
+// is finite counts as infinitely wrong
+static double ulps(float got, double ref, double scale)
+{
+   if (!isfinite(got))
+      return isfinite(ref) ? INFINITY : 0.0;
+   return fabs(got - ref) / ulp_of(scale);
+}
+
+static double max3(double a, double b, double c)
+{
+   return fmax(a, fmax(b, c));
+}
+
+template <class Impl>
+static double error(math_function fn, const math_input& in)
+{
+   const sr::float3& a = in.a;
+   const sr::float3& b = in.b;
+   const double3 da = to_double(a), db = to_double(b);
+   switch (fn)
+   {
+   case fn_rotation_y:
+   {
+      const sr::float4x4 m = Impl::rotation_y(in.s[0]);
+      const double c = cos((double)in.s[0]), s = sin((double)in.s[0]), scale = fmax(fabs(c), fabs(s));
+      return fmax(fmax(ulps(m.m[0][0], c, scale), ulps(m.m[0][2], -s, scale)), fmax(ulps(m.m[2][0], s, scale), ulps(m.m[2][2], c, scale)));
+   }
+   case fn_subtract:
+   {
+      const sr::float3 r = Impl::subtract(a, b);
+      const double3 ref = sub(da, db);
+      return max3(ulps(r.x, ref.x, ref.x), ulps(r.y, ref.y, ref.y), ulps(r.z, ref.z, ref.z));
+   }
+   case fn_length_sq:
+      return ulps(Impl::length_sq(a), dot(da, da), dot(da, da));
+   case fn_normalize:
+   {
+      const sr::float3 r = Impl::normalize(a);
+      const double3 ref = normalize(da);
+      const double scale = max3(fabs(ref.x), fabs(ref.y), fabs(ref.z));
+      return max3(ulps(r.x, ref.x, scale), ulps(r.y, ref.y, scale), ulps(r.z, ref.z, scale));
+   }
+   case fn_cross:
+   {
+      const sr::float3 r = Impl::cross(a, b);
+      const double3 ref = cross(da, db);
+      return max3(ulps(r.x, ref.x, fabs(da.y * db.z) + fabs(da.z * db.y)), ulps(r.y, ref.y, fabs(da.z * db.x) + fabs(da.x * db.z)),
+         ulps(r.z, ref.z, fabs(da.x * db.y) + fabs(da.y * db.x)));
+   }
+   case fn_dot:
+      return ulps(Impl::dot(a, b), dot(da, db), fabs(da.x * db.x) + fabs(da.y * db.y) + fabs(da.z * db.z));
+   case fn_look_at:
+   {
+      const sr::float4x4 m = Impl::look_at_lh(a, b, in.c);
+      double ref[4][3];
+      look_at_double(a, b, in.c, ref);
+      double worst = 0.0;
+      for (int i = 0; i < 4; i++)
+      {
+         const double scale = max3(fabs(ref[i][0]), fabs(ref[i][1]), fabs(ref[i][2]));
+         for (int j = 0; j < 3; j++)
+            worst = fmax(worst, ulps(m.m[i][j], ref[i][j], scale));
+      }
+      return worst;
+   }
+   case fn_perspective:
+   {
+      const sr::float4x4 m = Impl::perspective_fov_lh(in.s[0], in.s[1], in.s[2], in.s[3]);
+      const double h = cos(0.5 * (double)in.s[0]) / sin(0.5 * (double)in.s[0]);
+      const double q = (double)in.s[3] / ((double)in.s[3] - (double)in.s[2]);
+      const double ref[4] = { h / in.s[1], h, q, -q * in.s[2] };
+      const float got[4] = { m.m[0][0], m.m[1][1], m.m[2][2], m.m[3][2] };
+      double worst = 0.0;
+      for (int k = 0; k < 4; k++)
+         worst = fmax(worst, ulps(got[k], ref[k], ref[k]));
+      return worst;
+   }
+   default:
+      return 0.0;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Inputs
+
+static float signed_log_uniform(rng& r, float lo, float hi)
+{
+   return copysignf(exp2f(r.range(lo, hi)), r.range(-1.0f, 1.0f));
+}
+
+static sr::float3 random_float3(rng& r, float range)
+{
+   return { r.range(-range, range), r.range(-range, range), r.range(-range, range) };
+}
+
+// Each component its own magnitude, 2^-60 to 2^60
+static sr::float3 mixed_float3(rng& r)
+{
+   return { signed_log_uniform(r, -60.0f, 60.0f), signed_log_uniform(r, -60.0f, 60.0f), signed_log_uniform(r, -60.0f, 60.0f) };
+}
+
+static sr::float3 unit_float3(rng& r)
+{
+   double3 d;
+   do
+      d = { r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f) };
+   while (dot(d, d) < 0.01 || dot(d, d) > 1.0);
+   d = normalize(d);
+   return { (float)d.x, (float)d.y, (float)d.z };
+}
+
+// `v` turned by about `angle` radians in a random direction
+static sr::float3 tilt(rng& r, const sr::float3& v, float angle)
+{
+   const double3 d = to_double(v), side = normalize(cross(d, to_double(unit_float3(r))));
+   const double3 t = { d.x + side.x * angle, d.y + side.y * angle, d.z + side.z * angle };
+   return { (float)t.x, (float)t.y, (float)t.z };
+}
+
+static void make_input(math_function fn, bool adversarial, rng& r, math_input& in)
+{
+   in = math_input();
+   switch (fn)
+   {
+   case fn_rotation_y:
+      // Up to 2^17 radians: far enough to need an accurate reduction
+      in.s[0] = adversarial ? signed_log_uniform(r, -20.0f, 17.0f) : r.range(-6.3f, 6.3f);
+      break;
+   case fn_subtract:
+      in.a = adversarial ? mixed_float3(r) : random_float3(r, 100.0f);
+      in.b = random_float3(r, 100.0f);
+      if (adversarial)
+      {
+         // Nearly equal operands, or wildly different ones
+         const float k = 1.0f + r.range(-1e-6f, 1e-6f);
+         in.b = r.next() & 1 ? sr::scale(in.a, k) : mixed_float3(r);
+      }
+      break;
+   case fn_length_sq:
+   case fn_normalize:
+      in.a = random_float3(r, 100.0f);
+      if (adversarial)
+      {
+         // Mixed magnitudes, or within a few ULPs of unit length where
+         // d3dmath.h returns the input unchanged
+         in.a = r.next() & 1 ? mixed_float3(r) : sr::scale(unit_float3(r), 1.0f + r.range(-4.0f, 4.0f) * FLT_EPSILON);
+      }
+      break;
+   case fn_cross:
+   case fn_dot:
+      in.a = random_float3(r, 100.0f);
+      in.b = random_float3(r, 100.0f);
+      if (adversarial)
+      {
+         // Nearly parallel for cross, nearly perpendicular for dot, or mixed
+         // magnitudes
+         const int kind = (int)(r.next() % 3);
+         in.a = kind == 2 ? mixed_float3(r) : sr::scale(unit_float3(r), signed_log_uniform(r, -20.0f, 20.0f));
+         if (kind == 0)
+            in.b = sr::scale(tilt(r, in.a, 1e-4f), r.range(0.5f, 2.0f));
+         else if (kind == 1)
+            in.b = sr::scale(sr::add(sr::normalize(sr::cross(in.a, unit_float3(r))), sr::scale(sr::normalize(in.a), 1e-4f)), r.range(0.5f, 2.0f));
+         else
+            in.b = mixed_float3(r);
+      }
+      break;
+   case fn_look_at:
+      in.a = random_float3(r, 50.0f);
+      in.b = random_float3(r, 50.0f);
+      in.c = r.next() & 1 ? sr::float3{ 0.0f, 1.0f, 0.0f } : unit_float3(r);
+      if (adversarial)
+      {
+         // Far from the origin looking a short way, or looking within 0.01
+         // to 1 degree of up, with an up vector that is not unit length
+         const int kind = (int)(r.next() % 2);
+         in.c = sr::scale(unit_float3(r), exp2f(r.range(-10.0f, 10.0f)));
+         if (kind == 0)
+         {
+            in.a = random_float3(r, 1e5f);
+            in.b = sr::add(in.a, random_float3(r, 10.0f));
+         }
+         else
+         {
+            const float degrees = exp2f(r.range(-6.6f, 0.0f));
+            in.b = sr::add(in.a, sr::scale(tilt(r, sr::normalize(in.c), degrees * 0.0174533f), r.range(1.0f, 100.0f)));
+         }
+      }
+      break;
+   case fn_perspective:
+      in.s[0] = r.range(0.1f, 3.0f);
+      in.s[1] = r.range(0.5f, 3.0f);
+      in.s[2] = r.range(0.01f, 1.0f);
+      in.s[3] = in.s[2] + r.range(1.0f, 1000.0f);
+      if (adversarial)
+      {
+         // Very narrow or nearly 180 degree fields of view, extreme aspect
+         // ratios, a near plane down to 1e-6 and far/near ratios to 1e7
+         in.s[0] = r.next() & 1 ? exp2f(r.range(-13.0f, -3.0f)) : 3.14159265f - exp2f(r.range(-10.0f, -3.0f));
+         in.s[1] = exp2f(r.range(-10.0f, 10.0f));
+         in.s[2] = exp2f(r.range(-20.0f, 0.0f));
+         in.s[3] = in.s[2] * (1.0f + exp2f(r.range(-10.0f, 23.0f)));
+      }
+      break;
+   default:
+      break;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Degenerate inputs
+
+enum result_kind
+{
+   result_finite,
+   result_zero,          // a zero vector, or a matrix with a zero axis
+   result_non_finite,
+};
+
+struct degenerate_case
+{
+   const char* name;
+   math_function fn;
+   math_input in;
+};
+
+static std::vector<degenerate_case> degenerate_cases()
+{
+   const sr::float3 origin = { 0.0f, 0.0f, 0.0f }, up = { 0.0f, 1.0f, 0.0f };
+   auto vec = [](const char* name, math_function fn, const sr::float3& a) {
+      degenerate_case c = { name, fn, math_input() };
+      c.in.a = a;
+      return c;
+   };
+   auto look = [&](const char* name, const sr::float3& eye, const sr::float3& at, const sr::float3& u) {
+      degenerate_case c = { name, fn_look_at, math_input() };
+      c.in.a = eye;
+      c.in.b = at;
+      c.in.c = u;
+      return c;
+   };
+   auto persp = [](const char* name, float fovy, float aspect, float zn, float zf) {
+      degenerate_case c = { name, fn_perspective, math_input() };
+      c.in.s[0] = fovy;
+      c.in.s[1] = aspect;
+      c.in.s[2] = zn;
+      c.in.s[3] = zf;
+      return c;
+   };
+   auto rot = [](const char* name, float angle) {
+      degenerate_case c = { name, fn_rotation_y, math_input() };
+      c.in.s[0] = angle;
+      return c;
+   };
+   return {
+      vec("normalize zero", fn_normalize, origin),
+      vec("normalize |v| = 1e-20", fn_normalize, { 1e-20f, 0.0f, 0.0f }),
+      vec("normalize |v| = 3e19", fn_normalize, { 3e19f, 0.0f, 0.0f }),
+      vec("normalize denormal", fn_normalize, { 1e-40f, 1e-40f, 0.0f }),
+      vec("normalize inf", fn_normalize, { INFINITY, 0.0f, 0.0f }),
+      vec("normalize NaN", fn_normalize, { NAN, 0.0f, 0.0f }),
+      look("look_at eye == at", { 1.0f, 2.0f, 3.0f }, { 1.0f, 2.0f, 3.0f }, up),
+      look("look_at gaze along up", origin, { 0.0f, 5.0f, 0.0f }, up),
+      look("look_at gaze along -up", origin, { 0.0f, -5.0f, 0.0f }, up),
+      look("look_at gaze 1e-3 from up", origin, { 1e-3f, 1.0f, 0.0f }, up),
+      look("look_at gaze 1e-6 from up", origin, { 1e-6f, 1.0f, 0.0f }, up),
+      look("look_at up zero", origin, { 0.0f, 0.0f, 1.0f }, origin),
+      look("look_at eye at 1e7", { 1e7f, 0.0f, 0.0f }, { 1e7f, 0.0f, 1.0f }, up),
+      persp("perspective zn == zf", 1.0f, 1.0f, 1.0f, 1.0f),
+      persp("perspective fovy 0", 0.0f, 1.0f, 0.1f, 100.0f),
+      persp("perspective fovy pi", 3.14159265f, 1.0f, 0.1f, 100.0f),
+      persp("perspective aspect 0", 1.0f, 0.0f, 0.1f, 100.0f),
+      rot("rotation_y 1e30", 1e30f),
+      rot("rotation_y inf", INFINITY),
+   };
+}
+
+static int non_finite_count(const sr::float4x4& m)
+{
+   int n = 0;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         n += !isfinite(m.m[i][j]);
+   return n;
+}
+
+// What came out: the kind, for the gate, and a line for the table
+template <class Impl>
+static result_kind describe(const degenerate_case& c, std::string& text)
+{
+   char buf[160];
+   switch (c.fn)
+   {
+   case fn_normalize:
+   {
+      const sr::float3 v = Impl::normalize(c.in.a);
+      snprintf(buf, sizeof(buf), "(%g, %g, %g)", v.x, v.y, v.z);
+      text = buf;
+      if (!isfinite(v.x) || !isfinite(v.y) || !isfinite(v.z))
+         return result_non_finite;
+      return v.x == 0.0f && v.y == 0.0f && v.z == 0.0f ? result_zero : result_finite;
+   }
+   case fn_look_at:
+   {
+      const sr::float4x4 m = Impl::look_at_lh(c.in.a, c.in.b, c.in.c);
+      if (const int bad = non_finite_count(m))
+      {
+         snprintf(buf, sizeof(buf), "%d elements NaN or inf", bad);
+         text = buf;
+         return result_non_finite;
+      }
+      // Axes are the columns; a zero one makes the view singular
+      double length[3], worst = 0.0;
+      for (int a = 0; a < 3; a++)
+      {
+         for (int b = 0; b < 3; b++)
+         {
+            const double d = (double)m.m[0][a] * m.m[0][b] + (double)m.m[1][a] * m.m[1][b] + (double)m.m[2][a] * m.m[2][b];
+            worst = fmax(worst, fabs(d - (a == b ? 1.0 : 0.0)));
+            if (a == b)
+               length[a] = sqrt(d);
+         }
+      }
+      if (length[0] < 0.5 || length[1] < 0.5 || length[2] < 0.5)
+      {
+         snprintf(buf, sizeof(buf), "axis lengths %g %g %g", length[0], length[1], length[2]);
+         text = buf;
+         return result_zero;
+      }
+      snprintf(buf, sizeof(buf), "orthonormal to %.1e, %.3g ULPs from double", worst, error<Impl>(fn_look_at, c.in));
+      text = buf;
+      return result_finite;
+   }
+   case fn_perspective:
+   case fn_rotation_y:
+   {
+      const sr::float4x4 m = c.fn == fn_perspective ? Impl::perspective_fov_lh(c.in.s[0], c.in.s[1], c.in.s[2], c.in.s[3])
+                                                    : Impl::rotation_y(c.in.s[0]);
+      if (c.fn == fn_perspective)
+         snprintf(buf, sizeof(buf), "_11 %g _22 %g _33 %g _43 %g", m.m[0][0], m.m[1][1], m.m[2][2], m.m[3][2]);
+      else
+         snprintf(buf, sizeof(buf), "cos %g sin %g, %.3g ULPs from double", m.m[0][0], m.m[2][0], error<Impl>(fn_rotation_y, c.in));
+      text = buf;
+      return non_finite_count(m) ? result_non_finite : result_finite;
+   }
+   default:
+      text = "";
+      return result_finite;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Measurements
+
+struct impl_report
+{
+   const char* name;
+   double worst[fn_count][2];           // typical, adversarial
+   std::vector<result_kind> kinds;
+   std::vector<std::string> texts;
+   double ns[fn_count];
+};
+
+// One timed round of 100 calls per input
+template <class Impl>
+static double time_function(math_function fn, const std::vector<math_input>& in)
+{
+   const int rounds = 100;
+   std::vector<sr::float4x4> m(in.size());
+   std::vector<sr::float3> v(in.size());
+   std::vector<float> s(in.size());
+   const size_t n = in.size();
+   const double ms = best_of(1, [&] {
+      for (int k = 0; k < rounds; k++)
+      {
+         switch (fn)
+         {
+         case fn_rotation_y: for (size_t i = 0; i < n; i++) m[i] = Impl::rotation_y(in[i].s[0]); break;
+         case fn_subtract: for (size_t i = 0; i < n; i++) v[i] = Impl::subtract(in[i].a, in[i].b); break;
+         case fn_length_sq: for (size_t i = 0; i < n; i++) s[i] = Impl::length_sq(in[i].a); break;
+         case fn_normalize: for (size_t i = 0; i < n; i++) v[i] = Impl::normalize(in[i].a); break;
+         case fn_cross: for (size_t i = 0; i < n; i++) v[i] = Impl::cross(in[i].a, in[i].b); break;
+         case fn_dot: for (size_t i = 0; i < n; i++) s[i] = Impl::dot(in[i].a, in[i].b); break;
+         case fn_look_at: for (size_t i = 0; i < n; i++) m[i] = Impl::look_at_lh(in[i].a, in[i].b, in[i].c); break;
+         case fn_perspective: for (size_t i = 0; i < n; i++) m[i] = Impl::perspective_fov_lh(in[i].s[0], in[i].s[1], in[i].s[2], in[i].s[3]); break;
+         default: break;
+         }
+      }
+   });
+   consume((uint64_t)(m[n / 2].m[0][0] * 1000.0f) + (uint64_t)(v[n / 3].y * 1000.0f) + (uint64_t)s[n / 5]);
+   return ms * 1e6 / ((double)n * rounds);
+}
+
+template <class Impl>
+static impl_report measure(const std::vector<math_input> (&inputs)[fn_count][2], const std::vector<degenerate_case>& cases)
+{
+   impl_report rep;
+   rep.name = Impl::name();
+   for (int f = 0; f < fn_count; f++)
+   {
+      for (int adversarial = 0; adversarial < 2; adversarial++)
+      {
+         double worst = 0.0;
+         for (const math_input& in : inputs[f][adversarial])
+            worst = fmax(worst, error<Impl>((math_function)f, in));
+         rep.worst[f][adversarial] = worst;
+      }
+   }
+   for (const degenerate_case& c : cases)
+   {
+      std::string text;
+      rep.kinds.push_back(describe<Impl>(c, text));
+      rep.texts.push_back(text);
+   }
+   return rep;
+}
+
+// ns per call of both, a round of one then a round of the other and the
+// best of each, so a slow stretch of the machine lands on both rather than
+// on whichever ran through it
+template <class Base, class Cand>
+static void time_both(const std::vector<math_input> (&inputs)[fn_count][2], impl_report& base, impl_report& cand)
+{
+   const int turns = 15;
+   for (int f = 0; f < fn_count; f++)
+   {
+      const std::vector<math_input> typical(inputs[f][0].begin(), inputs[f][0].begin() + 4096);
+      base.ns[f] = cand.ns[f] = 1e30;
+      for (int t = 0; t < turns; t++)
+      {
+         base.ns[f] = fmin(base.ns[f], time_function<Base>((math_function)f, typical));
+         cand.ns[f] = fmin(cand.ns[f], time_function<Cand>((math_function)f, typical));
+      }
+   }
+}
+
+// The candidate may be 1 ULP worse than the baseline on any row, must give
+// the same kind of result on every degenerate input and take at most 25%
+// longer, plus 0.2 ns of timer noise
+static bool gate(const impl_report& base, const impl_report& cand, const std::vector<degenerate_case>& cases)
+{
+   std::string failures;
+   char buf[160];
+   for (int f = 0; f < fn_count; f++)
+   {
+      for (int adversarial = 0; adversarial < 2; adversarial++)
+      {
+         if (!(cand.worst[f][adversarial] <= base.worst[f][adversarial] + 1.0))
+         {
+            snprintf(buf, sizeof(buf), " %s %s %.3g ULPs;", s_function_names[f], adversarial ? "adversarial" : "typical", cand.worst[f][adversarial]);
+            failures += buf;
+         }
+      }
+      if (cand.ns[f] > base.ns[f] * 1.25 + 0.2)
+      {
+         snprintf(buf, sizeof(buf), " %s %.2f ns;", s_function_names[f], cand.ns[f]);
+         failures += buf;
+      }
+   }
+   for (size_t i = 0; i < cases.size(); i++)
+   {
+      if (cand.kinds[i] != base.kinds[i])
+      {
+         snprintf(buf, sizeof(buf), " %s;", cases[i].name);
+         failures += buf;
+      }
+   }
+   printf("  gate, %s against %s: %s%s\n", cand.name, base.name, failures.empty() ? "PASS" : "FAIL:", failures.c_str());
+   return failures.empty();
+}
+
+void run_d3dmath()
+{
+   const int n = 100000;
+   rng r(46);
+   static std::vector<math_input> inputs[fn_count][2];
+   for (int f = 0; f < fn_count; f++)
+   {
+      for (int adversarial = 0; adversarial < 2; adversarial++)
+      {
+         inputs[f][adversarial].resize(n);
+         for (math_input& in : inputs[f][adversarial])
+            make_input((math_function)f, adversarial != 0, r, in);
+      }
+   }
+   const std::vector<degenerate_case> cases = degenerate_cases();
+
+   impl_report base = measure<d3dmath_impl>(inputs, cases);
+   impl_report cand = measure<sr_math_impl>(inputs, cases);
+   time_both<d3dmath_impl, sr_math_impl>(inputs, base, cand);
+
+   printf("  max ULPs against double over %d inputs each, %s | %s:\n", n, base.name, cand.name);
+   printf("    %-20s %-19s %-19s\n", "", "typical", "adversarial");
+   for (int f = 0; f < fn_count; f++)
+      printf("    %-20s %8.3g | %-8.3g %8.3g | %-8.3g\n", s_function_names[f], base.worst[f][0], cand.worst[f][0], base.worst[f][1], cand.worst[f][1]);
+
+   printf("  degenerate inputs:\n");
+   for (size_t i = 0; i < cases.size(); i++)
+   {
+      if (base.texts[i] == cand.texts[i])
+         printf("    %-28s both: %s\n", cases[i].name, base.texts[i].c_str());
+      else
+         printf("    %-28s %s: %s | %s: %s\n", cases[i].name, base.name, base.texts[i].c_str(), cand.name, cand.texts[i].c_str());
+   }
+
+   printf("  ns per call, %s | %s:\n", base.name, cand.name);
+   for (int f = 0; f < fn_count; f++)
+      printf("%s%s %.2f | %.2f%s", f % 4 ? "" : "   ", s_function_names[f], base.ns[f], cand.ns[f], f % 4 == 3 ? "\n" : " ; ");
+
+   if (!gate(base, cand, cases))
+      gate_failed();
+}
+
+}
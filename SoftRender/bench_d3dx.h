@@ -0,0 +1,42 @@
+#pragma once
+
+// The samples' d3dmath.h, for the benchmarks that measure against it.
+// d3dmath.h needs D3DXMATRIX, D3DXVECTOR3 and a few Windows typedefs. Its
+// own sincosf would clash with the C library's, so it goes in a namespace
+
+#include <float.h>
+#include <math.h>
+
+namespace d3dx
+{
+
+typedef float FLOAT;
+typedef int BOOL;
+#define CONST const
+
+struct D3DXVECTOR3
+{
+   float x, y, z;
+   D3DXVECTOR3 operator/(float f) const { return { x / f, y / f, z / f }; }
+};
+
+struct D3DXMATRIX
+{
+   union
+   {
+      struct
+      {
+         float _11, _12, _13, _14;
+         float _21, _22, _23, _24;
+         float _31, _32, _33, _34;
+         float _41, _42, _43, _44;
+      };
+      float m[4][4];
+   };
+};
+
+#include "../DXGISample/d3dmath.h"
+
+#undef CONST
+
+}
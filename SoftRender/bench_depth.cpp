@@ -0,0 +1,163 @@
+// Hierarchical-Z vs flat depth buffer on high-overdraw scenes
+
+#include "bench.h"
+#include "sr_depth.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace bench
+{
+
+struct depth_tri
+{
+   sr::screen_vertex v[3];
+};
+
+// Full-screen layers stacked on top of each other plus a cloud of mid-size
+// triangles: the typical overdraw profile of UI + 3D composition
+static std::vector<depth_tri> make_overdraw_scene(int width, int height, int layers, int small_tris)
+{
+   rng r(1234);
+   std::vector<depth_tri> tris;
+   const float w = (float)width, h = (float)height;
+
+   for (int i = 0; i < layers; i++)
+   {
+      const float z = r.range(0.1f, 0.9f);
+      tris.push_back({ { { 0, 0, z }, { w, 0, z }, { 0, h, z } } });
+      tris.push_back({ { { w, 0, z }, { w, h, z }, { 0, h, z } } });
+   }
+
+   for (int i = 0; i < small_tris; i++)
+   {
+      const float cx = r.range(0, w), cy = r.range(0, h);
+      const float s = r.range(16.0f, 128.0f);
+      depth_tri t;
+      for (int k = 0; k < 3; k++)
+      {
+         t.v[k].x = cx + r.range(-s, s);
+         t.v[k].y = cy + r.range(-s, s);
+         t.v[k].z = r.range(0.05f, 0.95f);
+      }
+      tris.push_back(t);
+   }
+   return tris;
+}
+
+static float max_depth(const depth_tri& t)
+{
+   return std::max(t.v[0].z, std::max(t.v[1].z, t.v[2].z));
+}
+
+// Reference: flat buffer, full memset clear and a per-pixel test everywhere
+static uint64_t draw_flat(std::vector<float>& depth, int width, int height, const std::vector<depth_tri>& tris)
+{
+   std::fill(depth.begin(), depth.end(), 1.0f);
+   uint64_t shaded = 0;
+   for (const depth_tri& t : tris)
+   {
+      sr::raster_triangle rt;
+      if (!sr::setup_triangle(t.v[0], t.v[1], t.v[2], width, height, sr::cull_mode::none, rt))
+         continue;
+      for (int y = rt.min_y; y < rt.max_y; y++)
+      {
+         float* row = &depth[(size_t)y * width];
+         // The same plane evaluation the tiles use, 8 pixels at a time
+         alignas(32) float z[8];
+         for (int x = rt.min_x; x < rt.max_x; x++)
+         {
+            if (((x - rt.min_x) & 7) == 0)
+               sr::v8_store(z, sr::depth_row8(rt, x, y));
+            if (!sr::pixel_inside(rt, x, y))
+               continue;
+            const float pz = sr::clamp(z[(x - rt.min_x) & 7], rt.z_min, rt.z_max);
+            if (pz < row[x])
+            {
+               row[x] = pz;
+               shaded++;
+            }
+         }
+      }
+   }
+   return shaded;
+}
+
+static uint64_t draw_hiz(sr::depth_buffer& db, const std::vector<depth_tri>& tris)
+{
+   db.clear(1.0f);
+   uint64_t shaded = 0;
+   for (const depth_tri& t : tris)
+   {
+      sr::raster_triangle rt;
+      if (!sr::setup_triangle(t.v[0], t.v[1], t.v[2], db.width(), db.height(), sr::cull_mode::none, rt))
+         continue;
+      db.draw(rt, [&](int, int, int mask) { shaded += (uint64_t)sr::popcount32((uint32_t)mask); });
+   }
+   return shaded;
+}
+
+static void run_scene(int width, int height, const char* order_name, std::vector<depth_tri> tris, int order)
+{
+   if (order > 0)
+      std::sort(tris.begin(), tris.end(), [](const depth_tri& a, const depth_tri& b) { return max_depth(a) < max_depth(b); });
+   else if (order < 0)
+      std::sort(tris.begin(), tris.end(), [](const depth_tri& a, const depth_tri& b) { return max_depth(a) > max_depth(b); });
+
+   std::vector<float> flat((size_t)width * height);
+   sr::depth_buffer db(width, height);
+
+   uint64_t flat_shaded = 0, hiz_shaded = 0;
+   const double flat_ms = best_of(3, [&] { flat_shaded = draw_flat(flat, width, height, tris); });
+   db.reset_stats();
+   const double hiz_ms = best_of(3, [&] { db.reset_stats(); hiz_shaded = draw_hiz(db, tris); });
+   consume(flat_shaded + hiz_shaded);
+
+   // Both paths decide coverage on the same fixed-point edges and take depth
+   // from the same plane evaluation: they must agree to the bit
+   size_t mismatches = 0;
+   for (int y = 0; y < height; y++)
+      for (int x = 0; x < width; x++)
+         mismatches += flat[(size_t)y * width + x] != db.read(x, y);
+   if (mismatches || flat_shaded != hiz_shaded)
+      gate_failed();
+
+   const sr::depth_stats& s = db.stats();
+   const uint64_t tiles = s.tiles_rejected + s.tiles_accepted + s.tiles_tested;
+   printf("%4dx%-4d %-14s flat %8.2f ms  hiz %8.2f ms  (%.2fx)  shaded %llu/%llu  overdraw %.2f  differing %zu\n",
+      width, height, order_name, flat_ms, hiz_ms, flat_ms / hiz_ms,
+      (unsigned long long)hiz_shaded, (unsigned long long)flat_shaded,
+      (double)hiz_shaded / ((double)width * height), mismatches);
+   printf("          tris rejected %llu/%llu  tiles: rejected %.1f%%  accepted %.1f%%  tested %.1f%%  materialized %llu\n",
+      (unsigned long long)s.triangles_rejected, (unsigned long long)s.triangles,
+      100.0 * s.tiles_rejected / (double)(tiles ? tiles : 1),
+      100.0 * s.tiles_accepted / (double)(tiles ? tiles : 1),
+      100.0 * s.tiles_tested / (double)(tiles ? tiles : 1),
+      (unsigned long long)s.tiles_materialized);
+}
+
+static void run_clear(int width, int height)
+{
+   std::vector<float> flat((size_t)width * height);
+   sr::depth_buffer db(width, height);
+   const double flat_ms = best_of(20, [&] { std::fill(flat.begin(), flat.end(), 1.0f); consume((uint64_t)flat[width]); });
+   const double hiz_ms = best_of(20, [&] { db.clear(1.0f); });
+   printf("%4dx%-4d clear          memset %6.3f ms  tile flags %6.3f ms\n", width, height, flat_ms, hiz_ms);
+}
+
+void run_depth()
+{
+   const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+   for (const auto& sz : sizes)
+   {
+      const std::vector<depth_tri> tris = make_overdraw_scene(sz[0], sz[1], 16, 20000);
+      run_scene(sz[0], sz[1], "front-to-back", tris, 1);
+      run_scene(sz[0], sz[1], "submission", tris, 0);
+      run_scene(sz[0], sz[1], "back-to-front", tris, -1);
+      run_clear(sz[0], sz[1]);
+   }
+}
+
+}
@@ -0,0 +1,165 @@
+// Gradient fills at 4K: the sample's vertical background ramp, a translucent
+// horizontal ramp, a diagonal multi-stop mirrored ramp, a focal radial
+// gradient and a rotated, stretched radial gradient with wrap. Each is
+// filled from a 256 and a 1024 entry LUT and compared, time and worst
+// channel error, with a generic per-pixel brush that evaluates the stops for
+// every pixel. The cached rows replicate the one column or row the cache
+// keeps of the ramps and fill the rest from the LUT.
+
+#include "bench.h"
+#include "sr_gradient.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct gradient_case
+{
+   const char* name;
+   std::vector<sr::gradient_stop> stops;
+   sr::extend_mode extend;
+   bool radial;
+   sr::linear_gradient linear;
+   sr::radial_gradient radial_props;
+   sr::float3x2 transform;
+};
+
+// Per-pixel stop evaluation: what a brush without a LUT does
+static void reference_fill(sr::image_rgba8& target, const sr::gradient_brush& brush)
+{
+   for (int y = 0; y < target.height(); y++)
+   {
+      uint32_t* row = target.row(y);
+      for (int x = 0; x < target.width(); x++)
+      {
+         float c[4];
+         brush.stops().evaluate(brush.position(x + 0.5f, y + 0.5f), c);
+         row[x] = (uint32_t)(c[0] + 0.5f) | ((uint32_t)(c[1] + 0.5f) << 8) | ((uint32_t)(c[2] + 0.5f) << 16) | ((uint32_t)(c[3] + 0.5f) << 24);
+      }
+   }
+}
+
+static int max_channel_diff(const sr::image_rgba8& a, const sr::image_rgba8& b)
+{
+   int worst = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      for (int x = 0; x < a.width(); x++)
+      {
+         const uint32_t p = a.at(x, y), q = b.at(x, y);
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p >> c) & 0xff) - (int)((q >> c) & 0xff));
+            worst = d > worst ? d : worst;
+         }
+      }
+   }
+   return worst;
+}
+
+static void run_case(const gradient_case& gc, int width, int height)
+{
+   sr::image_rgba8 reference(width, height), image(width, height);
+   const sr::rect_i all = reference.bounds();
+
+   double reference_ms = 0.0;
+   for (int lut_size : { 256, 1024 })
+   {
+      const sr::gradient_stops stops(gc.stops.data(), gc.stops.size(), gc.extend, lut_size);
+      const sr::gradient_brush brush = gc.radial ? sr::gradient_brush(gc.radial_props, stops, gc.transform)
+                                                 : sr::gradient_brush(gc.linear, stops, gc.transform);
+      if (lut_size == 256)
+         reference_ms = best_of(1, [&] { reference_fill(reference, brush); });
+
+      // Translucent brushes blend, so those runs start from a cleared image
+      const bool clear = !brush.opaque();
+      const double lut_ms = best_of(5, [&] {
+         if (clear)
+            image.clear(0);
+         sr::fill_rect(image, all, brush);
+      });
+      const int diff = max_channel_diff(image, reference);
+
+      sr::gradient_fill_cache cache;
+      cache.fill(image, brush);
+      const double cached_ms = best_of(5, [&] {
+         if (clear)
+            image.clear(0);
+         cache.fill(image, brush);
+      });
+      const int cache_diff = max_channel_diff(image, reference);
+
+      const sr::gradient_cache_stats& st = cache.stats();
+      printf("  %-28s LUT %4d | per-pixel %7.2f ms  LUT %6.2f ms (%5.1fx)  max diff %d | cached %6.2f ms (%s, %.1f KB)  max diff %d\n",
+         gc.name, lut_size, reference_ms, lut_ms, reference_ms / lut_ms, diff, cached_ms,
+         st.uncached ? "not cached" : brush.constant_along_x() ? "one column" : "one row", cache.bytes() / 1024.0, cache_diff);
+      consume(image.at(width / 2, height / 2));
+   }
+}
+
+void run_gradient()
+{
+   const int width = 3840, height = 2160;
+   printf("gradient fills at %dx%d\n", width, height);
+
+   std::vector<gradient_case> cases;
+
+   // m_pBackBufferGradientBrush: (0, 0) -> (0, 1) scaled to the window
+   gradient_case background = {};
+   background.name = "background (vertical)";
+   background.stops = { { 0.0f, { 0.0f, 0.0f, 0.2f, 1.0f } }, { 1.0f, { 0.0f, 0.0f, 0.5f, 1.0f } } };
+   background.extend = sr::extend_mode::clamp;
+   background.linear = { { 0.0f, 0.0f }, { 0.0f, 1.0f } };
+   background.transform = sr::scale3x2((float)width, (float)height);
+   cases.push_back(background);
+
+   // Translucent left to right over the window: one row replicated
+   gradient_case horizontal = {};
+   horizontal.name = "horizontal (translucent)";
+   horizontal.stops = { { 0.0f, { 1.0f, 1.0f, 1.0f, 0.0f } }, { 1.0f, { 0.2f, 0.4f, 0.9f, 0.8f } } };
+   horizontal.extend = sr::extend_mode::clamp;
+   horizontal.linear = { { 0.0f, 0.0f }, { 1.0f, 0.0f } };
+   horizontal.transform = sr::scale3x2((float)width, (float)height);
+   cases.push_back(horizontal);
+
+   // m_pLGBrush stops, translucent, across the diagonal and mirrored
+   gradient_case diagonal = {};
+   diagonal.name = "diagonal 4 stops (mirror)";
+   diagonal.stops = {
+      { 0.0f, { 0.0f, 1.0f, 1.0f, 0.25f } },
+      { 0.3f, { 1.0f, 0.5f, 0.0f, 1.0f } },
+      { 0.6f, { 0.2f, 0.8f, 0.2f, 0.6f } },
+      { 1.0f, { 0.0f, 0.0f, 1.0f, 1.0f } },
+   };
+   diagonal.extend = sr::extend_mode::mirror;
+   diagonal.linear = { { 100.0f, 0.0f }, { 700.0f, 500.0f } };
+   diagonal.transform = sr::identity3x2();
+   cases.push_back(diagonal);
+
+   gradient_case focal = {};
+   focal.name = "radial focal (clamp)";
+   focal.stops = { { 0.0f, { 1.0f, 1.0f, 0.8f, 1.0f } }, { 0.5f, { 1.0f, 0.4f, 0.0f, 1.0f } }, { 1.0f, { 0.1f, 0.0f, 0.2f, 1.0f } } };
+   focal.extend = sr::extend_mode::clamp;
+   focal.radial = true;
+   focal.radial_props = { { 1920.0f, 1080.0f }, { 500.0f, -300.0f }, 1400.0f, 1000.0f };
+   focal.transform = sr::identity3x2();
+   cases.push_back(focal);
+
+   gradient_case rings = {};
+   rings.name = "radial rotated (wrap)";
+   rings.stops = { { 0.0f, { 0.0f, 0.0f, 0.0f, 1.0f } }, { 0.5f, { 1.0f, 1.0f, 1.0f, 1.0f } }, { 1.0f, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+   rings.extend = sr::extend_mode::wrap;
+   rings.radial = true;
+   rings.radial_props = { { 0.0f, 0.0f }, { 0.0f, 0.0f }, 160.0f, 60.0f };
+   rings.transform = sr::mul(sr::rotation3x2(30.0f), sr::translation3x2(1500.0f, 900.0f));
+   cases.push_back(rings);
+
+   for (const gradient_case& gc : cases)
+      run_case(gc, width, height);
+}
+
+}
@@ -0,0 +1,171 @@
+// Transform hierarchy: 100k nodes in a random tree listed depth first, as a
+// scene file would, animated with 100% (through set_locals()), 10% and 1% of
+// the local transforms changing per frame. The naive update walks the nodes in
+// order and multiplies every local matrix by its parent's world matrix, one
+// vec4f mul() each; transform_hierarchy is run on one thread and on a pool.
+// The world matrices must match the naive ones, and with every node moving
+// (the full pass) the hierarchy must be at least as fast as the naive walk
+// on the SIMD backends.
+
+#include "bench.h"
+#include "sr_hierarchy.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace bench
+{
+
+struct hierarchy_scene
+{
+   std::vector<int> parents;
+   std::vector<sr::local_transform> locals;
+   std::vector<sr::quaternion> poses;      // rotations the animation picks from
+};
+
+// 8 roots, then each node under a random earlier one: depth grows with the
+// log of the count, and early nodes get many children
+static void make_scene(rng& r, int count, hierarchy_scene& s)
+{
+   for (int i = 0; i < count; i++)
+   {
+      s.parents.push_back(i < 8 ? -1 : (int)(r.next() % (uint32_t)i));
+      const sr::float3 t = { r.range(-5.0f, 5.0f), r.range(-5.0f, 5.0f), r.range(-5.0f, 5.0f) };
+      const float scale = r.range(0.8f, 1.2f);
+      s.locals.push_back({ t, sr::identity_quaternion(), { scale, scale, scale } });
+   }
+   for (int i = 0; i < 256; i++)
+   {
+      const sr::float3 axis = { r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f), r.range(-1.0f, 1.0f) };
+      s.poses.push_back(sr::rotation_quaternion(axis, r.range(-3.14159265f, 3.14159265f)));
+   }
+}
+
+static void naive_update(const hierarchy_scene& s, std::vector<sr::float4x4>& world)
+{
+   for (size_t i = 0; i < s.parents.size(); i++)
+   {
+      const sr::float4x4 local = sr::local_matrix(s.locals[i]);
+      world[i] = s.parents[i] < 0 ? local : sr::mul(local, world[s.parents[i]]);
+   }
+}
+
+static float max_difference(const sr::transform_hierarchy& h, const std::vector<sr::float4x4>& world, int* differing)
+{
+   float worst = 0.0f;
+   *differing = 0;
+   for (size_t i = 0; i < world.size(); i++)
+   {
+      const sr::float4x4 m = h.world((int)i);
+      if (memcmp(&m, &world[i], sizeof(m)) != 0)
+         (*differing)++;
+      for (int r = 0; r < 4; r++)
+         for (int c = 0; c < 4; c++)
+            worst = fabsf(m.m[r][c] - world[i].m[r][c]) > worst ? fabsf(m.m[r][c] - world[i].m[r][c]) : worst;
+   }
+   return worst;
+}
+
+void run_hierarchy()
+{
+   const int count = 100000, frames = 20;
+   rng r;
+   hierarchy_scene s;
+   make_scene(r, count, s);
+
+   sr::transform_hierarchy h;
+   for (int i = 0; i < count; i++)
+      h.add_node(s.parents[i], s.locals[i]);
+   timer build_time;
+   h.build();
+   const double build_ms = build_time.elapsed_ms();
+   const sr::hierarchy_stats& st = h.last_update();
+   printf("%d nodes, %d levels, %d chunks, %d padding slots, build %.2f ms\n", st.nodes, st.levels, st.chunks, st.padding, build_ms);
+
+   std::vector<sr::float4x4> naive(count);
+   const int hw = (int)std::thread::hardware_concurrency();
+   sr::thread_pool pool(hw > 1 ? hw : 2);
+
+   const double rates[3] = { 1.0, 0.1, 0.01 };
+   for (double rate : rates)
+   {
+      // The same nodes move in every version: a fixed list per frame
+      std::vector<std::vector<int>> moved(frames);
+      for (int f = 0; f < frames; f++)
+      {
+         if (rate >= 1.0)
+         {
+            for (int i = 0; i < count; i++)
+               moved[f].push_back(i);
+         }
+         else
+         {
+            for (int k = 0; k < (int)(count * rate); k++)
+               moved[f].push_back((int)(r.next() % (uint32_t)count));
+         }
+      }
+      auto animate = [&](int f, int i) {
+         sr::local_transform& l = s.locals[i];
+         l.rotation = s.poses[(i + f * 7) & 255];
+         return l;
+      };
+
+      auto naive_frames = [&] {
+         for (int f = 0; f < frames; f++)
+         {
+            for (int i : moved[f])
+               animate(f, i);
+            naive_update(s, naive);
+         }
+      };
+      auto hierarchy_frames = [&](bool threaded) {
+         for (int f = 0; f < frames; f++)
+         {
+            if (rate >= 1.0)
+            {
+               for (int i : moved[f])
+                  animate(f, i);
+               h.set_locals(s.locals.data());
+            }
+            else
+            {
+               for (int i : moved[f])
+                  h.set_local(i, animate(f, i));
+            }
+            h.update(threaded ? &pool : nullptr);
+         }
+      };
+
+      // Taken in turns, so a busy stretch of the machine does not land on
+      // one version only. Every run writes the same locals, so the versions
+      // end up with the same world matrices
+      double naive_ms = 1e30, ms[2] = { 1e30, 1e30 };
+      for (int round = 0; round < 7; round++)
+      {
+         naive_ms = std::min(naive_ms, best_of(1, naive_frames) / frames);
+         for (int threaded = 0; threaded < 2; threaded++)
+            ms[threaded] = std::min(ms[threaded], best_of(1, [&] { hierarchy_frames(threaded != 0); }) / frames);
+      }
+      const sr::hierarchy_stats& u = h.last_update();
+      int differing = 0;
+      const float diff = max_difference(h, naive, &differing);
+      printf("  %5.1f%% dirty: naive %7.3f ms | hierarchy %7.3f ms (%5.1fx) | %d threads %7.3f ms | %6d dirty, %5d groups updated, %5d skipped%s | "
+             "max diff %g (%d matrices differ)\n",
+         rate * 100.0, naive_ms, ms[0], naive_ms / ms[0], pool.threads(), ms[1], u.dirty, u.groups_updated, u.groups_skipped,
+         u.full ? " (full pass)" : "", diff, differing);
+      if (differing)
+         gate_failed();
+#if defined(SR_HAS_SSE2)
+      // The scalar fallback runs each vec8f lane by lane and only reports
+      if (rate >= 1.0 && naive_ms / ms[0] < 1.0)
+         gate_failed();
+#endif
+   }
+   consume((uint64_t)(h.world(count / 2).m[3][0] * 1000.0f));
+}
+
+}
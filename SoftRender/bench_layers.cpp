@@ -0,0 +1,204 @@
+// Opacity layers at 4K: a UI frame with translucent panels full of shapes,
+// images and labels, single-primitive fades, nested groups, opaque clip
+// layers, invisible layers and one full-screen fade. Drawn the naive way (a
+// target-sized surface per layer, allocated each time), with bounds-sized
+// pooled surfaces but nothing folded, and with everything on. The frames
+// must match the naive one, folded layers to within a rounding step.
+
+#include "bench.h"
+#include "sr_layers.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+struct layers_content
+{
+   sr::path_geometry hourglass;
+   sr::image_rgba8 grid, icon;
+   std::vector<sr::gradient_stop> background_stops;
+   std::vector<std::string> labels;
+};
+
+static void make_content(layers_content& s)
+{
+   sr::path_geometry& h = s.hourglass;
+   h.begin_figure({ 0, 0 });
+   h.add_line({ 200, 0 });
+   h.add_bezier({ 150, 50 }, { 150, 150 }, { 200, 200 });
+   h.add_line({ 0, 200 });
+   h.add_bezier({ 50, 150 }, { 50, 50 }, { 0, 0 });
+   h.end_figure(sr::figure_end::closed);
+
+   const uint32_t line = sr::premultiplied_rgba8(0.93f, 0.94f, 0.96f, 1.0f);
+   s.grid.resize(10, 10);
+   for (int i = 0; i < 10; i++)
+   {
+      s.grid.row(0)[i] = line;
+      s.grid.row(i)[0] = line;
+   }
+
+   s.icon.resize(96, 96);
+   for (int y = 0; y < 96; y++)
+      for (int x = 0; x < 96; x++)
+         s.icon.row(y)[x] = sr::premultiplied_rgba8(x / 96.0f, 0.5f, y / 96.0f, ((x / 16 + y / 16) & 1) ? 1.0f : 0.5f);
+
+   s.background_stops = { { 0.0f, { 0.1f, 0.1f, 0.2f, 1.0f } }, { 1.0f, { 0.2f, 0.3f, 0.5f, 1.0f } } };
+   for (int i = 0; i < 32; i++)
+      s.labels.push_back("Setting " + std::to_string(i));
+}
+
+static int max_channel_diff(const sr::image_rgba8& a, const sr::image_rgba8& b)
+{
+   int worst = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      const uint32_t* p = a.row(y);
+      const uint32_t* q = b.row(y);
+      if (memcmp(p, q, a.width() * sizeof(uint32_t)) == 0)
+         continue;
+      for (int x = 0; x < a.width(); x++)
+      {
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p[x] >> c) & 0xff) - (int)((q[x] >> c) & 0xff));
+            worst = d > worst ? d : worst;
+         }
+      }
+   }
+   return worst;
+}
+
+static uint32_t random_color(rng& r, float min_alpha)
+{
+   return sr::premultiplied_rgba8(r.unit(), r.unit(), r.unit(), r.range(min_alpha, 1.0f));
+}
+
+void run_layers()
+{
+   const int width = 3840, height = 2160;
+   layers_content s;
+   make_content(s);
+
+   const sr::gradient_stops stops(s.background_stops.data(), s.background_stops.size());
+   const sr::gradient_brush background(sr::linear_gradient{ { 0.0f, 0.0f }, { 0.0f, 1.0f } }, stops, sr::scale3x2((float)width, (float)height));
+   const sr::bitmap_brush grid(s.grid, sr::extend_mode::wrap, sr::extend_mode::wrap, sr::bitmap_interpolation::linear, sr::identity3x2(), 0.5f);
+   sr::text_format label_format;
+   label_format.font = &sr::builtin_font();
+   label_format.size = 16.0f;
+   const uint32_t white = sr::premultiplied_rgba8(1.0f, 1.0f, 1.0f, 1.0f);
+
+   sr::display_list list;
+   rng r;
+   list.fill_rect(sr::rect_i{ 0, 0, width, height }, background);
+
+   // The grid fading in over the whole screen
+   list.push_layer(0.6f);
+   list.fill_rect(sr::rect_i{ 0, 0, width, height }, grid);
+   list.pop_layer();
+
+   // Panels: a layer each, clipped to the panel
+   for (int i = 0; i < 24; i++)
+   {
+      const int x = (i % 6) * 620 + 40, y = (i / 6) * 520 + 40;
+      const sr::rect_i panel = { x, y, x + 560, y + 460 };
+      list.push_layer(r.range(0.5f, 0.95f), panel);
+      list.fill_rect({ (float)x, (float)y, x + 560.0f, y + 460.0f }, sr::premultiplied_rgba8(0.15f, 0.15f, 0.18f, 0.9f));
+      for (int k = 0; k < 12; k++)
+      {
+         const float bx = x + 16.0f + (k % 4) * 136.0f, by = y + 60.0f + (k / 4) * 130.0f;
+         list.fill_rect({ bx, by, bx + 120.0f, by + 110.0f }, random_color(r, 0.4f));
+      }
+      list.fill_geometry(s.hourglass, sr::mul(sr::rotation3x2(r.range(0.0f, 360.0f)), sr::translation3x2(x + 400.0f, y + 300.0f)), random_color(r, 0.5f));
+      list.draw_image(s.icon, x + 440, y + 20);
+      for (int k = 0; k < 3; k++)
+      {
+         const std::string& label = s.labels[(i * 3 + k) % s.labels.size()];
+         list.draw_text(label.data(), label.size(), label_format, { 0.0f, 0.0f, 300.0f, 24.0f }, sr::translation3x2(x + 16.0f, y + 8.0f + k * 16.0f), white);
+      }
+      list.pop_layer();
+   }
+
+   // Fades of single primitives, with the default infinite content bounds
+   for (int i = 0; i < 160; i++)
+   {
+      const float x = r.range(0.0f, width - 200.0f), y = r.range(0.0f, height - 200.0f);
+      list.push_layer(r.range(0.1f, 0.9f));
+      switch (i % 3)
+      {
+      case 0:
+         list.fill_rect({ x, y, x + r.range(20.0f, 200.0f), y + r.range(20.0f, 200.0f) }, random_color(r, 0.3f));
+         break;
+      case 1:
+         list.fill_geometry(s.hourglass, sr::mul(sr::scale3x2(r.range(0.2f, 0.8f), r.range(0.2f, 0.8f)), sr::translation3x2(x, y)), random_color(r, 0.5f));
+         break;
+      default:
+         list.draw_image(s.icon, (int)x, (int)y, r.range(0.5f, 1.0f));
+         break;
+      }
+      list.pop_layer();
+   }
+
+   // Nested groups: a fading group of fading overlapping pairs
+   for (int i = 0; i < 12; i++)
+   {
+      const float x = r.range(0.0f, width - 500.0f), y = r.range(0.0f, height - 400.0f);
+      list.push_layer(0.8f);
+      for (int k = 0; k < 3; k++)
+      {
+         list.push_layer(r.range(0.3f, 0.9f));
+         list.fill_rect({ x + k * 120.0f, y + k * 80.0f, x + k * 120.0f + 200.0f, y + k * 80.0f + 160.0f }, random_color(r, 0.6f));
+         list.fill_rect({ x + k * 120.0f + 60.0f, y + k * 80.0f + 50.0f, x + k * 120.0f + 260.0f, y + k * 80.0f + 210.0f }, random_color(r, 0.6f));
+         list.pop_layer();
+      }
+      list.pop_layer();
+   }
+
+   // Opaque layers are clips; fully faded-out ones draw nothing
+   for (int i = 0; i < 20; i++)
+   {
+      const int x = (int)r.range(0.0f, width - 300.0f), y = (int)r.range(0.0f, height - 300.0f);
+      list.push_layer(i % 4 == 0 ? 0.0f : 1.0f, { x, y, x + 150, y + 150 });
+      list.fill_geometry(s.hourglass, sr::translation3x2((float)x - 25.0f, (float)y - 25.0f), random_color(r, 0.5f));
+      list.pop_layer();
+   }
+   printf("%dx%d, %zu commands\n", width, height, list.size());
+
+   struct config
+   {
+      const char* name;
+      sr::layer_compositor::options options;
+   };
+   const config configs[] = {
+      { "naive (target-sized) ", { false, false, false } },
+      { "bounds-sized, pooled ", { false, true, true } },
+      { "+ skip, clip and fold", { true, true, true } },
+   };
+
+   sr::image_rgba8 naive(width, height);
+   sr::image_rgba8 image(width, height);
+   for (const config& c : configs)
+   {
+      sr::layer_compositor compositor;
+      compositor.set_options(c.options);
+      sr::image_rgba8& target = c.options.fit_bounds ? image : naive;
+      compositor.render(target, list);   // warms the pool, the atlas and the realizations
+      const double ms = best_of(c.options.fit_bounds ? 5 : 1, [&] { compositor.render(target, list); });
+      const sr::layer_frame_stats& f = compositor.last_frame();
+      printf("  %s %8.2f ms | %3d layers: %3d composited, %3d folded, %2d clipped, %2d skipped\n", c.name, ms, f.layers, f.composited,
+         f.folded, f.clipped, f.skipped);
+      printf("    %7.1f Mpx cleared, %7.1f Mpx composited, peak %6.1f MB in layers, pool %6.1f MB, %d allocations",
+         f.cleared_pixels / 1e6, f.composited_pixels / 1e6, f.peak_bytes / 1048576.0, compositor.pool_bytes() / 1048576.0, f.pool_misses);
+      if (&target == &image)
+         printf(", max diff %d from naive", max_channel_diff(image, naive));
+      printf("\n");
+   }
+   consume(image.at(width / 2, height / 2));
+}
+
+}
@@ -0,0 +1,91 @@
+// SoftRender benchmark driver
+//
+// usage: SoftRender [bench...]
+// With no arguments every benchmark runs; otherwise only the named ones.
+// Exits with 2 when a benchmark's gate failed.
+
+#include "bench.h"
+#include "sr_simd.h"
+
+#include <string.h>
+
+namespace bench
+{
+
+static volatile uint64_t g_sink;
+static bool g_gate_failed;
+
+void consume(uint64_t value)
+{
+   g_sink = g_sink + value;
+}
+
+void gate_failed()
+{
+   g_gate_failed = true;
+}
+
+}
+
+struct bench_entry
+{
+   const char* name;
+   void (*run)();
+};
+
+static const bench_entry s_benches[] =
+{
+   { "depth", bench::run_depth },
+   { "vertex", bench::run_vertex },
+   { "clip", bench::run_clip },
+   { "blend", bench::run_blend },
+   { "msaa", bench::run_msaa },
+   { "path", bench::run_path },
+   { "realize", bench::run_realize },
+   { "scene", bench::run_scene },
+   { "gradient", bench::run_gradient },
+   { "pattern", bench::run_pattern },
+   { "text", bench::run_text },
+   { "resources", bench::run_resources },
+   { "tiles", bench::run_tiles },
+   { "stroke", bench::run_stroke },
+   { "layers", bench::run_layers },
+   { "math", bench::run_math },
+   { "simd_math", bench::run_simd_math },
+   { "hierarchy", bench::run_hierarchy },
+   { "cull", bench::run_cull },
+   { "d3dmath", bench::run_d3dmath },
+   { "quantize", bench::run_quantize },
+   { "mesh", bench::run_mesh },
+   { "sprite", bench::run_sprite },
+   { "upload", bench::run_upload },
+};
+
+int main(int argc, char** argv)
+{
+   printf("SoftRender benchmarks (SIMD backend: %s)\n", sr::simd_backend_name());
+
+   int ran = 0;
+   for (const bench_entry& b : s_benches)
+   {
+      bool selected = argc < 2;
+      for (int i = 1; i < argc; i++)
+         selected = selected || strcmp(argv[i], b.name) == 0;
+      if (!selected)
+         continue;
+
+      printf("\n== %s ==\n", b.name);
+      b.run();
+      ran++;
+   }
+
+   if (ran == 0)
+   {
+      printf("no benchmark matched; available:");
+      for (const bench_entry& b : s_benches)
+         printf(" %s", b.name);
+      printf("\n");
+      return 1;
+   }
+   return bench::g_gate_failed ? 2 : 0;
+}
@@ -0,0 +1,533 @@
+// Vector/matrix math: sr_math.h against the d3dmath.h helpers it replaces
+// (compiled here over stand-ins for the D3DX types), sr_constexpr.h against
+// sr_math.h and the C library, and sr_math.h against double precision,
+// then ns per call for the scalar code and the vec4f versions.
+//
+// Errors against double are in ULPs of the largest element of the row, so
+// an element that cancels to almost nothing does not count for millions.
+
+#include "bench.h"
+#include "bench_d3dx.h"
+#include "sr_constexpr.h"
+#include "sr_math.h"
+#include "sr_vertex.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// What sr_math.h did before: plain loops, summed left to right
+static sr::float4x4 mul_scalar(const sr::float4x4& a, const sr::float4x4& b)
+{
+   sr::float4x4 r;
+   for (int i = 0; i < 4; i++)
+   {
+      for (int j = 0; j < 4; j++)
+      {
+         r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+                     a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+      }
+   }
+   return r;
+}
+
+static sr::float4x4 transpose_scalar(const sr::float4x4& m)
+{
+   sr::float4x4 r;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         r.m[i][j] = m.m[j][i];
+   return r;
+}
+
+// Cofactors, as D3DXMatrixInverse is usually written
+static bool invert_scalar(const sr::float4x4& mat, sr::float4x4& out)
+{
+   const float* m = &mat.m[0][0];
+   float inv[16];
+   inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+   inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+   inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+   inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+   inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+   inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+   inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+   inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+   inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+   inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+   inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+   inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+   inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+   inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+   inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+   inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+   const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+   if (det == 0.0f)
+      return false;
+   const float r = 1.0f / det;
+   for (int i = 0; i < 16; i++)
+      (&out.m[0][0])[i] = inv[i] * r;
+   return true;
+}
+
+// Double-precision references
+
+struct double4x4
+{
+   double m[4][4];
+};
+
+static double4x4 to_double(const sr::float4x4& a)
+{
+   double4x4 r;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         r.m[i][j] = a.m[i][j];
+   return r;
+}
+
+static double4x4 mul_double(const double4x4& a, const double4x4& b)
+{
+   double4x4 r;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+   return r;
+}
+
+// Gauss-Jordan with partial pivoting
+static double4x4 invert_double(double4x4 a)
+{
+   double4x4 r = {};
+   for (int i = 0; i < 4; i++)
+      r.m[i][i] = 1.0;
+   for (int c = 0; c < 4; c++)
+   {
+      int p = c;
+      for (int i = c + 1; i < 4; i++)
+         p = fabs(a.m[i][c]) > fabs(a.m[p][c]) ? i : p;
+      for (int j = 0; j < 4; j++)
+      {
+         double t = a.m[c][j]; a.m[c][j] = a.m[p][j]; a.m[p][j] = t;
+         t = r.m[c][j]; r.m[c][j] = r.m[p][j]; r.m[p][j] = t;
+      }
+      const double k = 1.0 / a.m[c][c];
+      for (int j = 0; j < 4; j++)
+      {
+         a.m[c][j] *= k;
+         r.m[c][j] *= k;
+      }
+      for (int i = 0; i < 4; i++)
+      {
+         if (i == c)
+            continue;
+         const double f = a.m[i][c];
+         for (int j = 0; j < 4; j++)
+         {
+            a.m[i][j] -= f * a.m[c][j];
+            r.m[i][j] -= f * r.m[c][j];
+         }
+      }
+   }
+   return r;
+}
+
+static int64_t ulp_distance(float a, float b)
+{
+   int32_t ia, ib;
+   memcpy(&ia, &a, 4);
+   memcpy(&ib, &b, 4);
+   const int64_t oa = ia < 0 ? (int64_t)INT32_MIN - ia : ia, ob = ib < 0 ? (int64_t)INT32_MIN - ib : ib;
+   return oa > ob ? oa - ob : ob - oa;
+}
+
+// Largest bit difference between two float4x4s
+static int64_t max_ulps(const sr::float4x4& a, const sr::float4x4& b)
+{
+   int64_t worst = 0;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         worst = ulp_distance(a.m[i][j], b.m[i][j]) > worst ? ulp_distance(a.m[i][j], b.m[i][j]) : worst;
+   return worst;
+}
+
+// Error of `a` against `ref` in ULPs of each row's largest reference element
+static double row_ulps(const float* a, const double* ref, int n)
+{
+   double big = 0.0, worst = 0.0;
+   for (int j = 0; j < n; j++)
+      big = fabs(ref[j]) > big ? fabs(ref[j]) : big;
+   if (big == 0.0)
+      return 0.0;
+   int e;
+   frexp(big, &e);
+   const double ulp = ldexp(1.0, e - 24);
+   for (int j = 0; j < n; j++)
+      worst = fabs(a[j] - ref[j]) / ulp > worst ? fabs(a[j] - ref[j]) / ulp : worst;
+   return worst;
+}
+
+static double max_row_ulps(const sr::float4x4& a, const double4x4& ref)
+{
+   double worst = 0.0;
+   for (int i = 0; i < 4; i++)
+   {
+      const double e = row_ulps(a.m[i], ref.m[i], 4);
+      worst = e > worst ? e : worst;
+   }
+   return worst;
+}
+
+static sr::float3 random_float3(rng& r, float range)
+{
+   return { r.range(-range, range), r.range(-range, range), r.range(-range, range) };
+}
+
+static sr::quaternion random_quaternion(rng& r)
+{
+   return sr::rotation_quaternion(random_float3(r, 1.0f), r.range(-3.14159265f, 3.14159265f));
+}
+
+// Rotation, non-uniform scale and translation: the matrices a scene is made of
+static sr::float4x4 random_affine(rng& r)
+{
+   sr::float4x4 m = sr::rotation_matrix(random_quaternion(r));
+   const float s[3] = { r.range(0.25f, 4.0f), r.range(0.25f, 4.0f), r.range(0.25f, 4.0f) };
+   for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+         m.m[i][j] *= s[i];
+   m.m[3][0] = r.range(-100.0f, 100.0f);
+   m.m[3][1] = r.range(-100.0f, 100.0f);
+   m.m[3][2] = r.range(-100.0f, 100.0f);
+   return m;
+}
+
+static sr::float4x4 random_general(rng& r)
+{
+   sr::float4x4 m;
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         m.m[i][j] = r.range(-2.0f, 2.0f);
+   return m;
+}
+
+static sr::float4x4 from_d3dx(const d3dx::D3DXMATRIX& m)
+{
+   sr::float4x4 r;
+   memcpy(r.m, m.m, sizeof(r.m));
+   return r;
+}
+
+static void check_against_d3dmath(rng& r)
+{
+   const int n = 100000;
+   int64_t rot = 0, look = 0, persp = 0, vec = 0;
+   for (int i = 0; i < n; i++)
+   {
+      d3dx::D3DXMATRIX d;
+      const float angle = r.range(-100.0f, 100.0f);
+      d3dx::D3DMatrixRotationY(&d, angle);
+      const int64_t e_rot = max_ulps(sr::rotation_y(angle), from_d3dx(d));
+      rot = e_rot > rot ? e_rot : rot;
+
+      const sr::float3 eye = random_float3(r, 50.0f), at = random_float3(r, 50.0f), up = random_float3(r, 1.0f);
+      const d3dx::D3DXVECTOR3 de = { eye.x, eye.y, eye.z }, da = { at.x, at.y, at.z }, du = { up.x, up.y, up.z };
+      d3dx::D3DMatrixLookAtLH(&d, &de, &da, &du);
+      const int64_t e_look = max_ulps(sr::look_at_lh(eye, at, up), from_d3dx(d));
+      look = e_look > look ? e_look : look;
+
+      const float fov = r.range(0.1f, 3.0f), aspect = r.range(0.5f, 3.0f), zn = r.range(0.01f, 1.0f), zf = zn + r.range(1.0f, 1000.0f);
+      d3dx::D3DMatrixPerspectiveFovLH(&d, fov, aspect, zn, zf);
+      const int64_t e_persp = max_ulps(sr::perspective_fov_lh(fov, aspect, zn, zf), from_d3dx(d));
+      persp = e_persp > persp ? e_persp : persp;
+
+      d3dx::D3DXVECTOR3 dn, dc;
+      d3dx::D3DVec3Normalize(&dn, &de);
+      d3dx::D3DVec3Cross(&dc, &de, &da);
+      const sr::float3 sn = sr::normalize(eye), sc = sr::cross(eye, at);
+      const float pairs[7][2] = { { sn.x, dn.x }, { sn.y, dn.y }, { sn.z, dn.z }, { sc.x, dc.x }, { sc.y, dc.y }, { sc.z, dc.z },
+                                  { sr::dot(eye, at), d3dx::D3DVec3Dot(&de, &da) } };
+      for (const auto& p : pairs)
+         vec = ulp_distance(p[0], p[1]) > vec ? ulp_distance(p[0], p[1]) : vec;
+   }
+   printf("  against d3dmath.h, max ULPs over %d random inputs:\n", n);
+   printf("    rotation_y %lld | look_at_lh %lld | perspective_fov_lh %lld | normalize, cross, dot %lld\n",
+      (long long)rot, (long long)look, (long long)persp, (long long)vec);
+}
+
+// The sample's camera and projection, and a UI projection, as constants.
+// The expected values are what sqrtf, sinf, cosf and the runtime builders
+// give
+namespace baked
+{
+
+constexpr sr::float4x4 view = sr::cx::look_at_lh({ 0.0f, 2.0f, -6.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+constexpr sr::float4x4 projection = sr::cx::perspective_fov_lh(3.14159265f * 0.24f, 16.0f / 9.0f, 0.1f, 100.0f);
+constexpr sr::float4x4 view_projection = sr::cx::mul(view, projection);
+constexpr sr::float4x4 ui = sr::ortho_off_center_lh(0.0f, 1920.0f, 1080.0f, 0.0f, 0.0f, 1.0f);
+
+static_assert(sr::cx::sqrt(2.0f) == 0x1.6a09e6p+0f && sr::cx::sqrt(3.0f) == 0x1.bb67aep+0f && sr::cx::sqrt(1e-30f) == 0x1.203afap-50f, "sqrt");
+static_assert(sr::cx::sqrt(0.25f) == 0.5f && sr::cx::sqrt(0.0f) == 0.0f, "sqrt");
+static_assert(sr::cx::sin(1.0f) == 0x1.aed548p-1f && sr::cx::cos(1.0f) == 0x1.14a28p-1f, "sin, cos");
+static_assert(sr::cx::rotation_y(0.5f).m[0][0] == 0x1.c1528p-1f && sr::cx::rotation_y(0.5f).m[2][0] == 0x1.eaee88p-2f, "rotation_y");
+static_assert(view.m[1][1] == 0x1.e5b9dp-1f && view.m[1][2] == -0x1.43d136p-2f && view.m[2][1] == 0x1.43d136p-2f && view.m[3][2] == 0x1.94c582p+2f,
+   "look_at_lh");
+static_assert(projection.m[0][0] == 0x1.6bb3d6p+0f && projection.m[1][1] == 0x1.434a86p+1f && projection.m[2][2] == 0x1.00419ap+0f &&
+   projection.m[3][2] == -0x1.9a029p-4f, "perspective_fov_lh");
+static_assert(view_projection.m[1][1] == 0x1.32b36cp+1f && view_projection.m[1][2] == -0x1.44243p-2f && view_projection.m[2][1] == 0x1.98ef3cp-1f &&
+   view_projection.m[2][2] == 0x1.e63648p-1f && view_projection.m[3][2] == 0x1.8ec532p+2f, "mul");
+static_assert(sr::transform_point(sr::float2{ 0.0f, 0.0f }, sr::mul(sr::translation3x2(-960.0f, -540.0f), sr::scale3x2(1.0f / 960.0f, -1.0f / 540.0f))).x == -1.0f,
+   "3x2");
+static_assert(ui.m[0][0] * 1920.0f + ui.m[3][0] == 1.0f && ui.m[1][1] * 1080.0f + ui.m[3][1] == -1.0f && ui.m[3][1] == 1.0f, "ortho_off_center_lh");
+
+}
+
+// The constexpr functions run at run time against sqrtf, sinf, cosf and the
+// sr_math.h builders
+static void check_constexpr(rng& r)
+{
+   int64_t sqrt_ulps = 0, sin_ulps = 0, sin_far_ulps = 0;
+   int sqrt_count = 0, trig_count = 0, trig_diff = 0;
+   for (uint32_t u = 1; u < 0x7f800000u; u += 997)
+   {
+      float x;
+      memcpy(&x, &u, 4);
+      const int64_t e = ulp_distance(sr::cx::sqrt(x), sqrtf(x));
+      sqrt_ulps = e > sqrt_ulps ? e : sqrt_ulps;
+      sqrt_count++;
+   }
+   for (int i = 0; i < 1000000; i++)
+   {
+      const float x = i & 1 ? r.range(-100.0f, 100.0f) : r.range(-4.0f, 4.0f);
+      const int64_t es = ulp_distance(sr::cx::sin(x), sinf(x)), ec = ulp_distance(sr::cx::cos(x), cosf(x));
+      sin_ulps = es > sin_ulps ? es : sin_ulps;
+      sin_ulps = ec > sin_ulps ? ec : sin_ulps;
+      trig_diff += (es != 0) + (ec != 0);
+      const float far = r.range(-1e5f, 1e5f);
+      const int64_t ef = ulp_distance(sr::cx::sin(far), sinf(far));
+      sin_far_ulps = ef > sin_far_ulps ? ef : sin_far_ulps;
+      trig_count += 2;
+   }
+
+   const int n = 100000;
+   int64_t rot = 0, look = 0, persp = 0, product = 0, quat = 0;
+   for (int i = 0; i < n; i++)
+   {
+      const float angle = r.range(-100.0f, 100.0f);
+      const int64_t e_rot = max_ulps(sr::cx::rotation_y(angle), sr::rotation_y(angle));
+      rot = e_rot > rot ? e_rot : rot;
+
+      const sr::float3 eye = random_float3(r, 50.0f), at = random_float3(r, 50.0f), up = random_float3(r, 1.0f);
+      const int64_t e_look = max_ulps(sr::cx::look_at_lh(eye, at, up), sr::look_at_lh(eye, at, up));
+      look = e_look > look ? e_look : look;
+
+      const float fov = r.range(0.1f, 3.0f), aspect = r.range(0.5f, 3.0f), zn = r.range(0.01f, 1.0f), zf = zn + r.range(1.0f, 1000.0f);
+      const int64_t e_persp = max_ulps(sr::cx::perspective_fov_lh(fov, aspect, zn, zf), sr::perspective_fov_lh(fov, aspect, zn, zf));
+      persp = e_persp > persp ? e_persp : persp;
+
+      const sr::float4x4 a = random_general(r), b = random_general(r);
+      const int64_t e_mul = max_ulps(sr::cx::mul(a, b), sr::mul(a, b));
+      product = e_mul > product ? e_mul : product;
+
+      const sr::quaternion qc = sr::cx::rotation_quaternion(up, angle), qr = sr::rotation_quaternion(up, angle);
+      const float pairs[4][2] = { { qc.x, qr.x }, { qc.y, qr.y }, { qc.z, qr.z }, { qc.w, qr.w } };
+      for (const auto& p : pairs)
+         quat = ulp_distance(p[0], p[1]) > quat ? ulp_distance(p[0], p[1]) : quat;
+   }
+   printf("  constexpr at run time, max ULPs:\n");
+   printf("    sqrt %lld (%d floats) | sin, cos %lld (%d of %d differ), to 1e5 %lld\n", (long long)sqrt_ulps, sqrt_count, (long long)sin_ulps,
+      trig_diff, trig_count, (long long)sin_far_ulps);
+   printf("    rotation_y %lld | look_at_lh %lld | perspective_fov_lh %lld | mul %lld | rotation_quaternion %lld\n", (long long)rot,
+      (long long)look, (long long)persp, (long long)product, (long long)quat);
+}
+
+static void check_against_double(rng& r)
+{
+   const int n = 100000;
+   double mul_simd = 0.0, mul_loop = 0.0, inv_affine = 0.0, inv_affine_loop = 0.0, points = 0.0, points_loop = 0.0, quat = 0.0;
+   float inv_residual = 0.0f, inv_residual_loop = 0.0f;
+   int singular = 0, points_differ = 0;
+   for (int i = 0; i < n; i++)
+   {
+      const sr::float4x4 a = random_affine(r), b = random_affine(r);
+      const double4x4 ab = mul_double(to_double(a), to_double(b));
+      const sr::float4x4 p = sr::mul(a, b), q = mul_scalar(a, b);
+      mul_simd = fmax(mul_simd, max_row_ulps(p, ab));
+      mul_loop = fmax(mul_loop, max_row_ulps(q, ab));
+
+      sr::float4x4 inv;
+      const double4x4 a_inv = invert_double(to_double(a));
+      if (sr::invert(a, inv))
+         inv_affine = fmax(inv_affine, max_row_ulps(inv, a_inv));
+      if (invert_scalar(a, inv))
+         inv_affine_loop = fmax(inv_affine_loop, max_row_ulps(inv, a_inv));
+
+      // General matrices: how far M * M^-1 is from the identity
+      const sr::float4x4 g = random_general(r);
+      if (sr::invert(g, inv))
+      {
+         const sr::float4x4 id = sr::mul(g, inv);
+         for (int k = 0; k < 4; k++)
+            for (int j = 0; j < 4; j++)
+               inv_residual = fmaxf(inv_residual, fabsf(id.m[k][j] - (k == j ? 1.0f : 0.0f)));
+      }
+      else
+      {
+         singular++;
+      }
+      if (invert_scalar(g, inv))
+      {
+         const sr::float4x4 id = sr::mul(g, inv);
+         for (int k = 0; k < 4; k++)
+            for (int j = 0; j < 4; j++)
+               inv_residual_loop = fmaxf(inv_residual_loop, fabsf(id.m[k][j] - (k == j ? 1.0f : 0.0f)));
+      }
+
+      const sr::float3 v = random_float3(r, 100.0f);
+      sr::float4 t;
+      sr::transform_points(&v, 1, a, &t);
+      const double4x4 da = to_double(a);
+      double ref[4];
+      for (int j = 0; j < 4; j++)
+         ref[j] = v.x * da.m[0][j] + v.y * da.m[1][j] + v.z * da.m[2][j] + da.m[3][j];
+      points = fmax(points, row_ulps(&t.x, ref, 4));
+      const sr::float4 u = {
+         v.x * a.m[0][0] + v.y * a.m[1][0] + v.z * a.m[2][0] + a.m[3][0],
+         v.x * a.m[0][1] + v.y * a.m[1][1] + v.z * a.m[2][1] + a.m[3][1],
+         v.x * a.m[0][2] + v.y * a.m[1][2] + v.z * a.m[2][2] + a.m[3][2],
+         v.x * a.m[0][3] + v.y * a.m[1][3] + v.z * a.m[2][3] + a.m[3][3],
+      };
+      points_loop = fmax(points_loop, row_ulps(&u.x, ref, 4));
+      points_differ += memcmp(&t, &u, sizeof(t)) != 0;
+
+      // Composing quaternions and composing their matrices agree
+      const sr::quaternion qa = random_quaternion(r), qb = random_quaternion(r);
+      const sr::float4x4 mq = sr::rotation_matrix(sr::mul(qa, qb));
+      const sr::float4x4 mm = sr::mul(sr::rotation_matrix(qa), sr::rotation_matrix(qb));
+      for (int k = 0; k < 3; k++)
+         for (int j = 0; j < 3; j++)
+            quat = fmax(quat, fabs(mq.m[k][j] - mm.m[k][j]));
+      const sr::float3 rv = sr::rotate(v, qa);
+      const sr::float4 mv = sr::transform_point(v, sr::rotation_matrix(qa));
+      quat = fmax(quat, fmax(fabs(rv.x - mv.x), fmax(fabs(rv.y - mv.y), fabs(rv.z - mv.z))) / 100.0);
+   }
+   printf("  against double precision, max ULPs of each row's largest element over %d random inputs, scalar -> %s:\n", n,
+      sr::simd_backend_name());
+   printf("    mul %.2f -> %.2f | invert, affine %.2f -> %.2f | transform_points %.2f -> %.2f, %d points not bit for bit\n",
+      mul_loop, mul_simd, inv_affine_loop, inv_affine, points_loop, points, points_differ);
+   // transform_points rounds as the loop does: any difference is a bug
+   if (points_differ)
+      gate_failed();
+   printf("    invert, general: |M M^-1 - I| <= %.2g -> %.2g (%d singular) | quaternion vs matrix composition <= %.2g\n",
+      inv_residual_loop, inv_residual, singular, quat);
+}
+
+void run_math()
+{
+   printf("vec4f on %s\n", sr::simd_backend_name());
+   rng r;
+   check_against_d3dmath(r);
+   check_constexpr(r);
+   check_against_double(r);
+
+   const int count = 4096, rounds = 200;
+   std::vector<sr::float4x4> a(count), b(count), out(count);
+   std::vector<sr::quaternion> qa(count), qb(count), qout(count);
+   std::vector<sr::float3> eyes(count), ats(count);
+   for (int i = 0; i < count; i++)
+   {
+      a[i] = random_affine(r);
+      b[i] = random_affine(r);
+      qa[i] = random_quaternion(r);
+      qb[i] = random_quaternion(r);
+      eyes[i] = random_float3(r, 50.0f);
+      ats[i] = random_float3(r, 50.0f);
+   }
+   auto sink = [&] {
+      uint64_t h = 0;
+      for (int i = 0; i < count; i += 97)
+      {
+         uint32_t u;
+         memcpy(&u, &out[i].m[1][2], 4);
+         h += u;
+         memcpy(&u, &qout[i].y, 4);
+         h += u;
+      }
+      consume(h);
+   };
+   auto ns = [&](double ms) { return ms * 1e6 / ((double)count * rounds); };
+
+   printf("  ns per call, scalar -> %s:\n", sr::simd_backend_name());
+   const double mul_s = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = mul_scalar(a[i], b[i]); });
+   const double mul_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = sr::mul(a[i], b[i]); });
+   sink();
+   const double tr_s = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = transpose_scalar(a[i]); });
+   const double tr_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = sr::transpose(a[i]); });
+   sink();
+   const double inv_s = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) invert_scalar(a[i], out[i]); });
+   const double inv_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) sr::invert(a[i], out[i]); });
+   sink();
+   const d3dx::D3DXVECTOR3 up = { 0.0f, 1.0f, 0.0f };
+   const double look_s = best_of(5, [&] {
+      for (int k = 0; k < rounds; k++)
+      {
+         for (int i = 0; i < count; i++)
+         {
+            d3dx::D3DXMATRIX d;
+            d3dx::D3DMatrixLookAtLH(&d, (const d3dx::D3DXVECTOR3*)&eyes[i], (const d3dx::D3DXVECTOR3*)&ats[i], &up);
+            memcpy(out[i].m, d.m, sizeof(d.m));
+         }
+      }
+   });
+   const double look_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = sr::look_at_lh(eyes[i], ats[i], { 0.0f, 1.0f, 0.0f }); });
+   sink();
+   const double qmul_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) qout[i] = sr::mul(qa[i], qb[i]); });
+   sink();
+   const double slerp_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) qout[i] = sr::slerp(qa[i], qb[i], 0.3f); });
+   const double qmat_v = best_of(5, [&] { for (int k = 0; k < rounds; k++) for (int i = 0; i < count; i++) out[i] = sr::rotation_matrix(qa[i]); });
+   sink();
+   printf("    mul %.2f -> %.2f | transpose %.2f -> %.2f | invert %.2f -> %.2f | look_at_lh %.2f -> %.2f\n",
+      ns(mul_s), ns(mul_v), ns(tr_s), ns(tr_v), ns(inv_s), ns(inv_v), ns(look_s), ns(look_v));
+   printf("    quaternion mul %.2f | slerp %.2f | rotation_matrix %.2f\n", ns(qmul_v), ns(slerp_v), ns(qmat_v));
+
+   // A million points: one transform_point at a time, transform_points, and
+   // the 8-wide SoA transform the vertex stage uses
+   const size_t points = 1 << 20;
+   std::vector<sr::float3> in(points);
+   std::vector<sr::float4> pout(points);
+   std::vector<float> px(points), py(points), pz(points), ox(points), oy(points), oz(points), ow(points);
+   for (size_t i = 0; i < points; i++)
+   {
+      in[i] = random_float3(r, 100.0f);
+      px[i] = in[i].x;
+      py[i] = in[i].y;
+      pz[i] = in[i].z;
+   }
+   const sr::float4x4 m = sr::mul(a[0], sr::perspective_fov_lh(1.0f, 1.5f, 0.1f, 100.0f));
+   const double one_ms = best_of(5, [&] {
+      for (size_t i = 0; i < points; i++)
+      {
+         const sr::float3& p = in[i];
+         pout[i] = {
+            p.x * m.m[0][0] + p.y * m.m[1][0] + p.z * m.m[2][0] + m.m[3][0],
+            p.x * m.m[0][1] + p.y * m.m[1][1] + p.z * m.m[2][1] + m.m[3][1],
+            p.x * m.m[0][2] + p.y * m.m[1][2] + p.z * m.m[2][2] + m.m[3][2],
+            p.x * m.m[0][3] + p.y * m.m[1][3] + p.z * m.m[2][3] + m.m[3][3],
+         };
+      }
+   });
+   consume((uint64_t)pout[points / 2].w);
+   const double batch_ms = best_of(5, [&] { sr::transform_points(in.data(), points, m, pout.data()); });
+   consume((uint64_t)pout[points / 3].w);
+   const double soa_ms = best_of(5, [&] { sr::transform_positions_soa(m, px.data(), py.data(), pz.data(), points, ox.data(), oy.data(), oz.data(), ow.data()); });
+   consume((uint64_t)ow[points / 3]);
+   printf("  %zu points: scalar %.2f ms (%.0f M/s) | transform_points %.2f ms (%.0f M/s) | SoA 8-wide %.2f ms (%.0f M/s)\n", points,
+      one_ms, points / one_ms / 1e3, batch_ms, points / batch_ms / 1e3, soa_ms, points / soa_ms / 1e3);
+}
+
+}
@@ -0,0 +1,213 @@
+// Mesh pipeline: a 512x512 torus written as OBJ text the way an exporter
+// with no regard for order might leave it, faces and vertex numbers
+// shuffled. Parse time, ACMR, ATVR and overfetch of the position stream
+// before and after optimize_vertex_cache() and optimize_vertex_fetch(),
+// meshlet statistics, file sizes, the time to open and check the binary
+// file against the time to parse the OBJ, and a check that damaged files
+// are refused.
+
+#include "bench.h"
+#include "sr_mesh.h"
+
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench
+{
+
+static std::string make_torus_obj(int side, rng& r)
+{
+   const int n = side * side;
+   const float two_pi = 6.28318531f;
+
+   // Vertex i of the grid is written as number slot[i]
+   std::vector<int> slot(n), order(n);
+   for (int i = 0; i < n; i++)
+      slot[i] = i;
+   for (int i = n - 1; i > 0; i--)
+      std::swap(slot[i], slot[r.next() % (uint32_t)(i + 1)]);
+   for (int i = 0; i < n; i++)
+      order[slot[i]] = i;
+
+   std::string text = "# torus\n";
+   char line[256];
+   for (int k = 0; k < 3; k++)
+   {
+      for (int s = 0; s < n; s++)
+      {
+         const int i = order[s] % side, j = order[s] / side;
+         const float a = two_pi * i / side, b = two_pi * j / side;
+         const float nx = cosf(a) * cosf(b), ny = sinf(b), nz = sinf(a) * cosf(b);
+         if (k == 0)
+            snprintf(line, sizeof(line), "v %.6f %.6f %.6f\n", cosf(a) * 3.0f + nx, ny, sinf(a) * 3.0f + nz);
+         else if (k == 1)
+            snprintf(line, sizeof(line), "vt %.6f %.6f\n", (float)i / side, (float)j / side);
+         else
+            snprintf(line, sizeof(line), "vn %.6f %.6f %.6f\n", nx, ny, nz);
+         text += line;
+      }
+   }
+
+   // Quads, wrapping around both ways, in random order
+   std::vector<int> faces(n);
+   for (int i = 0; i < n; i++)
+      faces[i] = i;
+   for (int i = n - 1; i > 0; i--)
+      std::swap(faces[i], faces[r.next() % (uint32_t)(i + 1)]);
+   for (int f : faces)
+   {
+      const int i = f % side, j = f / side;
+      const int i1 = (i + 1) % side, j1 = (j + 1) % side;
+      const int q[4] = { slot[j * side + i] + 1, slot[j * side + i1] + 1, slot[j1 * side + i1] + 1, slot[j1 * side + i] + 1 };
+      snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", q[0], q[0], q[0], q[1], q[1], q[1], q[2], q[2], q[2], q[3],
+         q[3], q[3]);
+      text += line;
+   }
+   return text;
+}
+
+static bool write_text(const char* path, const std::string& text)
+{
+#if defined(_MSC_VER)
+   FILE* f = nullptr;
+   if (fopen_s(&f, path, "wb") != 0)
+      return false;
+#else
+   FILE* f = fopen(path, "wb");
+   if (!f)
+      return false;
+#endif
+   const bool ok = fwrite(text.data(), 1, text.size(), f) == text.size();
+   return fclose(f) == 0 && ok;
+}
+
+static void print_cache(const char* label, const sr::mesh_data& mesh)
+{
+   const sr::mesh_cache_stats s16 = sr::analyze_mesh(mesh.indices.data(), mesh.indices.size(), mesh.vertex_count(), 8, 16);
+   const sr::mesh_cache_stats s32 = sr::analyze_mesh(mesh.indices.data(), mesh.indices.size(), mesh.vertex_count(), 8, 32);
+   printf("  %-22s ACMR %.3f (FIFO 16) %.3f (FIFO 32) | ATVR %.3f | position overfetch %.2fx\n", label, s16.acmr, s32.acmr, s16.atvr,
+      s16.overfetch);
+}
+
+void run_mesh()
+{
+   rng r(48);
+   const int side = 512;
+   const char* obj_path = "sr_bench_mesh.obj";
+   const char* mesh_path = "sr_bench_mesh.srm";
+   const std::string text = make_torus_obj(side, r);
+   if (!write_text(obj_path, text))
+   {
+      printf("  cannot write %s\n", obj_path);
+      return;
+   }
+
+   const int rounds = 3;
+   sr::mesh_data mesh;
+   bool ok = true;
+   const double parse_ms = best_of(rounds, [&] { ok = sr::load_obj(obj_path, mesh); });
+   if (!ok)
+   {
+      printf("  cannot parse %s\n", obj_path);
+      remove(obj_path);
+      return;
+   }
+   printf("  OBJ %.1f MB: %zu vertices, %zu triangles, parsed in %.1f ms\n", text.size() * 1e-6, mesh.vertex_count(),
+      mesh.indices.size() / 3, parse_ms);
+   print_cache("as exported:", mesh);
+
+   std::vector<uint32_t> original = mesh.indices;
+   const double cache_ms = best_of(rounds, [&] {
+      mesh.indices = original;
+      sr::optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertex_count());
+   });
+   char label[64];
+   snprintf(label, sizeof(label), "vertex cache (%.0f ms):", cache_ms);
+   print_cache(label, mesh);
+
+   timer t;
+   sr::optimize_vertex_fetch(mesh);
+   snprintf(label, sizeof(label), "vertex fetch (%.1f ms):", t.elapsed_ms());
+   print_cache(label, mesh);
+
+   sr::meshlet_data meshlets;
+   const double meshlet_ms = best_of(rounds, [&] { sr::build_meshlets(mesh, meshlets); });
+   const size_t meshlet_count = meshlets.meshlets.size();
+   printf("  %zu meshlets in %.1f ms: %.1f vertices, %.1f triangles each, %.3f vertices a triangle\n", meshlet_count, meshlet_ms,
+      (double)meshlets.vertices.size() / meshlet_count, (double)meshlets.triangles.size() / 3 / meshlet_count,
+      (double)meshlets.vertices.size() / (meshlets.triangles.size() / 3));
+
+   t.reset();
+   ok = sr::write_mesh_file(mesh_path, mesh, meshlets);
+   const double write_ms = t.elapsed_ms();
+   sr::mapped_mesh mapped;
+   const double open_ms = best_of(rounds * 10, [&] { ok = ok && mapped.open(mesh_path); });
+   if (!ok)
+   {
+      printf("  cannot write or map %s\n", mesh_path);
+      remove(obj_path);
+      remove(mesh_path);
+      return;
+   }
+
+   // First use: the quantized positions decoded straight out of the mapping
+   std::vector<sr::float4> positions(mapped.vertex_count());
+   t.reset();
+   sr::decode_positions(mapped.positions(), mapped.vertex_count(), mapped.position(), positions.data());
+   const double decode_ms = t.elapsed_ms();
+   printf("  mesh file %.1f MB (OBJ %.1f MB), written in %.1f ms | mapped and checked in %.3f ms (%.0fx faster than parsing), "
+          "positions decoded from the mapping in %.2f ms\n",
+      mapped.file_size() * 1e-6, text.size() * 1e-6, write_ms, open_ms, parse_ms / open_ms, decode_ms);
+
+   // What came back matches what went in
+   int differ = mapped.vertex_count() != mesh.vertex_count() || mapped.index_count() != mesh.indices.size() ||
+                mapped.meshlet_count() != meshlet_count;
+   for (size_t i = 0; !differ && i < mesh.indices.size(); i++)
+   {
+      const uint32_t index = mapped.index_size() == 2 ? ((const uint16_t*)mapped.indices())[i] : ((const uint32_t*)mapped.indices())[i];
+      differ += index != mesh.indices[i];
+   }
+   double pos_err = 0.0;
+   for (size_t i = 0; !differ && i < mesh.vertex_count(); i++)
+   {
+      const sr::float3& p = mesh.positions[i];
+      pos_err = fmax(pos_err, fmax(fabs(positions[i].x - p.x), fmax(fabs(positions[i].y - p.y), fabs(positions[i].z - p.z))));
+   }
+   sr::input_element layout[4];
+   const size_t elements = mapped.input_layout(layout);
+   printf("  round trip: %s, largest position error %.6f, %zu input elements, %u-bit indices\n", differ ? "MISMATCH" : "indices match",
+      pos_err, elements, mapped.index_size() * 8);
+
+   mapped.close();
+
+   // Damaged files are refused at open: an index past the vertices, a
+   // meshlet running off its vertex list, a meshlet-local index past the
+   // meshlet's vertices
+   int accepted = 0;
+   for (int damage = 0; damage < 3; damage++)
+   {
+      sr::mesh_data bad_mesh = mesh;
+      sr::meshlet_data bad_meshlets = meshlets;
+      if (damage == 0)
+         bad_mesh.indices[bad_mesh.indices.size() / 2] = (uint32_t)mesh.vertex_count();
+      else if (damage == 1)
+         bad_meshlets.meshlets.back().vertex_count++;
+      else
+         bad_meshlets.triangles[1] = (uint8_t)bad_meshlets.meshlets[0].vertex_count;
+      accepted += sr::write_mesh_file(mesh_path, bad_mesh, bad_meshlets) && mapped.open(mesh_path);
+      mapped.close();
+   }
+   printf("  damaged files: %d of 3 accepted\n", accepted);
+   if (differ || accepted)
+      gate_failed();
+
+   remove(obj_path);
+   remove(mesh_path);
+   consume((uint64_t)positions.size());
+}
+
+}
@@ -0,0 +1,216 @@
+// 2D path fill at 4K: the sample's hourglass (at its own size and scaled up),
+// a self-intersecting path of random cubics under both fill rules, and a
+// path of many small circles. Strip coverage is checked against a dense
+// full-frame accumulation of the same lines. Each scene is also rasterized
+// with every tile row sparse and every tile row dense, and a sweep over
+// circle counts finds where dense rows start to win: the crossover that
+// strip_rasterizer's default dense threshold stands for.
+
+#include "bench.h"
+#include "sr_path.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// Same figure as DXGISampleApp::CreateD2DResources
+static void add_hourglass(sr::path_geometry& path)
+{
+   path.begin_figure({ 0, 0 });
+   path.add_line({ 200, 0 });
+   path.add_bezier({ 150, 50 }, { 150, 150 }, { 200, 200 });
+   path.add_line({ 0, 200 });
+   path.add_bezier({ 50, 150 }, { 50, 50 }, { 0, 0 });
+   path.end_figure(sr::figure_end::closed);
+}
+
+static void add_random_cubics(sr::path_geometry& path, int width, int height, int count, uint32_t seed)
+{
+   rng r(seed);
+   auto point = [&]() { return sr::float2{ r.range(0.0f, (float)width), r.range(0.0f, (float)height) }; };
+   path.begin_figure(point());
+   for (int i = 0; i < count; i++)
+      path.add_bezier(point(), point(), point());
+   path.end_figure(sr::figure_end::closed);
+}
+
+static void add_circles(sr::path_geometry& path, int width, int height, int count, uint32_t seed)
+{
+   // Four cubics per circle, control points at the usual 0.5523 of the radius
+   const float k = 0.5522847f;
+   rng r(seed);
+   for (int i = 0; i < count; i++)
+   {
+      const float cx = r.range(0.0f, (float)width), cy = r.range(0.0f, (float)height), d = r.range(3.0f, 40.0f);
+      const float c = d * k;
+      path.begin_figure({ cx + d, cy });
+      path.add_bezier({ cx + d, cy + c }, { cx + c, cy + d }, { cx, cy + d });
+      path.add_bezier({ cx - c, cy + d }, { cx - d, cy + c }, { cx - d, cy });
+      path.add_bezier({ cx - d, cy - c }, { cx - c, cy - d }, { cx, cy - d });
+      path.add_bezier({ cx + c, cy - d }, { cx + d, cy - c }, { cx + d, cy });
+      path.end_figure(sr::figure_end::closed);
+   }
+}
+
+// Every pixel accumulates every line it is under, then a scalar prefix sum.
+// The margin keeps the shapes that cross the left and right edges unclipped.
+static void dense_reference(const std::vector<sr::line_segment>& lines, sr::fill_mode mode, int width, int height,
+                            std::vector<float>& acc, std::vector<uint8_t>& alpha)
+{
+   const int margin = 64;
+   const int stride = width + 2 * margin + 2;
+   acc.assign((size_t)stride * height, 0.0f);
+   for (const sr::line_segment& l : lines)
+      sr::accumulate_line(l, -(float)margin, 0.0f, acc.data(), stride, height);
+
+   alpha.resize((size_t)width * height);
+   for (int y = 0; y < height; y++)
+   {
+      const float* row = &acc[(size_t)y * stride];
+      float sum = 0.0f;
+      for (int x = 0; x < margin; x++)
+         sum += row[x];
+      for (int x = 0; x < width; x++)
+      {
+         sum += row[margin + x];
+         float a = mode == sr::fill_mode::alternate ? fabsf(sum - 2.0f * floorf(sum * 0.5f + 0.5f)) : fminf(fabsf(sum), 1.0f);
+         alpha[(size_t)y * width + x] = (uint8_t)(a * 255.0f + 0.5f);
+      }
+   }
+}
+
+static void expand_coverage(const sr::coverage_strips& cov, int width, int height, std::vector<uint8_t>& alpha)
+{
+   alpha.assign((size_t)width * height, 0);
+   for (const sr::coverage_strip& s : cov.strips)
+   {
+      for (int r = 0; r < sr::coverage_strips::strip_height && s.y + r < height; r++)
+      {
+         const uint8_t* a = cov.strip_row(s, r);
+         for (int x = 0; x < s.width && s.x + x < width; x++)
+            alpha[(size_t)(s.y + r) * width + s.x + x] = a[x];
+      }
+   }
+   for (const sr::coverage_span& s : cov.spans)
+   {
+      for (int x = s.x0; x < s.x1; x++)
+         alpha[(size_t)s.y * width + x] = s.alpha;
+   }
+}
+
+static void run_scene(const char* name, const sr::path_geometry& path, const sr::float3x2& transform, sr::fill_mode mode, int width, int height)
+{
+   std::vector<sr::line_segment> lines;
+   const double flatten_ms = best_of(5, [&] {
+      lines.clear();
+      sr::flatten_path(path, transform, 0.25f, lines);
+   });
+
+   sr::strip_rasterizer raster(width, height);
+   sr::coverage_strips cov;
+   raster.rasterize(lines.data(), lines.size(), mode, cov);
+   raster.reset_stats();
+   raster.rasterize(lines.data(), lines.size(), mode, cov);
+   const sr::strip_stats st = raster.stats();
+   const double raster_ms = best_of(5, [&] { raster.rasterize(lines.data(), lines.size(), mode, cov); });
+   const float threshold = raster.dense_threshold();
+   sr::coverage_strips other;
+   raster.set_dense_threshold(1e30f);
+   const double sparse_ms = best_of(3, [&] { raster.rasterize(lines.data(), lines.size(), mode, other); });
+   raster.set_dense_threshold(0.0f);
+   const double dense_ms = best_of(3, [&] { raster.rasterize(lines.data(), lines.size(), mode, other); });
+   raster.set_dense_threshold(threshold);
+
+   sr::image_rgba8 image(width, height);
+   image.clear(0xffffffffu);
+   const uint32_t color = sr::premultiplied_rgba8(0.0f, 0.0f, 0.0f, 1.0f);
+   const double fill_ms = best_of(5, [&] { sr::fill_coverage(image, cov, color); });
+
+   std::vector<float> acc;
+   std::vector<uint8_t> ref, got;
+   const double reference_ms = best_of(2, [&] { dense_reference(lines, mode, width, height, acc, ref); });
+   expand_coverage(cov, width, height, got);
+   int max_diff = 0;
+   size_t differ = 0;
+   for (size_t i = 0; i < ref.size(); i++)
+   {
+      const int d = abs((int)ref[i] - (int)got[i]);
+      max_diff = d > max_diff ? d : max_diff;
+      differ += d > 1;
+   }
+
+   const double pixels = (double)width * height;
+   printf("%-22s %-9s | %6zu segs %7zu lines | flatten %6.2f ms  raster %6.2f ms (sparse %6.2f, dense rows %6.2f)  fill %6.2f ms | "
+          "reference %7.2f ms (x%.1f) | %6llu strips %5.1f%% px, %6llu spans %5.1f%% px, %4llu dense rows | max diff %d%s\n",
+      name, mode == sr::fill_mode::alternate ? "alternate" : "winding", path.segment_count(), lines.size(),
+      flatten_ms, raster_ms, sparse_ms, dense_ms, fill_ms, reference_ms, reference_ms / raster_ms,
+      (unsigned long long)st.strips, 100.0 * st.strip_pixels / pixels, (unsigned long long)st.spans, 100.0 * st.span_pixels / pixels,
+      (unsigned long long)st.dense_rows, max_diff, differ ? " MISMATCH" : "");
+   consume(image.at(width / 2, height / 2) + cov.alphas.size());
+}
+
+// Circles of growing count: tiles touched per tile of a row against the
+// time with every row sparse and every row dense
+static void run_crossover(int width, int height)
+{
+   printf("crossover: touched tiles per tile of a row, sparse and dense rows\n");
+   const int tiles_x = (width + sr::strip_rasterizer::tile_size - 1) / sr::strip_rasterizer::tile_size;
+   const int tiles_y = (height + sr::strip_rasterizer::tile_size - 1) / sr::strip_rasterizer::tile_size;
+   double crossover = -1.0;
+   const int counts[] = { 1000, 2000, 4000, 8000, 16000, 32000, 64000 };
+   for (int count : counts)
+   {
+      sr::path_geometry circles;
+      add_circles(circles, width, height, count, 13);
+      std::vector<sr::line_segment> lines;
+      sr::flatten_path(circles, sr::identity3x2(), 0.25f, lines);
+
+      sr::strip_rasterizer raster(width, height);
+      sr::coverage_strips cov;
+      raster.set_dense_threshold(1e30f);
+      raster.rasterize(lines.data(), lines.size(), sr::fill_mode::winding, cov);
+      const double touched = (double)raster.stats().tiles / ((double)tiles_x * tiles_y);
+      const double sparse_ms = best_of(3, [&] { raster.rasterize(lines.data(), lines.size(), sr::fill_mode::winding, cov); });
+      raster.set_dense_threshold(0.0f);
+      const double dense_ms = best_of(3, [&] { raster.rasterize(lines.data(), lines.size(), sr::fill_mode::winding, cov); });
+      printf("  %6d circles  %5.2f tiles a tile | sparse %7.2f ms  dense rows %7.2f ms\n", count, touched, sparse_ms, dense_ms);
+      if (crossover < 0.0 && dense_ms < sparse_ms)
+         crossover = touched;
+      consume(cov.alphas.size());
+   }
+   if (crossover < 0.0)
+      printf("  dense rows never win; default threshold %.2f\n", sr::strip_rasterizer().dense_threshold());
+   else
+      printf("  dense rows win from %.2f tiles a tile; default threshold %.2f\n", crossover, sr::strip_rasterizer().dense_threshold());
+}
+
+void run_path()
+{
+   const int width = 3840, height = 2160;
+
+   sr::path_geometry hourglass;
+   add_hourglass(hourglass);
+   // The sample fills it twice, at the bottom left and the top right corner
+   run_scene("hourglass 200px", hourglass, sr::translation3x2(0.0f, (float)(height - 200)), sr::fill_mode::alternate, width, height);
+   const sr::float3x2 big = sr::mul(sr::scale3x2(10.0f, 10.0f), sr::translation3x2(920.0f, 80.0f));
+   run_scene("hourglass x10", hourglass, big, sr::fill_mode::alternate, width, height);
+   run_scene("hourglass x10 rotated", hourglass, sr::mul(big, sr::rotation3x2(30.0f, { 1920.0f, 1080.0f })), sr::fill_mode::winding, width, height);
+
+   sr::path_geometry cubics;
+   add_random_cubics(cubics, width, height, 2000, 7);
+   run_scene("2000 random cubics", cubics, sr::identity3x2(), sr::fill_mode::alternate, width, height);
+   run_scene("2000 random cubics", cubics, sr::identity3x2(), sr::fill_mode::winding, width, height);
+
+   sr::path_geometry circles;
+   add_circles(circles, width, height, 5000, 11);
+   run_scene("5000 circles", circles, sr::identity3x2(), sr::fill_mode::alternate, width, height);
+   run_scene("5000 circles", circles, sr::identity3x2(), sr::fill_mode::winding, width, height);
+
+   run_crossover(width, height);
+}
+
+}
@@ -0,0 +1,203 @@
+// Quantized vertex streams: a 1024x1024 torus with SimpleVertex's position
+// and texture coordinate plus a normal and Test5's float3 color, 44 bytes a
+// vertex in floats. Bytes saved, encode time, decode throughput of each
+// stream against a scalar loop over the one-value helpers, the largest
+// error of each attribute, and the half conversions checked against the
+// scalar ones over every half.
+
+#include "bench.h"
+#include "sr_quantize.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct float_vertex
+{
+   sr::float3 pos;
+   sr::float2 tex;
+   sr::float3 normal;
+   sr::float3 color;
+};
+
+static std::vector<float_vertex> make_torus(int side, float major, float minor)
+{
+   std::vector<float_vertex> v((size_t)side * side);
+   const float two_pi = 6.28318531f;
+   for (int j = 0; j < side; j++)
+   {
+      for (int i = 0; i < side; i++)
+      {
+         const float u = (float)i / (side - 1), w = (float)j / (side - 1);
+         const float a = two_pi * u, b = two_pi * w;
+         const sr::float3 n = { cosf(a) * cosf(b), sinf(b), sinf(a) * cosf(b) };
+         float_vertex& o = v[(size_t)j * side + i];
+         o.pos = { cosf(a) * major + n.x * minor, n.y * minor, sinf(a) * major + n.z * minor };
+         o.tex = { u, w };
+         o.normal = n;
+         o.color = { 0.5f + 0.5f * n.x, 0.5f + 0.5f * n.y, u };
+      }
+   }
+   return v;
+}
+
+static void report_decode(const char* name, size_t count, size_t bytes_in, double scalar_ms, double simd_ms)
+{
+   printf("  %-12s scalar %6.2f ms | SIMD %6.2f ms (%4.1fx) | %6.0f Mvertices/s, %5.1f GB/s read\n", name, scalar_ms, simd_ms,
+      scalar_ms / simd_ms, count / simd_ms * 1e-3, bytes_in / simd_ms * 1e-6);
+}
+
+void run_quantize()
+{
+   const int side = 1024;
+   const size_t count = (size_t)side * side;
+   const std::vector<float_vertex> src = make_torus(side, 40.0f, 12.0f);
+   const int rounds = 5;
+
+   sr::vertex_source source;
+   source.count = count;
+   source.positions = &src[0].pos;
+   source.position_stride = sizeof(float_vertex);
+   source.uvs = &src[0].tex;
+   source.uv_stride = sizeof(float_vertex);
+   source.normals = &src[0].normal;
+   source.normal_stride = sizeof(float_vertex);
+   source.colors = &src[0].color;
+   source.color_stride = sizeof(float_vertex);
+   source.color_components = 3;
+
+   sr::quantized_mesh mesh;
+   const double encode_ms = best_of(rounds, [&] { sr::quantize_mesh(source, sr::uv_encoding::unorm16, mesh); });
+   const size_t float_bytes = count * sizeof(float_vertex);
+   printf("  %zu vertices: %zu bytes a vertex in floats, %zu quantized: %.1f MB -> %.1f MB (%.0f%% saved), encoded in %.2f ms\n", count,
+      sizeof(float_vertex), mesh.bytes() / count, float_bytes * 1e-6, mesh.bytes() * 1e-6,
+      100.0 * (1.0 - (double)mesh.bytes() / float_bytes), encode_ms);
+   printf("  SimpleVertex: %zu bytes -> %u (position and texture coordinate streams)\n", sizeof(sr::float3) + sizeof(sr::float2),
+      sr::format_size(sr::vertex_format::r16g16b16a16_snorm) + sr::format_size(sr::vertex_format::r16g16_unorm));
+
+   sr::input_element layout[4];
+   const size_t elements = mesh.input_layout(layout);
+   printf("  input layout:");
+   for (size_t e = 0; e < elements; e++)
+      printf(" %s slot %u DXGI_FORMAT %u (%u bytes)%s", layout[e].semantic, layout[e].input_slot, (uint32_t)layout[e].format,
+         sr::format_size(layout[e].format), e + 1 < elements ? "," : "\n");
+
+   // Decode, SIMD streams against per-vertex scalar loops
+   std::vector<sr::float4> pos(count), colors(count);
+   std::vector<sr::float2> uvs(count);
+   std::vector<float> nx(count), ny(count), nz(count);
+   const sr::position_quantization q = mesh.position;
+
+   double scalar_ms = best_of(rounds, [&] {
+      const float r = 1.0f / 32767.0f;
+      for (size_t i = 0; i < count; i++)
+      {
+         const int16_t* p = &mesh.positions[4 * i];
+         const float x = p[0] > -32767 ? p[0] : -32767.0f, y = p[1] > -32767 ? p[1] : -32767.0f, z = p[2] > -32767 ? p[2] : -32767.0f;
+         pos[i] = { x * (q.scale.x * r) + q.bias.x, y * (q.scale.y * r) + q.bias.y, z * (q.scale.z * r) + q.bias.z, 1.0f };
+      }
+   });
+   report_decode("positions", count, mesh.positions.size() * 2, scalar_ms,
+      best_of(rounds, [&] { sr::decode_positions(mesh.positions.data(), count, q, pos.data()); }));
+
+   scalar_ms = best_of(rounds, [&] {
+      for (size_t i = 0; i < count; i++)
+         uvs[i] = { mesh.uvs[2 * i] * (1.0f / 65535.0f), mesh.uvs[2 * i + 1] * (1.0f / 65535.0f) };
+   });
+   report_decode("uvs unorm16", count, mesh.uvs.size() * 2, scalar_ms,
+      best_of(rounds, [&] { sr::decode_uvs(mesh.uvs.data(), count, sr::uv_encoding::unorm16, uvs.data()); }));
+
+   scalar_ms = best_of(rounds, [&] {
+      for (size_t i = 0; i < count; i++)
+      {
+         const sr::float3 n = sr::decode_octahedral(&mesh.normals[2 * i]);
+         nx[i] = n.x;
+         ny[i] = n.y;
+         nz[i] = n.z;
+      }
+   });
+   report_decode("normals", count, mesh.normals.size() * 2, scalar_ms,
+      best_of(rounds, [&] { sr::decode_normals(mesh.normals.data(), count, nx.data(), ny.data(), nz.data()); }));
+
+   scalar_ms = best_of(rounds, [&] {
+      for (size_t i = 0; i < count; i++)
+      {
+         const uint8_t* c = &mesh.colors[4 * i];
+         colors[i] = { c[0] * (1.0f / 255.0f), c[1] * (1.0f / 255.0f), c[2] * (1.0f / 255.0f), c[3] * (1.0f / 255.0f) };
+      }
+   });
+   report_decode("colors", count, mesh.colors.size(), scalar_ms,
+      best_of(rounds, [&] { sr::decode_colors(mesh.colors.data(), count, colors.data()); }));
+
+   // The streams against the one-value helpers
+   int normals_differ = 0;
+   for (size_t i = 0; i < count; i++)
+   {
+      int16_t o[2];
+      sr::encode_octahedral(src[i].normal, o);
+      normals_differ += o[0] != mesh.normals[2 * i] || o[1] != mesh.normals[2 * i + 1];
+   }
+
+   // Errors of what was just decoded
+   double pos_err = 0.0, uv_err = 0.0, normal_err = 0.0, color_err = 0.0;
+   for (size_t i = 0; i < count; i++)
+   {
+      const float_vertex& v = src[i];
+      pos_err = fmax(pos_err, fmax(fabs(pos[i].x - v.pos.x), fmax(fabs(pos[i].y - v.pos.y), fabs(pos[i].z - v.pos.z))));
+      uv_err = fmax(uv_err, fmax(fabs(uvs[i].x - v.tex.x), fabs(uvs[i].y - v.tex.y)));
+      const double d = (double)nx[i] * v.normal.x + (double)ny[i] * v.normal.y + (double)nz[i] * v.normal.z;
+      normal_err = fmax(normal_err, acos(fmin(d, 1.0)) * 57.29577951308232);
+      color_err = fmax(color_err, fmax(fabs(colors[i].x - v.color.x), fmax(fabs(colors[i].y - v.color.y), fabs(colors[i].z - v.color.z))));
+   }
+   printf("  max error: position %.5f (extent %.1f, bound %.5f) | uv %.2e | normal %.4f deg | color %.3f/255 | %d normals encoded "
+          "differ from encode_octahedral\n",
+      pos_err, 2.0f * q.scale.x, q.scale.x / 32767.0f, uv_err, normal_err, color_err * 255.0, normals_differ);
+
+   // Half texture coordinates, tiled 8 times
+   std::vector<sr::float2> tiled(count);
+   for (size_t i = 0; i < count; i++)
+      tiled[i] = { src[i].tex.x * 8.0f, src[i].tex.y * 8.0f };
+   std::vector<uint16_t> halves(2 * count);
+   sr::encode_uvs(tiled.data(), sizeof(sr::float2), count, sr::uv_encoding::half, halves.data());
+   int encode_differ = 0;
+   for (size_t i = 0; i < count; i++)
+      encode_differ += (halves[2 * i] != sr::float_to_half(tiled[i].x)) + (halves[2 * i + 1] != sr::float_to_half(tiled[i].y));
+   scalar_ms = best_of(rounds, [&] {
+      for (size_t i = 0; i < count; i++)
+         uvs[i] = { sr::half_to_float(halves[2 * i]), sr::half_to_float(halves[2 * i + 1]) };
+   });
+   report_decode("uvs half", count, halves.size() * 2, scalar_ms,
+      best_of(rounds, [&] { sr::decode_uvs(halves.data(), count, sr::uv_encoding::half, uvs.data()); }));
+   double half_err = 0.0;
+   for (size_t i = 0; i < count; i++)
+      half_err = fmax(half_err, fmax(fabs(uvs[i].x - tiled[i].x), fabs(uvs[i].y - tiled[i].y)));
+
+   // Every half through the streams against the scalar helpers, and back
+   std::vector<uint16_t> all(65536);
+   std::vector<sr::float2> all_f(32768);
+   for (uint32_t h = 0; h < 65536; h++)
+      all[h] = (uint16_t)h;
+   sr::decode_uvs(all.data(), 32768, sr::uv_encoding::half, all_f.data());
+   std::vector<uint16_t> back(65536);
+   sr::encode_uvs(all_f.data(), sizeof(sr::float2), 32768, sr::uv_encoding::half, back.data());
+   int decode_differ = 0, round_trip_differ = 0;
+   for (uint32_t h = 0; h < 65536; h++)
+   {
+      if ((h & 0x7c00) == 0x7c00 && (h & 0x03ff))
+         continue;
+      const float f = (&all_f[0].x)[h], g = sr::half_to_float((uint16_t)h);
+      decode_differ += memcmp(&f, &g, 4) != 0;
+      round_trip_differ += back[h] != h || sr::float_to_half(f) != h;
+   }
+   printf("  half uvs: max error %.2e over [0, 8] | %d of %zu encoded differ from float_to_half | every non-NaN half: %d decoded differ "
+          "from half_to_float, %d do not round trip\n",
+      half_err, encode_differ, 2 * count, decode_differ, round_trip_differ);
+
+   consume((uint64_t)(pos[count / 2].x + uvs[count / 3].y + nx[count / 5] + colors[count / 7].z));
+}
+
+}
@@ -0,0 +1,225 @@
+// Geometry realizations: per-frame cost of path fills at 4K with and without
+// the cache, for the sample's two hourglass fills, a frame of many small
+// shapes, the same shapes scrolling by fractions of a pixel, and that again
+// under a budget too small to hold them. Cached frames are compared with
+// uncached ones: whole-pixel offsets match to rounding, scrolling shapes are
+// off by up to 1/8 pixel with 4 phases and exact with phases disabled.
+
+#include "bench.h"
+#include "sr_realize.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct fill_command
+{
+   const sr::path_geometry* geometry;
+   sr::float3x2 transform;
+   uint32_t color;
+};
+
+static void add_hourglass(sr::path_geometry& path)
+{
+   path.begin_figure({ 0, 0 });
+   path.add_line({ 200, 0 });
+   path.add_bezier({ 150, 50 }, { 150, 150 }, { 200, 200 });
+   path.add_line({ 0, 200 });
+   path.add_bezier({ 50, 150 }, { 50, 50 }, { 0, 0 });
+   path.end_figure(sr::figure_end::closed);
+}
+
+static void add_circle(sr::path_geometry& path, float cx, float cy, float d)
+{
+   const float c = d * 0.5522847f;
+   path.begin_figure({ cx + d, cy });
+   path.add_bezier({ cx + d, cy + c }, { cx + c, cy + d }, { cx, cy + d });
+   path.add_bezier({ cx - c, cy + d }, { cx - d, cy + c }, { cx - d, cy });
+   path.add_bezier({ cx - d, cy - c }, { cx - c, cy - d }, { cx, cy - d });
+   path.add_bezier({ cx + c, cy - d }, { cx + d, cy - c }, { cx + d, cy });
+   path.end_figure(sr::figure_end::closed);
+}
+
+static void add_star(sr::path_geometry& path, int points, float r0, float r1)
+{
+   for (int i = 0; i < 2 * points; i++)
+   {
+      const float a = 3.14159265f * i / points;
+      const float r = i & 1 ? r1 : r0;
+      const sr::float2 p = { r * cosf(a), r * sinf(a) };
+      if (i == 0)
+         path.begin_figure(p);
+      else
+         path.add_line(p);
+   }
+   path.end_figure(sr::figure_end::closed);
+}
+
+static void uncached_fill(sr::image_rgba8& target, const fill_command& c, sr::strip_rasterizer& raster,
+                          std::vector<sr::line_segment>& lines, sr::coverage_strips& coverage)
+{
+   lines.clear();
+   sr::flatten_path(*c.geometry, c.transform, 0.25f, lines);
+   raster.rasterize(lines.data(), lines.size(), c.geometry->get_fill_mode(), coverage);
+   sr::fill_coverage(target, coverage, c.color);
+}
+
+static int max_difference(const sr::image_rgba8& a, const sr::image_rgba8& b)
+{
+   int worst = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      for (int x = 0; x < a.width(); x++)
+      {
+         const uint32_t p = a.at(x, y), q = b.at(x, y);
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p >> c) & 0xff) - (int)((q >> c) & 0xff));
+            worst = d > worst ? d : worst;
+         }
+      }
+   }
+   return worst;
+}
+
+// `frame(i)` returns the fill commands of frame i
+template<class F>
+static void run_scene(const char* name, int frames, size_t budget, int steps, F&& frame)
+{
+   const int width = 3840, height = 2160;
+   sr::image_rgba8 uncached(width, height), cached(width, height);
+   sr::strip_rasterizer raster(width, height);
+   std::vector<sr::line_segment> lines;
+   sr::coverage_strips coverage;
+
+   uncached.clear(0xffffffffu);
+   timer t;
+   for (int i = 0; i < frames; i++)
+   {
+      for (const fill_command& c : frame(i))
+         uncached_fill(uncached, c, raster, lines, coverage);
+   }
+   const double uncached_ms = t.elapsed_ms() / frames;
+
+   sr::realization_cache cache(budget);
+   cache.set_subpixel_steps(steps);
+   cached.clear(0xffffffffu);
+   t.reset();
+   for (const fill_command& c : frame(0))
+      cache.fill(cached, *c.geometry, c.transform, c.color);
+   const double first_ms = t.elapsed_ms();
+   t.reset();
+   for (int i = 1; i <= frames; i++)
+   {
+      for (const fill_command& c : frame(i))
+         cache.fill(cached, *c.geometry, c.transform, c.color);
+   }
+   const double cached_ms = t.elapsed_ms() / frames;
+   const sr::realization_stats st = cache.stats();
+
+   // One more frame of each on a clean target for the comparison
+   uncached.clear(0xffffffffu);
+   cached.clear(0xffffffffu);
+   for (const fill_command& c : frame(frames + 1))
+   {
+      uncached_fill(uncached, c, raster, lines, coverage);
+      cache.fill(cached, *c.geometry, c.transform, c.color);
+   }
+
+   printf("%-22s | %4zu fills | uncached %7.3f ms/frame | cached first %7.3f ms, then %7.3f ms/frame (%5.1f%% saved) | "
+          "edges %llu hit %llu miss | masks %llu hit %llu miss | %llu edge fills | %llu evicted | %6.1f KB | max diff %d\n",
+      name, frame(0).size(), uncached_ms, first_ms, cached_ms, 100.0 * (1.0 - cached_ms / uncached_ms),
+      (unsigned long long)st.edge_hits, (unsigned long long)st.edge_misses,
+      (unsigned long long)st.mask_hits, (unsigned long long)st.mask_misses,
+      (unsigned long long)st.edge_fills, (unsigned long long)st.evictions,
+      cache.bytes() / 1024.0, max_difference(uncached, cached));
+   consume(cached.at(width / 2, height / 2) + uncached.at(width / 2, height / 2));
+}
+
+void run_realize()
+{
+   const int width = 3840, height = 2160;
+   const uint32_t black = sr::premultiplied_rgba8(0.0f, 0.0f, 0.0f, 1.0f);
+
+   sr::path_geometry hourglass;
+   add_hourglass(hourglass);
+
+   // The sample: one geometry at the bottom left and top right corners
+   std::vector<fill_command> sample = {
+      { &hourglass, sr::translation3x2(0.0f, (float)(height - 200)), black },
+      { &hourglass, sr::translation3x2((float)(width - 200), 0.0f), black },
+   };
+   run_scene("sample hourglasses", 200, 32u << 20, 4, [&](int) -> const std::vector<fill_command>& { return sample; });
+
+   // A frame of small shapes: 8 geometries, 3 scales and rotations each
+   std::vector<sr::path_geometry> shapes(8);
+   add_hourglass(shapes[0]);
+   add_circle(shapes[1], 0, 0, 60);
+   add_circle(shapes[2], 0, 0, 80);
+   add_circle(shapes[2], 0, 0, 50);
+   add_star(shapes[3], 5, 90, 35);
+   add_star(shapes[4], 12, 80, 60);
+   add_star(shapes[5], 7, 90, 20);
+   shapes[5].set_fill_mode(sr::fill_mode::winding);
+   add_hourglass(shapes[6]);
+   add_circle(shapes[6], 100, 100, 40);
+   {
+      rng r(5);
+      shapes[7].begin_figure({ 0, 0 });
+      for (int i = 0; i < 12; i++)
+         shapes[7].add_bezier({ r.range(-100, 100), r.range(-100, 100) }, { r.range(-100, 100), r.range(-100, 100) }, { r.range(-100, 100), r.range(-100, 100) });
+      shapes[7].end_figure(sr::figure_end::closed);
+   }
+
+   std::vector<sr::float3x2> variants;
+   for (int k = 0; k < 3; k++)
+      variants.push_back(sr::mul(sr::scale3x2(0.3f + 0.15f * k, 0.3f + 0.15f * k), sr::rotation3x2(25.0f * k)));
+
+   struct placed
+   {
+      int shape, variant;
+      float x, y;
+      uint32_t color;
+   };
+   std::vector<placed> icons;
+   rng r(9);
+   for (int i = 0; i < 600; i++)
+   {
+      const float a = r.range(0.5f, 1.0f);
+      icons.push_back({ (int)(r.next() % shapes.size()), (int)(r.next() % variants.size()),
+                        r.range(0.0f, (float)width), r.range(0.0f, (float)height),
+                        sr::premultiplied_rgba8(r.unit(), r.unit(), r.unit(), a) });
+   }
+
+   std::vector<fill_command> commands;
+   auto icon_frame = [&](float step_x, float step_y) {
+      return [&, step_x, step_y](int i) -> const std::vector<fill_command>& {
+         commands.clear();
+         for (const placed& p : icons)
+         {
+            sr::float3x2 m = variants[p.variant];
+            m.dx = p.x + step_x * i;
+            m.dy = p.y + step_y * i;
+            commands.push_back({ &shapes[p.shape], m, p.color });
+         }
+         return commands;
+      };
+   };
+
+   // Whole-pixel positions stay exact; the scrolling ones cycle through phases
+   for (placed& p : icons)
+   {
+      p.x = floorf(p.x);
+      p.y = floorf(p.y);
+   }
+   run_scene("600 shapes, static", 20, 32u << 20, 4, icon_frame(0.0f, 0.0f));
+   run_scene("scrolling, 4 phases", 20, 32u << 20, 4, icon_frame(0.37f, 0.21f));
+   run_scene("scrolling, exact", 20, 32u << 20, 0, icon_frame(0.37f, 0.21f));
+   run_scene("scrolling, 256 KB", 20, 256u << 10, 4, icon_frame(0.37f, 0.21f));
+}
+
+}
@@ -0,0 +1,229 @@
+// Brush creation per frame, as the samples do it and interned. Each scenario
+// draws the same frames twice: once creating every brush inside the frame
+// (Test1's D2DDraw, DXGISample's CreateD2DDeviceResources run every frame)
+// and once through a resource_cache. Both go through a mock_backend, whose
+// counts give the creations of the last, steady-state frame; the frames
+// must match pixel for pixel. The last palette has more colors than the
+// cache holds, to show what interning costs when the working set does not
+// fit.
+
+#include "bench.h"
+#include "sr_resources.h"
+
+#include <string.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct resource_frame
+{
+   sr::image_rgba8& target;
+   sr::resource_backend& backend;
+   sr::resource_cache* cache;   // null: create per frame
+   int frame;
+   double brush_ms;   // time spent getting brushes
+
+   // The brushes a frame asks for: from the cache, or created and kept in
+   // `owned` until the frame ends
+   std::vector<std::unique_ptr<sr::solid_color_brush>> owned_solids;
+   std::vector<std::unique_ptr<sr::gradient_stops>> owned_stops;
+   std::vector<std::unique_ptr<sr::bitmap_brush>> owned_bitmaps;
+
+   const sr::solid_color_brush* solid(const sr::color_f& c)
+   {
+      timer t;
+      const sr::solid_color_brush* brush;
+      if (cache)
+         brush = cache->solid_brush(c);
+      else
+      {
+         owned_solids.push_back(backend.create_solid_brush(c));
+         brush = owned_solids.back().get();
+      }
+      brush_ms += t.elapsed_ms();
+      return brush;
+   }
+
+   const sr::gradient_stops* stops(const std::vector<sr::gradient_stop>& s)
+   {
+      timer t;
+      const sr::gradient_stops* collection;
+      if (cache)
+         collection = cache->stops(s.data(), s.size());
+      else
+      {
+         owned_stops.push_back(backend.create_gradient_stops(s.data(), s.size(), sr::extend_mode::clamp, 256));
+         collection = owned_stops.back().get();
+      }
+      brush_ms += t.elapsed_ms();
+      return collection;
+   }
+
+   const sr::bitmap_brush* bitmap(const sr::image_rgba8& b, float opacity)
+   {
+      const sr::extend_mode wrap = sr::extend_mode::wrap;
+      const sr::bitmap_interpolation linear = sr::bitmap_interpolation::linear;
+      timer t;
+      const sr::bitmap_brush* brush;
+      if (cache)
+         brush = cache->bitmap(b, wrap, wrap, linear, sr::identity3x2(), opacity);
+      else
+      {
+         owned_bitmaps.push_back(backend.create_bitmap_brush(b, wrap, wrap, linear, sr::identity3x2(), opacity));
+         brush = owned_bitmaps.back().get();
+      }
+      brush_ms += t.elapsed_ms();
+      return brush;
+   }
+};
+
+// FillRectangle with a solid brush
+static void fill_solid(sr::image_rgba8& target, const sr::rect_i& rect, uint32_t color)
+{
+   static uint8_t s_opaque[4096];
+   if (!s_opaque[0])
+      memset(s_opaque, 0xff, sizeof(s_opaque));
+   const sr::rect_i r = sr::intersect(rect, target.clip());
+   for (int y = r.top; y < r.bottom; y++)
+      sr::blend_mask(target.row(y) + r.left, s_opaque, r.right - r.left, color);
+}
+
+// Test1/test2/Test3: one green rectangle, the brush created in the draw call
+static void draw_test1(resource_frame& f)
+{
+   f.target.clear(0xff000000u);
+   fill_solid(f.target, { 100, 300, 700, 500 }, f.solid({ 0.0f, 1.0f, 0.0f, 0.75f })->pixel);
+}
+
+// DXGISample's brushes: background and geometry gradients, red and black
+// solid brushes and the 50% grid pattern over the offscreen surface
+static void draw_dxgi(resource_frame& f, const sr::image_rgba8& grid)
+{
+   static const std::vector<sr::gradient_stop> s_background = { { 0.0f, { 0.0f, 0.0f, 0.2f, 1.0f } }, { 1.0f, { 0.0f, 0.0f, 0.5f, 1.0f } } };
+   static const std::vector<sr::gradient_stop> s_geometry = { { 0.0f, { 0.0f, 1.0f, 1.0f, 0.25f } }, { 1.0f, { 0.0f, 0.0f, 1.0f, 1.0f } } };
+
+   sr::image_rgba8& t = f.target;
+   const sr::gradient_brush background(sr::linear_gradient{ { 0.0f, 0.0f }, { 0.0f, 1.0f } }, *f.stops(s_background), sr::scale3x2((float)t.width(), (float)t.height()));
+   sr::fill_rect(t, t.bounds(), background);
+   sr::fill_rect(t, t.bounds(), *f.bitmap(grid, 0.5f));
+   const sr::gradient_brush geometry(sr::linear_gradient{ { 100.0f, 0.0f }, { 100.0f, 200.0f } }, *f.stops(s_geometry));
+   sr::fill_rect(t, { 50, 0, 250, 200 }, geometry);
+   fill_solid(t, { 40, 220, 260, 230 }, f.solid({ 0.0f, 0.0f, 0.0f, 1.0f })->pixel);
+   fill_solid(t, { 20, 20, 120, 36 }, f.solid({ 1.0f, 0.0f, 0.0f, 1.0f })->pixel);
+}
+
+// A palette: `count` small swatches a frame, colors drawn from `colors`
+static void draw_palette(resource_frame& f, const std::vector<sr::color_f>& colors, int count)
+{
+   f.target.clear(0xff000000u);
+   rng r(0x5eed0000u + f.frame);
+   for (int i = 0; i < count; i++)
+   {
+      const sr::color_f& c = colors[r.next() % colors.size()];
+      const int x = (i % 64) * 12, y = (i / 64) * 12;
+      fill_solid(f.target, { x, y, x + 10, y + 10 }, f.solid(c)->pixel);
+   }
+}
+
+template<class Draw>
+static void run_scenario(const char* name, int frames, size_t max_resources, Draw&& draw)
+{
+   sr::image_rgba8 created_image(800, 600), interned_image(800, 600);
+
+   sr::mock_backend created_backend;
+   uint64_t created_last = 0;
+   double created_brush_ms = 0.0;
+   timer t;
+   for (int i = 0; i < frames; i++)
+   {
+      const uint64_t before = created_backend.log().size();
+      resource_frame f = { created_image, created_backend, nullptr, i, 0.0, {}, {}, {} };
+      draw(f);
+      created_last = created_backend.log().size() - before;
+      created_brush_ms += f.brush_ms;
+   }
+   const double created_ms = t.elapsed_ms();
+
+   sr::mock_backend interned_backend;
+   sr::resource_cache cache(interned_backend, max_resources);
+   double interned_brush_ms = 0.0;
+   t.reset();
+   for (int i = 0; i < frames; i++)
+   {
+      timer frame_start;
+      cache.begin_frame();
+      resource_frame f = { interned_image, interned_backend, &cache, i, 0.0, {}, {}, {} };
+      f.brush_ms = frame_start.elapsed_ms();
+      draw(f);
+      interned_brush_ms += f.brush_ms;
+   }
+   const double interned_ms = t.elapsed_ms();
+
+   bool same = true;
+   for (int y = 0; y < created_image.height() && same; y++)
+      same = memcmp(created_image.row(y), interned_image.row(y), created_image.width() * sizeof(uint32_t)) == 0;
+
+   // Per frame: whole frame and (in parentheses) the part spent getting brushes
+   printf("  %-28s created %6.3f ms (brushes %6.3f ms, %4llu creations) | interned %6.3f ms (brushes %6.3f ms, %4llu creations, %4llu hits) | "
+          "%llu creations in %d frames, %llu evictions, %zu live, %s\n",
+      name, created_ms / frames, created_brush_ms / frames, (unsigned long long)created_last,
+      interned_ms / frames, interned_brush_ms / frames, (unsigned long long)cache.frame().created, (unsigned long long)cache.frame().hits,
+      (unsigned long long)interned_backend.log().size(), frames, (unsigned long long)cache.total().evictions, cache.size(),
+      same ? "same pixels" : "PIXELS DIFFER");
+   consume(interned_image.at(400, 300));
+}
+
+void run_resources()
+{
+   printf("brush creation per frame at 800x600, created in the frame vs interned\n");
+
+   // The grid bitmap of CreateGridPatternBrush
+   sr::image_rgba8 grid(10, 10);
+   grid.clear(0);
+   for (int i = 0; i < 10; i++)
+   {
+      grid.row(0)[i] = sr::premultiplied_rgba8(0.93f, 0.94f, 0.96f, 1.0f);
+      grid.row(i)[0] = sr::premultiplied_rgba8(0.93f, 0.94f, 0.96f, 1.0f);
+   }
+
+   std::vector<sr::color_f> small_palette, large_palette;
+   rng r;
+   for (int i = 0; i < 256; i++)
+      small_palette.push_back({ r.unit(), r.unit(), r.unit(), 1.0f });
+   for (int i = 0; i < 16384; i++)
+      large_palette.push_back({ r.unit(), r.unit(), r.unit(), r.range(0.5f, 1.0f) });
+
+   run_scenario("Test1 D2DDraw", 500, 4096, [&](resource_frame& f) { draw_test1(f); });
+   run_scenario("DXGISample device resources", 200, 4096, [&](resource_frame& f) { draw_dxgi(f, grid); });
+   run_scenario("palette 2048 of 256 colors", 200, 4096, [&](resource_frame& f) { draw_palette(f, small_palette, 2048); });
+   run_scenario("palette 2048 of 16384 colors", 200, 4096, [&](resource_frame& f) { draw_palette(f, large_palette, 2048); });
+
+   // Device loss: the next frame creates everything again, then nothing
+   sr::mock_backend backend;
+   sr::resource_cache cache(backend);
+   sr::image_rgba8 image(800, 600);
+   uint64_t per_frame[4] = {};
+   for (int i = 0; i < 4; i++)
+   {
+      if (i == 2)
+         cache.clear();
+      cache.begin_frame();
+      resource_frame f = { image, backend, &cache, i, 0.0, {}, {}, {} };
+      draw_dxgi(f, grid);
+      per_frame[i] = cache.frame().created;
+   }
+
+   // A failed creation is not interned; the next request tries again
+   backend.fail_next(1);
+   cache.clear();
+   cache.begin_frame();
+   const bool failed = cache.solid_brush({ 0.0f, 1.0f, 0.0f, 0.75f }) == nullptr;
+   const bool retried = cache.solid_brush({ 0.0f, 1.0f, 0.0f, 0.75f }) != nullptr;
+   printf("  device loss at frame 2: creations per frame %llu %llu %llu %llu; failed creation %s, retry %s\n",
+      (unsigned long long)per_frame[0], (unsigned long long)per_frame[1], (unsigned long long)per_frame[2], (unsigned long long)per_frame[3],
+      failed ? "returns null" : "NOT REPORTED", retried ? "creates" : "FAILS");
+}
+
+}
@@ -0,0 +1,165 @@
+// Retained 2D scene at 4K: the sample's offscreen content (grid, two bitmaps,
+// a rotated label, two hourglasses) presented frame after frame while it is
+// static, while one small shape spins, and while everything scrolls. Each is
+// timed against redrawing the whole surface, and the retained surface is
+// compared with a full redraw of the last frame.
+
+#include "bench.h"
+#include "sr_scene.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct scene_content
+{
+   sr::path_geometry hourglass;
+   sr::path_geometry label;
+   sr::path_geometry star;
+   sr::image_rgba8 bitmap_a, bitmap_b;
+};
+
+static void make_content(scene_content& s)
+{
+   sr::path_geometry& h = s.hourglass;
+   h.begin_figure({ 0, 0 });
+   h.add_line({ 200, 0 });
+   h.add_bezier({ 150, 50 }, { 150, 150 }, { 200, 200 });
+   h.add_line({ 0, 200 });
+   h.add_bezier({ 50, 150 }, { 50, 50 }, { 0, 0 });
+   h.end_figure(sr::figure_end::closed);
+
+   // Stand-in for the rotated text: a row of glyph-sized boxes with holes
+   for (int i = 0; i < 24; i++)
+   {
+      const float x = i * 28.0f;
+      const sr::float2 outer[4] = { { x, 0 }, { x + 22, 0 }, { x + 22, 36 }, { x, 36 } };
+      const sr::float2 inner[4] = { { x + 6, 8 }, { x + 6, 28 }, { x + 16, 28 }, { x + 16, 8 } };
+      s.label.begin_figure(outer[0]);
+      s.label.add_lines(outer + 1, 3);
+      s.label.end_figure(sr::figure_end::closed);
+      s.label.begin_figure(inner[0]);
+      s.label.add_lines(inner + 1, 3);
+      s.label.end_figure(sr::figure_end::closed);
+   }
+
+   for (int i = 0; i < 10; i++)
+   {
+      const float a = 3.14159265f * i / 5, r = i & 1 ? 25.0f : 60.0f;
+      if (i == 0)
+         s.star.begin_figure({ r * cosf(a), r * sinf(a) });
+      else
+         s.star.add_line({ r * cosf(a), r * sinf(a) });
+   }
+   s.star.end_figure(sr::figure_end::closed);
+
+   s.bitmap_a.resize(640, 480);
+   s.bitmap_b.resize(640, 480);
+   for (int y = 0; y < 480; y++)
+   {
+      for (int x = 0; x < 640; x++)
+      {
+         s.bitmap_a.row(y)[x] = sr::premultiplied_rgba8(x / 640.0f, y / 480.0f, 0.5f, 1.0f);
+         s.bitmap_b.row(y)[x] = sr::premultiplied_rgba8(0.2f, x / 640.0f, y / 480.0f, ((x / 32 + y / 32) & 1) ? 1.0f : 0.4f);
+      }
+   }
+}
+
+// One frame of the sample's offscreen content, everything moved by `scroll`
+static void record(sr::display_list& list, const scene_content& s, int width, int height, float scroll, float spin)
+{
+   const uint32_t grid = sr::premultiplied_rgba8(0.93f, 0.94f, 0.96f, 1.0f);
+   const uint32_t black = sr::premultiplied_rgba8(0.0f, 0.0f, 0.0f, 1.0f);
+   const uint32_t red = sr::premultiplied_rgba8(1.0f, 0.0f, 0.0f, 1.0f);
+   const int offset = (int)scroll;
+
+   list.clear();
+   for (int x = 0; x < width; x += 40)
+      list.fill_rect({ (float)x + scroll, 0.0f, (float)x + scroll + 1.0f, (float)height }, grid);
+   for (int y = 0; y < height; y += 40)
+      list.fill_rect({ 0.0f, (float)y + scroll, (float)width, (float)y + scroll + 1.0f }, grid);
+   list.draw_image(s.bitmap_a, 200 + offset, 200 + offset);
+   list.draw_image(s.bitmap_b, width - 900 + offset, height - 700 + offset, 0.8f);
+   list.fill_geometry(s.label, sr::mul(sr::rotation3x2(-30.0f), sr::translation3x2(1500.0f + scroll, 1400.0f + scroll)), red);
+   list.fill_geometry(s.hourglass, sr::translation3x2(scroll, (float)(height - 200) + scroll), black);
+   list.fill_geometry(s.hourglass, sr::translation3x2((float)(width - 200) + scroll, scroll), black);
+   list.fill_geometry(s.star, sr::mul(sr::rotation3x2(spin), sr::translation3x2(2600.0f + scroll, 500.0f + scroll)), red);
+}
+
+static int max_difference(const sr::image_rgba8& a, const sr::image_rgba8& b)
+{
+   int worst = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      for (int x = 0; x < a.width(); x++)
+      {
+         const uint32_t p = a.at(x, y), q = b.at(x, y);
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p >> c) & 0xff) - (int)((q >> c) & 0xff));
+            worst = d > worst ? d : worst;
+         }
+      }
+   }
+   return worst;
+}
+
+static void run_case(const char* name, const scene_content& content, int frames, float scroll_step, float spin_step)
+{
+   const int width = 3840, height = 2160;
+   const uint32_t white = 0xffffffffu;
+   sr::display_list list;
+
+   // Baseline: the whole surface every frame, as OnRender does today
+   sr::retained_scene full(width, height, white);
+   record(list, content, width, height, 0.0f, 0.0f);
+   full.present(list);
+   timer t;
+   for (int i = 1; i <= frames; i++)
+   {
+      record(list, content, width, height, scroll_step * i, spin_step * i);
+      full.invalidate_all();
+      full.present(list);
+   }
+   const double full_ms = t.elapsed_ms() / frames;
+
+   sr::retained_scene retained(width, height, white);
+   record(list, content, width, height, 0.0f, 0.0f);
+   retained.present(list);
+   retained.reset_stats();
+   int64_t max_pixels = 0;
+   int max_rects = 0;
+   t.reset();
+   for (int i = 1; i <= frames; i++)
+   {
+      record(list, content, width, height, scroll_step * i, spin_step * i);
+      retained.present(list);
+      max_pixels = retained.last_frame().pixels_redrawn > max_pixels ? retained.last_frame().pixels_redrawn : max_pixels;
+      max_rects = retained.last_frame().damage_rects > max_rects ? retained.last_frame().damage_rects : max_rects;
+   }
+   const double retained_ms = t.elapsed_ms() / frames;
+   const sr::scene_stats& st = retained.stats();
+
+   const double pixels = (double)width * height;
+   printf("%-16s | %3zu commands | full redraw %7.3f ms/frame | retained %7.3f ms/frame (x%.0f) | %3llu/%d frames skipped | "
+          "redrawn %5.2f%% px/frame avg, %5.2f%% max, <= %d rects | %5.1f commands replayed/frame | max diff %d\n",
+      name, list.size(), full_ms, retained_ms, full_ms / retained_ms, (unsigned long long)st.frames_skipped, frames,
+      100.0 * st.pixels_redrawn / frames / pixels, 100.0 * max_pixels / pixels, max_rects,
+      (double)st.commands_replayed / frames, max_difference(full.surface(), retained.surface()));
+   consume(retained.surface().at(width / 2, height / 2));
+}
+
+void run_scene()
+{
+   scene_content content;
+   make_content(content);
+   run_case("static", content, 200, 0.0f, 0.0f);
+   run_case("spinning star", content, 100, 0.0f, 3.0f);
+   run_case("all scrolling", content, 20, 1.0f, 0.0f);
+}
+
+}
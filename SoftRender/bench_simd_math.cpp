@@ -0,0 +1,272 @@
+// SIMD transcendentals: accuracy against double-precision libm, with the
+// float libm functions alongside, then values per second for libm one at a
+// time against the batch functions, and 10000 objects' rotation_y per frame
+// the d3dmath.h way (sinf and cosf per object) against rotation_y_batch.
+//
+// Errors are in ULPs of the exact result: a correctly rounded function
+// scores at most 0.5. Every row is held to the bound sr_simd_math.h
+// documents for it.
+
+#include "bench.h"
+#include "sr_simd_math.h"
+
+#include <math.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// |a - ref| in units of the float spacing at ref, denormals included
+static double ulps(float a, double ref)
+{
+   if (isnan(ref) || isinf(ref))
+      return (isnan(ref) && isnan(a)) || a == ref ? 0.0 : 1e9;
+   int e;
+   frexp(ref, &e);
+   const double ulp = ldexp(1.0, (e < -125 ? -125 : e) - 24);
+   return fabs(a - ref) / ulp;
+}
+
+struct error_stats
+{
+   double max = 0.0, sum = 0.0, max_abs = 0.0;
+   int n = 0;
+
+   void add(float a, double ref)
+   {
+      const double u = ulps(a, ref);
+      max = u > max ? u : max;
+      sum += u;
+      max_abs = fabs(a - ref) > max_abs ? fabs(a - ref) : max_abs;
+      n++;
+   }
+};
+
+struct accuracy_case
+{
+   const char* name;
+   const char* range;
+   std::vector<float> x, y;       // y for atan2 only
+   double max_ulps;               // the bound sr_simd_math.h documents: ULPs,
+   double max_abs;                // or when nonzero, absolute error
+};
+
+// sin and cos beyond [-pi, pi]: the reduction is only exact with FMA
+#if defined(SR_SIMD_FMA)
+static const double far_trig_ulps = 1.6, near_trig_abs = 0.0, far_trig_abs = 0.0;
+#else
+static const double far_trig_ulps = 0.0, near_trig_abs = 1e-7, far_trig_abs = 1e-6;
+#endif
+
+// Fails the gate past the documented bound
+static void print_row(const accuracy_case& c, const error_stats& simd, const error_stats& libm)
+{
+   const bool over = c.max_abs > 0.0 ? simd.max_abs > c.max_abs : simd.max > c.max_ulps;
+   printf("  %-6s %-22s | %8.2f %6.3f %9.2g | %8.2f %6.3f %9.2g | %s %g%s\n", c.name, c.range, simd.max, simd.sum / simd.n, simd.max_abs,
+      libm.max, libm.sum / libm.n, libm.max_abs, over ? "OVER" : "within", c.max_abs > 0.0 ? c.max_abs : c.max_ulps,
+      c.max_abs > 0.0 ? " abs" : " ULP");
+   if (over)
+      gate_failed();
+}
+
+// Log-uniform magnitudes between 2^lo and 2^hi
+static float log_uniform(rng& r, float lo, float hi)
+{
+   return exp2f(r.range(lo, hi));
+}
+
+static void accuracy(rng& r)
+{
+   const int n = 1 << 20;
+   printf("  accuracy over %d values: max ULP, mean ULP, max absolute error\n", n);
+   printf("  %-6s %-22s | %-26s | %-26s | documented\n", "", "", "SIMD", "libm (float)");
+
+   std::vector<float> out(n), out2(n);
+   auto fill = [&](accuracy_case& c, float lo, float hi) {
+      c.x.resize(n);
+      for (float& v : c.x)
+         v = r.range(lo, hi);
+   };
+
+   const double pi = 3.14159265358979323846;
+   accuracy_case trig[] = { { "sin", "[-pi, pi]", {}, {}, 1.5, 0.0 },
+                            { "sin", "[-8192, 8192]", {}, {}, far_trig_ulps, near_trig_abs },
+                            { "sin", "[-1e5, 1e5]", {}, {}, far_trig_ulps, far_trig_abs },
+                            { "cos", "[-pi, pi]", {}, {}, 1.5, 0.0 },
+                            { "cos", "[-8192, 8192]", {}, {}, far_trig_ulps, near_trig_abs },
+                            { "cos", "[-1e5, 1e5]", {}, {}, far_trig_ulps, far_trig_abs } };
+   for (int k = 0; k < 6; k++)
+   {
+      const float span = k % 3 == 0 ? (float)pi : k % 3 == 1 ? 8192.0f : 1e5f;
+      fill(trig[k], -span, span);
+      const bool is_sin = k < 3;
+      sr::sincos_batch(trig[k].x.data(), n, out.data(), out2.data());
+      error_stats simd, libm;
+      for (int i = 0; i < n; i++)
+      {
+         const float x = trig[k].x[i];
+         simd.add(is_sin ? out[i] : out2[i], is_sin ? sin((double)x) : cos((double)x));
+         libm.add(is_sin ? sinf(x) : cosf(x), is_sin ? sin((double)x) : cos((double)x));
+      }
+      print_row(trig[k], simd, libm);
+   }
+
+   accuracy_case angles[] = { { "atan2", "unit square", {}, {}, 3.0, 0.0 }, { "atan2", "2^-60 to 2^60", {}, {}, 3.0, 0.0 } };
+   for (int k = 0; k < 2; k++)
+   {
+      accuracy_case& c = angles[k];
+      c.x.resize(n);
+      c.y.resize(n);
+      for (int i = 0; i < n; i++)
+      {
+         c.x[i] = k == 0 ? r.range(-1.0f, 1.0f) : copysignf(log_uniform(r, -60.0f, 60.0f), r.range(-1.0f, 1.0f));
+         c.y[i] = k == 0 ? r.range(-1.0f, 1.0f) : copysignf(log_uniform(r, -60.0f, 60.0f), r.range(-1.0f, 1.0f));
+      }
+      sr::atan2_batch(c.y.data(), c.x.data(), n, out.data());
+      error_stats simd, libm;
+      for (int i = 0; i < n; i++)
+      {
+         const double ref = atan2((double)c.y[i], (double)c.x[i]);
+         simd.add(out[i], ref);
+         libm.add(atan2f(c.y[i], c.x[i]), ref);
+      }
+      print_row(c, simd, libm);
+   }
+
+   accuracy_case exps[] = { { "exp", "[-10, 10]", {}, {}, 1.0, 0.0 },
+                            { "exp", "[-87, 88.7]", {}, {}, 1.0, 0.0 },
+                            { "exp", "[-103, -87] denormal", {}, {}, 1.0, 0.0 } };
+   const float exp_ranges[3][2] = { { -10.0f, 10.0f }, { -87.0f, 88.7f }, { -103.0f, -87.0f } };
+   for (int k = 0; k < 3; k++)
+   {
+      fill(exps[k], exp_ranges[k][0], exp_ranges[k][1]);
+      sr::exp_batch(exps[k].x.data(), n, out.data());
+      error_stats simd, libm;
+      for (int i = 0; i < n; i++)
+      {
+         const double ref = exp((double)exps[k].x[i]);
+         simd.add(out[i], ref);
+         libm.add(expf(exps[k].x[i]), ref);
+      }
+      print_row(exps[k], simd, libm);
+   }
+
+   accuracy_case logs[] = { { "log", "[0.5, 2]", {}, {}, 1.0, 0.0 },
+                            { "log", "2^-126 to 2^127", {}, {}, 1.0, 0.0 },
+                            { "log", "denormals", {}, {}, 1.0, 0.0 } };
+   for (int k = 0; k < 3; k++)
+   {
+      accuracy_case& c = logs[k];
+      c.x.resize(n);
+      for (float& v : c.x)
+         v = k == 0 ? r.range(0.5f, 2.0f) : k == 1 ? log_uniform(r, -126.0f, 127.0f) : log_uniform(r, -149.0f, -126.0f);
+      sr::log_batch(c.x.data(), n, out.data());
+      error_stats simd, libm;
+      for (int i = 0; i < n; i++)
+      {
+         const double ref = log((double)c.x[i]);
+         simd.add(out[i], ref);
+         libm.add(logf(c.x[i]), ref);
+      }
+      print_row(c, simd, libm);
+   }
+
+   // Special values
+   const float specials[8] = { 0.0f, -0.0f, INFINITY, -INFINITY, NAN, -1.0f, 1e-45f, 1000.0f };
+   float s[8], c[8], e[8], l[8];
+   sr::sincos_batch(specials, 8, s, c);
+   sr::exp_batch(specials, 8, e);
+   sr::log_batch(specials, 8, l);
+   printf("  0, -0, inf, -inf, nan, -1, 1e-45, 1000:\n");
+   printf("    sin");
+   for (float v : s)
+      printf(" %g", v);
+   printf(" | cos");
+   for (float v : c)
+      printf(" %g", v);
+   printf("\n    exp");
+   for (float v : e)
+      printf(" %g", v);
+   printf(" | log");
+   for (float v : l)
+      printf(" %g", v);
+   printf("\n");
+}
+
+void run_simd_math()
+{
+   rng r;
+   accuracy(r);
+
+   const size_t n = 1 << 16;
+   const int rounds = 40;
+   std::vector<float> x(n), y(n), exponent(n), positive(n), out(n), out2(n);
+   for (size_t i = 0; i < n; i++)
+   {
+      x[i] = r.range(-100.0f, 100.0f);
+      y[i] = r.range(-100.0f, 100.0f);
+      exponent[i] = r.range(-50.0f, 50.0f);
+      positive[i] = r.range(1e-3f, 1e3f);
+   }
+   auto mps = [&](double ms) { return (double)n * rounds / (ms * 1e3); };
+   auto sink = [&] { consume((uint64_t)(out[n / 3] * 1000.0f) + (uint64_t)(out2[n / 5] * 1000.0f)); };
+
+   struct timing
+   {
+      const char* name;
+      double libm, simd;
+   };
+   std::vector<timing> t;
+   t.push_back({ "sin", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) out[i] = sinf(x[i]); }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::sin_batch(x.data(), n, out.data()); }) });
+   sink();
+   t.push_back({ "cos", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) out[i] = cosf(x[i]); }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::cos_batch(x.data(), n, out.data()); }) });
+   sink();
+   t.push_back({ "sincos", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) { out[i] = sinf(x[i]); out2[i] = cosf(x[i]); } }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::sincos_batch(x.data(), n, out.data(), out2.data()); }) });
+   sink();
+   t.push_back({ "atan2", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) out[i] = atan2f(y[i], x[i]); }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::atan2_batch(y.data(), x.data(), n, out.data()); }) });
+   sink();
+   t.push_back({ "exp", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) out[i] = expf(exponent[i]); }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::exp_batch(exponent.data(), n, out.data()); }) });
+   sink();
+   t.push_back({ "log", best_of(5, [&] { for (int k = 0; k < rounds; k++) for (size_t i = 0; i < n; i++) out[i] = logf(positive[i]); }),
+                 best_of(5, [&] { for (int k = 0; k < rounds; k++) sr::log_batch(positive.data(), n, out.data()); }) });
+   sink();
+
+   printf("  M values/s, libm -> %s batch:\n   ", sr::simd_backend_name());
+   for (const timing& e : t)
+      printf(" %s %.0f -> %.0f (%.1fx) |", e.name, mps(e.libm), mps(e.simd), e.libm / e.simd);
+   printf("\n");
+
+   // Per-frame rotation of 10000 animated objects, each at its own angle
+   const size_t objects = 10000;
+   const int frames = 100;
+   std::vector<float> angles(objects);
+   std::vector<sr::float4x4> world(objects);
+   for (float& a : angles)
+      a = r.range(-3.14159265f, 3.14159265f);
+   const double per_object = best_of(5, [&] {
+      for (int f = 0; f < frames; f++)
+         for (size_t i = 0; i < objects; i++)
+            world[i] = sr::rotation_y(angles[i] + f * 0.01f);
+   });
+   consume((uint64_t)(world[objects / 2].m[0][0] * 1000.0f));
+   std::vector<float> frame_angles(objects);
+   const double batched = best_of(5, [&] {
+      for (int f = 0; f < frames; f++)
+      {
+         for (size_t i = 0; i < objects; i++)
+            frame_angles[i] = angles[i] + f * 0.01f;
+         sr::rotation_y_batch(frame_angles.data(), objects, world.data());
+      }
+   });
+   consume((uint64_t)(world[objects / 2].m[0][0] * 1000.0f));
+   printf("  rotation_y for %zu objects: %.1f us per frame -> rotation_y_batch %.1f us (%.1fx)\n", objects, per_object * 1e3 / frames,
+      batched * 1e3 / frames, per_object / batched);
+}
+
+}
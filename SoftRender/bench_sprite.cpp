@@ -0,0 +1,180 @@
+// Sprite batching: 100k sprites a frame from 16 atlas pages, rotated,
+// scaled and tinted across a 1920x1080 target on 8 depth layers, through
+// sprite_batch and an upload_ring into memory_sprite_backend. Time per frame
+// split into submission and end() (sort, vertex writes, draws), draws, maps
+// and discards per frame for every sort mode, against one draw per sprite
+// the way d3d11_engine::draw would go. The first frame of each mode is
+// checked: every sprite drawn once, from its own texture, with the corners
+// and texture coordinates of its transform and texel rectangle, in order,
+// and no draw from vertices written over since the last discard.
+
+#include "bench.h"
+#include "sr_sprite.h"
+
+#include <math.h>
+
+#include <vector>
+
+namespace bench
+{
+
+struct sprite_params
+{
+   int page;
+   sr::rect_f source;
+   sr::float3x2 transform;
+   float depth;
+};
+
+static const int sprite_pages = 16;
+static const int sprite_layers = 8;
+
+static std::vector<sprite_params> make_sprites(size_t count, rng& r)
+{
+   std::vector<sprite_params> sprites(count);
+   for (sprite_params& s : sprites)
+   {
+      // 2048x2048 pages of 16x16 cells of 128 texels, sprites of 16 to 128
+      s.page = (int)(r.next() % sprite_pages);
+      const float cx = (float)(r.next() % 16) * 128.0f, cy = (float)(r.next() % 16) * 128.0f;
+      const float w = r.range(16.0f, 128.0f), h = r.range(16.0f, 128.0f);
+      s.source = { cx, cy, cx + w, cy + h };
+      const float scale = r.range(0.25f, 1.5f);
+      const sr::float2 center = { w * 0.5f, h * 0.5f };
+      s.transform = sr::mul(sr::mul(sr::translation3x2(-center.x, -center.y), sr::scale3x2(scale, scale)),
+         sr::mul(sr::rotation3x2(r.range(0.0f, 360.0f)), sr::translation3x2(r.range(0.0f, 1920.0f), r.range(0.0f, 1080.0f))));
+      s.depth = (float)(r.next() % sprite_layers) / sprite_layers;
+   }
+   return sprites;
+}
+
+// What went into the ring against the parameters: returns the errors
+static int check_frame(const sr::memory_sprite_backend& backend, const std::vector<sprite_params>& sprites, const sr::sprite_texture* pages,
+                       sr::sprite_sort sort, int& texture_runs)
+{
+   int errors = 0;
+   std::vector<uint8_t> seen(sprites.size());
+   const void* last_texture = nullptr;
+   float last_depth = sort == sr::sprite_sort::back_to_front ? 2.0f : -1.0f;
+   texture_runs = 0;
+   for (const sr::sprite_draw& d : backend.draws())
+   {
+      texture_runs += d.texture != last_texture;
+      last_texture = d.texture;
+      for (uint32_t q = 0; q < d.quad_count; q++)
+      {
+         const sr::sprite_vertex* v = &backend.vertices()[d.base_vertex + 4 * q];
+         const uint32_t i = v[0].color & 0xffffff;
+         if (i >= sprites.size() || seen[i])
+         {
+            errors++;
+            continue;
+         }
+         seen[i] = 1;
+         const sprite_params& s = sprites[i];
+         const sr::sprite_texture& page = pages[s.page];
+         errors += d.texture != page.handle;
+         if (sort == sr::sprite_sort::back_to_front || sort == sr::sprite_sort::front_to_back)
+         {
+            errors += sort == sr::sprite_sort::back_to_front ? s.depth > last_depth : s.depth < last_depth;
+            last_depth = s.depth;
+         }
+
+         const sr::float3x2& m = s.transform;
+         const float w = s.source.right - s.source.left, h = s.source.bottom - s.source.top;
+         const float corner[4][2] = { { 0.0f, 0.0f }, { w, 0.0f }, { 0.0f, h }, { w, h } };
+         for (int c = 0; c < 4; c++)
+         {
+            const float x = corner[c][0] * m.m11 + corner[c][1] * m.m21 + m.dx;
+            const float y = corner[c][0] * m.m12 + corner[c][1] * m.m22 + m.dy;
+            const float u = (c & 1 ? s.source.right : s.source.left) / page.width;
+            const float t = (c & 2 ? s.source.bottom : s.source.top) / page.height;
+            errors += fabsf(v[c].x - x) > 1e-3f || fabsf(v[c].y - y) > 1e-3f || fabsf(v[c].u - u) > 1e-6f || fabsf(v[c].v - t) > 1e-6f ||
+                      v[c].color != v[0].color;
+         }
+      }
+   }
+   for (uint8_t s : seen)
+      errors += !s;
+   return errors + (int)backend.overwrites();
+}
+
+void run_sprite()
+{
+   const size_t count = 100000;
+   const uint32_t capacity = 1 << 17;   // quads
+   const size_t ring_bytes = 4 * (size_t)capacity * sizeof(sr::sprite_vertex);
+   const int frames = 10;
+   rng r(49);
+   const std::vector<sprite_params> sprites = make_sprites(count, r);
+
+   static const char page_handles[sprite_pages] = {};
+   sr::sprite_texture pages[sprite_pages];
+   for (int p = 0; p < sprite_pages; p++)
+      pages[p] = { &page_handles[p], 2048, 2048 };
+
+   // Colors number the sprites so the check can find them
+   auto submit_all = [&](sr::sprite_batch& batch) {
+      for (size_t i = 0; i < count; i++)
+      {
+         const sprite_params& s = sprites[i];
+         batch.submit(pages[s.page], s.source, s.transform, 0xff000000u | (uint32_t)i, s.depth);
+      }
+   };
+
+   printf("  %zu sprites a frame, %d pages, %d depth layers, ring of %u quads (%.1f MB), %zu bytes a vertex\n", count, sprite_pages,
+      sprite_layers, capacity, capacity * 4.0 * sizeof(sr::sprite_vertex) * 1e-6, sizeof(sr::sprite_vertex));
+   printf("  one draw per sprite (d3d11_engine::draw per image): %zu draws a frame\n", count);
+
+   const struct
+   {
+      const char* name;
+      sr::sprite_sort sort;
+   } modes[] = {
+      { "deferred", sr::sprite_sort::deferred },
+      { "texture", sr::sprite_sort::texture },
+      { "back to front", sr::sprite_sort::back_to_front },
+      { "front to back", sr::sprite_sort::front_to_back },
+   };
+   for (const auto& mode : modes)
+   {
+      // The memory backend is done with a frame once it is drawn
+      sr::memory_sprite_backend backend(ring_bytes);
+      sr::upload_ring ring(backend, ring_bytes, 0);
+      sr::sprite_batch batch(ring, backend);
+
+      batch.begin(mode.sort);
+      submit_all(batch);
+      batch.end();
+      ring.retire(ring.end_frame());
+      int texture_runs = 0;
+      const int errors = check_frame(backend, sprites, pages, mode.sort, texture_runs);
+
+      batch.reset_stats();
+      const uint64_t maps = backend.maps(), discards = backend.discards();
+      double submit_ms = 1e30, end_ms = 1e30;
+      for (int f = 0; f < frames; f++)
+      {
+         backend.clear_draws();
+         timer t;
+         batch.begin(mode.sort);
+         submit_all(batch);
+         const double s = t.elapsed_ms();
+         batch.end();
+         const double e = t.elapsed_ms() - s;
+         ring.retire(ring.end_frame());
+         submit_ms = s < submit_ms ? s : submit_ms;
+         end_ms = e < end_ms ? e : end_ms;
+      }
+      const sr::sprite_stats& st = batch.stats();
+      printf("  %-13s %5.2f ms a frame (submit %5.2f, end %5.2f) | %5.1f Msprites/s | %6.1f draws, %.1f maps, %.1f discards a frame | "
+             "%d texture runs | check: %d errors\n",
+         mode.name, submit_ms + end_ms, submit_ms, end_ms, count / (submit_ms + end_ms) * 1e-3, (double)st.draws / st.frames,
+         (double)(backend.maps() - maps) / st.frames, (double)(backend.discards() - discards) / st.frames, texture_runs, errors);
+      if (errors)
+         gate_failed();
+      consume(st.draws + backend.vertices()[count].color);
+   }
+}
+
+}
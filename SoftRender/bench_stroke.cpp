@@ -0,0 +1,453 @@
+// Stroke expansion at 4K: 4000 strokes per frame (the sample's hourglass
+// outlined with every join, open cubic curves, dashed circles and polyline
+// charts), offset directly as curves against flattening the centerline first
+// and stroking the polyline, both filled the same way. Round strokes, whose
+// true shape is every point within half the width of the centerline, are
+// checked against a supersampled distance test. Where an outline overlaps
+// itself inside a partly covered pixel (thin strokes turning back on
+// themselves) the area accumulation counts the overlap twice; that is what
+// the larger max diffs at 1 px are.
+
+#include "bench.h"
+#include "sr_stroke.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// The bench's own record of each figure, so the flatten-first side can
+// flatten the centerline itself
+struct figure_desc
+{
+   struct segment
+   {
+      bool line;
+      sr::float2 c1, c2, p;
+   };
+
+   sr::float2 start;
+   std::vector<segment> segments;
+   bool closed;
+};
+
+struct stroke_item
+{
+   std::vector<figure_desc> figures;
+   sr::path_geometry path;
+   sr::float3x2 transform;
+   float scale;
+   float width;
+   int style;
+   uint32_t color;
+};
+
+static void build_path(const std::vector<figure_desc>& figures, sr::path_geometry& path)
+{
+   path.clear();
+   for (const figure_desc& f : figures)
+   {
+      path.begin_figure(f.start, sr::figure_begin::hollow);
+      for (const figure_desc::segment& s : f.segments)
+      {
+         if (s.line)
+            path.add_line(s.p);
+         else
+            path.add_bezier(s.c1, s.c2, s.p);
+      }
+      path.end_figure(f.closed ? sr::figure_end::closed : sr::figure_end::open);
+   }
+}
+
+// Centerline points of a figure in its own space, closing point included.
+// Same segment counts as flatten_path (Wang's formula)
+static void flatten_figure(const figure_desc& f, float tolerance, std::vector<sr::float2>& points)
+{
+   points.clear();
+   points.push_back(f.start);
+   for (const figure_desc::segment& s : f.segments)
+   {
+      if (s.line)
+      {
+         points.push_back(s.p);
+         continue;
+      }
+      const sr::float2 c[4] = { points.back(), s.c1, s.c2, s.p };
+      const float d1 = hypotf(c[0].x - 2 * c[1].x + c[2].x, c[0].y - 2 * c[1].y + c[2].y);
+      const float d2 = hypotf(c[1].x - 2 * c[2].x + c[3].x, c[1].y - 2 * c[2].y + c[3].y);
+      const float nf = ceilf(sqrtf(0.75f * (d1 > d2 ? d1 : d2) / tolerance));
+      const int n = nf < 1.0f ? 1 : (nf > 1024.0f ? 1024 : (int)nf);
+      for (int i = 1; i <= n; i++)
+      {
+         const float t = (float)i / (float)n, u = 1.0f - t;
+         const float b0 = u * u * u, b1 = 3 * u * u * t, b2 = 3 * u * t * t, b3 = t * t * t;
+         points.push_back(i == n ? c[3] : sr::float2{ b0 * c[0].x + b1 * c[1].x + b2 * c[2].x + b3 * c[3].x,
+                                                      b0 * c[0].y + b1 * c[1].y + b2 * c[2].y + b3 * c[3].y });
+      }
+   }
+   if (f.closed)
+      points.push_back(f.start);
+}
+
+static void build_polyline(const std::vector<figure_desc>& figures, float tolerance, sr::path_geometry& path, std::vector<sr::float2>& points)
+{
+   path.clear();
+   for (const figure_desc& f : figures)
+   {
+      flatten_figure(f, tolerance, points);
+      path.begin_figure(points[0], sr::figure_begin::hollow);
+      path.add_lines(points.data() + 1, points.size() - (f.closed ? 2 : 1));
+      path.end_figure(f.closed ? sr::figure_end::closed : sr::figure_end::open);
+   }
+}
+
+static figure_desc hourglass()
+{
+   // Same figure as DXGISampleApp::CreateD2DResources
+   figure_desc f;
+   f.start = { 0, 0 };
+   f.segments = {
+      { true, {}, {}, { 200, 0 } },
+      { false, { 150, 50 }, { 150, 150 }, { 200, 200 } },
+      { true, {}, {}, { 0, 200 } },
+      { false, { 50, 150 }, { 50, 50 }, { 0, 0 } },
+   };
+   f.closed = true;
+   return f;
+}
+
+static figure_desc circle(float r)
+{
+   const float k = 0.5522847f * r;
+   figure_desc f;
+   f.start = { r, 0 };
+   f.segments = {
+      { false, { r, k }, { k, r }, { 0, r } },
+      { false, { -k, r }, { -r, k }, { -r, 0 } },
+      { false, { -r, -k }, { -k, -r }, { 0, -r } },
+      { false, { k, -r }, { r, -k }, { r, 0 } },
+   };
+   f.closed = true;
+   return f;
+}
+
+static figure_desc curve(rng& r, int segments, float size)
+{
+   figure_desc f;
+   auto point = [&]() { return sr::float2{ r.range(-size, size), r.range(-size, size) }; };
+   f.start = point();
+   for (int i = 0; i < segments; i++)
+      f.segments.push_back({ false, point(), point(), point() });
+   f.closed = false;
+   return f;
+}
+
+static figure_desc chart(rng& r, int points, float width, float height)
+{
+   figure_desc f;
+   float y = r.range(0.0f, height);
+   f.start = { 0.0f, y };
+   for (int i = 1; i < points; i++)
+   {
+      y = sr::clamp(y + r.range(-0.3f, 0.3f) * height, 0.0f, height);
+      f.segments.push_back({ true, {}, {}, { width * i / (points - 1), y } });
+   }
+   f.closed = false;
+   return f;
+}
+
+struct stroke_run
+{
+   double stroke_ms = 0, fill_ms = 0;
+   uint64_t curves = 0, lines = 0, splits = 0, fill_lines = 0;
+};
+
+// Strokes every item into `outlines` (flattening the centerline first when
+// `flatten_first`), then fills the outlines
+static stroke_run run_frame(std::vector<stroke_item>& items, size_t first, size_t last, const std::vector<sr::stroke_style>& styles,
+                            bool flatten_first, std::vector<sr::path_geometry>& outlines, sr::image_rgba8& image)
+{
+   const float tolerance = 0.1f;
+   sr::path_stroker stroker;
+   sr::path_geometry polyline;
+   std::vector<sr::float2> points;
+   stroke_run run;
+   run.stroke_ms = best_of(3, [&] {
+      stroker.reset_stats();
+      for (size_t i = first; i < last; i++)
+      {
+         stroke_item& it = items[i];
+         const sr::path_geometry* path = &it.path;
+         if (flatten_first)
+         {
+            build_polyline(it.figures, tolerance / it.scale, polyline, points);
+            path = &polyline;
+         }
+         stroker.stroke(*path, it.width, styles[it.style], it.transform, tolerance, outlines[i]);
+      }
+   });
+   run.curves = stroker.stats().curves;
+   run.lines = stroker.stats().lines;
+   run.splits = stroker.stats().splits;
+
+   sr::strip_rasterizer raster(image.width(), image.height());
+   sr::coverage_strips cov;
+   std::vector<sr::line_segment> lines;
+   run.fill_ms = best_of(3, [&] {
+      image.clear(0xff000000u);
+      run.fill_lines = 0;
+      for (size_t i = first; i < last; i++)
+      {
+         lines.clear();
+         sr::flatten_path(outlines[i], items[i].transform, 0.25f, lines);
+         raster.rasterize(lines.data(), lines.size(), sr::fill_mode::winding, cov);
+         sr::fill_coverage(image, cov, items[i].color);
+         run.fill_lines += lines.size();
+      }
+   });
+   return run;
+}
+
+static int max_channel_diff(const sr::image_rgba8& a, const sr::image_rgba8& b, double& mean)
+{
+   int worst = 0;
+   uint64_t sum = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      for (int x = 0; x < a.width(); x++)
+      {
+         const uint32_t p = a.row(y)[x], q = b.row(y)[x];
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p >> c) & 0xff) - (int)((q >> c) & 0xff));
+            worst = d > worst ? d : worst;
+            sum += d;
+         }
+      }
+   }
+   mean = (double)sum / ((double)a.width() * a.height() * 4);
+   return worst;
+}
+
+// Round joins and caps: the stroke is every point within half the width
+// of the centerline. 8x8 samples per pixel against a centerline flattened to
+// 0.01 px, compared over the pixels either side covers. The outline is
+// filled at 0.02 px so that flattening it adds little
+static void check_round(const char* name, const std::vector<figure_desc>& figures, const sr::float3x2& m, float width)
+{
+   const int size = 512, ss = 8;
+   sr::stroke_style style;
+   style.start_cap = style.end_cap = sr::cap_style::round;
+   style.join = sr::line_join::round;
+
+   sr::path_geometry path, outline;
+   build_path(figures, path);
+   sr::path_stroker stroker;
+   stroker.stroke(path, width, style, m, 0.1f, outline);
+   std::vector<sr::line_segment> lines;
+   sr::flatten_path(outline, m, 0.02f, lines);
+   sr::strip_rasterizer raster(size, size);
+   sr::coverage_strips cov;
+   raster.rasterize(lines.data(), lines.size(), sr::fill_mode::winding, cov);
+   sr::image_rgba8 image(size, size);
+   image.clear(0);
+   sr::fill_coverage(image, cov, 0xffffffffu);
+
+   // `m` is a rotation and a uniform scale here
+   const float scale = sqrtf(fabsf(m.m11 * m.m22 - m.m12 * m.m21));
+   const float h = 0.5f * width * scale, h2 = h * h;
+   std::vector<sr::float2> points;
+   std::vector<sr::line_segment> center;
+   for (const figure_desc& f : figures)
+   {
+      flatten_figure(f, 0.01f / scale, points);
+      for (size_t i = 0; i + 1 < points.size(); i++)
+      {
+         const sr::float2 a = sr::transform_point(points[i], m), b = sr::transform_point(points[i + 1], m);
+         center.push_back({ a.x, a.y, b.x, b.y });
+      }
+   }
+
+   // Per pixel near the stroke: is any sample within h of any line?
+   std::vector<std::vector<uint32_t>> bins((size_t)(size / 16) * (size / 16));
+   for (uint32_t i = 0; i < center.size(); i++)
+   {
+      const sr::line_segment& l = center[i];
+      const int x0 = sr::clamp((int)floorf((fminf(l.x0, l.x1) - h) / 16), 0, size / 16 - 1);
+      const int x1 = sr::clamp((int)floorf((fmaxf(l.x0, l.x1) + h) / 16), 0, size / 16 - 1);
+      const int y0 = sr::clamp((int)floorf((fminf(l.y0, l.y1) - h) / 16), 0, size / 16 - 1);
+      const int y1 = sr::clamp((int)floorf((fmaxf(l.y0, l.y1) + h) / 16), 0, size / 16 - 1);
+      for (int by = y0; by <= y1; by++)
+         for (int bx = x0; bx <= x1; bx++)
+            bins[(size_t)by * (size / 16) + bx].push_back(i);
+   }
+
+   int worst = 0;
+   double sum = 0.0;
+   size_t counted = 0;
+   for (int y = 0; y < size; y++)
+   {
+      for (int x = 0; x < size; x++)
+      {
+         const std::vector<uint32_t>& bin = bins[(size_t)(y / 16) * (size / 16) + x / 16];
+         int hits = 0;
+         if (!bin.empty())
+         {
+            for (int sy = 0; sy < ss; sy++)
+            {
+               for (int sx = 0; sx < ss; sx++)
+               {
+                  const float px = x + (sx + 0.5f) / ss, py = y + (sy + 0.5f) / ss;
+                  for (uint32_t i : bin)
+                  {
+                     const sr::line_segment& l = center[i];
+                     const float dx = l.x1 - l.x0, dy = l.y1 - l.y0;
+                     const float len2 = dx * dx + dy * dy;
+                     float t = len2 > 0.0f ? ((px - l.x0) * dx + (py - l.y0) * dy) / len2 : 0.0f;
+                     t = sr::clamp(t, 0.0f, 1.0f);
+                     const float ex = l.x0 + t * dx - px, ey = l.y0 + t * dy - py;
+                     if (ex * ex + ey * ey <= h2)
+                     {
+                        hits++;
+                        break;
+                     }
+                  }
+               }
+            }
+         }
+         const int ref = (hits * 255 + ss * ss / 2) / (ss * ss);
+         const int got = (int)(image.row(y)[x] >> 24);
+         if (ref || got)
+         {
+            const int d = abs(ref - got);
+            worst = d > worst ? d : worst;
+            sum += d;
+            counted++;
+         }
+      }
+   }
+   printf("  %-28s width %5.1f | %6llu cubics %5llu lines | %7zu stroke pixels, alpha diff max %3d, mean %5.2f\n", name, width * scale,
+      (unsigned long long)stroker.stats().curves, (unsigned long long)stroker.stats().lines, counted, worst, counted ? sum / counted : 0.0);
+}
+
+void run_stroke()
+{
+   const int width = 3840, height = 2160;
+
+   std::vector<sr::stroke_style> styles;
+   static const sr::line_join joins[] = { sr::line_join::miter, sr::line_join::round, sr::line_join::bevel, sr::line_join::miter_or_bevel };
+   for (sr::line_join j : joins)
+   {
+      sr::stroke_style s;
+      s.join = j;
+      styles.push_back(s);
+   }
+   const int first_curve_style = (int)styles.size();
+   {
+      sr::stroke_style s;
+      s.start_cap = s.end_cap = sr::cap_style::round;
+      s.join = sr::line_join::round;
+      styles.push_back(s);
+      s.start_cap = sr::cap_style::triangle;
+      s.end_cap = sr::cap_style::square;
+      s.join = sr::line_join::miter;
+      styles.push_back(s);
+   }
+   const int first_dash_style = (int)styles.size();
+   static const sr::dash_style dashes[] = { sr::dash_style::dash, sr::dash_style::dot, sr::dash_style::dash_dot, sr::dash_style::dash_dot_dot, sr::dash_style::custom };
+   for (sr::dash_style d : dashes)
+   {
+      sr::stroke_style s;
+      s.dash = d;
+      s.dash_cap = d == sr::dash_style::dash ? sr::cap_style::flat : (d == sr::dash_style::custom ? sr::cap_style::square : sr::cap_style::round);
+      s.dashes = { 4.0f, 1.0f, 1.0f, 1.0f };
+      s.dash_offset = 0.5f;
+      styles.push_back(s);
+   }
+   const int chart_style = (int)styles.size();
+   {
+      sr::stroke_style s;
+      s.start_cap = s.end_cap = sr::cap_style::square;
+      s.join = sr::line_join::bevel;
+      styles.push_back(s);
+   }
+
+   // Four groups, back to front
+   struct group
+   {
+      const char* name;
+      size_t first, last;
+   };
+   std::vector<group> groups;
+   std::vector<stroke_item> items;
+   rng r(3);
+   auto add = [&](std::vector<figure_desc> figures, float scale, float degrees, float line_width, int style) {
+      stroke_item it;
+      it.figures = std::move(figures);
+      build_path(it.figures, it.path);
+      it.scale = scale;
+      it.transform = sr::mul(sr::mul(sr::scale3x2(scale, scale), sr::rotation3x2(degrees)),
+                             sr::translation3x2(r.range(0.0f, (float)width), r.range(0.0f, (float)height)));
+      it.width = line_width / scale;
+      it.style = style;
+      it.color = sr::premultiplied_rgba8(r.unit(), r.unit(), r.unit(), r.range(0.6f, 1.0f));
+      items.push_back(std::move(it));
+   };
+
+   groups.push_back({ "1000 hourglasses", items.size(), 0 });
+   for (int i = 0; i < 1000; i++)
+      add({ hourglass() }, r.range(0.2f, 1.0f), r.range(0.0f, 360.0f), r.range(1.0f, 6.0f), i % 4);
+   groups.back().last = items.size();
+   groups.push_back({ "1500 cubic curves", items.size(), 0 });
+   for (int i = 0; i < 1500; i++)
+      add({ curve(r, 3, 100.0f) }, 1.0f, 0.0f, r.range(1.0f, 8.0f), first_curve_style + i % 2);
+   groups.back().last = items.size();
+   groups.push_back({ "1000 dashed circles", items.size(), 0 });
+   for (int i = 0; i < 1000; i++)
+      add({ circle(r.range(10.0f, 80.0f)) }, 1.0f, r.range(0.0f, 360.0f), r.range(1.5f, 4.0f), first_dash_style + i % 5);
+   groups.back().last = items.size();
+   groups.push_back({ "500 charts", items.size(), 0 });
+   for (int i = 0; i < 500; i++)
+      add({ chart(r, 20, 300.0f, 120.0f) }, 1.0f, 0.0f, r.range(1.0f, 3.0f), chart_style);
+   groups.back().last = items.size();
+
+   printf("%zu strokes at %dx%d, tolerance 0.1 px, outlines filled at 0.25 px\n", items.size(), width, height);
+   std::vector<sr::path_geometry> outlines(items.size());
+   sr::image_rgba8 direct(width, height), flattened(width, height);
+   groups.push_back({ "all", 0, items.size() });
+   for (const group& g : groups)
+   {
+      const stroke_run a = run_frame(items, g.first, g.last, styles, false, outlines, direct);
+      const stroke_run b = run_frame(items, g.first, g.last, styles, true, outlines, flattened);
+      double mean = 0.0;
+      const int diff = max_channel_diff(direct, flattened, mean);
+      const double strokes = (double)(g.last - g.first);
+      printf("  %-20s direct  stroke %7.2f ms (%6.0f strokes/ms) | %7llu cubics %7llu lines %6llu splits | fill %7.2f ms, %8llu lines\n",
+         g.name, a.stroke_ms, strokes / a.stroke_ms, (unsigned long long)a.curves, (unsigned long long)a.lines, (unsigned long long)a.splits,
+         a.fill_ms, (unsigned long long)a.fill_lines);
+      printf("  %-20s flatten stroke %7.2f ms (%6.0f strokes/ms) | %7llu cubics %7llu lines %6s        | fill %7.2f ms, %8llu lines"
+             " | diff max %d, mean %.3f\n",
+         "", b.stroke_ms, strokes / b.stroke_ms, (unsigned long long)b.curves, (unsigned long long)b.lines, "",
+         b.fill_ms, (unsigned long long)b.fill_lines, diff, mean);
+   }
+   consume(direct.at(width / 2, height / 2) + flattened.at(width / 2, height / 2));
+
+   printf("Round joins and caps against supersampled distance to the centerline:\n");
+   rng rc(5);
+   const sr::float3x2 fit = sr::mul(sr::scale3x2(2.0f, 2.0f), sr::translation3x2(56.0f, 56.0f));
+   const figure_desc loop = { { 100, 400 }, { { false, { 500, 0 }, { 0, 0 }, { 400, 400 } } }, false };
+   const figure_desc cusp = { { 60, 450 }, { { false, { 450, 60 }, { 60, 60 }, { 450, 450 } } }, false };
+   for (float w : { 1.0f, 4.0f, 16.0f })
+   {
+      check_round("hourglass x2", { hourglass() }, fit, w / 2.0f);
+      check_round("loop", { loop }, sr::identity3x2(), w);
+      check_round("cusp", { cusp }, sr::identity3x2(), w);
+      check_round("rotated circle", { circle(200.0f) }, sr::mul(sr::rotation3x2(17.0f), sr::translation3x2(256.0f, 256.0f)), w);
+      check_round("random cubics", { curve(rc, 6, 240.0f) }, sr::translation3x2(256.0f, 256.0f), w);
+   }
+}
+
+}
@@ -0,0 +1,207 @@
+// Text at 4K with the embedded font: the sample's frame ("Hello, World!"
+// centered at 50px, then again under a 45 degree rotation), a wrapped page
+// of 16px text, and 3000 short labels. Each is drawn the way a test path
+// without caches does it (lay out, flatten and rasterize every glyph on
+// every draw) and through text_renderer, reporting glyphs per second.
+// Every case, rotated text included, is compared with uncached fills at the
+// same quarter-pixel snapped positions, and the run fails when any channel
+// differs by more than max_text_diff. A rotated 400px title is too large for
+// per-transform coverage and goes through the distance fields; its error is
+// reported, not gated.
+
+#include "bench.h"
+#include "sr_text.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+namespace bench
+{
+
+struct text_draw
+{
+   std::string text;
+   sr::rect_f box;
+   sr::float3x2 transform;
+   uint32_t color;
+};
+
+struct uncached_text
+{
+   sr::text_layout layout;
+   std::vector<sr::line_segment> lines;
+   sr::strip_rasterizer raster;
+   sr::coverage_strips coverage;
+   uint64_t glyphs = 0;
+};
+
+// Rounding of the coverage bytes and the blends, nothing more
+static const int max_text_diff = 1;
+
+// Lays out and fills every glyph outline; positions snap like the renderer's
+static void draw_uncached(sr::image_rgba8& target, const sr::text_format& format, const text_draw& d, uncached_text& u)
+{
+   sr::layout_text(d.text.data(), d.text.size(), format, d.box, u.layout);
+   const sr::font_face& font = *format.font;
+   const float em = format.size / font.metrics().units_per_em;
+   const sr::float3x2& t = d.transform;
+   const bool snapped = t.m12 == 0.0f && t.m21 == 0.0f && t.m11 == t.m22 && t.m11 > 0.0f;
+   u.raster.set_target_size(target.width(), target.height());
+   const float steps = (float)sr::glyph_atlas::subpixel_steps;
+   for (const sr::positioned_glyph& g : u.layout.glyphs)
+   {
+      sr::float3x2 m;
+      const sr::float2 p = sr::transform_point({ g.x, g.y }, t);
+      const float x = floorf(p.x * steps + 0.5f) / steps;
+      if (snapped)
+      {
+         m = sr::mul(sr::scale3x2(em * t.m11, em * t.m11), sr::translation3x2(x, floorf(p.y + 0.5f)));
+      }
+      else
+      {
+         const sr::float3x2 linear = { t.m11, t.m12, t.m21, t.m22, 0.0f, 0.0f };
+         m = sr::mul(sr::mul(sr::scale3x2(em, em), linear), sr::translation3x2(x, floorf(p.y * steps + 0.5f) / steps));
+      }
+      u.lines.clear();
+      sr::flatten_path(font.outline(g.glyph), m, 0.25f, u.lines);
+      u.raster.rasterize(u.lines.data(), u.lines.size(), font.outline(g.glyph).get_fill_mode(), u.coverage);
+      sr::fill_coverage(target, u.coverage, d.color);
+   }
+   u.glyphs += u.layout.glyphs.size();
+}
+
+static void compare(const sr::image_rgba8& a, const sr::image_rgba8& b, int& max_diff, double& mean_diff)
+{
+   max_diff = 0;
+   uint64_t sum = 0, pixels = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      for (int x = 0; x < a.width(); x++)
+      {
+         const uint32_t p = a.at(x, y), q = b.at(x, y);
+         if (p == q)
+            continue;
+         int worst = 0;
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int diff = abs((int)((p >> c) & 0xff) - (int)((q >> c) & 0xff));
+            worst = diff > worst ? diff : worst;
+         }
+         max_diff = worst > max_diff ? worst : max_diff;
+         sum += worst;
+         pixels++;
+      }
+   }
+   // Over the pixels text touched in either image
+   mean_diff = pixels ? (double)sum / pixels : 0.0;
+}
+
+static void run_case(const char* name, const sr::text_format& format, const std::vector<text_draw>& draws, int width, int height)
+{
+   const uint32_t background = 0xffffffffu;
+   sr::image_rgba8 reference(width, height), image(width, height);
+   uncached_text u;
+   sr::text_renderer renderer;
+
+   reference.clear(background);
+   for (const text_draw& d : draws)
+      draw_uncached(reference, format, d, u);
+   const uint64_t glyphs = u.glyphs;
+
+   // First frame fills the caches; later frames only emit and draw quads
+   image.clear(background);
+   timer first;
+   for (const text_draw& d : draws)
+      renderer.draw_text(image, d.text.data(), d.text.size(), format, d.box, d.transform, d.color);
+   renderer.flush();
+   const double first_ms = first.elapsed_ms();
+   int max_diff;
+   double mean_diff;
+   compare(image, reference, max_diff, mean_diff);
+
+   const double uncached_ms = best_of(3, [&] {
+      for (const text_draw& d : draws)
+         draw_uncached(reference, format, d, u);
+   });
+   renderer.reset_stats();
+   renderer.layouts().reset_stats();
+   renderer.atlas().reset_stats();
+   const double cached_ms = best_of(5, [&] {
+      for (const text_draw& d : draws)
+         renderer.draw_text(image, d.text.data(), d.text.size(), format, d.box, d.transform, d.color);
+      renderer.flush();
+   });
+
+   const sr::text_stats& ts = renderer.stats();
+   printf("  %-26s %6llu glyphs | uncached %8.2f ms (%6.2f Mglyph/s) | cached %7.2f ms (%6.2f Mglyph/s, %5.1fx), first frame %7.2f ms\n",
+      name, (unsigned long long)glyphs, uncached_ms, glyphs / uncached_ms * 1e-3, cached_ms, glyphs / cached_ms * 1e-3,
+      uncached_ms / cached_ms, first_ms);
+   printf("  %-26s quads %llu + sdf %llu, %llu flushes | layouts %llu hits %llu misses | atlas %zu glyphs, %llu hits, %llu resets | diff max %d, mean %.2f\n",
+      "", (unsigned long long)ts.quads, (unsigned long long)ts.sdf_quads, (unsigned long long)ts.flushes,
+      (unsigned long long)renderer.layouts().stats().hits, (unsigned long long)renderer.layouts().stats().misses,
+      renderer.atlas().glyph_count(), (unsigned long long)renderer.atlas().stats().hits,
+      (unsigned long long)renderer.atlas().stats().resets, max_diff, mean_diff);
+   if (max_diff > max_text_diff && ts.sdf_quads == 0)
+      gate_failed();
+   consume(image.at(width / 2, height / 2) + reference.at(width / 2, height / 2));
+}
+
+void run_text()
+{
+   const int width = 3840, height = 2160;
+   printf("text at %dx%d with the embedded font\n", width, height);
+   const sr::rect_f screen = { 0.0f, 0.0f, (float)width, (float)height };
+   const uint32_t black = 0xff000000u;
+
+   // msc_fontSize, centered both ways
+   sr::text_format sample;
+   sample.font = &sr::builtin_font();
+   sample.size = 50.0f;
+   sample.alignment = sr::text_alignment::center;
+   sample.paragraph = sr::paragraph_alignment::center;
+
+   const std::string hello = "Hello, World!";
+   run_case("hello", sample, { { hello, screen, sr::identity3x2(), black } }, width, height);
+   run_case("hello rotated 45", sample,
+      { { hello, screen, sr::rotation3x2(45.0f, { width * 0.5f, height * 0.5f }), black } }, width, height);
+   sr::text_format title = sample;
+   title.size = 400.0f;
+   run_case("title 400px rotated 30", title,
+      { { "Hello", screen, sr::rotation3x2(30.0f, { width * 0.5f, height * 0.5f }), black } }, width, height);
+
+   // A page of wrapped words
+   rng r(17);
+   std::string page;
+   static const char* const s_words[] = { "lorem", "ipsum", "dolor", "sit", "amet,", "render", "target", "swap", "chain", "glyph",
+                                          "atlas", "DrawText", "Direct2D", "layout", "0123", "quad!" };
+   while (page.size() < 20000)
+   {
+      page += s_words[r.next() % (sizeof(s_words) / sizeof(s_words[0]))];
+      page += ' ';
+   }
+   sr::text_format body;
+   body.font = &sr::builtin_font();
+   body.size = 16.0f;
+   run_case("page 16px", body, { { page, { 40.0f, 40.0f, width - 40.0f, height - 40.0f }, sr::identity3x2(), black } }, width, height);
+
+   // Labels at fractional positions, a few of them rotated
+   sr::text_format label = body;
+   label.size = 14.0f;
+   label.word_wrap = false;
+   std::vector<text_draw> labels;
+   for (int i = 0; i < 3000; i++)
+   {
+      const float x = r.range(0.0f, width - 200.0f), y = r.range(0.0f, height - 20.0f);
+      char text[32];
+      snprintf(text, sizeof(text), "item %d: %u", i, r.next() % 100000);
+      const sr::float3x2 t = i % 10 == 0 ? sr::rotation3x2(r.range(-30.0f, 30.0f), { x, y }) : sr::identity3x2();
+      labels.push_back({ text, { x, y, x + 200.0f, y + 20.0f }, t, 0xff000000u | (r.next() & 0x7f7f7fu) });
+   }
+   run_case("3000 labels", label, labels, width, height);
+}
+
+}
@@ -0,0 +1,179 @@
+// Tile-parallel display list playback at 4K: a frame of the sample's kind of
+// content (gradient background, the 50% grid brush, hourglasses, rectangles,
+// gradient panels, bitmaps, labels and rotated text) drawn with 1 to N
+// threads and three tile sizes. Every run must give exactly the frame drawn
+// untiled (the whole surface one tile) on one thread.
+
+#include "bench.h"
+#include "sr_tiles.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bench
+{
+
+struct tiles_content
+{
+   sr::path_geometry hourglass;
+   sr::image_rgba8 grid, photo;
+   std::vector<sr::gradient_stop> background_stops;
+   std::vector<sr::gradient_stop> panel_stops;
+   std::vector<std::string> labels;
+};
+
+static void make_content(tiles_content& s)
+{
+   sr::path_geometry& h = s.hourglass;
+   h.begin_figure({ 0, 0 });
+   h.add_line({ 200, 0 });
+   h.add_bezier({ 150, 50 }, { 150, 150 }, { 200, 200 });
+   h.add_line({ 0, 200 });
+   h.add_bezier({ 50, 150 }, { 50, 50 }, { 0, 0 });
+   h.end_figure(sr::figure_end::closed);
+
+   const uint32_t line = sr::premultiplied_rgba8(0.93f, 0.94f, 0.96f, 1.0f);
+   s.grid.resize(10, 10);
+   for (int i = 0; i < 10; i++)
+   {
+      s.grid.row(0)[i] = line;
+      s.grid.row(i)[0] = line;
+   }
+
+   s.photo.resize(320, 240);
+   for (int y = 0; y < 240; y++)
+      for (int x = 0; x < 320; x++)
+         s.photo.row(y)[x] = sr::premultiplied_rgba8(x / 320.0f, y / 240.0f, 0.5f, ((x / 40 + y / 40) & 1) ? 1.0f : 0.6f);
+
+   s.background_stops = { { 0.0f, { 0.0f, 0.0f, 0.2f, 1.0f } }, { 1.0f, { 0.0f, 0.0f, 0.5f, 1.0f } } };
+   s.panel_stops = { { 0.0f, { 0.0f, 1.0f, 1.0f, 0.25f } }, { 0.5f, { 1.0f, 0.5f, 0.0f, 0.8f } }, { 1.0f, { 0.0f, 0.0f, 1.0f, 1.0f } } };
+
+   rng r(7);
+   for (int i = 0; i < 64; i++)
+   {
+      std::string label = "Item " + std::to_string(i);
+      const int extra = (int)(r.next() % 12);
+      for (int k = 0; k < extra; k++)
+         label += (char)('a' + r.next() % 26);
+      s.labels.push_back(label);
+   }
+}
+
+static int max_channel_diff(const sr::image_rgba8& a, const sr::image_rgba8& b)
+{
+   int worst = 0;
+   for (int y = 0; y < a.height(); y++)
+   {
+      const uint32_t* p = a.row(y);
+      const uint32_t* q = b.row(y);
+      if (memcmp(p, q, a.width() * sizeof(uint32_t)) == 0)
+         continue;
+      for (int x = 0; x < a.width(); x++)
+      {
+         for (int c = 0; c < 32; c += 8)
+         {
+            const int d = abs((int)((p[x] >> c) & 0xff) - (int)((q[x] >> c) & 0xff));
+            worst = d > worst ? d : worst;
+         }
+      }
+   }
+   return worst;
+}
+
+void run_tiles()
+{
+   const int width = 3840, height = 2160;
+   tiles_content s;
+   make_content(s);
+
+   const sr::gradient_stops stops(s.background_stops.data(), s.background_stops.size());
+   const sr::gradient_brush background(sr::linear_gradient{ { 0.0f, 0.0f }, { 0.0f, 1.0f } }, stops, sr::scale3x2((float)width, (float)height));
+   const sr::gradient_stops panel_stops(s.panel_stops.data(), s.panel_stops.size(), sr::extend_mode::mirror);
+   const sr::gradient_brush diagonal(sr::linear_gradient{ { 0.0f, 0.0f }, { 157.0f, 93.0f } }, panel_stops);
+   const sr::gradient_brush rings(sr::radial_gradient{ { 0.0f, 0.0f }, { 20.0f, -10.0f }, 90.0f, 60.0f }, panel_stops,
+                                  sr::mul(sr::rotation3x2(30.0f), sr::translation3x2(2400.0f, 700.0f)));
+   const sr::bitmap_brush grid(s.grid, sr::extend_mode::wrap, sr::extend_mode::wrap, sr::bitmap_interpolation::linear, sr::identity3x2(), 0.5f);
+   sr::text_format label_format;
+   label_format.font = &sr::builtin_font();
+   label_format.size = 16.0f;
+   sr::text_format title_format = label_format;
+   title_format.size = 48.0f;
+
+   // Back to front: background, grid, shapes, bitmaps, text
+   sr::display_list list;
+   rng r;
+   list.fill_rect(sr::rect_i{ 0, 0, width, height }, background);
+   list.fill_rect(sr::rect_i{ 0, 0, width, height }, grid);
+   for (int i = 0; i < 300; i++)
+   {
+      const float x = r.range(-100.0f, (float)width), y = r.range(-100.0f, (float)height);
+      list.fill_rect({ x, y, x + r.range(20.0f, 300.0f), y + r.range(20.0f, 200.0f) },
+                     sr::premultiplied_rgba8(r.unit(), r.unit(), r.unit(), r.range(0.3f, 1.0f)));
+   }
+   for (int i = 0; i < 150; i++)
+   {
+      const sr::float3x2 m = sr::mul(sr::mul(sr::scale3x2(r.range(0.3f, 1.5f), r.range(0.3f, 1.5f)), sr::rotation3x2(r.range(0.0f, 360.0f))),
+                                     sr::translation3x2(r.range(0.0f, (float)width), r.range(0.0f, (float)height)));
+      list.fill_geometry(s.hourglass, m, sr::premultiplied_rgba8(r.unit(), r.unit(), r.unit(), r.range(0.5f, 1.0f)));
+   }
+   list.fill_rect(sr::rect_i{ 200, 1200, 1500, 1900 }, diagonal);
+   list.fill_rect(sr::rect_i{ 2000, 300, 3000, 1100 }, rings);
+   for (int i = 0; i < 24; i++)
+      list.draw_image(s.photo, (int)r.range(0.0f, width - 320.0f), (int)r.range(0.0f, height - 240.0f), r.range(0.5f, 1.0f));
+   const uint32_t white = sr::premultiplied_rgba8(1.0f, 1.0f, 1.0f, 1.0f);
+   for (int i = 0; i < 600; i++)
+   {
+      const std::string& label = s.labels[i % s.labels.size()];
+      const float x = (float)(i % 12) * 320.0f + 8.0f, y = (float)(i / 12) * 43.0f + 4.0f;
+      list.draw_text(label.data(), label.size(), label_format, { 0.0f, 0.0f, 300.0f, 40.0f }, sr::translation3x2(x, y), white);
+   }
+   for (int i = 0; i < 8; i++)
+   {
+      static const char title[] = "Hello, World!";
+      const sr::float3x2 m = sr::mul(sr::rotation3x2(45.0f * (i + 1) / 8), sr::translation3x2(400.0f + i * 420.0f, 1000.0f));
+      list.draw_text(title, sizeof(title) - 1, title_format, { 0.0f, 0.0f, 800.0f, 100.0f }, m, sr::premultiplied_rgba8(1.0f, 0.0f, 0.0f, 1.0f));
+   }
+   printf("%dx%d, %zu commands, %u hardware threads\n", width, height, list.size(), std::thread::hardware_concurrency());
+
+   // Untiled, one thread: the whole frame is one tile
+   sr::image_rgba8 untiled(width, height);
+   {
+      sr::thread_pool pool(1);
+      sr::tile_renderer renderer(pool, 1 << 14);
+      renderer.render(untiled, list);
+      const double ms = best_of(3, [&] { renderer.render(untiled, list); });
+      printf("  untiled, 1 thread      %7.2f ms\n", ms);
+   }
+
+   sr::image_rgba8 image(width, height);
+   const int hardware = (int)std::thread::hardware_concurrency();
+   const int max_threads = hardware > 8 ? hardware : 8;
+   double one_thread_ms[3] = {};
+   for (int threads = 1; threads <= max_threads; threads *= 2)
+   {
+      sr::thread_pool pool(threads);
+      for (int t = 0; t < 3; t++)
+      {
+         const int tile = 64 << t;
+         sr::tile_renderer renderer(pool, tile);
+         renderer.render(image, list);   // warms the atlas and the buffers
+         renderer.reset_stats();
+         const double ms = best_of(3, [&] { renderer.render(image, list); });
+         if (threads == 1)
+            one_thread_ms[t] = ms;
+         const sr::tile_stats& st = renderer.stats();
+         const int diff = max_channel_diff(image, untiled);
+         printf("  %2d threads, %3d px tiles %7.2f ms (%5.2fx) | %4llu tiles, %4.1f commands per tile | %s\n",
+            threads, tile, ms, one_thread_ms[t] / ms, (unsigned long long)(st.tiles_drawn / st.frames),
+            st.tiles_drawn ? (double)st.binned / st.tiles_drawn : 0.0, diff == 0 ? "same as untiled" : "DIFFERS FROM UNTILED");
+      }
+   }
+   consume(image.at(width / 2, height / 2));
+}
+
+}
@@ -0,0 +1,241 @@
+// Upload ring: frames of the DXGISample kind scaled up, 1000 to 3000
+// objects a frame, each with World, View and Projection in a 256-byte
+// aligned constant range and one in four streaming 256 to 16K of vertices.
+// Allocations per second of ring_allocator against malloc and free of a
+// block per upload, the same frames written through upload_ring with the
+// maps per frame against a map per upload, fragmentation (alignment padding
+// and the unused ends of laps) and failures for ring sizes of 2 to 6
+// frames and 1 to 3 frames in flight, a check that no allocation reaches
+// bytes of a frame the GPU may still be reading, and a check that a failed
+// map takes nothing from the ring.
+
+#include "bench.h"
+#include "sr_upload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// Fails every map while `fail` is set
+class failing_dynamic_buffer : public sr::memory_dynamic_buffer
+{
+public:
+   using memory_dynamic_buffer::memory_dynamic_buffer;
+
+   uint8_t* map(bool discard) override { return fail ? nullptr : memory_dynamic_buffer::map(discard); }
+
+   bool fail = false;
+};
+
+struct upload_request
+{
+   uint32_t size;
+   uint32_t alignment;
+};
+
+// One frame's requests, appended to `out`; returns the bytes asked for
+static size_t make_upload_frame(rng& r, std::vector<upload_request>& out)
+{
+   const int objects = 1000 + (int)(r.next() % 2001);
+   size_t bytes = 0;
+   for (int i = 0; i < objects; i++)
+   {
+      out.push_back({ 3 * 64, (uint32_t)sr::constant_alignment });
+      bytes += 3 * 64;
+      if ((r.next() & 3) == 0)
+      {
+         const uint32_t size = 16 * (16 + r.next() % 1009);
+         out.push_back({ size, 16 });
+         bytes += size;
+      }
+   }
+   return bytes;
+}
+
+void run_upload()
+{
+   const int frames = 200;
+   rng r(50);
+   std::vector<upload_request> requests;
+   std::vector<size_t> frame_start(frames + 1);
+   size_t total_bytes = 0;
+   for (int f = 0; f < frames; f++)
+   {
+      frame_start[f] = requests.size();
+      total_bytes += make_upload_frame(r, requests);
+   }
+   frame_start[frames] = requests.size();
+   const size_t frame_bytes = total_bytes / frames;
+   const double per_frame = (double)requests.size() / frames;
+   printf("  %d frames, %.0f allocations and %.2f MB a frame on average\n", frames, per_frame, frame_bytes * 1e-6);
+
+   // Allocation alone, 3 frames in flight and the frame being written in 6
+   // frames of ring
+   const size_t capacity = 6 * frame_bytes;
+   uint64_t sink = 0;
+   const int rounds = 5;
+   const double ring_ms = best_of(rounds, [&] {
+      sr::ring_allocator ring(capacity);
+      sr::ring_allocation a;
+      for (int f = 0; f < frames; f++)
+      {
+         for (size_t i = frame_start[f]; i < frame_start[f + 1]; i++)
+         {
+            ring.allocate(requests[i].size, requests[i].alignment, a);
+            sink += a.offset;
+         }
+         ring.end_frame();
+      }
+   });
+   std::vector<void*> blocks;
+   blocks.reserve(requests.size());
+   const double malloc_ms = best_of(rounds, [&] {
+      for (int f = 0; f < frames; f++)
+      {
+         for (size_t i = frame_start[f]; i < frame_start[f + 1]; i++)
+            blocks.push_back(malloc(requests[i].size));
+         sink += (uintptr_t)blocks.back();
+         for (void* b : blocks)
+            free(b);
+         blocks.clear();
+      }
+   });
+   printf("  ring_allocator %6.1f ns an allocation (%5.0f M/s) | malloc and free %6.1f ns (%5.0f M/s)\n",
+      ring_ms * 1e6 / requests.size(), requests.size() / ring_ms * 1e-3, malloc_ms * 1e6 / requests.size(),
+      requests.size() / malloc_ms * 1e-3);
+
+   // Written through upload_ring: one map a frame unless a lap starts in it
+   std::vector<uint8_t> payload(16 * 1024 + 16 * 16);
+   for (size_t i = 0; i < payload.size(); i++)
+      payload[i] = (uint8_t)i;
+   uint64_t flushes = 0, failures = 0;
+   uint64_t maps = 0;
+   const double upload_ms = best_of(rounds, [&] {
+      sr::memory_dynamic_buffer buffer(capacity);
+      sr::upload_ring ring(buffer, capacity);
+      flushes = failures = 0;
+      for (int f = 0; f < frames; f++)
+      {
+         for (size_t i = frame_start[f]; i < frame_start[f + 1]; i++)
+         {
+            size_t offset;
+            void* p = ring.allocate(requests[i].size, requests[i].alignment, offset);
+            if (!p && ring.allocator().wraps(requests[i].size, requests[i].alignment))
+            {
+               // A lap starts: draw what is written, then go on
+               ring.flush();
+               flushes++;
+               p = ring.allocate(requests[i].size, requests[i].alignment, offset);
+            }
+            if (p)
+               memcpy(p, payload.data(), requests[i].size);
+            else
+               failures++;
+         }
+         ring.end_frame();
+      }
+      maps = buffer.maps();
+   });
+   printf("  upload_ring    %6.2f ms a frame, %5.1f GB/s written | %.2f maps a frame (%.2f flushes at a lap start) against %.0f for a map "
+          "per upload | %llu failed\n",
+      upload_ms / frames, total_bytes / upload_ms * 1e-6, (double)maps / frames, (double)flushes / frames, per_frame,
+      (unsigned long long)failures);
+
+   // Fragmentation and failures, longer runs
+   printf("  ring size, frames in flight: padding, wasted lap ends, peak use, failed allocations, discards a frame\n");
+   const double sizes[] = { 2.0, 3.0, 4.0, 6.0 };
+   for (double s : sizes)
+   {
+      for (uint32_t in_flight = 1; in_flight <= 3; in_flight++)
+      {
+         sr::ring_allocator ring((size_t)(s * frame_bytes), in_flight);
+         rng fr(500);
+         std::vector<upload_request> frame;
+         const int long_frames = 1000;
+         sr::ring_allocation a;
+         for (int f = 0; f < long_frames; f++)
+         {
+            frame.clear();
+            make_upload_frame(fr, frame);
+            for (const upload_request& q : frame)
+               ring.allocate(q.size, q.alignment, a);
+            ring.end_frame();
+         }
+         const sr::ring_stats& st = ring.stats();
+         const double used = (double)(st.requested + st.padding + st.wrap_waste);
+         printf("  %3.1f frames, %u: %5.2f%% padding, %5.2f%% lap ends, %5.1f%% peak, %7.3f%% failed, %.2f discards\n", s, in_flight,
+            100.0 * st.padding / used, 100.0 * st.wrap_waste / used, 100.0 * st.peak_in_use / ring.capacity(),
+            100.0 * st.failures / (st.allocations + st.failures), (double)st.discards / long_frames);
+      }
+   }
+
+   // Every 16 bytes remember the frame that wrote them; an allocation may
+   // only take bytes of retired frames. Fences retired by hand, the GPU two
+   // frames behind
+   {
+      const size_t check_capacity = 3 * frame_bytes;
+      sr::ring_allocator ring(check_capacity, 0);
+      std::vector<uint64_t> owner(check_capacity / 16 + 1);
+      uint64_t violations = 0;
+      sr::ring_allocation a;
+      for (int f = 0; f < frames; f++)
+      {
+         const uint64_t frame = ring.frame();
+         for (size_t i = frame_start[f]; i < frame_start[f + 1]; i++)
+         {
+            if (!ring.allocate(requests[i].size, requests[i].alignment, a))
+               continue;
+            for (size_t g = a.offset / 16; g < (a.offset + requests[i].size + 15) / 16; g++)
+            {
+               violations += owner[g] > ring.retired() && owner[g] != frame;
+               owner[g] = frame;
+            }
+         }
+         const uint64_t fence = ring.end_frame();
+         if (fence > 2)
+            ring.retire(fence - 2);
+      }
+      const sr::ring_stats& st = ring.stats();
+      printf("  check, 3 frames of ring, GPU 2 frames behind: %llu allocations, %llu failed, %llu reached bytes in flight\n",
+         (unsigned long long)st.allocations, (unsigned long long)st.failures, (unsigned long long)violations);
+   }
+
+   // A map that fails takes nothing from the ring: the retry gets the same
+   // bytes, and the map that starts a lap still discards
+   {
+      const size_t check_capacity = 4096;
+      failing_dynamic_buffer buffer(check_capacity);
+      sr::upload_ring ring(buffer, check_capacity, 0);
+      int wrong = 0;
+      size_t offset = 0;
+      for (int lap = 0; lap < 3; lap++)
+      {
+         buffer.fail = true;
+         wrong += ring.allocate(1024, 256, offset) != nullptr || !ring.allocator().wraps(1024, 256);
+         buffer.fail = false;
+         wrong += ring.allocate(1024, 256, offset) == nullptr || offset != 0 || buffer.discards() != (uint64_t)lap + 1;
+         for (int i = 1; i < 4; i++)
+         {
+            ring.flush();
+            buffer.fail = true;
+            wrong += ring.allocate(1024, 256, offset) != nullptr;
+            buffer.fail = false;
+            wrong += ring.allocate(1024, 256, offset) == nullptr || offset != 1024u * i;
+         }
+         ring.retire(ring.end_frame());
+      }
+      const sr::ring_stats& st = ring.allocator().stats();
+      wrong += st.allocations != 12 || st.discards != 3 || buffer.discards() != 3;
+      printf("  check, maps failing before each allocation: %d wrong\n", wrong);
+      if (wrong)
+         gate_failed();
+   }
+
+   consume(sink);
+}
+
+}
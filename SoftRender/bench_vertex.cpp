@@ -0,0 +1,134 @@
+// Vertex stage: per-reference World/View/Projection vs concatenated SoA + post-transform cache
+
+#include "bench.h"
+#include "sr_vertex.h"
+
+#include <math.h>
+
+#include <vector>
+
+namespace bench
+{
+
+// Same layout as SimpleVertex in DxgiSample.h
+struct bench_vertex
+{
+   float pos[3];
+   float tex[2];
+};
+
+struct grid_mesh
+{
+   std::vector<bench_vertex> vertices;
+   std::vector<uint32_t> indices;
+};
+
+// Regular grid, two triangles per cell, rows emitted in order: interior
+// vertices are shared by six triangles like any closed mesh
+static grid_mesh make_grid(int side)
+{
+   grid_mesh g;
+   g.vertices.resize((size_t)side * side);
+   for (int y = 0; y < side; y++)
+      for (int x = 0; x < side; x++)
+         g.vertices[(size_t)y * side + x] = { { (float)x / side - 0.5f, 0.0f, (float)y / side - 0.5f }, { (float)x / side, (float)y / side } };
+
+   g.indices.reserve((size_t)(side - 1) * (side - 1) * 6);
+   for (int y = 0; y + 1 < side; y++)
+   {
+      for (int x = 0; x + 1 < side; x++)
+      {
+         const uint32_t i0 = (uint32_t)(y * side + x), i1 = i0 + 1, i2 = i0 + side, i3 = i2 + 1;
+         g.indices.insert(g.indices.end(), { i0, i2, i1, i1, i2, i3 });
+      }
+   }
+   return g;
+}
+
+static sr::float4x4 make_matrix(float seed)
+{
+   sr::float4x4 m = sr::identity4x4();
+   m.m[0][0] = cosf(seed); m.m[0][2] = -sinf(seed);
+   m.m[2][0] = sinf(seed); m.m[2][2] = cosf(seed);
+   m.m[3][0] = 0.1f * seed; m.m[3][1] = 0.2f; m.m[3][2] = 3.0f;
+   return m;
+}
+
+void run_vertex()
+{
+   const sr::float4x4 world = make_matrix(0.3f);
+   const sr::float4x4 view = make_matrix(1.1f);
+   sr::float4x4 proj = {};
+   proj.m[0][0] = 1.3f; proj.m[1][1] = 1.7f; proj.m[2][2] = 1.001f; proj.m[2][3] = 1.0f; proj.m[3][2] = -0.1f;
+
+   const int sides[] = { 100, 316, 1000, 3163 };   // 10k, 100k, 1M, 10M vertices
+   for (int side : sides)
+   {
+      const grid_mesh g = make_grid(side);
+      const size_t nidx = g.indices.size();
+      const int runs = side > 1000 ? 2 : 5;
+
+      // What the effect's VS does today: three multiplies per vertex reference
+      std::vector<sr::float4> naive(nidx);
+      const double naive_ms = best_of(runs, [&] {
+         for (size_t i = 0; i < nidx; i++)
+         {
+            const float* p = g.vertices[g.indices[i]].pos;
+            sr::float4 v = sr::transform_point({ p[0], p[1], p[2] }, world);
+            v = sr::transform(v, view);
+            naive[i] = sr::transform(v, proj);
+         }
+      });
+
+      // Concatenated matrix, still once per reference
+      const sr::float4x4 wvp = sr::mul(sr::mul(world, view), proj);
+      std::vector<sr::float4> concat(nidx);
+      const double concat_ms = best_of(runs, [&] {
+         for (size_t i = 0; i < nidx; i++)
+         {
+            const float* p = g.vertices[g.indices[i]].pos;
+            concat[i] = sr::transform_point({ p[0], p[1], p[2] }, wvp);
+         }
+      });
+
+      sr::vertex_stage stage;
+      stage.set_transforms(world, view, proj);
+      sr::clip_vertices out;
+      std::vector<uint32_t> remap;
+      const double soa_ms = best_of(runs, [&] {
+         stage.reset_stats();
+         stage.draw_indexed(g.vertices[0].pos, sizeof(bench_vertex), g.indices.data(), nidx, out, remap);
+      });
+
+      // Raw SoA kernel throughput over the whole (pre-deinterleaved) buffer
+      const size_t nv = g.vertices.size();
+      std::vector<float> sx(nv), sy(nv), sz(nv);
+      for (size_t i = 0; i < nv; i++)
+      {
+         sx[i] = g.vertices[i].pos[0];
+         sy[i] = g.vertices[i].pos[1];
+         sz[i] = g.vertices[i].pos[2];
+      }
+      sr::clip_vertices bulk;
+      bulk.resize(nv);
+      const double bulk_ms = best_of(runs, [&] {
+         sr::transform_positions_soa(wvp, sx.data(), sy.data(), sz.data(), nv, bulk.x.data(), bulk.y.data(), bulk.z.data(), bulk.w.data());
+      });
+
+      float max_err = 0.0f;
+      for (size_t i = 0; i < nidx; i += 97)
+      {
+         const sr::float4 a = naive[i], b = out.get(remap[i]);
+         max_err = fmaxf(max_err, fmaxf(fmaxf(fabsf(a.x - b.x), fabsf(a.y - b.y)), fmaxf(fabsf(a.z - b.z), fabsf(a.w - b.w))));
+      }
+      consume((uint64_t)out.size());
+
+      const sr::vertex_cache_stats& s = stage.stats();
+      const double verts = (double)g.vertices.size();
+      printf("%9.0f verts %9zu refs | per-ref WVP %8.2f ms  concat %8.2f ms  SoA+cache %7.2f ms (%6.1f Mrefs/s)  SoA bulk %7.2f ms (%6.1f Mverts/s) | hit rate %.1f%%  transformed %llu  max err %.2g\n",
+         verts, nidx, naive_ms, concat_ms, soa_ms, (double)nidx / (soa_ms * 1e3),
+         bulk_ms, verts / (bulk_ms * 1e3), 100.0 * s.hit_rate(), (unsigned long long)s.misses, max_err);
+   }
+}
+
+}
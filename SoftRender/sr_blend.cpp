@@ -0,0 +1,571 @@
+#include "sr_blend.h"
+#include "sr_simd.h"
+
+namespace sr
+{
+
+const char* blend_path_name(blend_path path)
+{
+   switch (path)
+   {
+   case blend_path::copy: return "copy";
+   case blend_path::masked_copy: return "masked copy";
+   case blend_path::premultiplied_over: return "premultiplied over";
+   case blend_path::alpha_lerp: return "alpha lerp";
+   case blend_path::additive: return "additive";
+   case blend_path::dest_alpha_lerp: return "dest alpha lerp";
+   case blend_path::generic: return "generic";
+   }
+   return "?";
+}
+
+static bool is_src1(blend_factor f)
+{
+   return f == blend_factor::src1_color || f == blend_factor::inv_src1_color ||
+          f == blend_factor::src1_alpha || f == blend_factor::inv_src1_alpha;
+}
+
+void blend_state::set_blend_factor(const float factor[4])
+{
+   for (int c = 0; c < 4; c++)
+      blend_factor_[c] = factor[c];
+   compile();
+}
+
+void blend_state::build_terms(blend_factor color, blend_factor alpha, factor_terms& out) const
+{
+   for (int c = 0; c < 4; c++)
+   {
+      float* t = out.t[c];
+      for (int j = 0; j < term_count; j++)
+         t[j] = 0.0f;
+      out.saturate[c] = false;
+
+      // On the alpha channel the *_COLOR factors read alpha, which is what
+      // the per-channel color terms hold there anyway
+      switch (c == 3 ? alpha : color)
+      {
+      case blend_factor::zero: break;
+      case blend_factor::one: t[term_k] = 1.0f; break;
+      case blend_factor::src_color: t[term_src_c] = 1.0f; break;
+      case blend_factor::inv_src_color: t[term_k] = 1.0f; t[term_src_c] = -1.0f; break;
+      case blend_factor::src_alpha: t[term_src_a] = 1.0f; break;
+      case blend_factor::inv_src_alpha: t[term_k] = 1.0f; t[term_src_a] = -1.0f; break;
+      case blend_factor::dest_alpha: t[term_dst_a] = 1.0f; break;
+      case blend_factor::inv_dest_alpha: t[term_k] = 1.0f; t[term_dst_a] = -1.0f; break;
+      case blend_factor::dest_color: t[term_dst_c] = 1.0f; break;
+      case blend_factor::inv_dest_color: t[term_k] = 1.0f; t[term_dst_c] = -1.0f; break;
+      case blend_factor::src_alpha_sat:
+         // (f, f, f, 1) with f = min(As, 1 - Ad)
+         if (c == 3)
+            t[term_k] = 1.0f;
+         else
+            out.saturate[c] = true;
+         break;
+      case blend_factor::blend_factor: t[term_k] = blend_factor_[c]; break;
+      case blend_factor::inv_blend_factor: t[term_k] = 1.0f - blend_factor_[c]; break;
+      case blend_factor::src1_color: t[term_src1_c] = 1.0f; break;
+      case blend_factor::inv_src1_color: t[term_k] = 1.0f; t[term_src1_c] = -1.0f; break;
+      case blend_factor::src1_alpha: t[term_src1_a] = 1.0f; break;
+      case blend_factor::inv_src1_alpha: t[term_k] = 1.0f; t[term_src1_a] = -1.0f; break;
+      }
+
+      for (int j = 0; j < term_count; j++)
+         out.lanes[j][c] = out.lanes[j][c + 4] = t[j];
+   }
+}
+
+void blend_state::compile()
+{
+   byte_mask_ = 0;
+   for (int c = 0; c < 4; c++)
+      if (desc_.write_mask & (1 << c))
+         byte_mask_ |= 0xffu << (c * 8);
+
+   build_terms(desc_.src_blend, desc_.src_blend_alpha, src_terms_);
+   build_terms(desc_.dest_blend, desc_.dest_blend_alpha, dst_terms_);
+
+   uses_src1_ = desc_.blend_enable &&
+      (is_src1(desc_.src_blend) || is_src1(desc_.dest_blend) || is_src1(desc_.src_blend_alpha) || is_src1(desc_.dest_blend_alpha));
+
+   if (!desc_.blend_enable)
+   {
+      path_ = (desc_.write_mask & color_write_all) == color_write_all ? blend_path::copy : blend_path::masked_copy;
+      return;
+   }
+
+   path_ = blend_path::generic;
+   if (desc_.op != blend_op::add || desc_.op_alpha != blend_op::add)
+      return;
+
+   // Test1 keeps the source alpha
+   if (desc_.src_blend == blend_factor::dest_alpha && desc_.dest_blend == blend_factor::inv_dest_alpha &&
+       desc_.src_blend_alpha == blend_factor::one && desc_.dest_blend_alpha == blend_factor::zero)
+   {
+      path_ = blend_path::dest_alpha_lerp;
+      return;
+   }
+
+   // The other fast paths need the same factors on color and alpha
+   if (desc_.src_blend != desc_.src_blend_alpha || desc_.dest_blend != desc_.dest_blend_alpha)
+      return;
+
+   if (desc_.src_blend == blend_factor::one && desc_.dest_blend == blend_factor::inv_src_alpha)
+      path_ = blend_path::premultiplied_over;
+   else if (desc_.src_blend == blend_factor::src_alpha && desc_.dest_blend == blend_factor::inv_src_alpha)
+      path_ = blend_path::alpha_lerp;
+   else if (desc_.src_blend == blend_factor::one && desc_.dest_blend == blend_factor::one)
+      path_ = blend_path::additive;
+}
+
+// ---------------------------------------------------------------------------
+// 8-bit fast paths
+
+// Round-to-nearest x / 255, exact for x <= 255 * 255
+static inline uint32_t div255(uint32_t x)
+{
+   x += 128;
+   return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t over_pixel(uint32_t s, uint32_t d)
+{
+   const uint32_t ia = 255 - (s >> 24);
+   uint32_t r = 0;
+   for (int c = 0; c < 32; c += 8)
+   {
+      const uint32_t v = ((s >> c) & 0xff) + div255(((d >> c) & 0xff) * ia);
+      r |= (v > 255 ? 255 : v) << c;
+   }
+   return r;
+}
+
+static inline uint32_t lerp_pixel(uint32_t s, uint32_t d)
+{
+   const uint32_t a = s >> 24, ia = 255 - a;
+   uint32_t r = 0;
+   for (int c = 0; c < 32; c += 8)
+      r |= div255(((s >> c) & 0xff) * a + ((d >> c) & 0xff) * ia) << c;
+   return r;
+}
+
+// Color Cs*Ad + Cd*(1 - Ad), alpha As
+static inline uint32_t dest_lerp_pixel(uint32_t s, uint32_t d)
+{
+   const uint32_t a = d >> 24, ia = 255 - a;
+   uint32_t r = s & 0xff000000u;
+   for (int c = 0; c < 24; c += 8)
+      r |= div255(((s >> c) & 0xff) * a + ((d >> c) & 0xff) * ia) << c;
+   return r;
+}
+
+static inline uint32_t add_pixel(uint32_t s, uint32_t d)
+{
+   uint32_t r = 0;
+   for (int c = 0; c < 32; c += 8)
+   {
+      const uint32_t v = ((s >> c) & 0xff) + ((d >> c) & 0xff);
+      r |= (v > 255 ? 255 : v) << c;
+   }
+   return r;
+}
+
+enum class fast_op { over, lerp, dest_lerp, add };
+
+template<fast_op Op>
+static SR_FORCEINLINE uint32_t fast_pixel(uint32_t s, uint32_t d)
+{
+   return Op == fast_op::over ? over_pixel(s, d) : Op == fast_op::lerp ? lerp_pixel(s, d) :
+          Op == fast_op::dest_lerp ? dest_lerp_pixel(s, d) : add_pixel(s, d);
+}
+
+#if defined(SR_HAS_SSE2)
+
+static SR_FORCEINLINE __m128i div255_epu16(__m128i x)
+{
+   x = _mm_add_epi16(x, _mm_set1_epi16(128));
+   return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+// s, d: two pixels widened to 16 bits per channel. dest_lerp takes the
+// factor from the destination and leaves alpha to the caller
+template<fast_op Op>
+static SR_FORCEINLINE __m128i fast_half(__m128i s, __m128i d)
+{
+   const __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Op == fast_op::dest_lerp ? d : s, 0xff), 0xff);
+   const __m128i ia = _mm_sub_epi16(_mm_set1_epi16(255), a);
+   if (Op == fast_op::over)
+      return _mm_add_epi16(s, div255_epu16(_mm_mullo_epi16(d, ia)));
+   return div255_epu16(_mm_add_epi16(_mm_mullo_epi16(s, a), _mm_mullo_epi16(d, ia)));
+}
+
+#if defined(SR_SIMD_AVX2)
+
+static SR_FORCEINLINE __m256i div255_epu16(__m256i x)
+{
+   x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+   return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+template<fast_op Op>
+static SR_FORCEINLINE __m256i fast_half(__m256i s, __m256i d)
+{
+   const __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Op == fast_op::dest_lerp ? d : s, 0xff), 0xff);
+   const __m256i ia = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+   if (Op == fast_op::over)
+      return _mm256_add_epi16(s, div255_epu16(_mm256_mullo_epi16(d, ia)));
+   return div255_epu16(_mm256_add_epi16(_mm256_mullo_epi16(s, a), _mm256_mullo_epi16(d, ia)));
+}
+
+// Eight pixels per step; returns how many pixels were done
+template<fast_op Op>
+static size_t fast_span_avx2(uint32_t* dst, const uint32_t* src, size_t count, uint32_t byte_mask)
+{
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i alpha = _mm256_set1_epi32((int)0xff000000u);
+   const __m256i mask = _mm256_set1_epi32((int)byte_mask);
+   const bool masked = byte_mask != 0xffffffffu;
+
+   size_t i = 0;
+   for (; i + 8 <= count; i += 8)
+   {
+      const __m256i s = _mm256_loadu_si256((const __m256i*)(src + i));
+      const __m256i d = _mm256_loadu_si256((const __m256i*)(dst + i));
+      __m256i r;
+      if (Op == fast_op::add)
+      {
+         r = _mm256_adds_epu8(s, d);
+      }
+      else if (Op == fast_op::dest_lerp)
+      {
+         if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(d, alpha), alpha)) == -1)
+            r = s;
+         else
+            r = _mm256_or_si256(_mm256_and_si256(s, alpha),
+               _mm256_andnot_si256(alpha, _mm256_packus_epi16(
+                  fast_half<Op>(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero)),
+                  fast_half<Op>(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero)))));
+      }
+      else
+      {
+         const __m256i sa = _mm256_and_si256(s, alpha);
+         if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(Op == fast_op::over ? s : sa, zero)) == -1)
+            continue;
+         if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alpha)) == -1)
+            r = s;
+         else
+            r = _mm256_packus_epi16(fast_half<Op>(_mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero)),
+                                    fast_half<Op>(_mm256_unpackhi_epi8(s, zero), _mm256_unpackhi_epi8(d, zero)));
+      }
+      if (masked)
+         r = _mm256_or_si256(_mm256_and_si256(r, mask), _mm256_andnot_si256(mask, d));
+      _mm256_storeu_si256((__m256i*)(dst + i), r);
+   }
+   return i;
+}
+
+#endif
+
+// Four pixels per step (eight with AVX2). Groups of fully opaque or fully
+// transparent source pixels skip the arithmetic.
+template<fast_op Op>
+static void fast_span(uint32_t* dst, const uint32_t* src, size_t count, uint32_t byte_mask)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i alpha = _mm_set1_epi32((int)0xff000000u);
+   const __m128i mask = _mm_set1_epi32((int)byte_mask);
+   const bool masked = byte_mask != 0xffffffffu;
+
+   size_t i = 0;
+#if defined(SR_SIMD_AVX2)
+   i = fast_span_avx2<Op>(dst, src, count, byte_mask);
+#endif
+   for (; i + 4 <= count; i += 4)
+   {
+      const __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+      const __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+      __m128i r;
+      if (Op == fast_op::add)
+      {
+         r = _mm_adds_epu8(s, d);
+      }
+      else if (Op == fast_op::dest_lerp)
+      {
+         // An opaque destination takes the source as it is
+         if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(d, alpha), alpha)) == 0xffff)
+            r = s;
+         else
+            r = _mm_or_si128(_mm_and_si128(s, alpha),
+               _mm_andnot_si128(alpha, _mm_packus_epi16(fast_half<Op>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero)),
+                                                        fast_half<Op>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero)))));
+      }
+      else
+      {
+         // A premultiplied source with zero alpha can still add light, so
+         // "over" may only skip pixels that are zero in every channel
+         const __m128i sa = _mm_and_si128(s, alpha);
+         if (_mm_movemask_epi8(_mm_cmpeq_epi32(Op == fast_op::over ? s : sa, zero)) == 0xffff)
+            continue;
+         if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alpha)) == 0xffff)
+            r = s;
+         else
+            r = _mm_packus_epi16(fast_half<Op>(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero)),
+                                 fast_half<Op>(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero)));
+      }
+      if (masked)
+         r = _mm_or_si128(_mm_and_si128(r, mask), _mm_andnot_si128(mask, d));
+      _mm_storeu_si128((__m128i*)(dst + i), r);
+   }
+
+   for (; i < count; i++)
+      dst[i] = (fast_pixel<Op>(src[i], dst[i]) & byte_mask) | (dst[i] & ~byte_mask);
+}
+
+#else
+
+template<fast_op Op>
+static void fast_span(uint32_t* dst, const uint32_t* src, size_t count, uint32_t byte_mask)
+{
+   for (size_t i = 0; i < count; i++)
+      dst[i] = (fast_pixel<Op>(src[i], dst[i]) & byte_mask) | (dst[i] & ~byte_mask);
+}
+
+#endif
+
+static void masked_copy_span(uint32_t* dst, const uint32_t* src, size_t count, uint32_t byte_mask)
+{
+   const vec8i mask = v8i_set1((int32_t)byte_mask);
+   const vec8i keep = v8i_set1((int32_t)~byte_mask);
+   size_t i = 0;
+   for (; i + 8 <= count; i += 8)
+      v8i_storeu(dst + i, (v8i_loadu(src + i) & mask) | (v8i_loadu(dst + i) & keep));
+   for (; i < count; i++)
+      dst[i] = (src[i] & byte_mask) | (dst[i] & ~byte_mask);
+}
+
+// ---------------------------------------------------------------------------
+// Generic kernels
+
+// k + sc*Cs + sa*As + dc*Cd + da*Ad (+ the src1 terms), branch free: a few
+// wasted multiplies by zero are cheaper than testing which terms are used
+template<bool Src1>
+static SR_FORCEINLINE vec8f eval_factor(const vec8f* t, vec8f sc, vec8f sa, vec8f dc, vec8f da, vec8f s1c, vec8f s1a)
+{
+   vec8f f = v8_fmadd(t[4], da, v8_fmadd(t[3], dc, v8_fmadd(t[2], sa, v8_fmadd(t[1], sc, t[0]))));
+   if (Src1)
+      f = v8_fmadd(t[6], s1a, v8_fmadd(t[5], s1c, f));
+   return f;
+}
+
+static SR_FORCEINLINE vec8f apply_op(blend_op op, vec8f s, vec8f fs, vec8f d, vec8f fd)
+{
+   switch (op)
+   {
+   case blend_op::add: return v8_fmadd(s, fs, d * fd);
+   case blend_op::subtract: return s * fs - d * fd;
+   case blend_op::rev_subtract: return d * fd - s * fs;
+   case blend_op::min: return v8_min(s, d);
+   case blend_op::max: return v8_max(s, d);
+   }
+   return s;
+}
+
+// Unpacks 8 pixels to one float register per channel, blends each channel
+// with its factors and repacks with UNORM clamping and rounding. `count` is
+// a multiple of 8.
+template<bool Src1>
+void blend_state::blend_rgba8_generic(uint32_t* dst, const uint32_t* src, const uint32_t* src1, size_t count) const
+{
+   vec8f ts[4][term_count], td[4][term_count];
+   for (int c = 0; c < 4; c++)
+   {
+      for (int j = 0; j < term_count; j++)
+      {
+         ts[c][j] = v8_set1(src_terms_.t[c][j]);
+         td[c][j] = v8_set1(dst_terms_.t[c][j]);
+      }
+   }
+   const blend_op ops[4] = { desc_.op, desc_.op, desc_.op, desc_.op_alpha };
+
+   const vec8i byte = v8i_set1(0xff);
+   const vec8f to_unit = v8_set1(1.0f / 255.0f);
+   const vec8f one = v8_set1(1.0f), zero = v8_zero(), to_byte = v8_set1(255.0f);
+   const vec8i mask = v8i_set1((int32_t)byte_mask_);
+   const vec8i keep = v8i_set1((int32_t)~byte_mask_);
+
+   for (size_t i = 0; i < count; i += 8)
+   {
+      const vec8i s = v8i_loadu(src + i), d = v8i_loadu(dst + i);
+      const vec8i s1 = Src1 ? v8i_loadu(src1 + i) : s;
+      const vec8f sa = v8i_to_float(v8i_srli(s, 24)) * to_unit;
+      const vec8f da = v8i_to_float(v8i_srli(d, 24)) * to_unit;
+      const vec8f s1a = Src1 ? v8i_to_float(v8i_srli(s1, 24)) * to_unit : zero;
+
+      vec8i out = v8i_set1(0);
+      for (int c = 0; c < 4; c++)
+      {
+         const vec8f sc = c == 3 ? sa : v8i_to_float(v8i_srli(s, c * 8) & byte) * to_unit;
+         const vec8f dc = c == 3 ? da : v8i_to_float(v8i_srli(d, c * 8) & byte) * to_unit;
+         const vec8f s1c = !Src1 ? zero : c == 3 ? s1a : v8i_to_float(v8i_srli(s1, c * 8) & byte) * to_unit;
+
+         vec8f fs = eval_factor<Src1>(ts[c], sc, sa, dc, da, s1c, s1a);
+         vec8f fd = eval_factor<Src1>(td[c], sc, sa, dc, da, s1c, s1a);
+         if (src_terms_.saturate[c])
+            fs = v8_min(sa, one - da);
+         if (dst_terms_.saturate[c])
+            fd = v8_min(sa, one - da);
+
+         const vec8f r = apply_op(ops[c], sc, fs, dc, fd);
+         out = out | v8i_slli(v8_round_to_int(v8_clamp(r, zero, one) * to_byte), c * 8);
+      }
+      v8i_storeu(dst + i, (out & mask) | (d & keep));
+   }
+}
+
+// Two RGBA pixels per register; the alpha of each pixel is broadcast with a
+// shuffle, so per-channel factors become per-lane multipliers. `count` is
+// even.
+template<bool Src1>
+void blend_state::blend_rgba32f_generic(float* dst, const float* src, const float* src1, size_t count) const
+{
+   vec8f ts[term_count], td[term_count];
+   for (int j = 0; j < term_count; j++)
+   {
+      ts[j] = v8_loadu(src_terms_.lanes[j]);
+      td[j] = v8_loadu(dst_terms_.lanes[j]);
+   }
+
+   const vec8f zero = v8_zero(), one = v8_set1(1.0f);
+   const vec8f rgb = v8_cmpgt(v8_set(1, 1, 1, 0, 1, 1, 1, 0), zero);
+   const int m = desc_.write_mask;
+   const vec8f write = v8_cmpgt(v8_set(
+      (float)(m & 1), (float)(m & 2), (float)(m & 4), (float)(m & 8),
+      (float)(m & 1), (float)(m & 2), (float)(m & 4), (float)(m & 8)), zero);
+   const bool masked = (m & color_write_all) != color_write_all;
+   const bool sat_s = src_terms_.saturate[0] || src_terms_.saturate[1] || src_terms_.saturate[2];
+   const bool sat_d = dst_terms_.saturate[0] || dst_terms_.saturate[1] || dst_terms_.saturate[2];
+   const bool split_op = desc_.op != desc_.op_alpha;
+
+   for (size_t i = 0; i < count * 4; i += 8)
+   {
+      const vec8f s = v8_loadu(src + i), d = v8_loadu(dst + i);
+      const vec8f s1 = Src1 ? v8_loadu(src1 + i) : zero;
+      const vec8f sa = v8_broadcast_w(s), da = v8_broadcast_w(d);
+      const vec8f s1a = Src1 ? v8_broadcast_w(s1) : zero;
+
+      vec8f fs = eval_factor<Src1>(ts, s, sa, d, da, s1, s1a);
+      vec8f fd = eval_factor<Src1>(td, s, sa, d, da, s1, s1a);
+      if (sat_s)
+         fs = v8_select(rgb, v8_min(sa, one - da), fs);
+      if (sat_d)
+         fd = v8_select(rgb, v8_min(sa, one - da), fd);
+
+      vec8f r = apply_op(desc_.op, s, fs, d, fd);
+      if (split_op)
+         r = v8_select(rgb, r, apply_op(desc_.op_alpha, s, fs, d, fd));
+      v8_storeu(dst + i, masked ? v8_select(write, r, d) : r);
+   }
+}
+
+void blend_state::blend_rgba8(uint32_t* dst, const uint32_t* src, size_t count, const uint32_t* src1) const
+{
+   switch (path_)
+   {
+   case blend_path::copy:
+      memcpy(dst, src, count * sizeof(uint32_t));
+      return;
+   case blend_path::masked_copy:
+      masked_copy_span(dst, src, count, byte_mask_);
+      return;
+   case blend_path::premultiplied_over:
+      fast_span<fast_op::over>(dst, src, count, byte_mask_);
+      return;
+   case blend_path::alpha_lerp:
+      fast_span<fast_op::lerp>(dst, src, count, byte_mask_);
+      return;
+   case blend_path::additive:
+      fast_span<fast_op::add>(dst, src, count, byte_mask_);
+      return;
+   case blend_path::dest_alpha_lerp:
+      fast_span<fast_op::dest_lerp>(dst, src, count, byte_mask_);
+      return;
+   case blend_path::generic:
+      break;
+   }
+
+   // A missing second source reads as zero
+   const bool has_src1 = uses_src1_ && src1;
+   const size_t body = count & ~(size_t)7;
+   if (has_src1)
+      blend_rgba8_generic<true>(dst, src, src1, body);
+   else
+      blend_rgba8_generic<false>(dst, src, nullptr, body);
+
+   if (body < count)
+   {
+      const size_t n = count - body;
+      uint32_t ts[8] = {}, td[8] = {}, t1[8] = {};
+      memcpy(ts, src + body, n * sizeof(uint32_t));
+      memcpy(td, dst + body, n * sizeof(uint32_t));
+      if (has_src1)
+      {
+         memcpy(t1, src1 + body, n * sizeof(uint32_t));
+         blend_rgba8_generic<true>(td, ts, t1, 8);
+      }
+      else
+      {
+         blend_rgba8_generic<false>(td, ts, nullptr, 8);
+      }
+      memcpy(dst + body, td, n * sizeof(uint32_t));
+   }
+}
+
+void blend_state::blend_rgba32f(float* dst, const float* src, size_t count, const float* src1) const
+{
+   if (path_ == blend_path::copy)
+   {
+      memcpy(dst, src, count * 4 * sizeof(float));
+      return;
+   }
+
+   if (path_ == blend_path::masked_copy)
+   {
+      const int m = desc_.write_mask;
+      const vec8f write = v8_cmpgt(v8_set(
+         (float)(m & 1), (float)(m & 2), (float)(m & 4), (float)(m & 8),
+         (float)(m & 1), (float)(m & 2), (float)(m & 4), (float)(m & 8)), v8_zero());
+      size_t i = 0;
+      for (; i + 8 <= count * 4; i += 8)
+         v8_storeu(dst + i, v8_select(write, v8_loadu(src + i), v8_loadu(dst + i)));
+      for (; i < count * 4; i++)
+         if (m & (1 << (i & 3)))
+            dst[i] = src[i];
+      return;
+   }
+
+   const bool has_src1 = uses_src1_ && src1;
+   const size_t body = count & ~(size_t)1;
+   if (has_src1)
+      blend_rgba32f_generic<true>(dst, src, src1, body);
+   else
+      blend_rgba32f_generic<false>(dst, src, nullptr, body);
+
+   if (body < count)
+   {
+      float ts[8] = {}, td[8] = {}, t1[8] = {};
+      memcpy(ts, src + body * 4, 4 * sizeof(float));
+      memcpy(td, dst + body * 4, 4 * sizeof(float));
+      if (has_src1)
+      {
+         memcpy(t1, src1 + body * 4, 4 * sizeof(float));
+         blend_rgba32f_generic<true>(td, ts, t1, 2);
+      }
+      else
+      {
+         blend_rgba32f_generic<false>(td, ts, nullptr, 2);
+      }
+      memcpy(dst + body * 4, td, 4 * sizeof(float));
+   }
+}
+
+}
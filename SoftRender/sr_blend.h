@@ -0,0 +1,161 @@
+#pragma once
+
+// Output-merger blending on the CPU.
+//
+// blend_desc mirrors D3D11_BLEND_DESC (same enum values, same rules: alpha
+// factors read the alpha of *_COLOR, MIN/MAX ignore the factors, the write
+// mask applies after blending). A blend_state compiles one render target's
+// description into a span function:
+//
+//   * blending off               -> copy, or a byte-masked copy for partial masks
+//   * ONE / INV_SRC_ALPHA         -> 8-bit premultiplied "over" (D2D interop)
+//   * SRC_ALPHA / INV_SRC_ALPHA   -> 8-bit straight alpha lerp (Test5)
+//   * ONE / ONE                   -> 8-bit saturating add
+//   * DEST_ALPHA / INV_DEST_ALPHA -> 8-bit lerp on the destination alpha,
+//     alpha ONE / ZERO (Test1)       source alpha kept
+//   * anything else               -> generic float kernel, 8 pixels per step
+//
+// The fast paths apply to RGBA8 targets; float targets always take the
+// generic kernel, two pixels per 8-wide register.
+//
+// The 8-bit paths use exact round-to-nearest division by 255 and may differ
+// from the float kernel by one unit in the last place.
+
+#include "sr_common.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sr
+{
+
+// Values match D3D11_BLEND
+enum class blend_factor : uint8_t
+{
+   zero = 1,
+   one = 2,
+   src_color = 3,
+   inv_src_color = 4,
+   src_alpha = 5,
+   inv_src_alpha = 6,
+   dest_alpha = 7,
+   inv_dest_alpha = 8,
+   dest_color = 9,
+   inv_dest_color = 10,
+   src_alpha_sat = 11,
+   blend_factor = 14,
+   inv_blend_factor = 15,
+   src1_color = 16,
+   inv_src1_color = 17,
+   src1_alpha = 18,
+   inv_src1_alpha = 19,
+};
+
+// Values match D3D11_BLEND_OP
+enum class blend_op : uint8_t
+{
+   add = 1,
+   subtract = 2,
+   rev_subtract = 3,
+   min = 4,
+   max = 5,
+};
+
+// Values match D3D11_COLOR_WRITE_ENABLE
+enum color_write : uint8_t
+{
+   color_write_red = 1,
+   color_write_green = 2,
+   color_write_blue = 4,
+   color_write_alpha = 8,
+   color_write_all = 15,
+};
+
+struct render_target_blend_desc
+{
+   bool blend_enable = false;
+   blend_factor src_blend = blend_factor::one;
+   blend_factor dest_blend = blend_factor::zero;
+   blend_op op = blend_op::add;
+   blend_factor src_blend_alpha = blend_factor::one;
+   blend_factor dest_blend_alpha = blend_factor::zero;
+   blend_op op_alpha = blend_op::add;
+   uint8_t write_mask = color_write_all;
+};
+
+struct blend_desc
+{
+   bool alpha_to_coverage_enable = false;
+   bool independent_blend_enable = false;
+   render_target_blend_desc render_target[8];
+
+   // Same rule as the runtime: without independent blend every target uses [0]
+   const render_target_blend_desc& target(int index) const
+   {
+      return render_target[independent_blend_enable ? index : 0];
+   }
+};
+
+enum class blend_path
+{
+   copy,
+   masked_copy,
+   premultiplied_over,
+   alpha_lerp,
+   additive,
+   dest_alpha_lerp,
+   generic,
+};
+
+const char* blend_path_name(blend_path path);
+
+class blend_state
+{
+public:
+   blend_state() { compile(); }
+   explicit blend_state(const render_target_blend_desc& desc) : desc_(desc) { compile(); }
+
+   const render_target_blend_desc& desc() const { return desc_; }
+   blend_path path() const { return path_; }
+
+   // The BlendFactor argument of OMSetBlendState
+   void set_blend_factor(const float factor[4]);
+
+   // dst = blend(src, dst) over `count` pixels. RGBA8 pixels are R8G8B8A8_UNORM
+   // (red in the low byte); floats are R32G32B32A32_FLOAT. `src1` is the second
+   // pixel shader output for the SRC1 factors and may be null otherwise.
+   void blend_rgba8(uint32_t* dst, const uint32_t* src, size_t count, const uint32_t* src1 = nullptr) const;
+   void blend_rgba32f(float* dst, const float* src, size_t count, const float* src1 = nullptr) const;
+
+   // Whether the description reads the second source
+   bool uses_src1() const { return uses_src1_; }
+
+private:
+   // A factor as k + sc*Cs + sa*As + dc*Cd + da*Ad + s1c*C1 + s1a*A1 per
+   // channel, which covers every D3D11_BLEND except SRC_ALPHA_SAT
+   enum { term_k, term_src_c, term_src_a, term_dst_c, term_dst_a, term_src1_c, term_src1_a, term_count };
+
+   struct factor_terms
+   {
+      float t[4][term_count];       // [channel][term]
+      float lanes[term_count][8];   // same, laid out as two RGBA pixels
+      bool saturate[4];             // min(As, 1 - Ad)
+   };
+
+   void compile();
+   void build_terms(blend_factor color, blend_factor alpha, factor_terms& out) const;
+
+   template<bool Src1> void blend_rgba8_generic(uint32_t* dst, const uint32_t* src, const uint32_t* src1, size_t count) const;
+   template<bool Src1> void blend_rgba32f_generic(float* dst, const float* src, const float* src1, size_t count) const;
+
+   render_target_blend_desc desc_;
+   float blend_factor_[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+   blend_path path_ = blend_path::copy;
+   bool uses_src1_ = false;
+   uint32_t byte_mask_ = 0xffffffffu;   // write mask expanded to RGBA8 bytes
+
+   factor_terms src_terms_;
+   factor_terms dst_terms_;
+};
+
+}
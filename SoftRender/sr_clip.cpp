@@ -0,0 +1,252 @@
+#include "sr_clip.h"
+
+namespace sr
+{
+
+// Clip planes as (a, b, c, d): inside where a*x + b*y + c*z + d*w >= 0.
+// Near and far come first; the guard band planes are filled per viewport.
+enum
+{
+   plane_near,
+   plane_far,
+   plane_left,
+   plane_right,
+   plane_bottom,
+   plane_top,
+   plane_count,
+};
+
+static inline float plane_distance(const float4& p, const float plane[4])
+{
+   return plane[0] * p.x + plane[1] * p.y + plane[2] * p.z + plane[3] * p.w;
+}
+
+static int clip_against_planes(const float4 tri[3], float4 poly[9], const float (*planes)[4], int count)
+{
+   float4 buf[2][9];
+   const float4* src = tri;
+   int n = 3;
+
+   for (int p = 0; p < count; p++)
+   {
+      float4* dst = (p == count - 1) ? poly : buf[p & 1];
+      float d[9];
+      int outside = 0;
+      for (int i = 0; i < n; i++)
+      {
+         d[i] = plane_distance(src[i], planes[p]);
+         outside += d[i] < 0.0f;
+      }
+
+      if (outside == n)
+         return 0;
+
+      if (outside == 0)
+      {
+         if (dst != src)
+            for (int i = 0; i < n; i++)
+               dst[i] = src[i];
+         src = dst;
+         continue;
+      }
+
+      int m = 0;
+      for (int i = 0; i < n; i++)
+      {
+         const int j = (i + 1) == n ? 0 : i + 1;
+         const bool in_i = d[i] >= 0.0f;
+         const bool in_j = d[j] >= 0.0f;
+
+         if (in_i)
+            dst[m++] = src[i];
+
+         if (in_i != in_j)
+         {
+            // Always interpolate from the inside vertex so the two triangles
+            // sharing this edge produce bit-identical intersection points
+            const float4& a = in_i ? src[i] : src[j];
+            const float4& b = in_i ? src[j] : src[i];
+            const float da = in_i ? d[i] : d[j];
+            const float db = in_i ? d[j] : d[i];
+            const float t = da / (da - db);
+            dst[m++] = {
+               a.x + (b.x - a.x) * t,
+               a.y + (b.y - a.y) * t,
+               a.z + (b.z - a.z) * t,
+               a.w + (b.w - a.w) * t,
+            };
+         }
+      }
+
+      n = m;
+      src = dst;
+   }
+
+   if (src != poly)
+      for (int i = 0; i < n; i++)
+         poly[i] = src[i];
+   return n;
+}
+
+void clipper::set_viewport(int width, int height, float guard_band_pixels)
+{
+   width_ = (float)width;
+   height_ = (float)height;
+
+   // NDC spans width/2 pixels per unit
+   guard_x_ = guard_band_pixels / (0.5f * width_);
+   guard_y_ = guard_band_pixels / (0.5f * height_);
+   if (guard_x_ < 1.0f)
+      guard_x_ = 1.0f;
+   if (guard_y_ < 1.0f)
+      guard_y_ = 1.0f;
+}
+
+int clipper::clip_polygon(const float4 tri[3], float4 poly[9]) const
+{
+   const float planes[plane_count][4] =
+   {
+      { 0.0f, 0.0f, 1.0f, 0.0f },
+      { 0.0f, 0.0f, -1.0f, 1.0f },
+      { 1.0f, 0.0f, 0.0f, guard_x_ },
+      { -1.0f, 0.0f, 0.0f, guard_x_ },
+      { 0.0f, 1.0f, 0.0f, guard_y_ },
+      { 0.0f, -1.0f, 0.0f, guard_y_ },
+   };
+   return clip_against_planes(tri, poly, planes, plane_count);
+}
+
+void clipper::clip_one(const clip_vertices& in, const uint32_t* tri, bool need_guard_band, clip_output& out)
+{
+   const float planes[plane_count][4] =
+   {
+      { 0.0f, 0.0f, 1.0f, 0.0f },
+      { 0.0f, 0.0f, -1.0f, 1.0f },
+      { 1.0f, 0.0f, 0.0f, guard_x_ },
+      { -1.0f, 0.0f, 0.0f, guard_x_ },
+      { 0.0f, 1.0f, 0.0f, guard_y_ },
+      { 0.0f, -1.0f, 0.0f, guard_y_ },
+   };
+
+   const float4 v[3] = { in.get(tri[0]), in.get(tri[1]), in.get(tri[2]) };
+   float4 poly[9];
+
+   stats_.clipped++;
+   if (need_guard_band)
+      stats_.clipped_guard_band++;
+
+   const int n = clip_against_planes(v, poly, planes, need_guard_band ? plane_count : plane_left);
+   if (n < 3)
+      return;
+
+   const uint32_t base = out.input_count + (uint32_t)out.extra.size();
+   out.extra.insert(out.extra.end(), poly, poly + n);
+   for (int i = 1; i + 1 < n; i++)
+   {
+      out.indices.push_back(base);
+      out.indices.push_back(base + i);
+      out.indices.push_back(base + i + 1);
+   }
+   stats_.output_triangles += n - 2;
+}
+
+void clipper::clip_triangles(const clip_vertices& in, const uint32_t* indices, size_t triangle_count, clip_output& out)
+{
+   out.reset((uint32_t)in.size());
+   out.indices.reserve(triangle_count * 3);
+   stats_.triangles += triangle_count;
+
+   const vec8f gx = v8_set1(guard_x_);
+   const vec8f gy = v8_set1(guard_y_);
+   const vec8f zero = v8_zero();
+   const float* const vx = in.x.data();
+   const float* const vy = in.y.data();
+   const float* const vz = in.z.data();
+   const float* const vw = in.w.data();
+
+   const vec8i stride3 = v8i_set(0, 3, 6, 9, 12, 15, 18, 21);
+
+   for (size_t base = 0; base < triangle_count; base += 8)
+   {
+      const int lanes = triangle_count - base < 8 ? (int)(triangle_count - base) : 8;
+
+      // Gather the 3 vertices of 8 triangles into SoA registers. The short
+      // last batch repeats its first triangle in the unused lanes.
+      const int32_t* tri_idx = (const int32_t*)(indices + base * 3);
+      int32_t tail[24];
+      if (lanes < 8)
+      {
+         for (int k = 0; k < 24; k++)
+            tail[k] = tri_idx[k < lanes * 3 ? k : k % 3];
+         tri_idx = tail;
+      }
+
+      // Per-plane outside masks: "all" for trivial reject, "any" for clipping
+      vec8f all_out[6], any_near_far = zero, any_guard = zero, non_finite = zero;
+      for (int j = 0; j < 3; j++)
+      {
+         const vec8i vi = v8i_gather(tri_idx + j, stride3);
+         const vec8f x = v8_gather(vx, vi), y = v8_gather(vy, vi), z = v8_gather(vz, vi), w = v8_gather(vw, vi);
+         const vec8f neg_w = zero - w;
+         const vec8f out_plane[6] =
+         {
+            v8_cmplt(z, zero),
+            v8_cmpgt(z, w),
+            v8_cmplt(x, neg_w),
+            v8_cmpgt(x, w),
+            v8_cmplt(y, neg_w),
+            v8_cmpgt(y, w),
+         };
+
+         const vec8f gw_x = gx * w, gw_y = gy * w;
+         const vec8f out_guard = v8_cmplt(x, zero - gw_x) | v8_cmpgt(x, gw_x) |
+                                 v8_cmplt(y, zero - gw_y) | v8_cmpgt(y, gw_y);
+
+         for (int p = 0; p < 6; p++)
+            all_out[p] = j == 0 ? out_plane[p] : (all_out[p] & out_plane[p]);
+         any_near_far = any_near_far | out_plane[0] | out_plane[1];
+         any_guard = any_guard | out_guard;
+
+         // inf/NaN anywhere turns the sum into NaN, which fails the compare
+         const vec8f sum = (x - x) + (y - y) + (z - z) + (w - w);
+         non_finite = non_finite | v8_andnot(v8_cmpeq(sum, zero), v8_true());
+      }
+
+      // Non-finite vertices cannot be clipped or rasterized meaningfully; drop them
+      const int reject = v8_movemask(all_out[0] | all_out[1] | all_out[2] | all_out[3] | all_out[4] | all_out[5] | non_finite);
+      const int near_far = v8_movemask(any_near_far);
+      const int guard = v8_movemask(any_guard);
+      const int lane_mask = (1 << lanes) - 1;
+
+      // Whole batch inside: straight copy of the index triples
+      if (((reject | near_far | guard) & lane_mask) == 0)
+      {
+         out.indices.insert(out.indices.end(), indices + base * 3, indices + (base + lanes) * 3);
+         stats_.trivially_accepted += lanes;
+         stats_.output_triangles += lanes;
+         continue;
+      }
+
+      for (int k = 0; k < lanes; k++)
+      {
+         const int bit = 1 << k;
+         const uint32_t* tri = indices + (base + k) * 3;
+         if (reject & bit)
+         {
+            stats_.trivially_rejected++;
+         }
+         else if (!((near_far | guard) & bit))
+         {
+            out.indices.insert(out.indices.end(), tri, tri + 3);
+            stats_.trivially_accepted++;
+            stats_.output_triangles++;
+         }
+         else
+         {
+            clip_one(in, tri, (guard & bit) != 0, out);
+         }
+      }
+   }
+}
+
+}
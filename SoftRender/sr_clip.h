@@ -0,0 +1,102 @@
+#pragma once
+
+// Homogeneous triangle clipper with a guard band.
+//
+// Only the near (z >= 0) and far (z <= w) planes are clipped exactly; the
+// x/y planes are pushed out to a guard band several times the size of the
+// viewport. Triangles that poke out of the viewport but stay inside the guard
+// band are handed straight to the rasterizer, whose bounding-box clamp
+// discards the invisible part for free. Before any clipping, triangles are
+// classified 8 at a time against all planes so the common cases (fully
+// inside, fully outside one plane) never reach the scalar clipping code.
+
+#include "sr_raster.h"
+#include "sr_vertex.h"
+
+#include <vector>
+
+namespace sr
+{
+
+struct clip_stats
+{
+   uint64_t triangles = 0;
+   uint64_t trivially_rejected = 0;   // all vertices outside one plane
+   uint64_t trivially_accepted = 0;   // inside near/far and the guard band
+   uint64_t clipped = 0;              // went through polygon clipping
+   uint64_t clipped_guard_band = 0;   // of those, needed x/y clipping too
+   uint64_t output_triangles = 0;
+};
+
+// Triangles produced by the clipper. Index values below `input_count` refer to
+// the input vertices, the others to `extra[index - input_count]`.
+struct clip_output
+{
+   uint32_t input_count = 0;
+   std::vector<float4> extra;
+   std::vector<uint32_t> indices;
+
+   void reset(uint32_t count)
+   {
+      input_count = count;
+      extra.clear();
+      indices.clear();
+   }
+
+   float4 vertex(const clip_vertices& in, uint32_t index) const
+   {
+      return index < input_count ? in.get(index) : extra[index - input_count];
+   }
+};
+
+class clipper
+{
+public:
+   // Guard band half-extent in pixels around the viewport center
+   static constexpr float default_guard_band = 16384.0f;
+
+   clipper(int viewport_width = 1, int viewport_height = 1, float guard_band_pixels = default_guard_band)
+   {
+      set_viewport(viewport_width, viewport_height, guard_band_pixels);
+   }
+
+   void set_viewport(int width, int height, float guard_band_pixels = default_guard_band);
+
+   // Clips triangle list `indices` (3 per triangle) over `in`
+   void clip_triangles(const clip_vertices& in, const uint32_t* indices, size_t triangle_count, clip_output& out);
+
+   // Clips one triangle exactly against near/far and the guard band.
+   // Returns the number of polygon vertices written to `poly` (0 or 3..9).
+   int clip_polygon(const float4 tri[3], float4 poly[9]) const;
+
+   // Perspective divide and D3D viewport transform
+   screen_vertex to_screen(const float4& v) const
+   {
+      const float inv_w = 1.0f / v.w;
+      return {
+         (v.x * inv_w * 0.5f + 0.5f) * width_,
+         (0.5f - v.y * inv_w * 0.5f) * height_,
+         v.z * inv_w,
+      };
+   }
+
+   float guard_band_x() const { return guard_x_; }
+   float guard_band_y() const { return guard_y_; }
+
+   const clip_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = clip_stats(); }
+
+private:
+   void clip_one(const clip_vertices& in, const uint32_t* tri, bool need_guard_band, clip_output& out);
+
+   float width_ = 1.0f;
+   float height_ = 1.0f;
+
+   // Guard band in NDC units: |x| <= guard_x_ * w
+   float guard_x_ = 1.0f;
+   float guard_y_ = 1.0f;
+
+   clip_stats stats_;
+};
+
+}
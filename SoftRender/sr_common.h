@@ -0,0 +1,86 @@
+#pragma once
+
+// Shared helpers for the portable software rendering path.
+// Nothing in SoftRender depends on windows.h so it builds on Linux as well.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <malloc.h>
+#define SR_FORCEINLINE __forceinline
+#else
+#define SR_FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+namespace sr
+{
+
+// Allocate a block aligned for the widest vector unit we use (AVX = 32 bytes, cache line = 64)
+inline void* aligned_malloc(size_t size, size_t alignment)
+{
+#if defined(_MSC_VER)
+   return _aligned_malloc(size, alignment);
+#else
+   void* p = nullptr;
+   if (posix_memalign(&p, alignment, size ? size : alignment) != 0)
+      return nullptr;
+   return p;
+#endif
+}
+
+inline void aligned_free(void* p)
+{
+#if defined(_MSC_VER)
+   _aligned_free(p);
+#else
+   free(p);
+#endif
+}
+
+// std::vector allocator so SIMD loops can use aligned loads on vector storage
+template<class T, size_t Alignment = 64>
+struct aligned_allocator
+{
+   typedef T value_type;
+
+   template<class U> struct rebind { typedef aligned_allocator<U, Alignment> other; };
+
+   aligned_allocator() = default;
+   template<class U> aligned_allocator(const aligned_allocator<U, Alignment>&) {}
+
+   T* allocate(size_t n)
+   {
+      void* p = aligned_malloc(n * sizeof(T), Alignment);
+      if (!p)
+         throw std::bad_alloc();
+      return static_cast<T*>(p);
+   }
+
+   void deallocate(T* p, size_t) { aligned_free(p); }
+
+   template<class U> bool operator==(const aligned_allocator<U, Alignment>&) const { return true; }
+   template<class U> bool operator!=(const aligned_allocator<U, Alignment>&) const { return false; }
+};
+
+template<class T>
+using aligned_vector = std::vector<T, aligned_allocator<T>>;
+
+inline int popcount32(uint32_t v)
+{
+   v = v - ((v >> 1) & 0x55555555u);
+   v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+   return (int)((((v + (v >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24);
+}
+
+template<class T>
+inline T clamp(T v, T lo, T hi)
+{
+   return v < lo ? lo : (v > hi ? hi : v);
+}
+
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+// Compile-time versions of the sr_math.h functions that need a square root,
+// sines and cosines or SIMD, so fixed cameras and projections can be
+// constants baked into the binary:
+//
+//    constexpr float4x4 view = cx::look_at_lh({ 0, 2, -6 }, { 0, 0, 0 }, { 0, 1, 0 });
+//
+// sqrt, sin and cos work in double precision and round once to float.
+// sqrt is correctly rounded, so equal to sqrtf; sin and cos are correctly
+// rounded except within about 1e-16 of a halfway point, and so within one
+// ULP of any good libm and equal to it almost everywhere. The builders do
+// the arithmetic of the runtime ones in the same order, and mul rounds like
+// the vec4f one, fused multiply-adds included where the build has them, so
+// they give the same bits wherever the compiler leaves a * b + c alone
+// (MSVC's /fp:precise; gcc and clang contract it unless -ffp-contract=off).
+//
+// Everything here also runs at run time, slowly; use the sr_math.h
+// functions there.
+
+#include "sr_math.h"
+
+#include <limits>
+
+namespace sr
+{
+namespace cx
+{
+
+constexpr float nan_value() { return std::numeric_limits<float>::quiet_NaN(); }
+
+constexpr float sqrt(float x)
+{
+   if (x == 0.0f || x > FLT_MAX)
+      return x;
+   if (!(x > 0.0f))
+      return nan_value();
+
+   // Newton's iteration on x scaled into [1/4, 4] by a power of four
+   double v = x, s = 1.0;
+   while (v > 4.0)
+   {
+      v *= 0.25;
+      s *= 2.0;
+   }
+   while (v < 0.25)
+   {
+      v *= 4.0;
+      s *= 0.5;
+   }
+   double r = 1.0;
+   for (int i = 0; i < 8; i++)
+      r = 0.5 * (r + v / r);
+   return (float)(r * s);
+}
+
+// x - k pi/2 in [-pi/4, pi/4], with pi/2 split in two so that k pi/2 is
+// exact for |k| < 2^20: accurate for |x| up to about 10^6
+constexpr double reduce(float x, int& quadrant)
+{
+   const double pio2_hi = 1.57079632673412561417e+00;   // first 33 bits
+   const double pio2_lo = 6.07710050650619224932e-11;
+   const double d = (double)x * 6.36619772367581382433e-01;
+   const double k = (double)(long long)(d + (d < 0.0 ? -0.5 : 0.5));
+   quadrant = (int)((long long)k & 3);
+   return ((double)x - k * pio2_hi) - k * pio2_lo;
+}
+
+// Taylor series, to below 1e-20 on [-pi/4, pi/4]
+constexpr double sin_reduced(double r)
+{
+   const double r2 = r * r;
+   double term = r, sum = r;
+   for (int n = 1; n <= 10; n++)
+   {
+      term *= -r2 / ((2 * n) * (2 * n + 1));
+      sum += term;
+   }
+   return sum;
+}
+
+constexpr double cos_reduced(double r)
+{
+   const double r2 = r * r;
+   double term = 1.0, sum = 1.0;
+   for (int n = 1; n <= 10; n++)
+   {
+      term *= -r2 / ((2 * n - 1) * (2 * n));
+      sum += term;
+   }
+   return sum;
+}
+
+constexpr float sin(float x)
+{
+   if (x == 0.0f)
+      return x;
+   if (!(x - x == 0.0f))
+      return nan_value();
+   int q = 0;
+   const double r = reduce(x, q);
+   const double s = q & 1 ? cos_reduced(r) : sin_reduced(r);
+   return (float)(q & 2 ? -s : s);
+}
+
+constexpr float cos(float x)
+{
+   if (!(x - x == 0.0f))
+      return nan_value();
+   int q = 0;
+   const double r = reduce(x, q);
+   const double c = q & 1 ? -sin_reduced(r) : cos_reduced(r);
+   return (float)(q & 2 ? -c : c);
+}
+
+// The vec4f mul's a * b + c: one rounding with FMA or NEON, two without.
+// The product is exact in double, so the sum rounds twice, which only
+// matters on a halfway case
+constexpr float madd(float a, float b, float c)
+{
+#if defined(SR_SIMD_FMA) || defined(SR_HAS_NEON)
+   return (float)((double)a * b + c);
+#else
+   return a * b + c;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// The sr_math.h functions
+
+constexpr float3 normalize(const float3& a)
+{
+   const float f = length_sq(a);
+   const float d = f - 1.0f;
+   if (-FLT_EPSILON <= d && d <= FLT_EPSILON)
+      return a;
+   if (f > FLT_MIN)
+   {
+      const float l = cx::sqrt(f);
+      return { a.x / l, a.y / l, a.z / l };
+   }
+   return { 0.0f, 0.0f, 0.0f };
+}
+
+constexpr float4x4 mul(const float4x4& a, const float4x4& b)
+{
+   float4x4 r = {};
+   for (int i = 0; i < 4; i++)
+   {
+      for (int j = 0; j < 4; j++)
+      {
+         float t = a.m[i][0] * b.m[0][j];
+         t = madd(a.m[i][1], b.m[1][j], t);
+         t = madd(a.m[i][2], b.m[2][j], t);
+         r.m[i][j] = madd(a.m[i][3], b.m[3][j], t);
+      }
+   }
+   return r;
+}
+
+constexpr float4x4 transpose(const float4x4& m)
+{
+   float4x4 r = {};
+   for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+         r.m[i][j] = m.m[j][i];
+   return r;
+}
+
+constexpr float4x4 rotation_y(float angle)
+{
+   const float s = cx::sin(angle), c = cx::cos(angle);
+   float4x4 r = identity4x4();
+   r.m[0][0] = c;
+   r.m[0][2] = -s;
+   r.m[2][0] = s;
+   r.m[2][2] = c;
+   return r;
+}
+
+constexpr float4x4 look_at_lh(const float3& eye, const float3& at, const float3& up)
+{
+   const float3 z = cx::normalize(sub(at, eye));
+   const float3 x = cx::normalize(cross(up, z));
+   const float3 y = cross(z, x);
+   return { { { x.x, y.x, z.x, 0.0f }, { x.y, y.y, z.y, 0.0f }, { x.z, y.z, z.z, 0.0f }, { -dot(x, eye), -dot(y, eye), -dot(z, eye), 1.0f } } };
+}
+
+constexpr float4x4 perspective_fov_lh(float fovy, float aspect, float zn, float zf)
+{
+   const float h = cx::cos(0.5f * fovy) / cx::sin(0.5f * fovy);
+   float4x4 r = {};
+   r.m[0][0] = h / aspect;
+   r.m[1][1] = h;
+   r.m[2][2] = zf / (zf - zn);
+   r.m[2][3] = 1.0f;
+   r.m[3][2] = -r.m[2][2] * zn;
+   return r;
+}
+
+constexpr quaternion rotation_quaternion(const float3& axis, float angle)
+{
+   const float3 a = cx::normalize(axis);
+   const float s = cx::sin(0.5f * angle), c = cx::cos(0.5f * angle);
+   return { a.x * s, a.y * s, a.z * s, c };
+}
+
+constexpr float3x2 rotation3x2(float degrees, const float2& center = { 0.0f, 0.0f })
+{
+   const float r = degrees * (3.14159265358979f / 180.0f);
+   const float c = cx::cos(r), s = cx::sin(r);
+   return { c, s, -s, c, center.x - c * center.x + s * center.y, center.y - s * center.x - c * center.y };
+}
+
+}
+}
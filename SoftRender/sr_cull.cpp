@@ -0,0 +1,262 @@
+#include "sr_cull.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace sr
+{
+
+frustum frustum_from_matrix(const float4x4& view_proj)
+{
+   // Column c of the matrix gives clip coordinate c of a point
+   const float(*m)[4] = view_proj.m;
+   const float4 col[4] = {
+      { m[0][0], m[1][0], m[2][0], m[3][0] },
+      { m[0][1], m[1][1], m[2][1], m[3][1] },
+      { m[0][2], m[1][2], m[2][2], m[3][2] },
+      { m[0][3], m[1][3], m[2][3], m[3][3] },
+   };
+   auto combine = [&](int c, float s) -> float4 {
+      return { col[3].x + s * col[c].x, col[3].y + s * col[c].y, col[3].z + s * col[c].z, col[3].w + s * col[c].w };
+   };
+
+   // -w <= x <= w, -w <= y <= w, 0 <= z <= w
+   frustum f;
+   f.planes[0] = combine(0, 1.0f);
+   f.planes[1] = combine(0, -1.0f);
+   f.planes[2] = combine(1, 1.0f);
+   f.planes[3] = combine(1, -1.0f);
+   f.planes[4] = col[2];
+   f.planes[5] = combine(2, -1.0f);
+   for (float4& p : f.planes)
+   {
+      const float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+      const float inv = length > 0.0f ? 1.0f / length : 0.0f;
+      p = { p.x * inv, p.y * inv, p.z * inv, p.w * inv };
+   }
+   return f;
+}
+
+// ---------------------------------------------------------------------------
+// Frustum
+
+// Appends base + k for every set bit k of `mask` below `lanes`
+static SR_FORCEINLINE size_t append_visible(int mask, uint32_t base, int lanes, uint32_t* visible, size_t n)
+{
+   if (mask == 0xff)
+   {
+      v8i_storeu(visible + n, v8i_set1((int32_t)base) + v8i_set(0, 1, 2, 3, 4, 5, 6, 7));
+      return n + 8;
+   }
+   for (int k = 0; k < lanes; k++)
+   {
+      visible[n] = base + (uint32_t)k;
+      n += (mask >> k) & 1;
+   }
+   return n;
+}
+
+// Runs `test` over groups of 8 loaded from `arrays`, the last group through
+// zero-padded copies, and compacts the lanes it passes
+template <int Arrays, typename Test>
+static size_t cull_groups(const float* const (&arrays)[Arrays], size_t count, uint32_t* visible, Test test)
+{
+   size_t n = 0, i = 0;
+   vec8f v[Arrays];
+   for (; i + 8 <= count; i += 8)
+   {
+      for (int a = 0; a < Arrays; a++)
+         v[a] = v8_load(arrays[a] + i);
+      n = append_visible(test(v), (uint32_t)i, 8, visible, n);
+   }
+   if (i < count)
+   {
+      const int lanes = (int)(count - i);
+      for (int a = 0; a < Arrays; a++)
+      {
+         alignas(32) float t[8] = {};
+         memcpy(t, arrays[a] + i, lanes * sizeof(float));
+         v[a] = v8_load(t);
+      }
+      n = append_visible(test(v) & ((1 << lanes) - 1), (uint32_t)i, lanes, visible, n);
+   }
+   return n;
+}
+
+size_t cull_frustum(const frustum& f, const cull_aabbs& boxes, uint32_t* visible)
+{
+   // Per plane, the corner furthest along the normal: max on the axes where
+   // the normal is positive
+   vec8f n[6][4];
+   int far_x[6], far_y[6], far_z[6];
+   for (int p = 0; p < 6; p++)
+   {
+      const float4& q = f.planes[p];
+      n[p][0] = v8_set1(q.x);
+      n[p][1] = v8_set1(q.y);
+      n[p][2] = v8_set1(q.z);
+      n[p][3] = v8_set1(q.w);
+      far_x[p] = q.x >= 0.0f ? 3 : 0;
+      far_y[p] = q.y >= 0.0f ? 4 : 1;
+      far_z[p] = q.z >= 0.0f ? 5 : 2;
+   }
+   const float* const arrays[6] = { boxes.min_x.data(), boxes.min_y.data(), boxes.min_z.data(),
+                                    boxes.max_x.data(), boxes.max_y.data(), boxes.max_z.data() };
+   return cull_groups(arrays, boxes.size(), visible, [&](const vec8f* b) {
+      vec8f outside = v8_zero();
+      for (int p = 0; p < 6; p++)
+      {
+         const vec8f d = v8_fmadd(n[p][0], b[far_x[p]], v8_fmadd(n[p][1], b[far_y[p]], v8_fmadd(n[p][2], b[far_z[p]], n[p][3])));
+         outside = outside | v8_cmplt(d, v8_zero());
+      }
+      return v8_movemask(outside) ^ 0xff;
+   });
+}
+
+size_t cull_frustum(const frustum& f, const cull_spheres& spheres, uint32_t* visible)
+{
+   vec8f n[6][4];
+   for (int p = 0; p < 6; p++)
+   {
+      n[p][0] = v8_set1(f.planes[p].x);
+      n[p][1] = v8_set1(f.planes[p].y);
+      n[p][2] = v8_set1(f.planes[p].z);
+      n[p][3] = v8_set1(f.planes[p].w);
+   }
+   const float* const arrays[4] = { spheres.x.data(), spheres.y.data(), spheres.z.data(), spheres.radius.data() };
+   return cull_groups(arrays, spheres.size(), visible, [&](const vec8f* s) {
+      const vec8f neg_r = v8_zero() - s[3];
+      vec8f outside = v8_zero();
+      for (int p = 0; p < 6; p++)
+      {
+         const vec8f d = v8_fmadd(n[p][0], s[0], v8_fmadd(n[p][1], s[1], v8_fmadd(n[p][2], s[2], n[p][3])));
+         outside = outside | v8_cmplt(d, neg_r);
+      }
+      return v8_movemask(outside) ^ 0xff;
+   });
+}
+
+// ---------------------------------------------------------------------------
+// Occlusion
+
+// Corner k of a box has the max on x for bit 0, y for bit 1, z for bit 2.
+// Faces are clockwise seen from outside, front facing to the rasterizer
+static const int s_box_triangles[36] = {
+   0, 4, 6, 0, 6, 2,   1, 3, 7, 1, 7, 5,   0, 1, 5, 0, 5, 4,
+   2, 6, 7, 2, 7, 3,   0, 2, 3, 0, 3, 1,   4, 5, 7, 4, 7, 6,
+};
+
+void occlusion_buffer::begin(const float4x4& view_proj)
+{
+   view_proj_ = view_proj;
+   depth_.clear(1.0f);
+}
+
+void occlusion_buffer::add_occluder(const float3& lo, const float3& hi)
+{
+   stats_.occluders++;
+   const float w = (float)depth_.width(), h = (float)depth_.height();
+   screen_vertex v[8];
+   for (int k = 0; k < 8; k++)
+   {
+      const float3 corner = { k & 1 ? hi.x : lo.x, k & 2 ? hi.y : lo.y, k & 4 ? hi.z : lo.z };
+      const float4 c = transform_point(corner, view_proj_);
+      if (!(c.z >= 0.0f && c.w > 0.0f))
+      {
+         stats_.occluders_skipped++;
+         return;
+      }
+      const float inv_w = 1.0f / c.w;
+      v[k] = { (c.x * inv_w * 0.5f + 0.5f) * w, (0.5f - c.y * inv_w * 0.5f) * h, c.z * inv_w };
+   }
+   for (int t = 0; t < 36; t += 3)
+   {
+      raster_triangle tri;
+      if (setup_triangle(v[s_box_triangles[t]], v[s_box_triangles[t + 1]], v[s_box_triangles[t + 2]], depth_.width(),
+             depth_.height(), cull_mode::back, tri))
+         depth_.draw(tri);
+   }
+}
+
+// 8 boxes at a time: the 8 corners projected with the matrix rows applied
+// to the min and max of each axis once, the screen rectangle and nearest
+// depth taken over them, then each box looked up in the tiles
+size_t occlusion_buffer::cull(const cull_aabbs& boxes, uint32_t* visible, size_t count)
+{
+   const float(*m)[4] = view_proj_.m;
+   const vec8f zero = v8_zero();
+   const vec8f half_w = v8_set1(0.5f * (float)depth_.width()), half_h = v8_set1(0.5f * (float)depth_.height());
+   const vec8f max_x = v8_set1((float)depth_.width()), max_y = v8_set1((float)depth_.height());
+   const float* const bounds[6] = { boxes.min_x.data(), boxes.min_y.data(), boxes.min_z.data(),
+                                    boxes.max_x.data(), boxes.max_y.data(), boxes.max_z.data() };
+
+   size_t n = 0;
+   for (size_t i = 0; i < count; i += 8)
+   {
+      const int lanes = count - i < 8 ? (int)(count - i) : 8;
+      alignas(32) int32_t index[8];
+      for (int k = 0; k < 8; k++)
+         index[k] = (int32_t)visible[i + (k < lanes ? k : 0)];
+      const vec8i vi = v8i_load(index);
+
+      // axis[a][side][c]: coordinate a at its min or max times row a, column c
+      vec8f axis[3][2][4];
+      for (int a = 0; a < 3; a++)
+      {
+         const vec8f lo = v8_gather(bounds[a], vi), hi = v8_gather(bounds[a + 3], vi);
+         for (int c = 0; c < 4; c++)
+         {
+            axis[a][0][c] = lo * v8_set1(m[a][c]);
+            axis[a][1][c] = hi * v8_set1(m[a][c]);
+         }
+      }
+
+      vec8f x0 = v8_set1(INFINITY), y0 = v8_set1(INFINITY), x1 = v8_set1(-INFINITY), y1 = v8_set1(-INFINITY);
+      vec8f z_min = v8_set1(INFINITY), crossing = zero;
+      for (int k = 0; k < 8; k++)
+      {
+         vec8f clip[4];
+         for (int c = 0; c < 4; c++)
+            clip[c] = axis[0][k & 1][c] + axis[1][(k >> 1) & 1][c] + axis[2][(k >> 2) & 1][c] + v8_set1(m[3][c]);
+         crossing = crossing | v8_cmplt(clip[2], zero) | v8_cmple(clip[3], zero);
+         const vec8f inv_w = v8_set1(1.0f) / clip[3];
+         const vec8f sx = v8_fmadd(clip[0] * inv_w, half_w, half_w);
+         const vec8f sy = half_h - clip[1] * inv_w * half_h;
+         x0 = v8_min(x0, sx);
+         x1 = v8_max(x1, sx);
+         y0 = v8_min(y0, sy);
+         y1 = v8_max(y1, sy);
+         z_min = v8_min(z_min, clip[2] * inv_w);
+      }
+
+      // Every pixel the rectangle touches, within the buffer
+      alignas(32) int32_t rx0[8], ry0[8], rx1[8], ry1[8];
+      alignas(32) float rz[8];
+      v8i_store(rx0, v8_trunc_to_int(v8_max(v8_floor(x0), zero)));
+      v8i_store(ry0, v8_trunc_to_int(v8_max(v8_floor(y0), zero)));
+      v8i_store(rx1, v8_trunc_to_int(v8_min(v8_floor(x1) + v8_set1(1.0f), max_x)));
+      v8i_store(ry1, v8_trunc_to_int(v8_min(v8_floor(y1) + v8_set1(1.0f), max_y)));
+      v8_store(rz, z_min);
+      const int crossing_mask = v8_movemask(crossing);
+
+      for (int k = 0; k < lanes; k++)
+      {
+         bool keep = true;
+         if (crossing_mask & (1 << k))
+         {
+            stats_.near_plane++;
+         }
+         else
+         {
+            stats_.tested++;
+            keep = rx0[k] < rx1[k] && ry0[k] < ry1[k] && !depth_.is_occluded(rx0[k], ry0[k], rx1[k], ry1[k], rz[k]);
+            stats_.occluded += !keep;
+         }
+         visible[n] = (uint32_t)index[k];
+         n += keep;
+      }
+   }
+   return n;
+}
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// Visibility culling for instance lists, before anything is submitted.
+//
+// frustum_from_matrix() takes the six planes out of a view * projection
+// matrix built the d3dmath.h way (row vectors, clip = (p, 1) * m, D3D depth
+// 0..w), normalized so plane distances are in world units.
+//
+// Bounds are kept as one array per component and tested 8 at a time in
+// vec8f: a box is outside when its corner furthest along a plane's normal is
+// behind it, a sphere when its center is more than the radius behind. Both
+// tests are conservative: a box near a frustum corner can pass while
+// outside. The instances that pass are written as a compacted list of
+// indices, without branches.
+//
+// occlusion_buffer is a small depth_buffer (256x128 by default) into which
+// a few large boxes are drawn as occluders. A box from the visible list is
+// projected, its screen rectangle and nearest depth compared with the max
+// depth of the 8x8 tiles under it, and dropped when it is behind all of
+// them. The occluders are sampled at the pixel centers of the small buffer,
+// so an instance seen only through a gap narrower than one of its pixels
+// can be dropped.
+
+#include "sr_depth.h"
+#include "sr_math.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// Inside where dot(normal, p) + d >= 0
+struct frustum
+{
+   float4 planes[6];   // left, right, bottom, top, near, far: (normal, d)
+};
+
+frustum frustum_from_matrix(const float4x4& view_proj);
+
+struct cull_aabbs
+{
+   aligned_vector<float> min_x, min_y, min_z, max_x, max_y, max_z;
+
+   size_t size() const { return min_x.size(); }
+
+   void resize(size_t n)
+   {
+      min_x.resize(n);
+      min_y.resize(n);
+      min_z.resize(n);
+      max_x.resize(n);
+      max_y.resize(n);
+      max_z.resize(n);
+   }
+
+   void set(size_t i, const float3& lo, const float3& hi)
+   {
+      min_x[i] = lo.x;
+      min_y[i] = lo.y;
+      min_z[i] = lo.z;
+      max_x[i] = hi.x;
+      max_y[i] = hi.y;
+      max_z[i] = hi.z;
+   }
+};
+
+struct cull_spheres
+{
+   aligned_vector<float> x, y, z, radius;
+
+   size_t size() const { return x.size(); }
+
+   void resize(size_t n)
+   {
+      x.resize(n);
+      y.resize(n);
+      z.resize(n);
+      radius.resize(n);
+   }
+
+   void set(size_t i, const float3& center, float r)
+   {
+      x[i] = center.x;
+      y[i] = center.y;
+      z[i] = center.z;
+      radius[i] = r;
+   }
+};
+
+// Writes the indices of the bounds inside or crossing the frustum to
+// `visible`, which needs room for all of them, and returns how many
+size_t cull_frustum(const frustum& f, const cull_aabbs& boxes, uint32_t* visible);
+size_t cull_frustum(const frustum& f, const cull_spheres& spheres, uint32_t* visible);
+
+struct occlusion_stats
+{
+   uint64_t occluders = 0;
+   uint64_t occluders_skipped = 0;    // crossing the near plane
+   uint64_t tested = 0;
+   uint64_t occluded = 0;             // or off the buffer
+   uint64_t near_plane = 0;           // crossing the near plane, kept without a test
+};
+
+class occlusion_buffer
+{
+public:
+   occlusion_buffer(int width = 256, int height = 128) : depth_(width, height) {}
+
+   int width() const { return depth_.width(); }
+   int height() const { return depth_.height(); }
+
+   // Clears the depth and sets the matrix occluders and tests go through
+   void begin(const float4x4& view_proj);
+
+   // Draws the 6 faces of a box, back faces culled. A box crossing the near
+   // plane is skipped, which only loses occlusion
+   void add_occluder(const float3& lo, const float3& hi);
+
+   // Removes the occluded boxes from the `count` indices in `visible`, in
+   // place and in order, and returns how many are left. Boxes whose
+   // rectangle misses the buffer go too
+   size_t cull(const cull_aabbs& boxes, uint32_t* visible, size_t count);
+
+   const depth_buffer& depth() const { return depth_; }
+   const occlusion_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = occlusion_stats(); }
+
+private:
+   depth_buffer depth_;
+   float4x4 view_proj_ = identity4x4();
+   occlusion_stats stats_;
+};
+
+}
@@ -0,0 +1,107 @@
+#include "sr_depth.h"
+
+namespace sr
+{
+
+void depth_buffer::resize(int width, int height)
+{
+   width_ = width;
+   height_ = height;
+   tiles_x_ = (width + tile_size - 1) / tile_size;
+   tiles_y_ = (height + tile_size - 1) / tile_size;
+   blocks_x_ = (tiles_x_ + block_tiles - 1) / block_tiles;
+   blocks_y_ = (tiles_y_ + block_tiles - 1) / block_tiles;
+
+   depth_.assign((size_t)tiles_x_ * tiles_y_ * tile_pixels, clear_value_);
+   tiles_.resize((size_t)tiles_x_ * tiles_y_);
+   block_max_.resize((size_t)blocks_x_ * blocks_y_);
+   clear(clear_value_);
+}
+
+void depth_buffer::clear(float depth)
+{
+   clear_value_ = depth;
+   for (tile& t : tiles_)
+   {
+      t.z_min = depth;
+      t.z_max = depth;
+      t.cleared = 1;
+   }
+   for (float& b : block_max_)
+      b = depth;
+}
+
+float depth_buffer::read(int x, int y) const
+{
+   const int tx = x / tile_size;
+   const int ty = y / tile_size;
+   if (tiles_[ty * tiles_x_ + tx].cleared)
+      return clear_value_;
+   return tile_data(tx, ty)[(y % tile_size) * tile_size + (x % tile_size)];
+}
+
+bool depth_buffer::is_occluded(const raster_triangle& tri) const
+{
+   const int block_pixels = tile_size * block_tiles;
+   const int bx0 = tri.min_x / block_pixels;
+   const int by0 = tri.min_y / block_pixels;
+   const int bx1 = (tri.max_x - 1) / block_pixels;
+   const int by1 = (tri.max_y - 1) / block_pixels;
+
+   for (int by = by0; by <= by1; by++)
+   {
+      const float* row = &block_max_[by * blocks_x_];
+      for (int bx = bx0; bx <= bx1; bx++)
+      {
+         if (tri.z_min < row[bx])
+            return false;
+      }
+   }
+   return true;
+}
+
+bool depth_buffer::is_occluded(int x0, int y0, int x1, int y1, float z_min) const
+{
+   const int tx0 = x0 / tile_size;
+   const int ty0 = y0 / tile_size;
+   const int tx1 = (x1 - 1) / tile_size;
+   const int ty1 = (y1 - 1) / tile_size;
+
+   for (int ty = ty0; ty <= ty1; ty++)
+   {
+      const tile* row = &tiles_[ty * tiles_x_];
+      for (int tx = tx0; tx <= tx1; tx++)
+      {
+         if (z_min < row[tx].z_max)
+            return false;
+      }
+   }
+   return true;
+}
+
+void depth_buffer::update_blocks(int tx0, int ty0, int tx1, int ty1)
+{
+   const int bx0 = tx0 / block_tiles;
+   const int by0 = ty0 / block_tiles;
+   const int bx1 = (tx1 - 1) / block_tiles;
+   const int by1 = (ty1 - 1) / block_tiles;
+
+   for (int by = by0; by <= by1; by++)
+   {
+      for (int bx = bx0; bx <= bx1; bx++)
+      {
+         const int ex = (bx + 1) * block_tiles < tiles_x_ ? (bx + 1) * block_tiles : tiles_x_;
+         const int ey = (by + 1) * block_tiles < tiles_y_ ? (by + 1) * block_tiles : tiles_y_;
+         float m = -INFINITY;
+         for (int ty = by * block_tiles; ty < ey; ty++)
+         {
+            const tile* t = &tiles_[ty * tiles_x_];
+            for (int tx = bx * block_tiles; tx < ex; tx++)
+               m = t[tx].z_max > m ? t[tx].z_max : m;
+         }
+         block_max_[by * blocks_x_ + bx] = m;
+      }
+   }
+}
+
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+// Hierarchical-Z depth buffer for the CPU rendering path.
+//
+// Depth is stored in 8x8 pixel tiles. Every tile keeps its min/max depth and
+// a "cleared" flag, and every 8x8 group of tiles (a 64x64 pixel block) keeps
+// the max of its tiles. With the D3D11_COMPARISON_LESS test used by Test5 and
+// DXGISample this lets draw():
+//
+//  - reject a whole triangle when it is behind every block it touches,
+//  - reject a tile when the triangle's nearest depth in it is behind the tile max,
+//  - accept a tile without reading depth when the triangle is in front of the tile min,
+//  - clear by flagging tiles instead of touching every pixel.
+
+#include "sr_raster.h"
+
+namespace sr
+{
+
+struct depth_stats
+{
+   uint64_t triangles = 0;
+   uint64_t triangles_rejected = 0;   // culled by the block level before any tile work
+   uint64_t tiles_rejected = 0;       // triangle behind the tile max
+   uint64_t tiles_accepted = 0;       // triangle in front of the tile min, no per-pixel test
+   uint64_t tiles_tested = 0;         // needed per-pixel depth compares
+   uint64_t tiles_materialized = 0;   // fast-cleared tiles that had to be filled
+   uint64_t pixels_passed = 0;        // pixels handed to the shade callback
+};
+
+class depth_buffer
+{
+public:
+   static const int tile_size = 8;
+   static const int tile_pixels = tile_size * tile_size;
+   static const int block_tiles = 8;
+
+   depth_buffer() = default;
+   depth_buffer(int width, int height) { resize(width, height); }
+
+   void resize(int width, int height);
+
+   // Flags every tile as cleared; pixel memory is only filled when a tile is
+   // partially drawn for the first time
+   void clear(float depth = 1.0f);
+
+   int width() const { return width_; }
+   int height() const { return height_; }
+   int tiles_x() const { return tiles_x_; }
+   int tiles_y() const { return tiles_y_; }
+
+   float read(int x, int y) const;
+   float tile_min(int tx, int ty) const { return tiles_[ty * tiles_x_ + tx].z_min; }
+   float tile_max(int tx, int ty) const { return tiles_[ty * tiles_x_ + tx].z_max; }
+   bool tile_cleared(int tx, int ty) const { return tiles_[ty * tiles_x_ + tx].cleared != 0; }
+
+   // Conservative test against the block level: true means no pixel of the
+   // triangle can pass the LESS test
+   bool is_occluded(const raster_triangle& tri) const;
+
+   // Same against the tile level for the pixels [x0, x1) x [y0, y1), within
+   // the target, and a nearest depth of z_min
+   bool is_occluded(int x0, int y0, int x1, int y1, float z_min) const;
+
+   // Depth-tests and writes the triangle. For every 8-pixel row segment with
+   // passing pixels, shade(x, y, mask) is called once after the depth write;
+   // bit i of mask stands for pixel (x + i, y).
+   template<class Shade>
+   void draw(const raster_triangle& tri, Shade&& shade);
+
+   void draw(const raster_triangle& tri) { draw(tri, [](int, int, int) {}); }
+
+   const depth_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = depth_stats(); }
+
+private:
+   struct tile
+   {
+      float z_min;
+      float z_max;
+      uint32_t cleared;
+   };
+
+   float* tile_data(int tx, int ty) { return &depth_[(size_t)(ty * tiles_x_ + tx) * tile_pixels]; }
+   const float* tile_data(int tx, int ty) const { return &depth_[(size_t)(ty * tiles_x_ + tx) * tile_pixels]; }
+
+   void update_blocks(int tx0, int ty0, int tx1, int ty1);
+
+   int width_ = 0;
+   int height_ = 0;
+   int tiles_x_ = 0;
+   int tiles_y_ = 0;
+   int blocks_x_ = 0;
+   int blocks_y_ = 0;
+   float clear_value_ = 1.0f;
+
+   aligned_vector<float> depth_;
+   std::vector<tile> tiles_;
+   std::vector<float> block_max_;
+   depth_stats stats_;
+};
+
+template<class Shade>
+void depth_buffer::draw(const raster_triangle& tri, Shade&& shade)
+{
+   stats_.triangles++;
+   if (is_occluded(tri))
+   {
+      stats_.triangles_rejected++;
+      return;
+   }
+
+   const int tx0 = tri.min_x / tile_size;
+   const int ty0 = tri.min_y / tile_size;
+   const int tx1 = (tri.max_x + tile_size - 1) / tile_size;
+   const int ty1 = (tri.max_y + tile_size - 1) / tile_size;
+   const vec8f lane_x = v8_ramp() + v8_set1(0.5f);
+   bool changed = false;
+
+   for (int ty = ty0; ty < ty1; ty++)
+   {
+      const int y0 = ty * tile_size;
+      const int by0 = y0 > tri.min_y ? y0 : tri.min_y;
+      const int by1 = y0 + tile_size < tri.max_y ? y0 + tile_size : tri.max_y;
+
+      for (int tx = tx0; tx < tx1; tx++)
+      {
+         const int x0 = tx * tile_size;
+         const int bx0 = x0 > tri.min_x ? x0 : tri.min_x;
+         const int bx1 = x0 + tile_size < tri.max_x ? x0 + tile_size : tri.max_x;
+
+         const block_coverage cov = classify_block(tri, bx0, by0, bx1, by1);
+         if (cov == block_coverage::outside)
+            continue;
+
+         // Depth range of the triangle over this tile. depth_row8 rounds
+         // monotonically in x and y, so the extremes of what the pixels get
+         // are on the first and last covered rows, exactly
+         const int col_mask = ((1 << (bx1 - x0)) - 1) & ~((1 << (bx0 - x0)) - 1);
+         const vec8f cols = v8_lane_mask(col_mask);
+         const vec8f top = depth_row8(tri, x0, by0), bottom = depth_row8(tri, x0, by1 - 1);
+         const vec8f lo = v8_min(top, bottom), hi = v8_max(top, bottom);
+         const float tz_min = clamp(v8_hmin(v8_select(cols, lo, v8_set1(INFINITY))), tri.z_min, tri.z_max);
+         const float tz_max = clamp(v8_hmax(v8_select(cols, hi, v8_set1(-INFINITY))), tri.z_min, tri.z_max);
+
+         tile& t = tiles_[ty * tiles_x_ + tx];
+         if (!(tz_min < t.z_max))
+         {
+            stats_.tiles_rejected++;
+            continue;
+         }
+
+         const bool full_tile = cov == block_coverage::inside &&
+            bx0 == x0 && by0 == y0 && bx1 == x0 + tile_size && by1 == y0 + tile_size;
+         float* d = tile_data(tx, ty);
+
+         if (t.cleared)
+         {
+            // Fully covered and in front of the clear value: every pixel gets
+            // overwritten, so the clear never has to hit memory
+            if (!(full_tile && tz_max < clear_value_))
+            {
+               const vec8f cv = v8_set1(clear_value_);
+               for (int i = 0; i < tile_pixels; i += 8)
+                  v8_store(d + i, cv);
+               stats_.tiles_materialized++;
+            }
+            t.cleared = 0;
+         }
+
+         const bool accept = tz_max < t.z_min;
+         if (accept)
+            stats_.tiles_accepted++;
+         else
+            stats_.tiles_tested++;
+
+         const vec8f vz_min = v8_set1(tri.z_min);
+         const vec8f vz_max = v8_set1(tri.z_max);
+         const vec8f px = v8_set1((float)x0) + lane_x;
+         const vec8f valid_cols = v8_cmplt(px, v8_set1((float)width_));
+         vec8f row_min = v8_set1(INFINITY);
+         vec8f row_max = v8_set1(-INFINITY);
+         const int valid_rows = height_ - y0 < tile_size ? height_ - y0 : tile_size;
+
+         for (int r = 0; r < valid_rows; r++)
+         {
+            const int y = y0 + r;
+            float* row = d + r * tile_size;
+            vec8f old = v8_load(row);
+
+            if (y >= by0 && y < by1)
+            {
+               int mask = full_tile ? 0xff : (coverage_row8(tri, x0, y) & col_mask);
+               if (mask)
+               {
+                  const vec8f z = v8_clamp(depth_row8(tri, x0, y), vz_min, vz_max);
+                  if (!accept)
+                     mask &= v8_movemask(v8_cmplt(z, old));
+
+                  if (mask)
+                  {
+                     old = mask == 0xff ? z : v8_select(v8_lane_mask(mask), z, old);
+                     v8_store(row, old);
+                     stats_.pixels_passed += (uint64_t)popcount32((uint32_t)mask);
+                     shade(x0, y, mask);
+                  }
+               }
+            }
+
+            row_min = v8_min(row_min, v8_select(valid_cols, old, v8_set1(INFINITY)));
+            row_max = v8_max(row_max, v8_select(valid_cols, old, v8_set1(-INFINITY)));
+         }
+
+         const float new_min = v8_hmin(row_min);
+         const float new_max = v8_hmax(row_max);
+         if (new_max != t.z_max)
+            changed = true;
+         t.z_min = new_min;
+         t.z_max = new_max;
+      }
+   }
+
+   if (changed)
+      update_blocks(tx0, ty0, tx1, ty1);
+}
+
+}
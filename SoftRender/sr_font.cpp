@@ -0,0 +1,172 @@
+#include "sr_font.h"
+
+#include <math.h>
+
+#include <atomic>
+
+namespace sr
+{
+
+static std::atomic<uint64_t> s_next_font_id(1);
+
+font_face::font_face() : id_(s_next_font_id++)
+{
+}
+
+uint16_t font_face::add_glyph(uint32_t codepoint, float advance, const path_geometry& outline)
+{
+   glyph_data g = { { advance, {}, {} }, outline };
+   outline.bounds(g.metrics.min, g.metrics.max);
+   glyphs_.push_back(g);
+   const uint16_t index = (uint16_t)(glyphs_.size() - 1);
+   cmap_[codepoint] = index;
+   return index;
+}
+
+uint16_t font_face::glyph_index(uint32_t codepoint) const
+{
+   const auto it = cmap_.find(codepoint);
+   return it != cmap_.end() ? it->second : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Embedded font
+
+// 5x7 pixel font for 0x20..0x7e: one byte per column, bit 0 the top row,
+// bit 7 the descender row below the baseline
+static const uint8_t s_font_5x7[95][5] =
+{
+   { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5f, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 }, { 0x14, 0x7f, 0x14, 0x7f, 0x14 },
+   { 0x24, 0x2a, 0x7f, 0x2a, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 }, { 0x36, 0x49, 0x56, 0x20, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 },
+   { 0x00, 0x1c, 0x22, 0x41, 0x00 }, { 0x00, 0x41, 0x22, 0x1c, 0x00 }, { 0x2a, 0x1c, 0x7f, 0x1c, 0x2a }, { 0x08, 0x08, 0x3e, 0x08, 0x08 },
+   { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 }, { 0x20, 0x10, 0x08, 0x04, 0x02 },
+   { 0x3e, 0x51, 0x49, 0x45, 0x3e }, { 0x00, 0x42, 0x7f, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 }, { 0x21, 0x41, 0x45, 0x4b, 0x31 },
+   { 0x18, 0x14, 0x12, 0x7f, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 }, { 0x3c, 0x4a, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 },
+   { 0x36, 0x49, 0x49, 0x49, 0x36 }, { 0x06, 0x49, 0x49, 0x29, 0x1e }, { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 },
+   { 0x08, 0x14, 0x22, 0x41, 0x00 }, { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+   { 0x32, 0x49, 0x79, 0x41, 0x3e }, { 0x7e, 0x11, 0x11, 0x11, 0x7e }, { 0x7f, 0x49, 0x49, 0x49, 0x36 }, { 0x3e, 0x41, 0x41, 0x41, 0x22 },
+   { 0x7f, 0x41, 0x41, 0x22, 0x1c }, { 0x7f, 0x49, 0x49, 0x49, 0x41 }, { 0x7f, 0x09, 0x09, 0x09, 0x01 }, { 0x3e, 0x41, 0x49, 0x49, 0x7a },
+   { 0x7f, 0x08, 0x08, 0x08, 0x7f }, { 0x00, 0x41, 0x7f, 0x41, 0x00 }, { 0x20, 0x40, 0x41, 0x3f, 0x01 }, { 0x7f, 0x08, 0x14, 0x22, 0x41 },
+   { 0x7f, 0x40, 0x40, 0x40, 0x40 }, { 0x7f, 0x02, 0x0c, 0x02, 0x7f }, { 0x7f, 0x04, 0x08, 0x10, 0x7f }, { 0x3e, 0x41, 0x41, 0x41, 0x3e },
+   { 0x7f, 0x09, 0x09, 0x09, 0x06 }, { 0x3e, 0x41, 0x51, 0x21, 0x5e }, { 0x7f, 0x09, 0x19, 0x29, 0x46 }, { 0x46, 0x49, 0x49, 0x49, 0x31 },
+   { 0x01, 0x01, 0x7f, 0x01, 0x01 }, { 0x3f, 0x40, 0x40, 0x40, 0x3f }, { 0x1f, 0x20, 0x40, 0x20, 0x1f }, { 0x3f, 0x40, 0x38, 0x40, 0x3f },
+   { 0x63, 0x14, 0x08, 0x14, 0x63 }, { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 }, { 0x00, 0x7f, 0x41, 0x41, 0x00 },
+   { 0x02, 0x04, 0x08, 0x10, 0x20 }, { 0x00, 0x41, 0x41, 0x7f, 0x00 }, { 0x04, 0x02, 0x01, 0x02, 0x04 }, { 0x40, 0x40, 0x40, 0x40, 0x40 },
+   { 0x00, 0x01, 0x02, 0x04, 0x00 }, { 0x20, 0x54, 0x54, 0x54, 0x78 }, { 0x7f, 0x48, 0x44, 0x44, 0x38 }, { 0x38, 0x44, 0x44, 0x44, 0x20 },
+   { 0x38, 0x44, 0x44, 0x48, 0x7f }, { 0x38, 0x54, 0x54, 0x54, 0x18 }, { 0x08, 0x7e, 0x09, 0x01, 0x02 }, { 0x18, 0xa4, 0xa4, 0xa4, 0x7c },
+   { 0x7f, 0x08, 0x04, 0x04, 0x78 }, { 0x00, 0x44, 0x7d, 0x40, 0x00 }, { 0x40, 0x80, 0x84, 0x7d, 0x00 }, { 0x7f, 0x10, 0x28, 0x44, 0x00 },
+   { 0x00, 0x41, 0x7f, 0x40, 0x00 }, { 0x7c, 0x04, 0x18, 0x04, 0x78 }, { 0x7c, 0x08, 0x04, 0x04, 0x78 }, { 0x38, 0x44, 0x44, 0x44, 0x38 },
+   { 0xfc, 0x24, 0x24, 0x24, 0x18 }, { 0x18, 0x24, 0x24, 0x18, 0xfc }, { 0x7c, 0x08, 0x04, 0x04, 0x08 }, { 0x48, 0x54, 0x54, 0x54, 0x20 },
+   { 0x04, 0x3f, 0x44, 0x40, 0x20 }, { 0x3c, 0x40, 0x40, 0x20, 0x7c }, { 0x1c, 0x20, 0x40, 0x20, 0x1c }, { 0x3c, 0x40, 0x30, 0x40, 0x3c },
+   { 0x44, 0x28, 0x10, 0x28, 0x44 }, { 0x1c, 0xa0, 0xa0, 0xa0, 0x7c }, { 0x44, 0x64, 0x54, 0x4c, 0x44 }, { 0x00, 0x08, 0x36, 0x41, 0x00 },
+   { 0x00, 0x00, 0x7f, 0x00, 0x00 }, { 0x00, 0x41, 0x36, 0x08, 0x00 }, { 0x08, 0x04, 0x08, 0x10, 0x08 },
+};
+
+static const float s_cell = 125.0f;
+static const int s_baseline_row = 7;
+
+// Outlines of the set pixels of one glyph: every pixel edge between a set
+// and a clear pixel, clockwise around set pixels, chained into loops and
+// with collinear edges merged. How loops are chained where two pixels touch
+// diagonally does not change the nonzero winding, which only depends on
+// the set of edges
+static path_geometry trace_glyph(const uint8_t columns[5])
+{
+   const int cols = 5, rows = 8;
+   auto set = [&](int c, int r) { return c >= 0 && c < cols && r >= 0 && r < rows && (columns[c] >> r & 1); };
+
+   struct edge
+   {
+      int x0, y0, x1, y1;
+      bool used;
+   };
+   std::vector<edge> edges;
+   for (int r = 0; r < rows; r++)
+   {
+      for (int c = 0; c < cols; c++)
+      {
+         if (!set(c, r))
+            continue;
+         if (!set(c, r - 1))
+            edges.push_back({ c, r, c + 1, r, false });
+         if (!set(c + 1, r))
+            edges.push_back({ c + 1, r, c + 1, r + 1, false });
+         if (!set(c, r + 1))
+            edges.push_back({ c + 1, r + 1, c, r + 1, false });
+         if (!set(c - 1, r))
+            edges.push_back({ c, r + 1, c, r, false });
+      }
+   }
+
+   path_geometry path;
+   path.set_fill_mode(fill_mode::winding);
+   auto point = [](int x, int y) { return float2{ x * s_cell, (y - s_baseline_row) * s_cell }; };
+   for (size_t first = 0; first < edges.size(); first++)
+   {
+      if (edges[first].used)
+         continue;
+
+      // Walk the loop, keeping only the corners
+      std::vector<float2> corners;
+      size_t e = first;
+      while (!edges[e].used)
+      {
+         edge& cur = edges[e];
+         cur.used = true;
+         size_t next = first;
+         for (size_t k = 0; k < edges.size(); k++)
+         {
+            if (!edges[k].used && edges[k].x0 == cur.x1 && edges[k].y0 == cur.y1)
+            {
+               next = k;
+               break;
+            }
+         }
+         const edge& n = edges[next];
+         if ((cur.x1 - cur.x0) != (n.x1 - n.x0) || (cur.y1 - cur.y0) != (n.y1 - n.y0))
+            corners.push_back(point(cur.x1, cur.y1));
+         e = next;
+      }
+
+      path.begin_figure(corners.back());
+      path.add_lines(corners.data(), corners.size() - 1);
+      path.end_figure(figure_end::closed);
+   }
+   return path;
+}
+
+static font_face make_builtin_font()
+{
+   font_face font;
+   font_metrics m;
+   m.units_per_em = 1000.0f;
+   m.ascent = s_baseline_row * s_cell;
+   m.descent = s_cell;
+   m.line_gap = 0.0f;
+   font.set_metrics(m);
+
+   // .notdef: a hollow box
+   path_geometry box;
+   box.set_fill_mode(fill_mode::winding);
+   const float2 outer[4] = { { 0, -m.ascent }, { 5 * s_cell, -m.ascent }, { 5 * s_cell, 0 }, { 0, 0 } };
+   const float2 inner[4] = { { s_cell, -s_cell }, { 4 * s_cell, -s_cell }, { 4 * s_cell, -m.ascent + s_cell }, { s_cell, -m.ascent + s_cell } };
+   box.begin_figure(outer[0]);
+   box.add_lines(outer + 1, 3);
+   box.end_figure(figure_end::closed);
+   box.begin_figure(inner[0]);
+   box.add_lines(inner + 1, 3);
+   box.end_figure(figure_end::closed);
+   font.add_glyph(0xffffffffu, 6 * s_cell, box);
+
+   for (uint32_t c = 0x20; c <= 0x7e; c++)
+      font.add_glyph(c, 6 * s_cell, trace_glyph(s_font_5x7[c - 0x20]));
+   return font;
+}
+
+const font_face& builtin_font()
+{
+   static const font_face s_font = make_builtin_font();
+   return s_font;
+}
+
+}
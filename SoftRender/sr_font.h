@@ -0,0 +1,67 @@
+#pragma once
+
+// Glyph outlines for the text path. The samples draw with DWrite's Verdana;
+// on Linux there is no font to load, so builtin_font() turns an embedded
+// 5x7 pixel font (printable ASCII, one descender row) into outlines by
+// tracing the edges of its pixels. Outlines are ordinary path geometries, so
+// glyphs go through the same flattening and coverage as FillGeometry and
+// scale to any size.
+
+#include "sr_path.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace sr
+{
+
+// DWRITE_FONT_METRICS, in font units with y down from the baseline
+struct font_metrics
+{
+   float units_per_em = 1000.0f;
+   float ascent = 0.0f;
+   float descent = 0.0f;
+   float line_gap = 0.0f;
+};
+
+struct glyph_metrics
+{
+   float advance;
+   float2 min, max;   // outline bounds; empty glyphs have min > max
+};
+
+class font_face
+{
+public:
+   font_face();
+
+   uint64_t id() const { return id_; }
+   const font_metrics& metrics() const { return metrics_; }
+   void set_metrics(const font_metrics& m) { metrics_ = m; }
+
+   // Glyph 0 is .notdef, shown for code points the font does not map
+   uint16_t add_glyph(uint32_t codepoint, float advance, const path_geometry& outline);
+   uint16_t glyph_index(uint32_t codepoint) const;
+   size_t glyph_count() const { return glyphs_.size(); }
+
+   const glyph_metrics& glyph(uint16_t index) const { return glyphs_[index].metrics; }
+   const path_geometry& outline(uint16_t index) const { return glyphs_[index].outline; }
+
+private:
+   struct glyph_data
+   {
+      glyph_metrics metrics;
+      path_geometry outline;
+   };
+
+   uint64_t id_;
+   font_metrics metrics_;
+   std::vector<glyph_data> glyphs_;
+   std::unordered_map<uint32_t, uint16_t> cmap_;
+};
+
+// The embedded font: 1000 units per em, 8 rows of 125 units (7 above the
+// baseline), glyphs 6 columns wide including spacing
+const font_face& builtin_font();
+
+}
@@ -0,0 +1,418 @@
+#include "sr_gradient.h"
+#include "sr_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace sr
+{
+
+static std::atomic<uint64_t> s_next_stops_id(1);
+
+// ---------------------------------------------------------------------------
+// gradient_stops
+
+gradient_stops::gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size)
+   : id_(s_next_stops_id++), extend_(extend), stops_(stops, stops + count)
+{
+   if (stops_.empty())
+      stops_.push_back({ 0.0f, { 0.0f, 0.0f, 0.0f, 0.0f } });
+   std::stable_sort(stops_.begin(), stops_.end(), [](const gradient_stop& a, const gradient_stop& b) {
+      return a.position < b.position;
+   });
+
+   // Cell i holds the color at the center of [i / n, (i + 1) / n)
+   const int n = lut_size > 256 ? 1024 : 256;
+   lut_.resize(n);
+   for (int i = 0; i < n; i++)
+   {
+      float c[4];
+      evaluate((i + 0.5f) / n, c);
+      lut_[i] = (uint32_t)(c[0] + 0.5f) | ((uint32_t)(c[1] + 0.5f) << 8) | ((uint32_t)(c[2] + 0.5f) << 16) | ((uint32_t)(c[3] + 0.5f) << 24);
+      opaque_ = opaque_ && (lut_[i] >> 24) == 0xff;
+   }
+}
+
+void gradient_stops::evaluate(float t, float out[4]) const
+{
+   switch (extend_)
+   {
+   case extend_mode::clamp:
+      t = clamp(t, 0.0f, 1.0f);
+      break;
+   case extend_mode::wrap:
+      t -= floorf(t);
+      break;
+   case extend_mode::mirror:
+      t -= 2.0f * floorf(0.5f * t);
+      t = t > 1.0f ? 2.0f - t : t;
+      break;
+   }
+
+   size_t i = 0;
+   while (i < stops_.size() && stops_[i].position <= t)
+      i++;
+   const gradient_stop& a = stops_[i ? i - 1 : 0];
+   const gradient_stop& b = stops_[i < stops_.size() ? i : stops_.size() - 1];
+   const float span = b.position - a.position;
+   const float f = span > 0.0f ? clamp((t - a.position) / span, 0.0f, 1.0f) : 0.0f;
+
+   const float pa[4] = { a.color.r * a.color.a, a.color.g * a.color.a, a.color.b * a.color.a, a.color.a };
+   const float pb[4] = { b.color.r * b.color.a, b.color.g * b.color.a, b.color.b * b.color.a, b.color.a };
+   for (int c = 0; c < 4; c++)
+      out[c] = 255.0f * clamp(pa[c] + (pb[c] - pa[c]) * f, 0.0f, 1.0f);
+}
+
+// ---------------------------------------------------------------------------
+// gradient_brush
+
+gradient_brush::gradient_brush(const linear_gradient& g, const gradient_stops& stops, const float3x2& transform)
+   : kind_(kind::linear), stops_(&stops), linear_(g), radial_(), transform_(transform)
+{
+   setup(transform);
+}
+
+gradient_brush::gradient_brush(const radial_gradient& g, const gradient_stops& stops, const float3x2& transform)
+   : kind_(kind::radial), stops_(&stops), linear_(), radial_(g), transform_(transform)
+{
+   setup(transform);
+}
+
+void gradient_brush::setup(const float3x2& transform)
+{
+   float3x2 inv;
+   degenerate_ = !invert(transform, inv);
+   if (degenerate_)
+      return;
+
+   if (kind_ == kind::linear)
+   {
+      // Projection of the brush-space point onto start -> end
+      const float vx = linear_.end.x - linear_.start.x, vy = linear_.end.y - linear_.start.y;
+      const float len2 = vx * vx + vy * vy;
+      degenerate_ = !(len2 > 0.0f);
+      if (degenerate_)
+         return;
+      ax_ = (inv.m11 * vx + inv.m12 * vy) / len2;
+      ay_ = (inv.m21 * vx + inv.m22 * vy) / len2;
+      a0_ = ((inv.dx - linear_.start.x) * vx + (inv.dy - linear_.start.y) * vy) / len2;
+      return;
+   }
+
+   // Unit-circle space, with the focal point kept strictly inside
+   const float rx = radial_.radius_x, ry = radial_.radius_y;
+   degenerate_ = !(rx != 0.0f && ry != 0.0f);
+   if (degenerate_)
+      return;
+   focal_ = { radial_.origin_offset.x / rx, radial_.origin_offset.y / ry };
+   const float f2 = focal_.x * focal_.x + focal_.y * focal_.y;
+   if (f2 > 0.998f)
+   {
+      const float s = sqrtf(0.998f / f2);
+      focal_ = { focal_.x * s, focal_.y * s };
+   }
+   focal_a_ = 1.0f - (focal_.x * focal_.x + focal_.y * focal_.y);
+   dx_ = { inv.m11 / rx, inv.m12 / ry };
+   dy_ = { inv.m21 / rx, inv.m22 / ry };
+   d0_ = { (inv.dx - radial_.center.x) / rx - focal_.x, (inv.dy - radial_.center.y) / ry - focal_.y };
+}
+
+bool gradient_brush::operator==(const gradient_brush& o) const
+{
+   if (kind_ != o.kind_ || stops_->id() != o.stops_->id() ||
+       memcmp(&transform_, &o.transform_, sizeof(transform_)) != 0)
+      return false;
+   if (kind_ == kind::linear)
+      return memcmp(&linear_, &o.linear_, sizeof(linear_)) == 0;
+   return memcmp(&radial_, &o.radial_, sizeof(radial_)) == 0;
+}
+
+float gradient_brush::position(float x, float y) const
+{
+   if (degenerate_)
+      return 1.0f;
+   if (kind_ == kind::linear)
+      return ax_ * x + ay_ * y + a0_;
+
+   // |f + d / t| = 1 solved for t
+   const float2 d = { d0_.x + dx_.x * x + dy_.x * y, d0_.y + dx_.y * x + dy_.y * y };
+   const float fd = focal_.x * d.x + focal_.y * d.y;
+   const float dd = d.x * d.x + d.y * d.y;
+   return (fd + sqrtf(fd * fd + focal_a_ * dd)) / focal_a_;
+}
+
+// Fills out[0, count) with one color
+static void fill_color(uint32_t* out, int count, uint32_t color)
+{
+   const vec8i c = v8i_set1((int32_t)color);
+   int i = 0;
+   for (; i + 8 <= count; i += 8)
+      v8i_storeu(out + i, c);
+   for (; i < count; i++)
+      out[i] = color;
+}
+
+// Stores the first `count` (up to 8) lanes
+static SR_FORCEINLINE void store_partial(uint32_t* out, int count, vec8i v)
+{
+   if (count >= 8)
+   {
+      v8i_storeu(out, v);
+      return;
+   }
+   alignas(32) int32_t tmp[8];
+   v8i_store(tmp, v);
+   memcpy(out, tmp, count * sizeof(uint32_t));
+}
+
+// LUT index of a position in LUT units, extend mode applied
+static int lut_index(double u, int n, extend_mode extend)
+{
+   switch (extend)
+   {
+   case extend_mode::clamp:
+      return u < 0.0 ? 0 : u >= n ? n - 1 : (int)u;
+   case extend_mode::wrap:
+      return (int)(u - n * floor(u / n)) & (n - 1);
+   case extend_mode::mirror:
+   {
+      const int i = (int)(u - 2.0 * n * floor(u / (2.0 * n))) & (2 * n - 1);
+      return i < n ? i : 2 * n - 1 - i;
+   }
+   }
+   return 0;
+}
+
+void gradient_brush::span(int x, int y, int count, uint32_t* out) const
+{
+   if (count <= 0)
+      return;
+   if (degenerate_)
+   {
+      fill_color(out, count, stops_->lut()[stops_->lut_size() - 1]);
+      return;
+   }
+   if (kind_ == kind::linear)
+      linear_span(x, y, count, out);
+   else
+      radial_span(x, y, count, out);
+}
+
+void gradient_brush::linear_span(int x, int y, int count, uint32_t* out) const
+{
+   const int n = stops_->lut_size();
+   const int32_t* lut = (const int32_t*)stops_->lut();
+   const extend_mode extend = stops_->extend();
+
+   // Position in LUT units at the center of pixel 0 of the row, and per
+   // pixel. Positions are stepped from pixel 0 rather than from x, so a span
+   // gets the same colors however the row is split (tiles, clip rectangles)
+   const double row_t = ((double)ax_ * 0.5 + (double)ay_ * (y + 0.5) + a0_) * n;
+   const double dt = (double)ax_ * n;
+   const double t0 = row_t + x * dt;
+
+   // Constant along the row: one color
+   if (dt == 0.0)
+   {
+      fill_color(out, count, (uint32_t)lut[lut_index(t0, n, extend)]);
+      return;
+   }
+
+   if (extend == extend_mode::clamp)
+   {
+      // Pixels that are more than a cell past either end are the end colors;
+      // the rest step in 16.16, which cannot overflow in that range
+      double k_low = (-1.0 - t0) / dt, k_high = (n + 1.0 - t0) / dt;
+      if (dt < 0.0)
+         std::swap(k_low, k_high);
+      const int lo = (int)clamp(ceil(k_low), 0.0, (double)count);
+      const int hi = (int)clamp(ceil(k_high), (double)lo, (double)count);
+      const uint32_t before = (uint32_t)lut[dt > 0.0 ? 0 : n - 1];
+      const uint32_t after = (uint32_t)lut[dt > 0.0 ? n - 1 : 0];
+      fill_color(out, lo, before);
+      fill_color(out + hi, count - hi, after);
+
+      // Steep enough that 8 steps could overflow 16.16: a handful of pixels
+      if (fabs(dt) >= 1024.0)
+      {
+         for (int i = lo; i < hi; i++)
+            out[i] = (uint32_t)lut[lut_index(row_t + (x + i) * dt, n, extend)];
+         return;
+      }
+
+      // Pixel 0 in 16.16 may be far out of range; pixel x + lo is not
+      const int32_t step = (int32_t)lround(dt * 65536.0);
+      vec8i t = v8i_set1((int32_t)(llround(row_t * 65536.0) + (int64_t)(x + lo) * step));
+      t = t + v8i_set(0, step, 2 * step, 3 * step, 4 * step, 5 * step, 6 * step, 7 * step);
+      const vec8i step8 = v8i_set1(step * 8);
+      const vec8i zero = v8i_set1(0), last = v8i_set1(n - 1);
+      for (int i = lo; i < hi; i += 8)
+      {
+         const vec8i index = v8i_min(v8i_srli(v8i_max(t, zero), 16), last);
+         store_partial(out + i, hi - i, v8i_gather(lut, index));
+         t = t + step8;
+      }
+      return;
+   }
+
+   // Wrap and mirror are periodic: reduce the start and the step modulo the
+   // period, after which 32-bit wrap-around is harmless (the period in 16.16
+   // divides 2^32)
+   const int period = extend == extend_mode::wrap ? n : 2 * n;
+   const double row_mod = row_t - period * floor(row_t / period);
+   const double dt_mod = dt - period * floor(dt / period + 0.5);
+   const uint32_t step = (uint32_t)(int32_t)lround(dt_mod * 65536.0);
+   vec8i t = v8i_set1((int32_t)((uint32_t)lround(row_mod * 65536.0) + (uint32_t)x * step));
+   t = t + v8i_set(0, (int32_t)step, (int32_t)(2 * step), (int32_t)(3 * step), (int32_t)(4 * step), (int32_t)(5 * step), (int32_t)(6 * step), (int32_t)(7 * step));
+   const vec8i step8 = v8i_set1((int32_t)(8 * step));
+   const vec8i period_mask = v8i_set1(period - 1);
+   const vec8i half = v8i_set1(n), mirror_mask = v8i_set1(2 * n - 1);
+   for (int i = 0; i < count; i += 8)
+   {
+      vec8i index = v8i_srli(t, 16) & period_mask;
+      if (extend == extend_mode::mirror)
+         index = index ^ (v8i_cmpeq(index & half, half) & mirror_mask);
+      store_partial(out + i, count - i, v8i_gather(lut, index));
+      t = t + step8;
+   }
+}
+
+void gradient_brush::radial_span(int x, int y, int count, uint32_t* out) const
+{
+   const int n = stops_->lut_size();
+   const int32_t* lut = (const int32_t*)stops_->lut();
+   const extend_mode extend = stops_->extend();
+
+   // d at pixel centers, from pixel 0 of the row (see linear_span)
+   const float py = y + 0.5f;
+   const vec8f row_x = v8_set1(d0_.x + dy_.x * py), row_y = v8_set1(d0_.y + dy_.y * py);
+   const vec8f step_x = v8_set1(dx_.x), step_y = v8_set1(dx_.y);
+   const vec8f first = v8_set1((float)x + 0.5f) + v8_ramp();
+   const vec8f fx = v8_set1(focal_.x), fy = v8_set1(focal_.y);
+   const vec8f a = v8_set1(focal_a_);
+   const vec8f scale = v8_set1((float)n / focal_a_);
+
+   const vec8f max_index = v8_set1((float)n - 1.0f);
+   const vec8f period = v8_set1(extend == extend_mode::wrap ? (float)n : 2.0f * n);
+   const vec8f inv_period = v8_set1(extend == extend_mode::wrap ? 1.0f / n : 0.5f / n);
+   const vec8i period_mask = v8i_set1(extend == extend_mode::wrap ? n - 1 : 2 * n - 1);
+   const vec8i half = v8i_set1(n), mirror_mask = v8i_set1(2 * n - 1);
+
+   for (int i = 0; i < count; i += 8)
+   {
+      const vec8f px = first + v8_set1((float)i);
+      const vec8f dx = v8_fmadd(px, step_x, row_x), dy = v8_fmadd(px, step_y, row_y);
+      const vec8f fd = v8_fmadd(fx, dx, fy * dy);
+      const vec8f dd = v8_fmadd(dx, dx, dy * dy);
+      const vec8f u = (fd + v8_sqrt(v8_fmadd(fd, fd, a * dd))) * scale;
+
+      vec8i index;
+      if (extend == extend_mode::clamp)
+      {
+         index = v8_trunc_to_int(v8_clamp(u, v8_set1(0.0f), max_index));
+      }
+      else
+      {
+         index = v8_trunc_to_int(u - period * v8_floor(u * inv_period)) & period_mask;
+         if (extend == extend_mode::mirror)
+            index = index ^ (v8i_cmpeq(index & half, half) & mirror_mask);
+      }
+      store_partial(out + i, count - i, v8i_gather(lut, index));
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Fills
+
+void fill_rect(image_rgba8& target, const rect_i& rect, const gradient_brush& brush)
+{
+   const rect_i r = intersect(rect, target.clip());
+   if (r.empty())
+      return;
+
+   const bool opaque = brush.opaque();
+   aligned_vector<uint32_t> colors(opaque ? 0 : r.width());
+   for (int y = r.top; y < r.bottom; y++)
+   {
+      uint32_t* dst = target.row(y) + r.left;
+      if (opaque)
+      {
+         brush.span(r.left, y, r.width(), dst);
+         continue;
+      }
+      brush.span(r.left, y, r.width(), colors.data());
+      blend_over(dst, colors.data(), r.width());
+   }
+}
+
+void gradient_fill_cache::fill(image_rgba8& target, const gradient_brush& brush)
+{
+   const bool column = brush.constant_along_x();
+   if (!column && !brush.constant_along_y())
+   {
+      stats_.uncached++;
+      fill_rect(target, target.bounds(), brush);
+      return;
+   }
+
+   if (brush_ && *brush_ == brush && width_ == target.width() && height_ == target.height())
+   {
+      stats_.hits++;
+   }
+   else
+   {
+      stats_.misses++;
+      brush_ = brush;
+      column_ = column;
+      width_ = target.width();
+      height_ = target.height();
+      if (column_)
+      {
+         line_.resize(height_);
+         for (int y = 0; y < height_; y++)
+            brush.span(0, y, 1, &line_[y]);
+      }
+      else
+      {
+         line_.resize(width_);
+         brush.span(0, 0, width_, line_.data());
+      }
+   }
+
+   const rect_i& r = target.clip();
+   const bool opaque = brush.opaque();
+   if (column_ && !opaque)
+      scratch_.resize(r.width());
+   for (int y = r.top; y < r.bottom; y++)
+   {
+      uint32_t* dst = target.row(y) + r.left;
+      if (!column_)
+      {
+         if (opaque)
+            memcpy(dst, &line_[r.left], r.width() * sizeof(uint32_t));
+         else
+            blend_over(dst, &line_[r.left], r.width());
+      }
+      else if (opaque)
+      {
+         fill_color(dst, r.width(), line_[y]);
+      }
+      else
+      {
+         fill_color(scratch_.data(), r.width(), line_[y]);
+         blend_over(dst, scratch_.data(), r.width());
+      }
+   }
+}
+
+void gradient_fill_cache::clear()
+{
+   brush_.reset();
+   line_.clear();
+   width_ = height_ = 0;
+}
+
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+// Gradient brushes for the 2D path: m_pBackBufferGradientBrush (a vertical
+// ramp stretched over the whole window by SetTransform(Scale(GetSize()))) and
+// m_pLGBrush.
+//
+// gradient_stops bakes a stop collection once into a 256 or 1024 entry LUT of
+// premultiplied RGBA8 colors. Spans then only need an index per pixel: linear
+// gradients step a 16.16 fixed-point LUT position along the row, 8 pixels per
+// vector, and radial gradients solve for the focal-point ratio 8 pixels at a
+// time. Rows where the gradient does not vary (a vertical ramp) are a single
+// color. gradient_fill_cache keeps one row of a brush that only varies along
+// x, or one column of a brush that only varies along y, and replicates it
+// over the surface; anything else is filled from the LUT every time, which is
+// cheaper than reading back a full-surface copy.
+
+#include "sr_image.h"
+#include "sr_math.h"
+
+#include <optional>
+#include <vector>
+
+namespace sr
+{
+
+// D2D1_GRADIENT_STOP
+struct gradient_stop
+{
+   float position;
+   color_f color;
+};
+
+// ID2D1GradientStopCollection. Colors are interpolated premultiplied
+class gradient_stops
+{
+public:
+   // lut_size is 256 or 1024
+   gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend = extend_mode::clamp, int lut_size = 256);
+
+   extend_mode extend() const { return extend_; }
+   int lut_size() const { return (int)lut_.size(); }
+   const uint32_t* lut() const { return lut_.data(); }
+   bool opaque() const { return opaque_; }
+   uint64_t id() const { return id_; }
+
+   // Exact premultiplied color at gradient position t (extend mode applied),
+   // in [0, 255] per channel; the reference the LUT is built from
+   void evaluate(float t, float out[4]) const;
+
+private:
+   uint64_t id_;
+   extend_mode extend_;
+   bool opaque_ = true;
+   std::vector<gradient_stop> stops_;
+   aligned_vector<uint32_t> lut_;
+};
+
+// D2D1_LINEAR_GRADIENT_BRUSH_PROPERTIES
+struct linear_gradient
+{
+   float2 start, end;
+};
+
+// D2D1_RADIAL_GRADIENT_BRUSH_PROPERTIES
+struct radial_gradient
+{
+   float2 center;
+   float2 origin_offset;
+   float radius_x, radius_y;
+};
+
+class gradient_brush
+{
+public:
+   enum class kind
+   {
+      linear,
+      radial,
+   };
+
+   // `stops` must outlive the brush; `transform` maps brush space to the target
+   gradient_brush(const linear_gradient& g, const gradient_stops& stops, const float3x2& transform = identity3x2());
+   gradient_brush(const radial_gradient& g, const gradient_stops& stops, const float3x2& transform = identity3x2());
+
+   kind type() const { return kind_; }
+   const gradient_stops& stops() const { return *stops_; }
+   bool opaque() const { return stops_->opaque(); }
+
+   // Every row, or every column, gets the same colors
+   bool constant_along_y() const { return degenerate_ || (kind_ == kind::linear && ay_ == 0.0f); }
+   bool constant_along_x() const { return degenerate_ || (kind_ == kind::linear && ax_ == 0.0f); }
+
+   // Same brush, same pixels
+   bool operator==(const gradient_brush& o) const;
+
+   // Colors of pixels [x, x + count) of row y
+   void span(int x, int y, int count, uint32_t* out) const;
+
+   // Gradient position of a pixel center, for references and tests
+   float position(float x, float y) const;
+
+private:
+   void setup(const float3x2& transform);
+   void linear_span(int x, int y, int count, uint32_t* out) const;
+   void radial_span(int x, int y, int count, uint32_t* out) const;
+
+   kind kind_;
+   const gradient_stops* stops_;
+   linear_gradient linear_;
+   radial_gradient radial_;
+   float3x2 transform_;
+
+   // Linear: position = ax * x + ay * y + a0 at pixel centers
+   float ax_ = 0, ay_ = 0, a0_ = 0;
+   // Radial: d = point - focal in unit-circle space, affine in (x, y);
+   // focal f, and 1 - |f|^2
+   float2 dx_ = {}, dy_ = {}, d0_ = {};
+   float2 focal_ = {};
+   float focal_a_ = 1.0f;
+   bool degenerate_ = false;
+};
+
+// FillRectangle with a gradient brush: source-over, clipped to the target
+void fill_rect(image_rgba8& target, const rect_i& rect, const gradient_brush& brush);
+
+struct gradient_cache_stats
+{
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t uncached = 0;   // fills of brushes that vary along both axes
+};
+
+// Full-surface gradient fills. A brush constant along one axis is kept as
+// one row or one column of colors and replicated while brush and surface
+// size stay the same; other brushes go straight to fill_rect
+class gradient_fill_cache
+{
+public:
+   void fill(image_rgba8& target, const gradient_brush& brush);
+   void clear();
+
+   size_t bytes() const { return line_.size() * sizeof(uint32_t); }
+   const gradient_cache_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = gradient_cache_stats(); }
+
+private:
+   std::optional<gradient_brush> brush_;
+   bool column_ = false;            // line_ holds a color per row
+   int width_ = 0, height_ = 0;
+   aligned_vector<uint32_t> line_;
+   aligned_vector<uint32_t> scratch_;   // a translucent column color spread over a row
+   gradient_cache_stats stats_;
+};
+
+}
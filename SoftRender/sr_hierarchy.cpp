@@ -0,0 +1,430 @@
+#include "sr_hierarchy.h"
+
+#include <algorithm>
+
+namespace sr
+{
+
+// update_group() gathers the locals as floats
+static_assert(sizeof(local_transform) == 10 * sizeof(float), "local_transform is 10 floats");
+
+// Component c of a slot in the blocked arrays: each group of 8 slots keeps
+// its components one after the other, 8 lanes each
+static inline size_t local_at(uint32_t slot, int c)
+{
+   return ((size_t)(slot >> 3) * 10 + c) * 8 + (slot & 7);
+}
+
+static inline size_t world_at(uint32_t slot, int c)
+{
+   return ((size_t)(slot >> 3) * 12 + c) * 8 + (slot & 7);
+}
+
+int transform_hierarchy::add_node(int parent, const local_transform& local)
+{
+   if (locals_.empty())
+      locals_.push_back({ { 0.0f, 0.0f, 0.0f }, identity_quaternion(), { 1.0f, 1.0f, 1.0f } });
+   const int id = (int)parent_.size();
+   parent_.push_back(parent >= 0 && parent < id ? parent : -1);
+   locals_.push_back(local);
+   built_ = false;
+   return id;
+}
+
+void transform_hierarchy::clear()
+{
+   parent_.clear();
+   locals_.clear();
+   slot_of_.clear();
+   node_of_slot_.clear();
+   built_ = false;
+}
+
+uint32_t transform_hierarchy::add_slot(int node)
+{
+   const uint32_t slot = (uint32_t)node_of_slot_.size();
+   node_of_slot_.push_back(node);
+   if (node >= 0)
+      slot_of_[node] = slot;
+   return slot;
+}
+
+void transform_hierarchy::build()
+{
+   const int n = (int)parent_.size();
+
+   // Children by id, levels breadth first and subtree sizes
+   std::vector<uint32_t> first(n + 1, 0), kids(n);
+   for (int id = 0; id < n; id++)
+      if (parent_[id] >= 0)
+         first[parent_[id] + 1]++;
+   for (int id = 0; id < n; id++)
+      first[id + 1] += first[id];
+   {
+      std::vector<uint32_t> fill(first.begin(), first.end() - 1);
+      for (int id = 0; id < n; id++)
+         if (parent_[id] >= 0)
+            kids[fill[parent_[id]]++] = id;
+   }
+   std::vector<std::vector<int>> levels;
+   levels.emplace_back();
+   for (int id = 0; id < n; id++)
+      if (parent_[id] < 0)
+         levels[0].push_back(id);
+   while (!levels.back().empty())
+   {
+      std::vector<int> next;
+      for (int id : levels.back())
+         next.insert(next.end(), kids.begin() + first[id], kids.begin() + first[id + 1]);
+      levels.push_back(std::move(next));
+   }
+   levels.pop_back();
+   std::vector<int> subtree(n, 1);
+   for (int id = n - 1; id >= 0; id--)
+      if (parent_[id] >= 0)
+         subtree[parent_[id]] += subtree[id];
+
+   // The first level wide enough to split, its nodes cut into chunks of
+   // about equal subtree size. Deeper nodes follow their ancestor there; as
+   // levels are in parent order, each chunk is a run of every level
+   size_t split = 0;
+   while (split < levels.size() && levels[split].size() < (size_t)target_chunks)
+      split++;
+   std::vector<int> chunk_of(n, 0);
+   int chunks = 0;
+   if (split < levels.size())
+   {
+      chunks = target_chunks;
+      int64_t total = 0, before = 0;
+      for (int id : levels[split])
+         total += subtree[id];
+      for (int id : levels[split])
+      {
+         chunk_of[id] = (int)std::min<int64_t>(chunks - 1, before * chunks / total);
+         before += subtree[id];
+      }
+      for (size_t l = split + 1; l < levels.size(); l++)
+         for (int id : levels[l])
+            chunk_of[id] = chunk_of[parent_[id]];
+   }
+
+   // Slots: the identity root's group, the top levels, then chunk by chunk
+   // and level by level, each level padded to a group of 8
+   slot_of_.assign(n, 0);
+   node_of_slot_.clear();
+   top_.clear();
+   chunk_spans_.clear();
+   chunk_first_.clear();
+   int padding = 0;
+   auto pad = [&] {
+      while (node_of_slot_.size() % 8)
+      {
+         add_slot(-1);
+         padding++;
+      }
+   };
+   add_slot(-1);
+   pad();
+   padding = 0;
+   for (size_t l = 0; l < split; l++)
+   {
+      const uint32_t begin = (uint32_t)node_of_slot_.size();
+      for (int id : levels[l])
+         add_slot(id);
+      pad();
+      top_.push_back({ begin, (uint32_t)node_of_slot_.size() });
+   }
+   std::vector<size_t> cursor(levels.size(), 0);
+   for (int c = 0; c < chunks; c++)
+   {
+      chunk_first_.push_back((uint32_t)chunk_spans_.size());
+      for (size_t l = split; l < levels.size(); l++)
+      {
+         const uint32_t begin = (uint32_t)node_of_slot_.size();
+         size_t& i = cursor[l];
+         for (; i < levels[l].size() && chunk_of[levels[l][i]] == c; i++)
+            add_slot(levels[l][i]);
+         if (node_of_slot_.size() == begin)
+            break;
+         pad();
+         chunk_spans_.push_back({ begin, (uint32_t)node_of_slot_.size() });
+      }
+   }
+   chunk_first_.push_back((uint32_t)chunk_spans_.size());
+
+   // Per-slot arrays: identities for the root and the padding, everything
+   // dirty so the first update computes it all
+   const size_t slots = node_of_slot_.size();
+   local_at_.assign(slots, 0);
+   for (size_t s = 8; s < slots; s++)
+      local_at_[s] = node_of_slot_[s] < 0 ? 0 : 10 * (node_of_slot_[s] + 1);
+   const float identity[10] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f };
+   local_.resize(slots * 10);
+   world_.resize(slots * 12);
+   for (uint32_t s = 0; s < (uint32_t)slots; s++)
+   {
+      for (int c = 0; c < 10; c++)
+         local_[local_at(s, c)] = identity[c];
+      for (int c = 0; c < 12; c++)
+         world_[world_at(s, c)] = c == 0 || c == 4 || c == 8 ? 1.0f : 0.0f;
+   }
+   gather_locals_ = true;
+
+   // Padding takes the parent of the slot before it, so a group's parents
+   // are always an ascending run of one level
+   parent_slot_.assign(slots, 0);
+   for (size_t s = 8; s < slots; s++)
+   {
+      const int id = node_of_slot_[s];
+      parent_slot_[s] = id < 0 ? parent_slot_[s - 1] : parent_[id] >= 0 ? (int32_t)slot_of_[parent_[id]] : 0;
+   }
+   dirty_.assign(slots, 1);
+   dirty_count_ = n;
+   changed_.assign(slots, 0);
+   group_dirty_.assign(slots / 8, 1);
+   group_changed_.assign(slots / 8, 0);
+
+   built_ = true;
+
+   chunk_counts_.assign(chunks, chunk_counts());
+   stats_ = hierarchy_stats();
+   stats_.nodes = n;
+   stats_.levels = (int)levels.size();
+   stats_.chunks = chunks;
+   stats_.padding = padding;
+}
+
+void transform_hierarchy::set_local(int node, const local_transform& local)
+{
+   locals_[node + 1] = local;
+   if (!built_)
+      return;
+   const uint32_t s = slot_of_[node];
+   dirty_count_ += !dirty_[s];
+   dirty_[s] = 1;
+   group_dirty_[s >> 3] = 1;
+   if (gather_locals_)
+      return;
+   const float v[10] = { local.translation.x, local.translation.y, local.translation.z, local.rotation.x, local.rotation.y,
+                         local.rotation.z, local.rotation.w, local.scale.x, local.scale.y, local.scale.z };
+   for (int c = 0; c < 10; c++)
+      local_[local_at(s, c)] = v[c];
+}
+
+// Every node is dirty: update() takes the full pass, which needs no flags
+// and gathers the locals from here
+void transform_hierarchy::set_locals(const local_transform* locals)
+{
+   if (parent_.empty())
+      return;
+   std::copy(locals, locals + parent_.size(), locals_.begin() + 1);
+   dirty_count_ = parent_.size();
+   gather_locals_ = true;
+}
+
+local_transform transform_hierarchy::get_local(int node) const
+{
+   return locals_[node + 1];
+}
+
+float4x4 transform_hierarchy::world(int node) const
+{
+   const uint32_t s = slot_of_[node];
+   const float* w = &world_[world_at(s, 0)];
+   return { { { w[0], w[8], w[16], 0.0f },
+              { w[24], w[32], w[40], 0.0f },
+              { w[48], w[56], w[64], 0.0f },
+              { w[72], w[80], w[88], 1.0f } } };
+}
+
+// ---------------------------------------------------------------------------
+// Update
+
+// The slot arrays from the locals by id, once the frames after set_locals()
+// go back to set_local()
+void transform_hierarchy::refresh_locals()
+{
+   for (uint32_t s = 8; s < (uint32_t)node_of_slot_.size(); s++)
+   {
+      const int id = node_of_slot_[s];
+      if (id < 0)
+         continue;
+      const local_transform& l = locals_[id + 1];
+      const float v[10] = { l.translation.x, l.translation.y, l.translation.z, l.rotation.x, l.rotation.y,
+                            l.rotation.z, l.rotation.w, l.scale.x, l.scale.y, l.scale.z };
+      for (int c = 0; c < 10; c++)
+         local_[local_at(s, c)] = v[c];
+   }
+   gather_locals_ = false;
+}
+
+void transform_hierarchy::update(thread_pool* pool)
+{
+   if (!built_)
+      build();
+
+   const bool full = dirty_count_ > 0 && (float)dirty_count_ >= full_update_fraction * (float)parent_.size();
+   if (!full && dirty_count_ && gather_locals_)
+      refresh_locals();
+   chunk_counts top = {};
+   for (const span& s : top_)
+      update_span(s, full, top);
+
+   const int chunks = (int)chunk_counts_.size();
+   auto run_chunk = [&](int c, int) {
+      chunk_counts_[c] = chunk_counts();
+      for (uint32_t i = chunk_first_[c]; i < chunk_first_[c + 1]; i++)
+         update_span(chunk_spans_[i], full, chunk_counts_[c]);
+   };
+   if (pool && pool->threads() > 1)
+      pool->run(chunks, run_chunk);
+   else
+      for (int c = 0; c < chunks; c++)
+         run_chunk(c, 0);
+
+   stats_.dirty = top.dirty;
+   stats_.groups_updated = top.updated;
+   stats_.groups_skipped = top.skipped;
+   for (const chunk_counts& c : chunk_counts_)
+   {
+      stats_.dirty += c.dirty;
+      stats_.groups_updated += c.updated;
+      stats_.groups_skipped += c.skipped;
+   }
+   stats_.full = full;
+   if (full)
+   {
+      // The flags the incremental pass would have cleared. changed_ is only
+      // read below a group flagged changed in the same update, so it may stay
+      std::fill(dirty_.begin(), dirty_.end(), 0);
+      std::fill(group_dirty_.begin(), group_dirty_.end(), 0);
+      stats_.dirty = (int)parent_.size();
+   }
+   dirty_count_ = 0;
+}
+
+// A node changes when it was set or its parent changed. The parents of a
+// group are an ascending run of the level before, so a group with nothing
+// set and no changed group among its parents' is skipped on two loads; a
+// lane's changed_ is only read when its group changed this update. The full
+// pass recomputes every group and writes no flags
+void transform_hierarchy::update_span(const span& s, bool full, chunk_counts& counts)
+{
+   if (full)
+   {
+      for (uint32_t g = s.begin; g < s.end; g += 8)
+         update_group(g, gather_locals_);
+      counts.updated += (int)((s.end - s.begin) >> 3);
+      return;
+   }
+   for (uint32_t g = s.begin; g < s.end; g += 8)
+   {
+      const uint32_t lo = (uint32_t)parent_slot_[g] >> 3, hi = (uint32_t)parent_slot_[g + 7] >> 3;
+      bool candidate = group_dirty_[g >> 3] != 0;
+      for (uint32_t p = lo; p <= hi && !candidate; p++)
+         candidate = group_changed_[p] != 0;
+      group_changed_[g >> 3] = 0;
+      if (!candidate)
+      {
+         counts.skipped++;
+         continue;
+      }
+      group_dirty_[g >> 3] = 0;
+      int any = 0;
+      for (uint32_t k = g; k < g + 8; k++)
+      {
+         const uint32_t p = (uint32_t)parent_slot_[k];
+         changed_[k] = dirty_[k] | (group_changed_[p >> 3] & changed_[p]);
+         dirty_[k] = 0;
+         any |= changed_[k];
+         counts.dirty += changed_[k] && node_of_slot_[k] >= 0;
+      }
+      if (!any)
+      {
+         counts.skipped++;
+         continue;
+      }
+      group_changed_[g >> 3] = 1;
+      update_group(g, false);
+      counts.updated++;
+   }
+}
+
+// World = local * parent world for 8 slots, summed in the order of the
+// vec4f mul() so the result has the bits of mul(local_matrix(), world)
+void transform_hierarchy::update_group(uint32_t first, bool gather)
+{
+   // The parents are an ascending run of one level, most often within one
+   // or two groups: with AVX2 a load and a permute per component take the
+   // place of each gather, with a select between the two groups. Without it
+   // a permute is a gather from the stack, so the gather goes straight to
+   // the blocked rows
+   const vec8i parent = v8i_load(&parent_slot_[first]);
+   vec8f p[12];
+#if defined(SR_SIMD_AVX2)
+   const uint32_t lo = (uint32_t)parent_slot_[first] >> 3, hi = (uint32_t)parent_slot_[first + 7] >> 3;
+   const float* a = &world_[(size_t)lo * 96];
+   if (hi == lo)
+   {
+      for (int c = 0; c < 12; c++)
+         p[c] = v8_permute(v8_load(a + 8 * c), parent);
+   }
+   else if (hi == lo + 1)
+   {
+      const vec8f in_lo = v8i_as_float(v8i_cmpeq(v8i_srli(parent, 3), v8i_set1((int32_t)lo)));
+      for (int c = 0; c < 12; c++)
+         p[c] = v8_select(in_lo, v8_permute(v8_load(a + 8 * c), parent), v8_permute(v8_load(a + 96 + 8 * c), parent));
+   }
+   else
+#endif
+   {
+      const vec8i group = v8i_srli(parent, 3);
+      const vec8i at = v8i_slli(group, 6) + v8i_slli(group, 5) + (parent & v8i_set1(7));
+      for (int c = 0; c < 12; c++)
+         p[c] = v8_gather(world_.data() + 8 * c, at);
+   }
+
+   // tx ty tz, qx qy qz qw, sx sy sz of the 8 locals: from the slot arrays,
+   // or after set_locals() from the locals by id. Not stored back: stores
+   // among the gathers cost the full pass three times its time
+   vec8f v[10];
+   if (gather)
+   {
+      const float* locals = &locals_[0].translation.x;
+      const vec8i at = v8i_load(&local_at_[first]);
+      for (int c = 0; c < 10; c++)
+         v[c] = v8_gather(locals + c, at);
+   }
+   else
+   {
+      const float* l = &local_[(size_t)(first >> 3) * 80];
+      for (int c = 0; c < 10; c++)
+         v[c] = v8_load(l + 8 * c);
+   }
+
+   const vec8f qx = v[3], qy = v[4], qz = v[5], qw = v[6];
+   const vec8f x2 = qx + qx, y2 = qy + qy, z2 = qz + qz;
+   const vec8f xx = qx * x2, yy = qy * y2, zz = qz * z2;
+   const vec8f xy = qx * y2, xz = qx * z2, yz = qy * z2;
+   const vec8f wx = qw * x2, wy = qw * y2, wz = qw * z2;
+   const vec8f one = v8_set1(1.0f);
+   const vec8f sx = v[7], sy = v[8], sz = v[9];
+   const vec8f l[3][3] = {
+      { (one - (yy + zz)) * sx, (xy + wz) * sx, (xz - wy) * sx },
+      { (xy - wz) * sy, (one - (xx + zz)) * sy, (yz + wx) * sy },
+      { (xz + wy) * sz, (yz - wx) * sz, (one - (xx + yy)) * sz },
+   };
+
+   float* w = &world_[(size_t)(first >> 3) * 96];
+   for (int i = 0; i < 3; i++)
+   {
+      v8_store(w + 24 * i, v8_fmadd(l[i][2], p[6], v8_fmadd(l[i][1], p[3], l[i][0] * p[0])));
+      v8_store(w + 24 * i + 8, v8_fmadd(l[i][2], p[7], v8_fmadd(l[i][1], p[4], l[i][0] * p[1])));
+      v8_store(w + 24 * i + 16, v8_fmadd(l[i][2], p[8], v8_fmadd(l[i][1], p[5], l[i][0] * p[2])));
+   }
+   v8_store(w + 72, v8_fmadd(v[2], p[6], v8_fmadd(v[1], p[3], v[0] * p[0])) + p[9]);
+   v8_store(w + 80, v8_fmadd(v[2], p[7], v8_fmadd(v[1], p[4], v[0] * p[1])) + p[10]);
+   v8_store(w + 88, v8_fmadd(v[2], p[8], v8_fmadd(v[1], p[5], v[0] * p[2])) + p[11]);
+}
+
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+// World matrices for a transform hierarchy. The sample sets one World
+// matrix a frame; a scene of tens of thousands of nodes needs each node's
+// local transform concatenated with its parent's world matrix, every frame
+// something moved.
+//
+// build() lays the nodes out breadth first, parents before children. Every
+// level is padded to a multiple of 8 so update() can take 8 nodes of a level
+// at a time in vec8f: the local matrix from the quaternion and scale, the
+// parents' world rows gathered, 27 multiply-adds. Each group of 8 keeps its
+// local translation, rotation and scale one component after the other, 8
+// lanes each, and its world matrices (3x4, the last column is always
+// 0 0 0 1) likewise, so a group reads and writes one run of memory rather
+// than a stream per component; the parents of a group usually sit in one or
+// two groups, which a permute reads without a gather. The locals are also
+// kept in the order the nodes were added, so set_locals() is a copy rather
+// than a scatter into the breadth-first order; the full pass after it
+// gathers them from there, and the blocked arrays are only brought up to
+// date when an update takes the incremental path again.
+//
+// set_local() marks a node dirty. A node changes in update() when it is
+// dirty or its parent changed; a group of 8 whose nodes are clean and whose
+// parents' groups did not change is skipped without looking at its nodes,
+// so a frame that moves 1% of the nodes touches little more than those
+// nodes and their descendants. Past full_update_fraction of the nodes set
+// (and always after set_locals()) nearly every group changes anyway, and
+// update() recomputes them all in a straight pass without the flags.
+//
+// The levels above the first one with enough nodes are updated first; the
+// subtrees below are split into chunks of about equal size, each with its
+// own padded levels, which update() runs on a thread_pool with no barrier
+// between levels.
+
+#include "sr_math.h"
+#include "sr_simd.h"
+#include "sr_thread.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// Scale, then rotate, then translate
+struct local_transform
+{
+   float3 translation;
+   quaternion rotation;
+   float3 scale;
+};
+
+inline float4x4 local_matrix(const local_transform& t)
+{
+   float4x4 m = rotation_matrix(t.rotation);
+   for (int j = 0; j < 3; j++)
+   {
+      m.m[0][j] *= t.scale.x;
+      m.m[1][j] *= t.scale.y;
+      m.m[2][j] *= t.scale.z;
+   }
+   m.m[3][0] = t.translation.x;
+   m.m[3][1] = t.translation.y;
+   m.m[3][2] = t.translation.z;
+   return m;
+}
+
+struct hierarchy_stats
+{
+   int nodes = 0;
+   int levels = 0;
+   int chunks = 0;              // subtree chunks run in parallel
+   int padding = 0;             // empty slots that fill out the groups of 8
+   int dirty = 0;               // nodes that changed, with their descendants
+   int groups_updated = 0;      // groups of 8 recomputed
+   int groups_skipped = 0;      // groups with nothing dirty
+   bool full = false;           // every group recomputed without the flags
+};
+
+class transform_hierarchy
+{
+public:
+   // Subtree chunks to aim for; each holds at least one subtree, so fewer
+   // when the widest level has fewer nodes
+   static const int target_chunks = 64;
+
+   // Nodes set since the last update(), as a fraction of all, from which it
+   // recomputes every group: one set node per group of 8 on average
+   static constexpr float full_update_fraction = 0.125f;
+
+   // Adds a node under `parent`, or a root for -1, and returns its id. The
+   // parent must already exist
+   int add_node(int parent, const local_transform& local);
+   void clear();
+   size_t size() const { return parent_.size(); }
+
+   // Lays the nodes out; update() does it when nodes were added since
+   void build();
+
+   void set_local(int node, const local_transform& local);
+   local_transform get_local(int node) const;
+
+   // Every node's local, indexed by id: one copy, and update() recomputes
+   // everything in the full pass
+   void set_locals(const local_transform* locals);
+
+   // Recomputes the world matrices of the dirty nodes and their descendants,
+   // the subtree chunks on `pool` if one is given
+   void update(thread_pool* pool = nullptr);
+
+   // Valid after update()
+   float4x4 world(int node) const;
+
+   const hierarchy_stats& last_update() const { return stats_; }
+
+private:
+   struct span
+   {
+      uint32_t begin, end;      // slots, multiples of 8
+   };
+
+   struct chunk_counts
+   {
+      int dirty, updated, skipped;
+   };
+
+   void update_span(const span& s, bool full, chunk_counts& counts);
+   void update_group(uint32_t first, bool gather);
+   void refresh_locals();
+   uint32_t add_slot(int node);
+
+   // Per node id, in the order added
+   std::vector<int> parent_;
+   std::vector<local_transform> locals_;    // at id + 1, after an identity for the root and padding
+   std::vector<uint32_t> slot_of_;
+   bool built_ = false;
+
+   // Per slot
+   aligned_vector<int32_t> local_at_;       // the slot's local in locals_, in floats
+   aligned_vector<float> local_;            // per group of 8: tx ty tz, qx qy qz qw, sx sy sz, 8 lanes each
+   aligned_vector<float> world_;            // per group of 8: rows 0-3, columns 0-2, 8 lanes each
+   bool gather_locals_ = false;             // local_ behind locals_ since set_locals()
+   aligned_vector<int32_t> parent_slot_;    // slot 0 is an identity root above the roots
+   std::vector<int> node_of_slot_;          // -1 for padding
+   std::vector<uint8_t> dirty_;             // set since the last update
+   size_t dirty_count_ = 0;                 // of those, or every node after set_locals()
+   std::vector<uint8_t> changed_;           // recomputed by the last update
+   std::vector<uint8_t> group_dirty_;       // per group of 8
+   std::vector<uint8_t> group_changed_;
+
+   std::vector<span> top_;                  // levels above the chunks, in order
+   std::vector<span> chunk_spans_;          // each chunk's levels, in order
+   std::vector<uint32_t> chunk_first_;      // into chunk_spans_, one past the end at chunk + 1
+   std::vector<chunk_counts> chunk_counts_;
+   hierarchy_stats stats_;
+};
+
+}
@@ -0,0 +1,95 @@
+#include "sr_image.h"
+#include "sr_simd.h"
+
+#include <string.h>
+
+namespace sr
+{
+
+// src * opacity + dst * (1 - src alpha * opacity) on 8 pixels
+static SR_FORCEINLINE vec8i over8(vec8i dst, vec8i src, vec8f opacity)
+{
+   const vec8i byte = v8i_set1(0xff);
+   const vec8f to_unit = v8_set1(1.0f / 255.0f);
+   const vec8f inv = v8_set1(1.0f) - v8i_to_float(v8i_srli(src, 24)) * to_unit * opacity;
+   vec8i out = v8i_set1(0);
+   for (int c = 0; c < 4; c++)
+   {
+      const vec8f s = v8i_to_float(v8i_srli(src, c * 8) & byte);
+      const vec8f d = v8i_to_float(v8i_srli(dst, c * 8) & byte);
+      out = out | v8i_slli(v8_round_to_int(v8_fmadd(s, opacity, d * inv)), c * 8);
+   }
+   return out;
+}
+
+void blend_over(uint32_t* dst, const uint32_t* src, int count, float opacity)
+{
+   if (opacity <= 0.0f)
+      return;
+
+   // At full opacity, vectors of opaque source pixels are plain copies
+   const bool copy_opaque = opacity >= 1.0f;
+   const vec8f o = v8_set1(copy_opaque ? 1.0f : opacity);
+   const vec8i opaque_alpha = v8i_set1(0xff);
+   int i = 0;
+   for (; i + 8 <= count; i += 8)
+   {
+      const vec8i s = v8i_loadu(src + i);
+      if (copy_opaque && v8_movemask(v8i_as_float(v8i_cmpeq(v8i_srli(s, 24), opaque_alpha))) == 0xff)
+         v8i_storeu(dst + i, s);
+      else
+         v8i_storeu(dst + i, over8(v8i_loadu(dst + i), s, o));
+   }
+   if (i < count)
+   {
+      alignas(32) int32_t d[8], s[8];
+      memcpy(d, dst + i, (count - i) * sizeof(uint32_t));
+      memcpy(s, src + i, (count - i) * sizeof(uint32_t));
+      v8i_store(d, over8(v8i_load(d), v8i_load(s), o));
+      memcpy(dst + i, d, (count - i) * sizeof(uint32_t));
+   }
+}
+
+void blend_mask(uint32_t* dst, const uint8_t* alpha, int count, uint32_t color)
+{
+   const vec8i c = v8i_set1((int32_t)color);
+   const vec8f to_unit = v8_set1(1.0f / 255.0f);
+   int i = 0;
+   for (; i + 8 <= count; i += 8)
+   {
+      // Glyph and shape masks are mostly empty
+      uint64_t bits;
+      memcpy(&bits, alpha + i, sizeof(bits));
+      if (bits)
+         v8i_storeu(dst + i, over8(v8i_loadu(dst + i), c, v8i_to_float(v8i_load_u8(alpha + i)) * to_unit));
+   }
+   if (i < count)
+   {
+      alignas(8) uint8_t a[8] = {};
+      uint64_t bits = 0;
+      for (int k = 0; k < count - i; k++)
+      {
+         a[k] = alpha[i + k];
+         bits |= a[k];
+      }
+      if (!bits)
+         return;
+      alignas(32) int32_t d[8];
+      for (int k = 0; k < count - i; k++)
+         d[k] = (int32_t)dst[i + k];
+      v8i_store(d, over8(v8i_load(d), c, v8i_to_float(v8i_load_u8(a)) * to_unit));
+      for (int k = 0; k < count - i; k++)
+         dst[i + k] = (uint32_t)d[k];
+   }
+}
+
+void draw_image(image_rgba8& target, const image_rgba8& source, int x, int y, float opacity)
+{
+   const rect_i r = intersect(target.clip(), { x, y, x + source.width(), y + source.height() });
+   if (r.empty())
+      return;
+   for (int row = r.top; row < r.bottom; row++)
+      blend_over(target.row(row) + r.left, source.row(row - y) + (r.left - x), r.width(), opacity);
+}
+
+}
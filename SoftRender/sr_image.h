@@ -0,0 +1,182 @@
+#pragma once
+
+// Premultiplied RGBA8 surface for the 2D path: the CPU stand-in for the D2D
+// render target over m_pOffscreenTexture. Rows are padded to 8 pixels so span
+// kernels can run whole vectors; pixel (x, y) is at row(y)[x], and at
+// data()[y * pitch() + x] unless the image is a moved view.
+//
+// Like PushAxisAlignedClip, the clip rectangle limits every drawing call
+// (clear included) to part of the surface.
+
+#include "sr_common.h"
+
+#include <math.h>
+
+namespace sr
+{
+
+// Pixel rectangle, right and bottom exclusive
+struct rect_i
+{
+   int left, top, right, bottom;
+
+   int width() const { return right - left; }
+   int height() const { return bottom - top; }
+   bool empty() const { return right <= left || bottom <= top; }
+   int64_t area() const { return empty() ? 0 : (int64_t)width() * height(); }
+};
+
+// D2D1_RECT_F
+struct rect_f
+{
+   float left, top, right, bottom;
+};
+
+// Pixels a shape inside `r` can touch
+inline rect_i enclosing_pixels(const rect_f& r)
+{
+   return { (int)floorf(r.left), (int)floorf(r.top), (int)ceilf(r.right), (int)ceilf(r.bottom) };
+}
+
+inline rect_i intersect(const rect_i& a, const rect_i& b)
+{
+   return { a.left > b.left ? a.left : b.left, a.top > b.top ? a.top : b.top,
+            a.right < b.right ? a.right : b.right, a.bottom < b.bottom ? a.bottom : b.bottom };
+}
+
+// Smallest rectangle holding both; an empty side is ignored
+inline rect_i bounding_union(const rect_i& a, const rect_i& b)
+{
+   if (a.empty())
+      return b;
+   if (b.empty())
+      return a;
+   return { a.left < b.left ? a.left : b.left, a.top < b.top ? a.top : b.top,
+            a.right > b.right ? a.right : b.right, a.bottom > b.bottom ? a.bottom : b.bottom };
+}
+
+class image_rgba8
+{
+public:
+   image_rgba8() = default;
+   image_rgba8(int width, int height) { resize(width, height); }
+
+   // Another surface's pixels with a clip rectangle of its own, so several
+   // threads can draw into disjoint parts of one surface. `source` must
+   // outlive the view and not be resized while it is used
+   static image_rgba8 view(image_rgba8& source)
+   {
+      image_rgba8 v;
+      v.width_ = source.width_;
+      v.height_ = source.height_;
+      v.pitch_ = source.pitch_;
+      v.bounds_ = source.bounds_;
+      v.origin_ = source.origin_;
+      v.view_ = source.data();
+      v.reset_clip();
+      return v;
+   }
+
+   // `source` moved to (x, y): its pixel (0, 0) is the view's pixel (x, y)
+   // and the view's bounds are the source's, moved there. A small layer
+   // surface is drawn into in the coordinates of the surface it covers
+   static image_rgba8 view(image_rgba8& source, int x, int y)
+   {
+      image_rgba8 v;
+      v.width_ = x + source.width_;
+      v.height_ = y + source.height_;
+      v.pitch_ = source.pitch_;
+      v.bounds_ = { x, y, x + source.width_, y + source.height_ };
+      v.origin_ = (ptrdiff_t)y * (ptrdiff_t)source.pitch_ + x;
+      v.view_ = source.data();
+      v.reset_clip();
+      return v;
+   }
+
+   void resize(int width, int height)
+   {
+      view_ = nullptr;
+      width_ = width;
+      height_ = height;
+      pitch_ = (size_t)((width + 7) & ~7);
+      bounds_ = { 0, 0, width, height };
+      origin_ = 0;
+      pixels_.assign(pitch_ * height, 0);
+      reset_clip();
+   }
+
+   void clear(uint32_t color)
+   {
+      for (int y = clip_.top; y < clip_.bottom; y++)
+      {
+         uint32_t* p = row(y);
+         for (int x = clip_.left; x < clip_.right; x++)
+            p[x] = color;
+      }
+   }
+
+   int width() const { return width_; }
+   int height() const { return height_; }
+   size_t pitch() const { return pitch_; }
+   const rect_i& bounds() const { return bounds_; }
+
+   void set_clip(const rect_i& clip) { clip_ = intersect(clip, bounds()); }
+   void reset_clip() { clip_ = bounds(); }
+   const rect_i& clip() const { return clip_; }
+
+   // The pixel at the top left of bounds()
+   uint32_t* data() { return view_ ? view_ : pixels_.data(); }
+   const uint32_t* data() const { return view_ ? view_ : pixels_.data(); }
+   uint32_t* row(int y) { return data() + ((ptrdiff_t)y * (ptrdiff_t)pitch_ - origin_); }
+   const uint32_t* row(int y) const { return data() + ((ptrdiff_t)y * (ptrdiff_t)pitch_ - origin_); }
+   uint32_t at(int x, int y) const { return row(y)[x]; }
+
+private:
+   int width_ = 0;
+   int height_ = 0;
+   size_t pitch_ = 0;
+   rect_i bounds_ = { 0, 0, 0, 0 };
+   ptrdiff_t origin_ = 0;       // offset of pixel (0, 0) from data(), for a moved view
+   rect_i clip_ = { 0, 0, 0, 0 };
+   aligned_vector<uint32_t> pixels_;
+   uint32_t* view_ = nullptr;   // pixels of the surface this is a view of
+};
+
+// D2D1_COLOR_F: straight alpha, [0, 1]
+struct color_f
+{
+   float r, g, b, a;
+};
+
+// Packs a straight-alpha color in [0, 1] into premultiplied RGBA8
+inline uint32_t premultiplied_rgba8(float r, float g, float b, float a)
+{
+   const float s = a * 255.0f;
+   return (uint32_t)(r * s + 0.5f) | ((uint32_t)(g * s + 0.5f) << 8) |
+          ((uint32_t)(b * s + 0.5f) << 16) | ((uint32_t)(a * 255.0f + 0.5f) << 24);
+}
+
+inline uint32_t premultiplied_rgba8(const color_f& c)
+{
+   return premultiplied_rgba8(c.r, c.g, c.b, c.a);
+}
+
+// D2D1_EXTEND_MODE: what brushes show outside their gradient or bitmap
+enum class extend_mode
+{
+   clamp,
+   wrap,
+   mirror,
+};
+
+// Source-over of `count` premultiplied pixels scaled by `opacity`
+void blend_over(uint32_t* dst, const uint32_t* src, int count, float opacity = 1.0f);
+
+// Source-over of the premultiplied `color` through `count` 8-bit coverages
+void blend_mask(uint32_t* dst, const uint8_t* alpha, int count, uint32_t color);
+
+// DrawBitmap at a whole-pixel position without scaling: source-over of
+// `source` scaled by `opacity`
+void draw_image(image_rgba8& target, const image_rgba8& source, int x, int y, float opacity = 1.0f);
+
+}
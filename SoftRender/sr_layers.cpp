@@ -0,0 +1,352 @@
+#include "sr_layers.h"
+
+#include <algorithm>
+
+namespace sr
+{
+
+// Premultiplied color scaled by `alpha`, channel by channel
+static uint32_t scale_color(uint32_t color, float alpha)
+{
+   uint32_t out = 0;
+   for (int c = 0; c < 32; c += 8)
+      out |= (uint32_t)((float)((color >> c) & 0xff) * alpha + 0.5f) << c;
+   return out;
+}
+
+static size_t surface_bytes(const image_rgba8& image)
+{
+   return image.pitch() * image.height() * sizeof(uint32_t);
+}
+
+layer_compositor::layer_compositor(size_t pool_budget)
+   : pool_budget_(pool_budget)
+{
+}
+
+// ---------------------------------------------------------------------------
+// First pass
+
+void layer_compositor::analyze(const display_list& list, const rect_i& clip)
+{
+   const std::vector<draw_command>& commands = list.commands();
+   layers_.clear();
+   layer_of_push_.assign(commands.size(), -1);
+   stack_.clear();
+
+   for (size_t i = 0; i < commands.size(); i++)
+   {
+      const draw_command& c = commands[i];
+      if (c.kind == draw_kind::push_layer)
+      {
+         layer_info l = {};
+         l.push = i;
+         l.pop = commands.size();
+         l.parent = stack_.empty() ? -1 : stack_.back();
+         l.bounds = { 0, 0, 0, 0 };
+         l.foldable = true;
+         layer_of_push_[i] = (int)layers_.size();
+         stack_.push_back((int)layers_.size());
+         layers_.push_back(l);
+      }
+      else if (c.kind == draw_kind::pop_layer)
+      {
+         if (!stack_.empty())
+         {
+            close(stack_.back(), i, list);
+            stack_.pop_back();
+         }
+      }
+      else if (!stack_.empty())
+      {
+         // Text is not folded because its glyph quads may overlap, which a
+         // layer would blend once, and brushes have no color to scale
+         layer_info& l = layers_[stack_.back()];
+         l.bounds = bounding_union(l.bounds, intersect(c.bounds, clip));
+         l.primitives++;
+         l.foldable = l.foldable && (c.kind == draw_kind::fill_rect || c.kind == draw_kind::fill_geometry || c.kind == draw_kind::draw_image);
+      }
+   }
+   while (!stack_.empty())
+   {
+      close(stack_.back(), commands.size(), list);
+      stack_.pop_back();
+   }
+
+   // Parents come before their children, so their bounds are final first
+   for (layer_info& l : layers_)
+   {
+      if (l.parent >= 0)
+         l.bounds = intersect(l.bounds, layers_[l.parent].bounds);
+      const float opacity = commands[l.push].opacity;
+      if (opacity <= 0.0f || l.bounds.empty())
+         l.action = options_.shortcuts ? layer_action::skip : layer_action::composite;
+      else if (!options_.shortcuts)
+         l.action = layer_action::composite;
+      else if (opacity >= 1.0f)
+         l.action = layer_action::clip;
+      else if (l.primitives == 1 && l.foldable)
+         l.action = layer_action::fold;
+      else
+         l.action = layer_action::composite;
+   }
+}
+
+// Clips a finished layer to its content bounds and adds it to its parent.
+// Transparent layers add nothing
+void layer_compositor::close(int layer, size_t pop, const display_list& list)
+{
+   layer_info& l = layers_[layer];
+   const draw_command& push = list.commands()[l.push];
+   l.pop = pop;
+   l.bounds = intersect(l.bounds, push.bounds);
+   if (l.parent < 0 || push.opacity <= 0.0f || l.bounds.empty())
+      return;
+   layer_info& p = layers_[l.parent];
+   p.bounds = bounding_union(p.bounds, l.bounds);
+   p.primitives += l.primitives;
+   p.foldable = p.foldable && l.foldable;
+}
+
+// ---------------------------------------------------------------------------
+// Drawing
+
+void layer_compositor::render(image_rgba8& target, const display_list& list)
+{
+   const std::vector<draw_command>& commands = list.commands();
+   frame_ = layer_frame_stats();
+   stats_.frames++;
+   target_ = image_rgba8::view(target);
+   target_.set_clip(target.clip());
+   if (target_.clip().empty() || commands.empty())
+      return;
+
+   analyze(list, target_.clip());
+   rect_raster_.set_target_size(target.width(), target.height());
+   open_.clear();
+   for (size_t i = 0; i < commands.size(); i++)
+   {
+      const draw_command& c = commands[i];
+      if (c.kind == draw_kind::push_layer)
+      {
+         const int layer = layer_of_push_[i];
+         frame_.layers++;
+         if (layers_[layer].action == layer_action::skip)
+         {
+            frame_.skipped++;
+            i = layers_[layer].pop;
+            continue;
+         }
+         push(list, layer);
+      }
+      else if (c.kind == draw_kind::pop_layer)
+      {
+         if (!open_.empty() && layers_[open_.back().layer].pop == i)
+            pop(list);
+      }
+      else
+      {
+         image_rgba8& view = open_.empty() ? target_ : open_.back().view;
+         if (!intersect(c.bounds, view.clip()).empty())
+            draw(view, list, c, open_.empty() ? 1.0f : open_.back().alpha);
+      }
+   }
+   while (!open_.empty())
+      pop(list);
+
+   stats_.layers += (uint64_t)frame_.layers;
+   stats_.folded += (uint64_t)frame_.folded;
+   stats_.composited += (uint64_t)frame_.composited;
+   stats_.pool_misses += (uint64_t)frame_.pool_misses;
+   stats_.composited_pixels += (uint64_t)frame_.composited_pixels;
+   stats_.peak_bytes = std::max(stats_.peak_bytes, frame_.peak_bytes);
+   if (pool_bytes_ > pool_budget_)
+      evict(pool_budget_ - pool_budget_ / 4);
+}
+
+void layer_compositor::push(const display_list& list, int layer)
+{
+   const layer_info& l = layers_[layer];
+   image_rgba8& parent = open_.empty() ? target_ : open_.back().view;
+   const float parent_alpha = open_.empty() ? 1.0f : open_.back().alpha;
+
+   open_layer o;
+   o.layer = layer;
+   o.surface = nullptr;
+   o.alpha = parent_alpha;
+   switch (l.action)
+   {
+   case layer_action::clip:
+      frame_.clipped++;
+      o.view = image_rgba8::view(parent);
+      o.view.set_clip(l.bounds);
+      break;
+   case layer_action::fold:
+      frame_.folded++;
+      o.view = image_rgba8::view(parent);
+      o.view.set_clip(l.bounds);
+      o.alpha = parent_alpha * list.commands()[l.push].opacity;
+      break;
+   default:
+   {
+      // Everything drawn in the layer lands in `area`. Without fit_bounds
+      // that is all of the parent within the content bounds, and the surface
+      // is the size of the target
+      const rect_i area = options_.fit_bounds ? l.bounds : intersect(parent.clip(), list.commands()[l.push].bounds);
+      frame_.composited++;
+      if (options_.fit_bounds)
+      {
+         o.surface = acquire(area.width(), area.height());
+         o.view = image_rgba8::view(o.surface->image, area.left, area.top);
+      }
+      else
+      {
+         o.surface = acquire(target_.width(), target_.height());
+         o.view = image_rgba8::view(o.surface->image, 0, 0);
+      }
+      o.view.set_clip(area);
+      o.view.clear(0);
+      frame_.cleared_pixels += o.view.clip().area();
+      o.alpha = 1.0f;
+      break;
+   }
+   }
+   open_.push_back(std::move(o));
+}
+
+void layer_compositor::pop(const display_list& list)
+{
+   open_layer o = std::move(open_.back());
+   open_.pop_back();
+   if (!o.surface)
+      return;
+
+   image_rgba8& parent = open_.empty() ? target_ : open_.back().view;
+   const float opacity = list.commands()[layers_[o.layer].push].opacity * (open_.empty() ? 1.0f : open_.back().alpha);
+   const rect_i r = intersect(o.view.clip(), parent.clip());
+   for (int y = r.top; y < r.bottom; y++)
+      blend_over(parent.row(y) + r.left, o.view.row(y) + r.left, r.width(), opacity);
+   frame_.composited_pixels += r.area();
+   release(o.surface);
+}
+
+void layer_compositor::draw(image_rgba8& target, const display_list& list, const draw_command& c, float alpha)
+{
+   const uint32_t color = alpha < 1.0f ? scale_color(c.color, alpha) : c.color;
+   switch (c.kind)
+   {
+   case draw_kind::fill_rect:
+   {
+      const rect_f& r = c.rect;
+      const line_segment lines[4] = {
+         { r.left, r.top, r.right, r.top },
+         { r.right, r.top, r.right, r.bottom },
+         { r.right, r.bottom, r.left, r.bottom },
+         { r.left, r.bottom, r.left, r.top },
+      };
+      rect_raster_.rasterize(lines, 4, fill_mode::winding, rect_coverage_);
+      fill_coverage(target, rect_coverage_, color);
+      break;
+   }
+   case draw_kind::fill_geometry:
+      realizations_.fill(target, *c.geometry, c.transform, color);
+      break;
+   case draw_kind::draw_image:
+      sr::draw_image(target, *c.image, c.x, c.y, c.opacity * alpha);
+      break;
+   case draw_kind::fill_gradient:
+      sr::fill_rect(target, c.bounds, *c.gradient);
+      break;
+   case draw_kind::fill_bitmap:
+      sr::fill_rect(target, c.bounds, *c.bitmap);
+      break;
+   case draw_kind::draw_text:
+      text_.draw_text(target, list.text(c), c.text_length, c.format, c.rect, c.transform, color);
+      text_.flush();
+      break;
+   case draw_kind::push_layer:
+   case draw_kind::pop_layer:
+      break;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Surface pool
+
+layer_compositor::pooled_surface* layer_compositor::acquire(int width, int height)
+{
+   const int g = surface_granularity;
+   if (options_.fit_bounds)
+   {
+      width = (std::max(width, 1) + g - 1) / g * g;
+      height = (std::max(height, 1) + g - 1) / g * g;
+   }
+
+   // The smallest free surface that holds the layer without wasting more
+   // than its own size again
+   pooled_surface* best = nullptr;
+   if (options_.recycle)
+   {
+      const int64_t limit = 2 * (int64_t)width * height;
+      for (const std::unique_ptr<pooled_surface>& s : pool_)
+      {
+         const image_rgba8& image = s->image;
+         if (s->in_use || image.width() < width || image.height() < height || image.bounds().area() > limit)
+            continue;
+         if (!best || image.bounds().area() < best->image.bounds().area())
+            best = s.get();
+      }
+   }
+   if (best)
+   {
+      frame_.pool_hits++;
+   }
+   else
+   {
+      frame_.pool_misses++;
+      pool_.push_back(std::unique_ptr<pooled_surface>(new pooled_surface()));
+      best = pool_.back().get();
+      best->image.resize(width, height);
+      pool_bytes_ += surface_bytes(best->image);
+   }
+
+   best->in_use = true;
+   bytes_in_use_ += surface_bytes(best->image);
+   frame_.peak_bytes = std::max(frame_.peak_bytes, (int64_t)bytes_in_use_);
+   return best;
+}
+
+void layer_compositor::release(pooled_surface* s)
+{
+   bytes_in_use_ -= surface_bytes(s->image);
+   s->in_use = false;
+   s->last_used = ++clock_;
+   if (!options_.recycle)
+      evict(pool_bytes_ - surface_bytes(s->image));
+}
+
+// Frees unused surfaces, least recently used first, until the pool holds
+// `target` bytes or only surfaces in use
+void layer_compositor::evict(size_t target)
+{
+   std::stable_sort(pool_.begin(), pool_.end(), [](const std::unique_ptr<pooled_surface>& a, const std::unique_ptr<pooled_surface>& b) {
+      return a->last_used < b->last_used;
+   });
+   for (size_t i = 0; i < pool_.size() && pool_bytes_ > target;)
+   {
+      if (pool_[i]->in_use)
+      {
+         i++;
+         continue;
+      }
+      pool_bytes_ -= surface_bytes(pool_[i]->image);
+      pool_.erase(pool_.begin() + i);
+   }
+}
+
+void layer_compositor::trim()
+{
+   evict(0);
+}
+
+}
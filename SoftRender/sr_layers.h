@@ -0,0 +1,157 @@
+#pragma once
+
+// Opacity layers for a display list. D2D's PushLayer renders everything up
+// to PopLayer into an intermediate target the size of the render target and
+// then blends it back at the layer's opacity; a fade of one small panel
+// clears and composites a whole 4K surface. layer_compositor does less:
+//
+//  * A first pass matches pushes with pops and finds the pixels each layer
+//    actually draws: the bounds of its commands and child layers, within
+//    its content bounds and its parent's.
+//  * Layers that draw nothing or have zero opacity are skipped. Opaque
+//    layers are only a clip. A layer holding a single fill, geometry or
+//    image draws it straight into its parent with the opacity folded into
+//    the color or the image opacity; this goes for nested layers too.
+//  * Every other layer draws into a surface covering only its bounds, taken
+//    from a pool of recycled surfaces, through a view moved to the bounds so
+//    its commands draw at their own coordinates. The pop composites it with
+//    blend_over, the SIMD premultiplied source-over, at the layer opacity.
+//
+// Folding rounds once where compositing rounds twice, so a folded layer can
+// be a couple of steps away from the composited result in a channel.
+
+#include "sr_scene.h"
+
+#include <memory>
+#include <vector>
+
+namespace sr
+{
+
+struct layer_frame_stats
+{
+   int layers = 0;
+   int skipped = 0;                // empty or transparent
+   int clipped = 0;                // opaque, drawn as a clip
+   int folded = 0;                 // single primitive drawn with the opacity folded in
+   int composited = 0;             // drawn into an intermediate surface
+   int pool_hits = 0;
+   int pool_misses = 0;            // surfaces allocated
+   int64_t peak_bytes = 0;         // intermediate surfaces in use at once
+   int64_t cleared_pixels = 0;
+   int64_t composited_pixels = 0;
+};
+
+struct layer_stats
+{
+   uint64_t frames = 0;
+   uint64_t layers = 0;
+   uint64_t folded = 0;
+   uint64_t composited = 0;
+   uint64_t pool_misses = 0;
+   uint64_t composited_pixels = 0;
+   int64_t peak_bytes = 0;         // highest over all frames
+};
+
+class layer_compositor
+{
+public:
+   // Surface sizes are rounded up to this, so similar layers share surfaces
+   static const int surface_granularity = 64;
+
+   // The naive scheme turns them all off: a surface the size of the target
+   // for every layer, allocated and freed each time
+   struct options
+   {
+      bool shortcuts = true;       // skip, clip and fold where possible
+      bool fit_bounds = true;      // surfaces only as large as the layer draws
+      bool recycle = true;         // keep surfaces in the pool between layers and frames
+   };
+
+   // Unused surfaces beyond `pool_budget` bytes are freed after each frame,
+   // least recently used first
+   explicit layer_compositor(size_t pool_budget = 64u << 20);
+
+   void set_options(const options& o) { options_ = o; }
+   const options& get_options() const { return options_; }
+
+   // Draws `list` over `target`, within its clip rectangle. An unmatched
+   // pop_layer() is ignored; layers still open at the end are closed
+   void render(image_rgba8& target, const display_list& list);
+
+   // Frees every pooled surface
+   void trim();
+   size_t pool_bytes() const { return pool_bytes_; }
+
+   realization_cache& realizations() { return realizations_; }
+   text_renderer& text() { return text_; }
+
+   const layer_frame_stats& last_frame() const { return frame_; }
+   const layer_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = layer_stats(); }
+
+private:
+   enum class layer_action : uint8_t
+   {
+      skip,
+      clip,
+      fold,
+      composite,
+   };
+
+   // What the first pass found for a push_layer
+   struct layer_info
+   {
+      size_t push, pop;            // command indices; pop is the list size when unclosed
+      int parent;                  // index into layers_, -1 at the top
+      rect_i bounds;               // pixels drawn, in target coordinates
+      int primitives;              // drawing commands inside, nested layers included
+      bool foldable;               // all of them fills, geometries and images
+      layer_action action;
+   };
+
+   struct pooled_surface
+   {
+      image_rgba8 image;
+      bool in_use = false;
+      uint64_t last_used = 0;
+   };
+
+   // A layer being drawn
+   struct open_layer
+   {
+      int layer;
+      image_rgba8 view;            // what its contents draw into, clipped to the layer
+      pooled_surface* surface;     // composite only
+      float alpha;                 // opacity folded into its contents
+   };
+
+   void analyze(const display_list& list, const rect_i& clip);
+   void close(int layer, size_t pop, const display_list& list);
+   void draw(image_rgba8& target, const display_list& list, const draw_command& c, float alpha);
+   void push(const display_list& list, int layer);
+   void pop(const display_list& list);
+   pooled_surface* acquire(int width, int height);
+   void release(pooled_surface* s);
+   void evict(size_t target);
+
+   options options_;
+   size_t pool_budget_;
+   size_t pool_bytes_ = 0;
+   size_t bytes_in_use_ = 0;
+   uint64_t clock_ = 0;
+   std::vector<std::unique_ptr<pooled_surface>> pool_;
+   std::vector<layer_info> layers_;
+   std::vector<int> layer_of_push_;     // per command: index into layers_ for a push, else -1
+   std::vector<int> stack_;
+   std::vector<open_layer> open_;
+   image_rgba8 target_;                 // view of the target being drawn
+   realization_cache realizations_;
+   text_renderer text_;
+   strip_rasterizer rect_raster_;
+   coverage_strips rect_coverage_;
+   layer_frame_stats frame_;
+   layer_stats stats_;
+};
+
+}
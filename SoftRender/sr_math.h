@@ -0,0 +1,450 @@
+#pragma once
+
+// Vector/matrix math for the software path, in place of the scalar helpers
+// of DXGISample/d3dmath.h and the D3DX types under them.
+//
+// Same layout and conventions as D3DXMATRIX: row-major storage, row vectors
+// (v * M), so a World * View * Projection chain is concatenated left to
+// right. float3x2 is the 2D counterpart used by D2D.
+//
+// 4x4 products, transforms and inverses run one row per vec4f (sr_simd.h:
+// SSE2, AVX2 with FMA, NEON or scalar), quaternion dot products and
+// interpolation one quaternion per vec4f. 3-vectors stay scalar: they fill
+// three lanes of four and every dot product needs a horizontal add, so the
+// D3DVec3 functions give d3dmath.h's bits.
+//
+// Whatever needs no square root, trigonometry or SIMD is constexpr; the
+// rest has compile-time versions in sr_constexpr.h.
+
+#include "sr_simd.h"
+
+#include <float.h>
+#include <math.h>
+
+namespace sr
+{
+
+struct float2
+{
+   float x, y;
+};
+
+struct float3
+{
+   float x, y, z;
+};
+
+struct float4
+{
+   float x, y, z, w;
+};
+
+struct float4x4
+{
+   float m[4][4];
+};
+
+// D3DXQUATERNION: x, y, z imaginary, w real
+struct quaternion
+{
+   float x, y, z, w;
+};
+
+// ---------------------------------------------------------------------------
+// float3: the D3DVec3 helpers
+
+constexpr float3 add(const float3& a, const float3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+constexpr float3 sub(const float3& a, const float3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+constexpr float3 scale(const float3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+constexpr float dot(const float3& a, const float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr float length_sq(const float3& a) { return dot(a, a); }
+
+constexpr float3 cross(const float3& a, const float3& b)
+{
+   return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+// Same as D3DVec3Normalize: returned as is within FLT_EPSILON of unit length
+// squared, zero when the length squared is FLT_MIN or less
+inline float3 normalize(const float3& a)
+{
+   const float f = length_sq(a);
+   const float d = f - 1.0f;
+   if (-FLT_EPSILON <= d && d <= FLT_EPSILON)
+      return a;
+   if (f > FLT_MIN)
+   {
+      const float l = sqrtf(f);
+      return { a.x / l, a.y / l, a.z / l };
+   }
+   return { 0.0f, 0.0f, 0.0f };
+}
+
+// ---------------------------------------------------------------------------
+// float4x4
+
+constexpr float4x4 identity4x4()
+{
+   float4x4 r = {};
+   r.m[0][0] = r.m[1][1] = r.m[2][2] = r.m[3][3] = 1.0f;
+   return r;
+}
+
+// Row i of a * b is a's row i weighting b's rows, summed in the order the
+// scalar product does
+inline float4x4 mul(const float4x4& a, const float4x4& b)
+{
+   const vec4f b0 = v4_loadu(b.m[0]), b1 = v4_loadu(b.m[1]), b2 = v4_loadu(b.m[2]), b3 = v4_loadu(b.m[3]);
+   float4x4 r;
+   for (int i = 0; i < 4; i++)
+   {
+      const vec4f ai = v4_loadu(a.m[i]);
+      vec4f t = v4_splat<0>(ai) * b0;
+      t = v4_fmadd(v4_splat<1>(ai), b1, t);
+      t = v4_fmadd(v4_splat<2>(ai), b2, t);
+      v4_storeu(r.m[i], v4_fmadd(v4_splat<3>(ai), b3, t));
+   }
+   return r;
+}
+
+inline float4 transform(const float4& v, const float4x4& m)
+{
+   vec4f t = v4_set1(v.x) * v4_loadu(m.m[0]);
+   t = v4_fmadd(v4_set1(v.y), v4_loadu(m.m[1]), t);
+   t = v4_fmadd(v4_set1(v.z), v4_loadu(m.m[2]), t);
+   t = v4_fmadd(v4_set1(v.w), v4_loadu(m.m[3]), t);
+   float4 r;
+   v4_storeu(&r.x, t);
+   return r;
+}
+
+// (p, 1) * M, rounded as p.x*m0 + p.y*m1 + p.z*m2 + m3 written out in
+// scalar code: in that order without FMA, and with it fused the way gcc
+// contracts that expression, so a loop, transform_point and transform_points
+// give the same bits
+inline float4 transform_point(const float3& p, const float4x4& m)
+{
+   vec4f t = v4_set1(p.y) * v4_loadu(m.m[1]);
+   t = v4_fmadd(v4_set1(p.x), v4_loadu(m.m[0]), t);
+   t = v4_fmadd(v4_set1(p.z), v4_loadu(m.m[2]), t);
+   float4 r;
+   v4_storeu(&r.x, t + v4_loadu(m.m[3]));
+   return r;
+}
+
+inline float4x4 transpose(const float4x4& m)
+{
+   vec4f r0 = v4_loadu(m.m[0]), r1 = v4_loadu(m.m[1]), r2 = v4_loadu(m.m[2]), r3 = v4_loadu(m.m[3]);
+   v4_transpose(r0, r1, r2, r3);
+   float4x4 r;
+   v4_storeu(r.m[0], r0);
+   v4_storeu(r.m[1], r1);
+   v4_storeu(r.m[2], r2);
+   v4_storeu(r.m[3], r3);
+   return r;
+}
+
+// 2x2 blocks packed as (m00, m01, m10, m11): a * b, adj(a) * b, a * adj(b)
+SR_FORCEINLINE vec4f mul2x2(vec4f a, vec4f b)
+{
+   return a * v4_shuffle<0, 3, 0, 3>(b, b) + v4_shuffle<1, 0, 3, 2>(a, a) * v4_shuffle<2, 1, 2, 1>(b, b);
+}
+
+SR_FORCEINLINE vec4f adj_mul2x2(vec4f a, vec4f b)
+{
+   return v4_shuffle<3, 3, 0, 0>(a, a) * b - v4_shuffle<1, 1, 2, 2>(a, a) * v4_shuffle<2, 3, 0, 1>(b, b);
+}
+
+SR_FORCEINLINE vec4f mul_adj2x2(vec4f a, vec4f b)
+{
+   return a * v4_shuffle<3, 0, 3, 0>(b, b) - v4_shuffle<1, 0, 3, 2>(a, a) * v4_shuffle<2, 1, 2, 1>(b, b);
+}
+
+// Like D3DXMatrixInverse: false (and `out` untouched) when singular. The
+// matrix is split into 2x2 blocks A B / C D and inverted blockwise, which
+// needs six 2x2 products and one division instead of 16 cofactors
+inline bool invert(const float4x4& m, float4x4& out, float* determinant = nullptr)
+{
+   const vec4f r0 = v4_loadu(m.m[0]), r1 = v4_loadu(m.m[1]), r2 = v4_loadu(m.m[2]), r3 = v4_loadu(m.m[3]);
+   const vec4f a = v4_shuffle<0, 1, 0, 1>(r0, r1), b = v4_shuffle<2, 3, 2, 3>(r0, r1);
+   const vec4f c = v4_shuffle<0, 1, 0, 1>(r2, r3), d = v4_shuffle<2, 3, 2, 3>(r2, r3);
+
+   // Determinants of A, B, C and D in one go
+   const vec4f det_sub = v4_shuffle<0, 2, 0, 2>(r0, r2) * v4_shuffle<1, 3, 1, 3>(r1, r3) -
+                         v4_shuffle<1, 3, 1, 3>(r0, r2) * v4_shuffle<0, 2, 0, 2>(r1, r3);
+   const vec4f det_a = v4_splat<0>(det_sub), det_b = v4_splat<1>(det_sub);
+   const vec4f det_c = v4_splat<2>(det_sub), det_d = v4_splat<3>(det_sub);
+
+   const vec4f d_c = adj_mul2x2(d, c);
+   const vec4f a_b = adj_mul2x2(a, b);
+   vec4f x = det_d * a - mul2x2(b, d_c);
+   vec4f w = det_a * d - mul2x2(c, a_b);
+   vec4f y = det_b * c - mul_adj2x2(d, a_b);
+   vec4f z = det_c * b - mul_adj2x2(a, d_c);
+
+   // |M| = |A||D| + |B||C| - tr(adj(A) B adj(D) C)
+   const float det = v4_x(det_a * det_d + det_b * det_c) - v4_hsum(a_b * v4_shuffle<0, 2, 1, 3>(d_c, d_c));
+   if (determinant)
+      *determinant = det;
+   if (det == 0.0f || !isfinite(det))
+      return false;
+
+   const vec4f r = v4_set(1.0f, -1.0f, -1.0f, 1.0f) / v4_set1(det);
+   x = x * r;
+   y = y * r;
+   z = z * r;
+   w = w * r;
+   v4_storeu(out.m[0], v4_shuffle<3, 1, 3, 1>(x, y));
+   v4_storeu(out.m[1], v4_shuffle<2, 0, 2, 0>(x, y));
+   v4_storeu(out.m[2], v4_shuffle<3, 1, 3, 1>(z, w));
+   v4_storeu(out.m[3], v4_shuffle<2, 0, 2, 0>(z, w));
+   return true;
+}
+
+// Same matrix as D3DMatrixRotationY: radians, clockwise looking down +y
+inline float4x4 rotation_y(float angle)
+{
+   const float s = sinf(angle), c = cosf(angle);
+   return { { { c, 0.0f, -s, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { s, 0.0f, c, 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+}
+
+// Same matrix as D3DMatrixLookAtLH: +z towards `at`, +y towards `up`
+inline float4x4 look_at_lh(const float3& eye, const float3& at, const float3& up)
+{
+   const float3 z = normalize(sub(at, eye));
+   const float3 x = normalize(cross(up, z));
+   const float3 y = cross(z, x);
+   return { { { x.x, y.x, z.x, 0.0f }, { x.y, y.y, z.y, 0.0f }, { x.z, y.z, z.z, 0.0f }, { -dot(x, eye), -dot(y, eye), -dot(z, eye), 1.0f } } };
+}
+
+// Same matrix as D3DMatrixPerspectiveFovLH: clip z in [0, w], w = view z
+inline float4x4 perspective_fov_lh(float fovy, float aspect, float zn, float zf)
+{
+   const float h = cosf(0.5f * fovy) / sinf(0.5f * fovy);
+   const float q = zf / (zf - zn);
+   return { { { h / aspect, 0.0f, 0.0f, 0.0f }, { 0.0f, h, 0.0f, 0.0f }, { 0.0f, 0.0f, q, 1.0f }, { 0.0f, 0.0f, -q * zn, 0.0f } } };
+}
+
+// Same matrix as D3DXMatrixOrthoLH: a w x h view volume centered on the z axis
+constexpr float4x4 ortho_lh(float w, float h, float zn, float zf)
+{
+   float4x4 r = {};
+   r.m[0][0] = 2.0f / w;
+   r.m[1][1] = 2.0f / h;
+   r.m[2][2] = 1.0f / (zf - zn);
+   r.m[3][2] = zn / (zn - zf);
+   r.m[3][3] = 1.0f;
+   return r;
+}
+
+// Same matrix as D3DXMatrixOrthoOffCenterLH. (0, width, height, 0, 0, 1)
+// maps pixel coordinates, y down, to clip space for UI drawing
+constexpr float4x4 ortho_off_center_lh(float l, float r, float b, float t, float zn, float zf)
+{
+   float4x4 m = {};
+   m.m[0][0] = 2.0f / (r - l);
+   m.m[1][1] = 2.0f / (t - b);
+   m.m[2][2] = 1.0f / (zf - zn);
+   m.m[3][0] = (l + r) / (l - r);
+   m.m[3][1] = (t + b) / (b - t);
+   m.m[3][2] = zn / (zn - zf);
+   m.m[3][3] = 1.0f;
+   return m;
+}
+
+// ---------------------------------------------------------------------------
+// Batches
+
+// (p, 1) * M for `count` points, one per vec4f, two at a time, rounded as
+// transform_point rounds. About as fast as the scalar loop, which compilers
+// vectorize the same way; positions split into x, y and z arrays go through
+// transform_positions_soa (sr_vertex.h) 8 at a time, a third faster
+inline void transform_points(const float3* in, size_t count, const float4x4& m, float4* out)
+{
+   const vec4f m0 = v4_loadu(m.m[0]), m1 = v4_loadu(m.m[1]), m2 = v4_loadu(m.m[2]), m3 = v4_loadu(m.m[3]);
+   size_t i = 0;
+   for (; i + 2 <= count; i += 2)
+   {
+      const vec4f p = v4_load3(&in[i].x), q = v4_load3(&in[i + 1].x);
+      const vec4f a = v4_fmadd(v4_splat<2>(p), m2, v4_fmadd(v4_splat<0>(p), m0, v4_splat<1>(p) * m1));
+      const vec4f b = v4_fmadd(v4_splat<2>(q), m2, v4_fmadd(v4_splat<0>(q), m0, v4_splat<1>(q) * m1));
+      v4_storeu(&out[i].x, a + m3);
+      v4_storeu(&out[i + 1].x, b + m3);
+   }
+   if (i < count)
+   {
+      const vec4f p = v4_load3(&in[i].x);
+      v4_storeu(&out[i].x, v4_fmadd(v4_splat<2>(p), m2, v4_fmadd(v4_splat<0>(p), m0, v4_splat<1>(p) * m1)) + m3);
+   }
+}
+
+// (v, 0) * M, w dropped: directions, and normals with the inverse transpose
+inline void transform_vectors(const float3* in, size_t count, const float4x4& m, float3* out)
+{
+   const vec4f m0 = v4_loadu(m.m[0]), m1 = v4_loadu(m.m[1]), m2 = v4_loadu(m.m[2]);
+   for (size_t i = 0; i < count; i++)
+   {
+      const vec4f v = v4_load3(&in[i].x);
+      v4_store3(&out[i].x, v4_fmadd(v4_splat<2>(v), m2, v4_fmadd(v4_splat<0>(v), m0, v4_splat<1>(v) * m1)));
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Quaternions, as D3DXQUATERNION: unit length for rotations
+
+constexpr quaternion identity_quaternion()
+{
+   return { 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+// D3DXQuaternionRotationAxis: radians about `axis`, which need not be unit
+inline quaternion rotation_quaternion(const float3& axis, float angle)
+{
+   const float3 a = normalize(axis);
+   const float s = sinf(0.5f * angle), c = cosf(0.5f * angle);
+   return { a.x * s, a.y * s, a.z * s, c };
+}
+
+// D3DXQuaternionMultiply: the rotation a then b, the Hamilton product b a.
+// Each lane takes a different permutation of a with different signs, which
+// costs more in shuffles than the 16 scalar products
+inline quaternion mul(const quaternion& a, const quaternion& b)
+{
+   return {
+      b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+      b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+      b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+      b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z,
+   };
+}
+
+inline float dot(const quaternion& a, const quaternion& b)
+{
+   return v4_hsum(v4_loadu(&a.x) * v4_loadu(&b.x));
+}
+
+inline quaternion normalize(const quaternion& q)
+{
+   const vec4f v = v4_loadu(&q.x);
+   const float l = sqrtf(v4_hsum(v * v));
+   quaternion r;
+   v4_storeu(&r.x, l > 0.0f ? v / v4_set1(l) : v4_set(0.0f, 0.0f, 0.0f, 1.0f));
+   return r;
+}
+
+// D3DXQuaternionSlerp: the shorter arc from a (t = 0) to b (t = 1). Close
+// rotations, where sin(angle) loses precision, are interpolated linearly
+inline quaternion slerp(const quaternion& a, const quaternion& b, float t)
+{
+   float c = dot(a, b);
+   const float sign = c < 0.0f ? -1.0f : 1.0f;
+   c *= sign;
+   float ka, kb;
+   if (c > 0.9995f)
+   {
+      ka = 1.0f - t;
+      kb = t;
+   }
+   else
+   {
+      const float angle = acosf(c), s = 1.0f / sinf(angle);
+      ka = sinf((1.0f - t) * angle) * s;
+      kb = sinf(t * angle) * s;
+   }
+   quaternion r;
+   v4_storeu(&r.x, v4_fmadd(v4_set1(ka), v4_loadu(&a.x), v4_set1(kb * sign) * v4_loadu(&b.x)));
+   return c > 0.9995f ? normalize(r) : r;
+}
+
+// D3DXMatrixRotationQuaternion: v * M rotates v as q does
+inline float4x4 rotation_matrix(const quaternion& q)
+{
+   const float x2 = q.x + q.x, y2 = q.y + q.y, z2 = q.z + q.z;
+   const float xx = q.x * x2, yy = q.y * y2, zz = q.z * z2;
+   const float xy = q.x * y2, xz = q.x * z2, yz = q.y * z2;
+   const float wx = q.w * x2, wy = q.w * y2, wz = q.w * z2;
+   float4x4 r;
+   v4_storeu(r.m[0], v4_set(1.0f - (yy + zz), xy + wz, xz - wy, 0.0f));
+   v4_storeu(r.m[1], v4_set(xy - wz, 1.0f - (xx + zz), yz + wx, 0.0f));
+   v4_storeu(r.m[2], v4_set(xz + wy, yz - wx, 1.0f - (xx + yy), 0.0f));
+   v4_storeu(r.m[3], v4_set(0.0f, 0.0f, 0.0f, 1.0f));
+   return r;
+}
+
+// v rotated by the unit quaternion q: v + w t + u x t with t = 2 u x v
+inline float3 rotate(const float3& v, const quaternion& q)
+{
+   const float3 u = { q.x, q.y, q.z };
+   const float3 t = scale(cross(u, v), 2.0f);
+   return add(add(v, scale(t, q.w)), cross(u, t));
+}
+
+// ---------------------------------------------------------------------------
+// 2D
+
+// D2D1_MATRIX_3X2_F: the row vector (x, y, 1) times
+// | m11 m12 |
+// | m21 m22 |
+// | dx  dy  |
+struct float3x2
+{
+   float m11, m12, m21, m22, dx, dy;
+};
+
+constexpr float3x2 identity3x2()
+{
+   return { 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f };
+}
+
+constexpr float3x2 translation3x2(float x, float y)
+{
+   return { 1.0f, 0.0f, 0.0f, 1.0f, x, y };
+}
+
+constexpr float3x2 scale3x2(float sx, float sy, const float2& center = { 0.0f, 0.0f })
+{
+   return { sx, 0.0f, 0.0f, sy, center.x - sx * center.x, center.y - sy * center.y };
+}
+
+// Same as D2D1::Matrix3x2F::Rotation: degrees, clockwise on a y-down target
+inline float3x2 rotation3x2(float degrees, const float2& center = { 0.0f, 0.0f })
+{
+   const float r = degrees * (3.14159265358979f / 180.0f);
+   const float c = cosf(r), s = sinf(r);
+   return { c, s, -s, c, center.x - c * center.x + s * center.y, center.y - s * center.x - c * center.y };
+}
+
+// a then b
+constexpr float3x2 mul(const float3x2& a, const float3x2& b)
+{
+   return {
+      a.m11 * b.m11 + a.m12 * b.m21,
+      a.m11 * b.m12 + a.m12 * b.m22,
+      a.m21 * b.m11 + a.m22 * b.m21,
+      a.m21 * b.m12 + a.m22 * b.m22,
+      a.dx * b.m11 + a.dy * b.m21 + b.dx,
+      a.dx * b.m12 + a.dy * b.m22 + b.dy,
+   };
+}
+
+constexpr float2 transform_point(const float2& p, const float3x2& m)
+{
+   return { p.x * m.m11 + p.y * m.m21 + m.dx, p.x * m.m12 + p.y * m.m22 + m.dy };
+}
+
+// Same as D2D1InvertMatrix: false (and `out` untouched) when singular
+inline bool invert(const float3x2& m, float3x2& out)
+{
+   const float det = m.m11 * m.m22 - m.m12 * m.m21;
+   if (det == 0.0f || !isfinite(det))
+      return false;
+   const float r = 1.0f / det;
+   out = {
+      m.m22 * r, -m.m12 * r,
+      -m.m21 * r, m.m11 * r,
+      (m.m21 * m.dy - m.m22 * m.dx) * r, (m.m12 * m.dx - m.m11 * m.dy) * r,
+   };
+   return true;
+}
+
+}
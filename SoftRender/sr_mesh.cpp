@@ -0,0 +1,684 @@
+#include "sr_mesh.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <type_traits>
+#include <unordered_map>
+
+#if defined(_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sr
+{
+
+static FILE* open_file(const char* path, const char* mode)
+{
+#if defined(_MSC_VER)
+   FILE* f = nullptr;
+   return fopen_s(&f, path, mode) == 0 ? f : nullptr;
+#else
+   return fopen(path, mode);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// OBJ
+
+// Indices into the v, vt and vn lists, -1 when the corner has none
+struct obj_corner
+{
+   int32_t v, t, n;
+
+   bool operator==(const obj_corner& o) const { return v == o.v && t == o.t && n == o.n; }
+};
+
+struct obj_corner_hash
+{
+   size_t operator()(const obj_corner& c) const
+   {
+      return (size_t)((uint32_t)c.v * 73856093u ^ (uint32_t)c.t * 19349663u ^ (uint32_t)c.n * 83492791u);
+   }
+};
+
+static const char* skip_blanks(const char* p)
+{
+   while (*p == ' ' || *p == '\t' || *p == '\r')
+      p++;
+   return p;
+}
+
+static const char* next_line(const char* p)
+{
+   while (*p && *p != '\n')
+      p++;
+   return *p ? p + 1 : p;
+}
+
+static const char* parse_floats(const char* p, float* out, int count)
+{
+   for (int i = 0; i < count; i++)
+   {
+      char* end;
+      out[i] = strtof(p, &end);
+      p = end;
+   }
+   return p;
+}
+
+// 1-based, or negative counting back from `count`; -1 for 0 or nothing
+static const char* parse_index(const char* p, size_t count, int32_t& out)
+{
+   char* end;
+   const long i = strtol(p, &end, 10);
+   out = i > 0 ? (int32_t)(i - 1) : i < 0 ? (int32_t)((long)count + i) : -1;
+   return end;
+}
+
+bool parse_obj(const char* text, mesh_data& out)
+{
+   std::vector<float3> v, vn;
+   std::vector<float2> vt;
+   std::vector<obj_corner> corners;
+   std::vector<obj_corner> face;
+
+   for (const char* p = text; *p; p = next_line(p))
+   {
+      p = skip_blanks(p);
+      if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+      {
+         float3 f;
+         parse_floats(p + 2, &f.x, 3);
+         v.push_back(f);
+      }
+      else if (p[0] == 'v' && p[1] == 't')
+      {
+         float2 f;
+         parse_floats(p + 2, &f.x, 2);
+         vt.push_back(f);
+      }
+      else if (p[0] == 'v' && p[1] == 'n')
+      {
+         float3 f;
+         parse_floats(p + 2, &f.x, 3);
+         vn.push_back(f);
+      }
+      else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+      {
+         face.clear();
+         p = skip_blanks(p + 2);
+         while (*p && *p != '\n')
+         {
+            obj_corner c = { -1, -1, -1 };
+            const char* q = parse_index(p, v.size(), c.v);
+            if (q == p)
+               return false;
+            if (*q == '/')
+            {
+               q++;
+               if (*q != '/')
+                  q = parse_index(q, vt.size(), c.t);
+               if (*q == '/')
+                  q = parse_index(q + 1, vn.size(), c.n);
+            }
+            face.push_back(c);
+            p = skip_blanks(q);
+         }
+         for (size_t i = 2; i < face.size(); i++)
+            corners.insert(corners.end(), { face[0], face[i - 1], face[i] });
+      }
+   }
+
+   // Welded on the attributes every corner has
+   bool has_uv = !vt.empty(), has_normal = !vn.empty();
+   for (const obj_corner& c : corners)
+   {
+      if (c.v < 0 || (size_t)c.v >= v.size())
+         return false;
+      has_uv = has_uv && c.t >= 0 && (size_t)c.t < vt.size();
+      has_normal = has_normal && c.n >= 0 && (size_t)c.n < vn.size();
+   }
+
+   // z negated: OBJ's right-handed counter-clockwise faces become D3D's
+   // left-handed clockwise ones. v flipped to the top-left texture origin
+   out = mesh_data();
+   out.indices.resize(corners.size());
+   std::unordered_map<obj_corner, uint32_t, obj_corner_hash> welded;
+   welded.reserve(corners.size());
+   for (size_t i = 0; i < corners.size(); i++)
+   {
+      obj_corner c = corners[i];
+      c.t = has_uv ? c.t : -1;
+      c.n = has_normal ? c.n : -1;
+      auto r = welded.insert({ c, (uint32_t)out.positions.size() });
+      if (r.second)
+      {
+         const float3& p = v[c.v];
+         out.positions.push_back({ p.x, p.y, -p.z });
+         if (has_uv)
+            out.uvs.push_back({ vt[c.t].x, 1.0f - vt[c.t].y });
+         if (has_normal)
+            out.normals.push_back({ vn[c.n].x, vn[c.n].y, -vn[c.n].z });
+      }
+      out.indices[i] = r.first->second;
+   }
+   return true;
+}
+
+bool load_obj(const char* path, mesh_data& out)
+{
+   FILE* f = open_file(path, "rb");
+   if (!f)
+      return false;
+   std::vector<char> text;
+   char buffer[65536];
+   size_t n;
+   while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+      text.insert(text.end(), buffer, buffer + n);
+   fclose(f);
+   text.push_back('\0');
+   return parse_obj(text.data(), out);
+}
+
+// ---------------------------------------------------------------------------
+// Vertex cache
+
+// Forsyth's scores for an LRU cache of 32: the last triangle's vertices a
+// flat 0.75, the rest falling off with their position, plus a boost for
+// vertices with few triangles left so they are finished off
+static const int forsyth_cache_size = 32;
+static const int forsyth_valence_table = 32;
+
+static float forsyth_score(const float* cache_scores, const float* valence_scores, int position, uint32_t live)
+{
+   if (!live)
+      return -1.0f;
+   const float valence = live < (uint32_t)forsyth_valence_table ? valence_scores[live] : 2.0f / sqrtf((float)live);
+   return (position >= 0 ? cache_scores[position] : 0.0f) + valence;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count)
+{
+   const size_t triangle_count = index_count / 3;
+   if (!triangle_count)
+      return;
+
+   float cache_scores[forsyth_cache_size], valence_scores[forsyth_valence_table];
+   for (int i = 0; i < forsyth_cache_size; i++)
+      cache_scores[i] = i < 3 ? 0.75f : powf(1.0f - (float)(i - 3) / (forsyth_cache_size - 3), 1.5f);
+   for (int i = 0; i < forsyth_valence_table; i++)
+      valence_scores[i] = i ? 2.0f / sqrtf((float)i) : 0.0f;
+
+   // Triangles of each vertex; the first live[v] are the ones not emitted yet
+   std::vector<uint32_t> live(vertex_count, 0), first(vertex_count + 1, 0);
+   for (size_t i = 0; i < triangle_count * 3; i++)
+      live[indices[i]]++;
+   for (size_t v = 0; v < vertex_count; v++)
+      first[v + 1] = first[v] + live[v];
+   std::vector<uint32_t> adjacency(triangle_count * 3), fill(first.begin(), first.end() - 1);
+   for (size_t i = 0; i < triangle_count * 3; i++)
+      adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+
+   std::vector<int8_t> position(vertex_count, -1);
+   std::vector<float> vertex_score(vertex_count);
+   for (size_t v = 0; v < vertex_count; v++)
+      vertex_score[v] = forsyth_score(cache_scores, valence_scores, -1, live[v]);
+   std::vector<uint8_t> emitted(triangle_count, 0);
+   size_t best = 0;
+   float best_score = -1.0f;
+   for (size_t t = 0; t < triangle_count; t++)
+   {
+      const uint32_t* tri = indices + 3 * t;
+      const float s = vertex_score[tri[0]] + vertex_score[tri[1]] + vertex_score[tri[2]];
+      if (s > best_score)
+      {
+         best_score = s;
+         best = t;
+      }
+   }
+
+   std::vector<uint32_t> out(triangle_count * 3);
+   uint32_t cache[forsyth_cache_size + 3];
+   int cache_count = 0;
+   size_t cursor = 0;
+   for (size_t e = 0; e < triangle_count; e++)
+   {
+      // No scored triangle next to the cache: the next one in input order
+      if (best == SIZE_MAX)
+      {
+         while (emitted[cursor])
+            cursor++;
+         best = cursor;
+      }
+      const uint32_t* tri = indices + 3 * best;
+      memcpy(&out[3 * e], tri, 3 * sizeof(uint32_t));
+      emitted[best] = 1;
+      for (int k = 0; k < 3; k++)
+      {
+         uint32_t* list = &adjacency[first[tri[k]]];
+         uint32_t& n = live[tri[k]];
+         for (uint32_t j = 0; j < n; j++)
+         {
+            if (list[j] == best)
+            {
+               list[j] = list[--n];
+               break;
+            }
+         }
+      }
+
+      // The triangle's vertices to the front; whatever falls past the end
+      // leaves the cache
+      uint32_t next[forsyth_cache_size + 3];
+      int count = 0;
+      for (int k = 0; k < 3; k++)
+         next[count++] = tri[k];
+      for (int c = 0; c < cache_count; c++)
+         if (cache[c] != tri[0] && cache[c] != tri[1] && cache[c] != tri[2])
+            next[count++] = cache[c];
+      for (int c = 0; c < count; c++)
+      {
+         const uint32_t v = next[c];
+         position[v] = (int8_t)(c < forsyth_cache_size ? c : -1);
+         vertex_score[v] = forsyth_score(cache_scores, valence_scores, position[v], live[v]);
+      }
+
+      best = SIZE_MAX;
+      best_score = -1.0f;
+      for (int c = 0; c < count; c++)
+      {
+         const uint32_t v = next[c];
+         for (uint32_t j = 0; j < live[v]; j++)
+         {
+            const uint32_t t = adjacency[first[v] + j];
+            const uint32_t* u = indices + 3 * t;
+            const float s = vertex_score[u[0]] + vertex_score[u[1]] + vertex_score[u[2]];
+            if (s > best_score)
+            {
+               best_score = s;
+               best = t;
+            }
+         }
+      }
+      cache_count = count < forsyth_cache_size ? count : forsyth_cache_size;
+      memcpy(cache, next, cache_count * sizeof(uint32_t));
+   }
+   memcpy(indices, out.data(), out.size() * sizeof(uint32_t));
+}
+
+void optimize_vertex_fetch(mesh_data& mesh)
+{
+   const size_t n = mesh.vertex_count();
+   std::vector<uint32_t> remap(n, UINT32_MAX);
+   uint32_t next = 0;
+   for (uint32_t& i : mesh.indices)
+   {
+      if (remap[i] == UINT32_MAX)
+         remap[i] = next++;
+      i = remap[i];
+   }
+
+   auto reorder = [&](auto& attribute) {
+      if (attribute.empty())
+         return;
+      typename std::decay<decltype(attribute)>::type moved(next);
+      for (size_t v = 0; v < n; v++)
+         if (remap[v] != UINT32_MAX)
+            moved[remap[v]] = attribute[v];
+      attribute.swap(moved);
+   };
+   reorder(mesh.positions);
+   reorder(mesh.uvs);
+   reorder(mesh.normals);
+}
+
+// ---------------------------------------------------------------------------
+// Meshlets
+
+static float4 meshlet_bounds(const mesh_data& mesh, const uint32_t* vertices, uint32_t count)
+{
+   float3 lo = mesh.positions[vertices[0]], hi = lo;
+   for (uint32_t i = 1; i < count; i++)
+   {
+      const float3& p = mesh.positions[vertices[i]];
+      lo = { p.x < lo.x ? p.x : lo.x, p.y < lo.y ? p.y : lo.y, p.z < lo.z ? p.z : lo.z };
+      hi = { p.x > hi.x ? p.x : hi.x, p.y > hi.y ? p.y : hi.y, p.z > hi.z ? p.z : hi.z };
+   }
+   const float3 center = scale(add(lo, hi), 0.5f);
+   float radius_sq = 0.0f;
+   for (uint32_t i = 0; i < count; i++)
+   {
+      const float d = length_sq(sub(mesh.positions[vertices[i]], center));
+      radius_sq = d > radius_sq ? d : radius_sq;
+   }
+   return { center.x, center.y, center.z, sqrtf(radius_sq) };
+}
+
+void build_meshlets(const mesh_data& mesh, meshlet_data& out, uint32_t max_vertices, uint32_t max_triangles)
+{
+   out = meshlet_data();
+   max_vertices = max_vertices < 256 ? max_vertices : 256;
+   if (max_vertices < 3 || !max_triangles)
+      return;
+
+   // Local index of each mesh vertex in the open meshlet
+   std::vector<uint32_t> local(mesh.vertex_count(), UINT32_MAX);
+   meshlet m = {};
+   auto close = [&] {
+      if (!m.triangle_count)
+         return;
+      const uint32_t* vertices = &out.vertices[m.vertex_offset];
+      m.bounds = meshlet_bounds(mesh, vertices, m.vertex_count);
+      for (uint32_t i = 0; i < m.vertex_count; i++)
+         local[vertices[i]] = UINT32_MAX;
+      out.meshlets.push_back(m);
+      m = {};
+      m.vertex_offset = (uint32_t)out.vertices.size();
+      m.triangle_offset = (uint32_t)out.triangles.size();
+   };
+
+   for (size_t i = 0; i + 3 <= mesh.indices.size(); i += 3)
+   {
+      const uint32_t a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+      const uint32_t added = (local[a] == UINT32_MAX) + (local[b] == UINT32_MAX && b != a) + (local[c] == UINT32_MAX && c != a && c != b);
+      if (m.vertex_count + added > max_vertices || m.triangle_count == max_triangles)
+         close();
+      for (uint32_t v : { a, b, c })
+      {
+         if (local[v] == UINT32_MAX)
+         {
+            local[v] = m.vertex_count++;
+            out.vertices.push_back(v);
+         }
+         out.triangles.push_back((uint8_t)local[v]);
+      }
+      m.triangle_count++;
+   }
+   close();
+}
+
+// ---------------------------------------------------------------------------
+// Analysis
+
+mesh_cache_stats analyze_mesh(const uint32_t* indices, size_t index_count, size_t vertex_count, size_t vertex_size, int cache_size)
+{
+   mesh_cache_stats stats;
+   const size_t triangle_count = index_count / 3;
+   if (!triangle_count || !vertex_count)
+      return stats;
+
+   // FIFO: a vertex is in the cache while fewer than cache_size misses came
+   // after its own
+   const size_t never = 0;
+   std::vector<size_t> inserted(vertex_count, never);
+   size_t misses = 0, used = 0;
+   std::vector<uint8_t> seen(vertex_count, 0);
+
+   const size_t line_size = 64, line_count = 256;
+   std::vector<size_t> lines(line_count, SIZE_MAX);
+   size_t lines_read = 0;
+
+   for (size_t i = 0; i < triangle_count * 3; i++)
+   {
+      const uint32_t v = indices[i];
+      used += !seen[v];
+      seen[v] = 1;
+      if (inserted[v] != never && misses + 1 - inserted[v] <= (size_t)cache_size)
+         continue;
+      misses++;
+      inserted[v] = misses;
+      const size_t first = v * vertex_size / line_size, last = (v * vertex_size + vertex_size - 1) / line_size;
+      for (size_t line = first; line <= last; line++)
+      {
+         size_t& tag = lines[line % line_count];
+         lines_read += tag != line;
+         tag = line;
+      }
+   }
+   stats.acmr = (double)misses / (double)triangle_count;
+   stats.atvr = (double)misses / (double)used;
+   stats.overfetch = (double)(lines_read * line_size) / (double)(used * vertex_size);
+   return stats;
+}
+
+// ---------------------------------------------------------------------------
+// File
+
+static uint64_t align16(uint64_t n)
+{
+   return (n + 15) & ~(uint64_t)15;
+}
+
+bool write_mesh_file(const char* path, const mesh_data& mesh, const meshlet_data& meshlets, uv_encoding uv)
+{
+   const size_t vertex_count = mesh.vertex_count();
+   if (vertex_count > UINT32_MAX || mesh.indices.size() > UINT32_MAX)
+      return false;
+
+   vertex_source source;
+   source.count = vertex_count;
+   source.positions = mesh.positions.data();
+   source.position_stride = sizeof(float3);
+   source.uvs = mesh.uvs.empty() ? nullptr : mesh.uvs.data();
+   source.uv_stride = sizeof(float2);
+   source.normals = mesh.normals.empty() ? nullptr : mesh.normals.data();
+   source.normal_stride = sizeof(float3);
+   quantized_mesh q;
+   quantize_mesh(source, uv, q);
+
+   const bool short_indices = vertex_count <= 65536;
+   std::vector<uint16_t> indices16(short_indices ? mesh.indices.size() : 0);
+   for (size_t i = 0; i < indices16.size(); i++)
+      indices16[i] = (uint16_t)mesh.indices[i];
+
+   mesh_file_header h = {};
+   h.magic = mesh_file_magic;
+   h.version = mesh_file_version;
+   h.vertex_count = (uint32_t)vertex_count;
+   h.index_count = (uint32_t)mesh.indices.size();
+   h.index_size = short_indices ? 2 : 4;
+   h.uv = (uint32_t)uv;
+   h.meshlet_count = (uint32_t)meshlets.meshlets.size();
+   h.meshlet_vertex_count = (uint32_t)meshlets.vertices.size();
+   h.meshlet_triangle_bytes = (uint32_t)meshlets.triangles.size();
+   h.position = q.position;
+
+   const void* data[mesh_section_count] = {
+      q.positions.data(),
+      q.uvs.data(),
+      q.normals.data(),
+      short_indices ? (const void*)indices16.data() : (const void*)mesh.indices.data(),
+      meshlets.meshlets.data(),
+      meshlets.vertices.data(),
+      meshlets.triangles.data(),
+   };
+   const uint64_t sizes[mesh_section_count] = {
+      q.positions.size() * sizeof(int16_t),
+      q.uvs.size() * sizeof(uint16_t),
+      q.normals.size() * sizeof(int16_t),
+      mesh.indices.size() * h.index_size,
+      meshlets.meshlets.size() * sizeof(meshlet),
+      meshlets.vertices.size() * sizeof(uint32_t),
+      meshlets.triangles.size(),
+   };
+   uint64_t offset = align16(sizeof(mesh_file_header));
+   for (int s = 0; s < mesh_section_count; s++)
+   {
+      h.sections[s] = { offset, sizes[s] };
+      offset = align16(offset + sizes[s]);
+   }
+
+   FILE* f = open_file(path, "wb");
+   if (!f)
+      return false;
+   static const uint8_t zeros[16] = {};
+   bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+   uint64_t written = sizeof(h);
+   for (int s = 0; s < mesh_section_count && ok; s++)
+   {
+      ok = fwrite(zeros, 1, (size_t)(h.sections[s].offset - written), f) == h.sections[s].offset - written;
+      ok = ok && fwrite(data[s], 1, (size_t)sizes[s], f) == sizes[s];
+      written = h.sections[s].offset + sizes[s];
+   }
+   ok = fclose(f) == 0 && ok;
+   return ok;
+}
+
+bool convert_obj(const char* obj_path, const char* mesh_path, uv_encoding uv)
+{
+   mesh_data mesh;
+   if (!load_obj(obj_path, mesh))
+      return false;
+   optimize_vertex_cache(mesh.indices.data(), mesh.indices.size(), mesh.vertex_count());
+   optimize_vertex_fetch(mesh);
+   meshlet_data meshlets;
+   build_meshlets(mesh, meshlets);
+   return write_mesh_file(mesh_path, mesh, meshlets, uv);
+}
+
+// ---------------------------------------------------------------------------
+// Mapping
+
+static bool valid_mesh_file(const uint8_t* data, size_t size)
+{
+   if (size < sizeof(mesh_file_header))
+      return false;
+   const mesh_file_header& h = *(const mesh_file_header*)data;
+   if (h.magic != mesh_file_magic || h.version != mesh_file_version || (h.index_size != 2 && h.index_size != 4) ||
+       h.uv > (uint32_t)uv_encoding::half)
+      return false;
+
+   const uint64_t vertices = h.vertex_count;
+   const uint64_t uv_size = h.sections[mesh_section_uvs].size, normal_size = h.sections[mesh_section_normals].size;
+   const uint64_t expected[mesh_section_count] = {
+      vertices * 8,
+      uv_size ? vertices * 4 : 0,
+      normal_size ? vertices * 4 : 0,
+      (uint64_t)h.index_count * h.index_size,
+      (uint64_t)h.meshlet_count * sizeof(meshlet),
+      (uint64_t)h.meshlet_vertex_count * sizeof(uint32_t),
+      h.meshlet_triangle_bytes,
+   };
+   for (int s = 0; s < mesh_section_count; s++)
+   {
+      const mesh_file_section& e = h.sections[s];
+      if (e.size != expected[s] || e.offset % 16 || e.offset > size || e.size > size - e.offset)
+         return false;
+   }
+
+   // Every index names a vertex, and every meshlet's ranges lie inside their
+   // sections and name vertices that exist: nothing handed out reads past
+   // the mapping however the contents were damaged
+   const uint8_t* indices = data + h.sections[mesh_section_indices].offset;
+   uint32_t largest = 0;
+   if (h.index_size == 2)
+   {
+      for (uint32_t i = 0; i < h.index_count; i++)
+         largest = ((const uint16_t*)indices)[i] > largest ? ((const uint16_t*)indices)[i] : largest;
+   }
+   else
+   {
+      for (uint32_t i = 0; i < h.index_count; i++)
+         largest = ((const uint32_t*)indices)[i] > largest ? ((const uint32_t*)indices)[i] : largest;
+   }
+   if (h.index_count && largest >= h.vertex_count)
+      return false;
+
+   const meshlet* meshlets = (const meshlet*)(data + h.sections[mesh_section_meshlets].offset);
+   const uint32_t* meshlet_vertices = (const uint32_t*)(data + h.sections[mesh_section_meshlet_vertices].offset);
+   const uint8_t* triangles = data + h.sections[mesh_section_meshlet_triangles].offset;
+   for (uint32_t m = 0; m < h.meshlet_count; m++)
+   {
+      const meshlet& ml = meshlets[m];
+      if ((uint64_t)ml.vertex_offset + ml.vertex_count > h.meshlet_vertex_count ||
+          (uint64_t)ml.triangle_offset + 3 * (uint64_t)ml.triangle_count > h.meshlet_triangle_bytes)
+         return false;
+      for (uint32_t v = 0; v < ml.vertex_count; v++)
+      {
+         if (meshlet_vertices[ml.vertex_offset + v] >= h.vertex_count)
+            return false;
+      }
+      for (uint32_t t = 0; t < 3 * ml.triangle_count; t++)
+      {
+         if (triangles[ml.triangle_offset + t] >= ml.vertex_count)
+            return false;
+      }
+   }
+   return true;
+}
+
+bool mapped_mesh::open(const char* path)
+{
+   close();
+   const void* view = nullptr;
+   size_t size = 0;
+#if defined(_WIN32)
+   HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+   if (file == INVALID_HANDLE_VALUE)
+      return false;
+   LARGE_INTEGER length;
+   if (GetFileSizeEx(file, &length) && length.QuadPart > 0 && (uint64_t)length.QuadPart <= SIZE_MAX)
+   {
+      size = (size_t)length.QuadPart;
+      // The view keeps the file mapped after both handles are closed
+      HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+      if (mapping)
+      {
+         view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(mapping);
+      }
+   }
+   CloseHandle(file);
+#else
+   const int fd = ::open(path, O_RDONLY);
+   if (fd < 0)
+      return false;
+   struct stat st;
+   if (fstat(fd, &st) == 0 && st.st_size > 0)
+   {
+      size = (size_t)st.st_size;
+      void* p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      view = p != MAP_FAILED ? p : nullptr;
+   }
+   ::close(fd);
+#endif
+   if (!view)
+      return false;
+   data_ = (const uint8_t*)view;
+   size_ = size;
+   if (!valid_mesh_file(data_, size_))
+   {
+      close();
+      return false;
+   }
+   return true;
+}
+
+void mapped_mesh::close()
+{
+   if (!data_)
+      return;
+#if defined(_WIN32)
+   UnmapViewOfFile(data_);
+#else
+   munmap((void*)data_, size_);
+#endif
+   data_ = nullptr;
+   size_ = 0;
+}
+
+}
@@ -0,0 +1,193 @@
+#pragma once
+
+// Mesh pipeline: OBJ text to a binary file that is mapped and used in place.
+//
+// The samples compile their geometry in: s_VertexArray/s_FacesIndexArray in
+// DxgiSample.cpp, vertexData[] in d3d11_engine::create_vertex_buffer and
+// vertices[] in Test5. convert_obj() is the offline step. parse_obj() reads
+// positions, texture coordinates and normals and welds every distinct
+// v/vt/vn corner into one vertex; optimize_vertex_cache() reorders the
+// triangles for the post-transform cache with Forsyth's linear-speed
+// algorithm; optimize_vertex_fetch() renumbers the vertices in first-use
+// order so fetches walk memory forwards; build_meshlets() cuts the triangle
+// list into meshlets of at most 64 vertices and 124 triangles; and
+// write_mesh_file() stores the quantized streams of sr_quantize.h, the
+// indices (16-bit when they fit) and the meshlets.
+//
+// The file is a mesh_file_header followed by the sections at 16-byte
+// aligned offsets, each in the layout it has in memory. mapped_mesh maps the
+// file read-only and checks the header, that every section is the size the
+// counts imply and lies inside the file, that every index is below the
+// vertex count, and that every meshlet's vertex and triangle ranges lie
+// inside their sections and name vertices that exist. Everything it hands
+// out points into the mapping, so opening does no parsing and no copy; the
+// check reads the indices and meshlets once, the vertex streams are read as
+// their pages are first touched.
+//
+// analyze_mesh() gives the average cache miss ratio (ACMR, vertices
+// transformed per triangle) through a FIFO post-transform cache, the same
+// per distinct vertex (ATVR, 1 when every vertex is transformed once), and
+// the overfetch of one vertex stream through a 16 KB direct-mapped cache of
+// 64-byte lines.
+
+#include "sr_math.h"
+#include "sr_quantize.h"
+
+#include <vector>
+
+namespace sr
+{
+
+struct mesh_data
+{
+   std::vector<float3> positions;
+   std::vector<float2> uvs;         // empty, or one per vertex
+   std::vector<float3> normals;     // empty, or one per vertex
+   std::vector<uint32_t> indices;   // triangle list
+
+   size_t vertex_count() const { return positions.size(); }
+};
+
+// NUL-terminated OBJ text: v, vt, vn and f lines, polygons fanned into
+// triangles, negative indices counted back from the last element read;
+// everything else is ignored. vt and vn are kept when every face corner has
+// them. False when a face refers to a missing element
+bool parse_obj(const char* text, mesh_data& out);
+bool load_obj(const char* path, mesh_data& out);
+
+// Reorders the triangles of an index list in place
+void optimize_vertex_cache(uint32_t* indices, size_t index_count, size_t vertex_count);
+
+// Renumbers the vertices in the order the indices first use them and drops
+// the ones never used
+void optimize_vertex_fetch(mesh_data& mesh);
+
+// Triangles triangle_offset / 3 .. of meshlet_data::triangles index the
+// meshlet's vertices, which are vertex_count entries of
+// meshlet_data::vertices from vertex_offset
+struct meshlet
+{
+   uint32_t vertex_offset;
+   uint32_t triangle_offset;
+   uint32_t vertex_count;
+   uint32_t triangle_count;
+   float4 bounds;   // sphere: center, radius
+};
+
+struct meshlet_data
+{
+   std::vector<meshlet> meshlets;
+   std::vector<uint32_t> vertices;   // mesh vertices
+   std::vector<uint8_t> triangles;   // meshlet-local indices, 3 a triangle
+};
+
+// Greedy, in index order: a meshlet closes when the next triangle would
+// take it past either limit. max_vertices is at most 256
+void build_meshlets(const mesh_data& mesh, meshlet_data& out, uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+struct mesh_cache_stats
+{
+   double acmr = 0.0;
+   double atvr = 0.0;
+   double overfetch = 0.0;   // bytes read / bytes of the vertices used
+};
+
+mesh_cache_stats analyze_mesh(const uint32_t* indices, size_t index_count, size_t vertex_count, size_t vertex_size, int cache_size = 16);
+
+// ---------------------------------------------------------------------------
+// File
+
+static const uint32_t mesh_file_magic = 0x534d5253;   // "SRMS"
+static const uint32_t mesh_file_version = 1;
+
+enum mesh_section
+{
+   mesh_section_positions,           // int16_t x 4 a vertex
+   mesh_section_uvs,                 // uint16_t x 2 a vertex, or empty
+   mesh_section_normals,             // int16_t x 2 a vertex, or empty
+   mesh_section_indices,             // index_size bytes each
+   mesh_section_meshlets,            // meshlet
+   mesh_section_meshlet_vertices,    // uint32_t
+   mesh_section_meshlet_triangles,   // uint8_t
+   mesh_section_count
+};
+
+struct mesh_file_section
+{
+   uint64_t offset;
+   uint64_t size;
+};
+
+struct mesh_file_header
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t vertex_count;
+   uint32_t index_count;
+   uint32_t index_size;   // 2 or 4
+   uint32_t uv;           // uv_encoding
+   uint32_t meshlet_count;
+   uint32_t meshlet_vertex_count;
+   uint32_t meshlet_triangle_bytes;
+   uint32_t reserved;
+   position_quantization position;
+   mesh_file_section sections[mesh_section_count];
+};
+
+bool write_mesh_file(const char* path, const mesh_data& mesh, const meshlet_data& meshlets, uv_encoding uv = uv_encoding::unorm16);
+
+// parse, optimize_vertex_cache, optimize_vertex_fetch, build_meshlets, write
+bool convert_obj(const char* obj_path, const char* mesh_path, uv_encoding uv = uv_encoding::unorm16);
+
+class mapped_mesh
+{
+public:
+   mapped_mesh() = default;
+   ~mapped_mesh() { close(); }
+
+   mapped_mesh(const mapped_mesh&) = delete;
+   mapped_mesh& operator=(const mapped_mesh&) = delete;
+
+   // False when the file cannot be mapped or is not a valid mesh file
+   bool open(const char* path);
+   void close();
+
+   bool is_open() const { return data_ != nullptr; }
+   size_t file_size() const { return size_; }
+
+   uint32_t vertex_count() const { return header()->vertex_count; }
+   uint32_t index_count() const { return header()->index_count; }
+   uint32_t index_size() const { return header()->index_size; }
+   const position_quantization& position() const { return header()->position; }
+   uv_encoding uv() const { return (uv_encoding)header()->uv; }
+
+   const int16_t* positions() const { return (const int16_t*)section(mesh_section_positions); }
+   const uint16_t* uvs() const { return (const uint16_t*)section(mesh_section_uvs); }
+   const int16_t* normals() const { return (const int16_t*)section(mesh_section_normals); }
+   const void* indices() const { return section(mesh_section_indices); }
+
+   uint32_t meshlet_count() const { return header()->meshlet_count; }
+   const meshlet* meshlets() const { return (const meshlet*)section(mesh_section_meshlets); }
+   const uint32_t* meshlet_vertices() const { return (const uint32_t*)section(mesh_section_meshlet_vertices); }
+   const uint8_t* meshlet_triangles() const { return (const uint8_t*)section(mesh_section_meshlet_triangles); }
+
+   size_t input_layout(input_element out[4]) const
+   {
+      return stream_input_layout(uvs() != nullptr, uv(), normals() != nullptr, false, out);
+   }
+
+private:
+   const mesh_file_header* header() const { return (const mesh_file_header*)data_; }
+
+   // Null for an empty section
+   const void* section(mesh_section s) const
+   {
+      const mesh_file_section& e = header()->sections[s];
+      return e.size ? data_ + e.offset : nullptr;
+   }
+
+   const uint8_t* data_ = nullptr;
+   size_t size_ = 0;
+};
+
+}
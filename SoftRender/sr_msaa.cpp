@@ -0,0 +1,188 @@
+#include "sr_msaa.h"
+
+#include <string.h>
+
+namespace sr
+{
+
+// D3D11_STANDARD_MULTISAMPLE_PATTERN, in 1/16 pixel units from the center
+static const sample_position s_pattern_1[1] = { { 0, 0 } };
+static const sample_position s_pattern_2[2] = { { 4, 4 }, { -4, -4 } };
+static const sample_position s_pattern_4[4] = { { -2, -6 }, { 6, -2 }, { -6, 2 }, { 2, 6 } };
+static const sample_position s_pattern_8[8] =
+{
+   { 1, -3 }, { -1, 3 }, { 5, 1 }, { -3, -5 }, { -5, 5 }, { -7, -1 }, { 3, 7 }, { 7, -7 },
+};
+
+const sample_position* standard_sample_pattern(int count)
+{
+   switch (count)
+   {
+   case 1: return s_pattern_1;
+   case 2: return s_pattern_2;
+   case 4: return s_pattern_4;
+   case 8: return s_pattern_8;
+   }
+   return nullptr;
+}
+
+void msaa_target::resize(int width, int height, int samples)
+{
+   const sample_position* pattern = standard_sample_pattern(samples);
+   if (!pattern)
+   {
+      samples = 1;
+      pattern = s_pattern_1;
+   }
+
+   width_ = width;
+   height_ = height;
+   samples_ = samples;
+   tiles_x_ = (width + tile_size - 1) / tile_size;
+   tiles_y_ = (height + tile_size - 1) / tile_size;
+   for (int s = 0; s < samples; s++)
+      pattern_[s] = { pattern[s].x / 16.0f, pattern[s].y / 16.0f };
+
+   const size_t tiles = (size_t)tiles_x_ * tiles_y_;
+   color_.assign(tiles * tile_pixels, 0);
+   depth_.assign(tiles * samples * tile_pixels, clear_depth_);
+   tiles_.resize(tiles);
+   blocks_.clear();
+   blocks_.shrink_to_fit();
+   clear(0, clear_depth_);
+}
+
+void msaa_target::clear(uint32_t color, float depth)
+{
+   clear_depth_ = depth;
+   for (tile& t : tiles_)
+   {
+      t.block = -1;
+      t.depth_cleared = 1;
+   }
+
+   // Every block is free again; keep the storage for the next frame
+   const int blocks = samples_ > 1 ? (int)(blocks_.size() / ((size_t)(samples_ - 1) * tile_pixels)) : 0;
+   free_blocks_.clear();
+   for (int b = blocks - 1; b >= 0; b--)
+      free_blocks_.push_back(b);
+
+   const vec8i c = v8i_set1((int32_t)color);
+   int32_t* p = (int32_t*)color_.data();
+   for (size_t i = 0; i < color_.size(); i += 8)
+      v8i_store(p + i, c);
+}
+
+void msaa_target::decompress(tile& t, int index)
+{
+   if (free_blocks_.empty())
+   {
+      free_blocks_.push_back((int32_t)(blocks_.size() / ((size_t)(samples_ - 1) * tile_pixels)));
+      blocks_.resize(blocks_.size() + (size_t)(samples_ - 1) * tile_pixels);
+   }
+   t.block = free_blocks_.back();
+   free_blocks_.pop_back();
+
+   const uint32_t* src = color_plane(index);
+   for (int s = 1; s < samples_; s++)
+      memcpy(sample_plane(t.block, s), src, tile_pixels * sizeof(uint32_t));
+   stats_.tiles_decompressed++;
+}
+
+void msaa_target::compress(tile& t)
+{
+   free_blocks_.push_back(t.block);
+   t.block = -1;
+   stats_.tiles_recompressed++;
+}
+
+uint32_t msaa_target::read_sample(int x, int y, int sample) const
+{
+   const int index = (y / tile_size) * tiles_x_ + x / tile_size;
+   const int offset = (y % tile_size) * tile_size + x % tile_size;
+   const tile& t = tiles_[index];
+   if (sample == 0 || t.block < 0)
+      return color_plane(index)[offset];
+   return sample_plane(t.block, sample)[offset];
+}
+
+float msaa_target::read_depth(int x, int y, int sample) const
+{
+   const int index = (y / tile_size) * tiles_x_ + x / tile_size;
+   if (tiles_[index].depth_cleared)
+      return clear_depth_;
+   return depth_plane(index, sample)[(y % tile_size) * tile_size + x % tile_size];
+}
+
+void msaa_target::resolve(uint32_t* out, size_t pitch) const
+{
+   // Channels are summed in 16-bit fields (even bytes and odd bytes
+   // separately), which holds 8 samples of 255 without overflow
+   const int shift = samples_ == 8 ? 3 : samples_ == 4 ? 2 : samples_ == 2 ? 1 : 0;
+   const vec8i low = v8i_set1(0x00ff00ff);
+   const vec8i round = v8i_set1(shift ? (1 << (shift - 1)) * 0x00010001 : 0);
+
+   for (int ty = 0; ty < tiles_y_; ty++)
+   {
+      const int rows = height_ - ty * tile_size < tile_size ? height_ - ty * tile_size : tile_size;
+      for (int tx = 0; tx < tiles_x_; tx++)
+      {
+         const int index = ty * tiles_x_ + tx;
+         const tile& t = tiles_[index];
+         const int cols = width_ - tx * tile_size < tile_size ? width_ - tx * tile_size : tile_size;
+         const uint32_t* plane0 = color_plane(index);
+         uint32_t* dst = out + (size_t)ty * tile_size * pitch + (size_t)tx * tile_size;
+
+         for (int r = 0; r < rows; r++, dst += pitch)
+         {
+            alignas(32) uint32_t row[8];
+            if (t.block < 0)
+            {
+               if (cols == tile_size)
+               {
+                  v8i_storeu(dst, v8i_load((const int32_t*)plane0 + r * tile_size));
+                  continue;
+               }
+               memcpy(row, plane0 + r * tile_size, sizeof(row));
+            }
+            else
+            {
+               const vec8i p0 = v8i_load((const int32_t*)plane0 + r * tile_size);
+               vec8i even = p0 & low;
+               vec8i odd = v8i_srli(p0, 8) & low;
+               for (int s = 1; s < samples_; s++)
+               {
+                  const vec8i p = v8i_load((const int32_t*)sample_plane(t.block, s) + r * tile_size);
+                  even = even + (p & low);
+                  odd = odd + (v8i_srli(p, 8) & low);
+               }
+               even = v8i_srli(even + round, shift) & low;
+               odd = v8i_srli(odd + round, shift) & low;
+               const vec8i result = even | v8i_slli(odd, 8);
+               if (cols == tile_size)
+               {
+                  v8i_storeu(dst, result);
+                  continue;
+               }
+               v8i_store((int32_t*)row, result);
+            }
+            memcpy(dst, row, cols * sizeof(uint32_t));
+         }
+      }
+   }
+}
+
+msaa_memory msaa_target::memory() const
+{
+   msaa_memory m;
+   m.tiles = (int)tiles_.size();
+   for (const tile& t : tiles_)
+      m.compressed_tiles += t.block < 0;
+   m.color_bytes = color_.size() * sizeof(uint32_t);
+   m.sample_bytes = blocks_.size() * sizeof(uint32_t);
+   m.depth_bytes = depth_.size() * sizeof(float);
+   m.uncompressed_bytes = (size_t)width_ * height_ * samples_ * (sizeof(uint32_t) + sizeof(float));
+   return m;
+}
+
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+// Multisampled RGBA8 color + depth target for the CPU rendering path.
+//
+// The headless counterpart of Test5's WINDOW_MSAA: 1x/2x/4x/8x with the
+// D3D11 standard sample patterns. Coverage and depth are evaluated per
+// sample, the shade callback runs once per pixel and its color goes to every
+// sample that passed.
+//
+// Color is kept in 8x8 pixel tiles. The color plane always holds sample 0;
+// a tile whose pixels all have equal samples (the common case away from
+// triangle edges) stores nothing else. The first partial-coverage write
+// decompresses the tile into a pooled block holding samples 1..n-1, and a
+// draw that overwrites every sample of the tile compresses it again. Resolve
+// copies compressed tiles and box-filters the others 8 pixels at a time.
+
+#include "sr_raster.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// Offset from the pixel center, in pixels
+struct sample_position
+{
+   float x, y;
+};
+
+// D3D11_STANDARD_MULTISAMPLE_PATTERN for 1, 2, 4 or 8 samples; null otherwise
+const sample_position* standard_sample_pattern(int count);
+
+struct msaa_stats
+{
+   uint64_t triangles = 0;
+   uint64_t pixels_shaded = 0;        // shade invocations x pixels, once per pixel
+   uint64_t samples_written = 0;
+   uint64_t tiles_decompressed = 0;
+   uint64_t tiles_recompressed = 0;
+};
+
+// Bytes held by a target, next to what a flat per-sample layout would need
+struct msaa_memory
+{
+   size_t color_bytes = 0;          // sample 0 plane
+   size_t sample_bytes = 0;         // blocks of decompressed tiles
+   size_t depth_bytes = 0;
+   size_t uncompressed_bytes = 0;   // flat color + depth for every sample
+   int tiles = 0;
+   int compressed_tiles = 0;
+
+   size_t total() const { return color_bytes + sample_bytes + depth_bytes; }
+};
+
+class msaa_target
+{
+public:
+   static const int tile_size = 8;
+   static const int tile_pixels = tile_size * tile_size;
+   static const int max_samples = 8;
+
+   msaa_target() = default;
+   msaa_target(int width, int height, int samples) { resize(width, height, samples); }
+
+   // `samples` must be 1, 2, 4 or 8
+   void resize(int width, int height, int samples);
+
+   // Compresses every tile and fills it with `color`; depth tiles are only
+   // filled when first drawn to
+   void clear(uint32_t color, float depth = 1.0f);
+
+   int width() const { return width_; }
+   int height() const { return height_; }
+   int samples() const { return samples_; }
+
+   // Depth-tests (LESS) and writes the triangle. For every 8-pixel row segment
+   // with a passing sample, shade(x, y, mask, colors) is called once and
+   // must fill colors[i] for every bit i set in mask (pixel x + i).
+   template<class Shade>
+   void draw(const raster_triangle& tri, Shade&& shade);
+
+   uint32_t read_sample(int x, int y, int sample) const;
+   float read_depth(int x, int y, int sample) const;
+   bool tile_compressed(int tx, int ty) const { return tiles_[ty * tiles_x_ + tx].block < 0; }
+
+   // Box-filter resolve to a row-major RGBA8 image with `pitch` pixels per row
+   void resolve(uint32_t* out, size_t pitch) const;
+
+   msaa_memory memory() const;
+
+   const msaa_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = msaa_stats(); }
+
+private:
+   struct tile
+   {
+      int32_t block;           // index of the samples 1..n-1 block, -1 when compressed
+      uint32_t depth_cleared;
+   };
+
+   uint32_t* color_plane(int t) { return &color_[(size_t)t * tile_pixels]; }
+   const uint32_t* color_plane(int t) const { return &color_[(size_t)t * tile_pixels]; }
+   // Sample s (>= 1) of a decompressed tile
+   uint32_t* sample_plane(int block, int s) { return &blocks_[((size_t)block * (samples_ - 1) + s - 1) * tile_pixels]; }
+   const uint32_t* sample_plane(int block, int s) const { return &blocks_[((size_t)block * (samples_ - 1) + s - 1) * tile_pixels]; }
+   float* depth_plane(int t, int s) { return &depth_[((size_t)t * samples_ + s) * tile_pixels]; }
+   const float* depth_plane(int t, int s) const { return &depth_[((size_t)t * samples_ + s) * tile_pixels]; }
+
+   void decompress(tile& t, int index);
+   void compress(tile& t);
+
+   int width_ = 0;
+   int height_ = 0;
+   int samples_ = 1;
+   int tiles_x_ = 0;
+   int tiles_y_ = 0;
+   float clear_depth_ = 1.0f;
+   sample_position pattern_[max_samples] = {};
+
+   aligned_vector<uint32_t> color_;
+   aligned_vector<uint32_t> blocks_;
+   std::vector<int32_t> free_blocks_;
+   aligned_vector<float> depth_;
+   std::vector<tile> tiles_;
+   msaa_stats stats_;
+};
+
+template<class Shade>
+void msaa_target::draw(const raster_triangle& tri, Shade&& shade)
+{
+   stats_.triangles++;
+
+   // Samples sit up to half a pixel from the center, so pixels just outside
+   // the center-based bounding box can still have covered samples
+   const int min_x = tri.min_x > 0 ? tri.min_x - 1 : 0;
+   const int min_y = tri.min_y > 0 ? tri.min_y - 1 : 0;
+   const int max_x = tri.max_x < width_ ? tri.max_x + 1 : width_;
+   const int max_y = tri.max_y < height_ ? tri.max_y + 1 : height_;
+
+   const int tx0 = min_x / tile_size, tx1 = (max_x + tile_size - 1) / tile_size;
+   const int ty0 = min_y / tile_size, ty1 = (max_y + tile_size - 1) / tile_size;
+   const int n = samples_;
+   const vec8f lane_x = v8_ramp() + v8_set1(0.5f);
+   const vec8f vz_min = v8_set1(tri.z_min), vz_max = v8_set1(tri.z_max);
+   const vec8f zero = v8_zero();
+
+   // Edge and depth values at the first sample of each lane step linearly by
+   // the sample offset; fold the offsets into per-sample constants
+   float edge_c[max_samples][3], depth_c[max_samples];
+   for (int s = 0; s < n; s++)
+   {
+      for (int e = 0; e < 3; e++)
+         edge_c[s][e] = tri.c[e] + tri.a[e] * pattern_[s].x + tri.b[e] * pattern_[s].y;
+      depth_c[s] = tri.z_c + tri.z_a * pattern_[s].x + tri.z_b * pattern_[s].y;
+   }
+
+   alignas(32) uint32_t colors[8];
+
+   for (int ty = ty0; ty < ty1; ty++)
+   {
+      const int y0 = ty * tile_size;
+      const int ry0 = min_y > y0 ? min_y - y0 : 0;
+      const int ry1 = max_y < y0 + tile_size ? max_y - y0 : tile_size;
+
+      for (int tx = tx0; tx < tx1; tx++)
+      {
+         const int x0 = tx * tile_size;
+         const int cx0 = min_x > x0 ? min_x - x0 : 0;
+         const int cx1 = max_x < x0 + tile_size ? max_x - x0 : tile_size;
+         const int col_mask = ((1 << cx1) - 1) & ~((1 << cx0) - 1);
+         const int index = ty * tiles_x_ + tx;
+         tile& t = tiles_[index];
+         const vec8f px = v8_set1((float)x0) + lane_x;
+         int full_rows = 0;
+
+         for (int r = ry0; r < ry1; r++)
+         {
+            const int y = y0 + r;
+            const vec8f py = v8_set1((float)y + 0.5f);
+
+            int cover[max_samples];
+            int any_cover = 0;
+            for (int s = 0; s < n; s++)
+            {
+               vec8f inside = v8_true();
+               for (int e = 0; e < 3; e++)
+               {
+                  const vec8f ev = v8_fmadd(v8_set1(tri.a[e]), px, v8_fmadd(v8_set1(tri.b[e]), py, v8_set1(edge_c[s][e])));
+                  vec8f m = v8_cmpgt(ev, zero);
+                  if (tri.top_left[e])
+                     m = m | v8_cmpeq(ev, zero);
+                  inside = inside & m;
+               }
+               cover[s] = v8_movemask(inside) & col_mask;
+               any_cover |= cover[s];
+            }
+            if (!any_cover)
+               continue;
+
+            if (t.depth_cleared)
+            {
+               const vec8f cd = v8_set1(clear_depth_);
+               for (int s = 0; s < n; s++)
+               {
+                  float* d = depth_plane(index, s);
+                  for (int i = 0; i < tile_pixels; i += 8)
+                     v8_store(d + i, cd);
+               }
+               t.depth_cleared = 0;
+            }
+
+            // Per-sample LESS test and depth write
+            int pass[max_samples];
+            int any = 0, all = 0xff;
+            const vec8f zrow = v8_fmadd(v8_set1(tri.z_a), px, v8_set1(tri.z_b * ((float)y + 0.5f)));
+            for (int s = 0; s < n; s++)
+            {
+               pass[s] = 0;
+               if (cover[s])
+               {
+                  float* d = depth_plane(index, s) + r * tile_size;
+                  const vec8f old = v8_load(d);
+                  const vec8f z = v8_clamp(zrow + v8_set1(depth_c[s]), vz_min, vz_max);
+                  pass[s] = cover[s] & v8_movemask(v8_cmplt(z, old));
+                  if (pass[s])
+                     v8_store(d, pass[s] == 0xff ? z : v8_select(v8_lane_mask(pass[s]), z, old));
+               }
+               any |= pass[s];
+               all &= pass[s];
+            }
+            if (!any)
+               continue;
+
+            shade(x0, y, any, colors);
+            stats_.pixels_shaded += (uint64_t)popcount32((uint32_t)any);
+            const vec8f c = v8i_as_float(v8i_load((const int32_t*)colors));
+
+            // Every shaded pixel had all its samples pass: the tile may stay compressed
+            if (t.block < 0 && (any & ~all) != 0)
+               decompress(t, index);
+
+            uint32_t* plane0 = color_plane(index) + r * tile_size;
+            const vec8f old0 = v8i_as_float(v8i_load((const int32_t*)plane0));
+            const int mask0 = t.block < 0 ? any : pass[0];
+            if (mask0)
+               v8i_store((int32_t*)plane0, v8_as_int(mask0 == 0xff ? c : v8_select(v8_lane_mask(mask0), c, old0)));
+
+            int written = 0;
+            if (t.block >= 0)
+            {
+               for (int s = 1; s < n; s++)
+               {
+                  if (!pass[s])
+                     continue;
+                  uint32_t* p = sample_plane(t.block, s) + r * tile_size;
+                  const vec8f old = v8i_as_float(v8i_load((const int32_t*)p));
+                  v8i_store((int32_t*)p, v8_as_int(pass[s] == 0xff ? c : v8_select(v8_lane_mask(pass[s]), c, old)));
+                  written += popcount32((uint32_t)pass[s]);
+               }
+               written += popcount32((uint32_t)pass[0]);
+            }
+            else
+            {
+               written = popcount32((uint32_t)any) * n;
+            }
+            stats_.samples_written += (uint64_t)written;
+
+            if (all == 0xff)
+               full_rows++;
+         }
+
+         // This draw replaced every sample of the tile
+         if (full_rows == tile_size && t.block >= 0)
+            compress(t);
+      }
+   }
+}
+
+}
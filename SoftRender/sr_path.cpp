@@ -0,0 +1,660 @@
+#include "sr_path.h"
+#include "sr_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+namespace sr
+{
+
+// ---------------------------------------------------------------------------
+// path_geometry
+
+static std::atomic<uint64_t> s_next_geometry_id(1);
+
+path_geometry::path_geometry() : id_(s_next_geometry_id++)
+{
+}
+
+path_geometry::path_geometry(const path_geometry& other)
+   : id_(s_next_geometry_id++), fill_mode_(other.fill_mode_), verbs_(other.verbs_), points_(other.points_)
+{
+}
+
+path_geometry& path_geometry::operator=(const path_geometry& other)
+{
+   fill_mode_ = other.fill_mode_;
+   verbs_ = other.verbs_;
+   points_ = other.points_;
+   revision_++;
+   return *this;
+}
+
+void path_geometry::begin_figure(const float2& start, figure_begin begin)
+{
+   revision_++;
+   verbs_.push_back(begin == figure_begin::filled ? verb::begin : verb::begin_hollow);
+   points_.push_back(start);
+}
+
+void path_geometry::add_line(const float2& p)
+{
+   revision_++;
+   verbs_.push_back(verb::line);
+   points_.push_back(p);
+}
+
+void path_geometry::add_lines(const float2* p, size_t count)
+{
+   for (size_t i = 0; i < count; i++)
+      add_line(p[i]);
+}
+
+void path_geometry::add_quadratic_bezier(const float2& control, const float2& end)
+{
+   revision_++;
+   verbs_.push_back(verb::quadratic);
+   points_.push_back(control);
+   points_.push_back(end);
+}
+
+void path_geometry::add_bezier(const float2& control1, const float2& control2, const float2& end)
+{
+   revision_++;
+   verbs_.push_back(verb::cubic);
+   points_.push_back(control1);
+   points_.push_back(control2);
+   points_.push_back(end);
+}
+
+void path_geometry::end_figure(figure_end end)
+{
+   revision_++;
+   // Fills close every figure anyway; the flag only matters to strokes
+   verbs_.push_back(end == figure_end::closed ? verb::end_closed : verb::end);
+}
+
+void path_geometry::clear()
+{
+   revision_++;
+   verbs_.clear();
+   points_.clear();
+}
+
+void path_geometry::bounds(float2& min, float2& max) const
+{
+   min = { INFINITY, INFINITY };
+   max = { -INFINITY, -INFINITY };
+   for (const float2& p : points_)
+   {
+      min = { fminf(min.x, p.x), fminf(min.y, p.y) };
+      max = { fmaxf(max.x, p.x), fmaxf(max.y, p.y) };
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Flattening
+
+// Wang's formula: n segments keep a degree-d Bezier within `tolerance` of
+// its chords when n >= sqrt(d * (d - 1) / 8 * max |second difference| / tolerance)
+static int wang_segments(float second_difference, float degree_factor, float tolerance)
+{
+   const float n = ceilf(sqrtf(degree_factor * second_difference / tolerance));
+   return n < 1.0f ? 1 : (n > 1024.0f ? 1024 : (int)n);
+}
+
+static float length(float x, float y)
+{
+   return sqrtf(x * x + y * y);
+}
+
+static void flatten_quadratic(const float2& p0, const float2& p1, const float2& p2, float tolerance, std::vector<line_segment>& out)
+{
+   const int n = wang_segments(length(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y), 0.25f, tolerance);
+   float2 prev = p0;
+   for (int i = 1; i <= n; i++)
+   {
+      const float t = (float)i / (float)n, u = 1.0f - t;
+      const float2 p = i == n ? p2 : float2{
+         u * u * p0.x + 2 * u * t * p1.x + t * t * p2.x,
+         u * u * p0.y + 2 * u * t * p1.y + t * t * p2.y,
+      };
+      out.push_back({ prev.x, prev.y, p.x, p.y });
+      prev = p;
+   }
+}
+
+static void flatten_cubic(const float2& p0, const float2& p1, const float2& p2, const float2& p3, float tolerance, std::vector<line_segment>& out)
+{
+   const float d1 = length(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y);
+   const float d2 = length(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y);
+   const int n = wang_segments(d1 > d2 ? d1 : d2, 0.75f, tolerance);
+   float2 prev = p0;
+   for (int i = 1; i <= n; i++)
+   {
+      const float t = (float)i / (float)n, u = 1.0f - t;
+      const float b0 = u * u * u, b1 = 3 * u * u * t, b2 = 3 * u * t * t, b3 = t * t * t;
+      const float2 p = i == n ? p3 : float2{
+         b0 * p0.x + b1 * p1.x + b2 * p2.x + b3 * p3.x,
+         b0 * p0.y + b1 * p1.y + b2 * p2.y + b3 * p3.y,
+      };
+      out.push_back({ prev.x, prev.y, p.x, p.y });
+      prev = p;
+   }
+}
+
+void flatten_path(const path_geometry& path, const float3x2& transform, float tolerance, std::vector<line_segment>& out)
+{
+   typedef path_geometry::verb verb;
+   const float2* pts = path.points_.data();
+   float2 start = { 0, 0 }, cur = { 0, 0 };
+   bool open = false, filled = false;
+
+   auto close = [&]() {
+      if (open && filled && (cur.x != start.x || cur.y != start.y))
+         out.push_back({ cur.x, cur.y, start.x, start.y });
+      open = false;
+   };
+
+   for (verb v : path.verbs_)
+   {
+      switch (v)
+      {
+      case verb::begin:
+      case verb::begin_hollow:
+         close();
+         start = cur = transform_point(*pts++, transform);
+         open = true;
+         filled = v == verb::begin;
+         break;
+      case verb::line:
+      {
+         const float2 p = transform_point(*pts++, transform);
+         if (filled)
+            out.push_back({ cur.x, cur.y, p.x, p.y });
+         cur = p;
+         break;
+      }
+      case verb::quadratic:
+      {
+         const float2 c = transform_point(pts[0], transform), p = transform_point(pts[1], transform);
+         pts += 2;
+         if (filled)
+            flatten_quadratic(cur, c, p, tolerance, out);
+         cur = p;
+         break;
+      }
+      case verb::cubic:
+      {
+         const float2 c1 = transform_point(pts[0], transform), c2 = transform_point(pts[1], transform), p = transform_point(pts[2], transform);
+         pts += 3;
+         if (filled)
+            flatten_cubic(cur, c1, c2, p, tolerance, out);
+         cur = p;
+         break;
+      }
+      case verb::end:
+      case verb::end_closed:
+         close();
+         break;
+      }
+   }
+   close();
+}
+
+// ---------------------------------------------------------------------------
+// Area accumulation
+
+void accumulate_line(const line_segment& line, float origin_x, float origin_y, float* acc, int stride, int rows)
+{
+   float x0 = line.x0 - origin_x, y0 = line.y0 - origin_y;
+   float x1 = line.x1 - origin_x, y1 = line.y1 - origin_y;
+   if (y0 == y1)
+      return;
+
+   // Walk downwards; upward lines subtract
+   float dir = 1.0f;
+   if (y0 > y1)
+   {
+      float t = x0; x0 = x1; x1 = t;
+      t = y0; y0 = y1; y1 = t;
+      dir = -1.0f;
+   }
+   if (y1 <= 0.0f || y0 >= (float)rows)
+      return;
+
+   const float dxdy = (x1 - x0) / (y1 - y0);
+   const float max_x = (float)(stride - 2);
+   const float y_start = y0 > 0.0f ? y0 : 0.0f;
+   const int row_end = y1 < (float)rows ? (int)ceilf(y1) : rows;
+
+   for (int y = (int)y_start; y < row_end; y++)
+   {
+      float* cells = acc + (size_t)y * stride;
+      // x from the endpoint on every row, so long lines do not drift
+      const float ya = fmaxf((float)y, y_start), yb = fminf((float)(y + 1), y1);
+      const float x = x0 + (ya - y0) * dxdy;
+      const float x_next = x0 + (yb - y0) * dxdy;
+      const float d = (yb - ya) * dir;
+
+      // Clamping keeps stray rounding inside the row; lines are expected to
+      // be clipped to the accumulator already
+      const float xa = clamp(fminf(x, x_next), 0.0f, max_x);
+      const float xb = clamp(fmaxf(x, x_next), 0.0f, max_x);
+      const float xa_floor = floorf(xa);
+      const int ia = (int)xa_floor;
+      const float xb_ceil = ceilf(xb);
+      const int ib = (int)xb_ceil;
+
+      if (ib <= ia + 1)
+      {
+         // Within one cell: the trapezoid right of the line
+         const float xm = 0.5f * (xa + xb) - xa_floor;
+         cells[ia] += d - d * xm;
+         cells[ia + 1] += d * xm;
+      }
+      else
+      {
+         const float s = 1.0f / (xb - xa);
+         const float fa = xa - xa_floor;
+         const float a0 = 0.5f * s * (1.0f - fa) * (1.0f - fa);
+         const float fb = xb - xb_ceil + 1.0f;
+         const float am = 0.5f * s * fb * fb;
+         cells[ia] += d * a0;
+         if (ib == ia + 2)
+         {
+            cells[ia + 1] += d * (1.0f - a0 - am);
+         }
+         else
+         {
+            const float a1 = s * (1.5f - fa);
+            cells[ia + 1] += d * (a1 - a0);
+            for (int i = ia + 2; i < ib - 1; i++)
+               cells[i] += d * s;
+            const float a2 = a1 + (float)(ib - ia - 3) * s;
+            cells[ib - 1] += d * (1.0f - a2 - am);
+         }
+         cells[ib] += d * am;
+      }
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Sparse strips
+
+// Key: first tile | last tile | line, so keys sort by first tile
+static SR_FORCEINLINE uint64_t tile_key(int tx0, int tx1, uint32_t line) { return (uint64_t)tx0 << 48 | (uint64_t)tx1 << 32 | line; }
+static SR_FORCEINLINE int key_first_tile(uint64_t k) { return (int)(k >> 48); }
+static SR_FORCEINLINE int key_last_tile(uint64_t k) { return (int)((k >> 32) & 0xffff); }
+
+void strip_rasterizer::bin_lines(const line_segment* lines, size_t count)
+{
+   clipped_.clear();
+
+   const float w = (float)width_, h = (float)height_;
+   float y_min = h, y_max = 0.0f;
+
+   // `l` runs downwards inside the target; `up` restores the winding sign
+   auto bin = [&](const line_segment& l, bool up) {
+      if (l.y0 >= l.y1)
+         return;
+      clipped_.push_back(up ? line_segment{ l.x1, l.y1, l.x0, l.y0 } : l);
+      y_min = fminf(y_min, l.y0);
+      y_max = fmaxf(y_max, l.y1);
+   };
+
+   for (size_t i = 0; i < count; i++)
+   {
+      line_segment l = lines[i];
+      if (l.y0 == l.y1 || !isfinite(l.x0 + l.y0 + l.x1 + l.y1))
+         continue;
+      const bool up = l.y0 > l.y1;
+      if (up)
+         l = { l.x1, l.y1, l.x0, l.y0 };
+      if (l.y1 <= 0.0f || l.y0 >= h)
+         continue;
+
+      const float dxdy = (l.x1 - l.x0) / (l.y1 - l.y0);
+      if (l.y0 < 0.0f)
+      {
+         l.x0 -= l.y0 * dxdy;
+         l.y0 = 0.0f;
+      }
+      if (l.y1 > h)
+      {
+         l.x1 -= (l.y1 - h) * dxdy;
+         l.y1 = h;
+      }
+
+      // Split at x = 0 and x = width. Left of the target only the winding
+      // matters, so that part moves onto x = 0; right of it nothing is visible
+      const float xs[2] = { 0.0f, w };
+      float y_split[2];
+      for (int k = 0; k < 2; k++)
+      {
+         const bool crosses = (l.x0 < xs[k]) != (l.x1 < xs[k]);
+         y_split[k] = crosses ? clamp(l.y0 + (xs[k] - l.x0) / dxdy, l.y0, l.y1) : l.y0;
+      }
+      float y = l.y0;
+      float x = l.x0;
+      float ys[3] = { y_split[0], y_split[1], l.y1 };
+      if (ys[0] > ys[1])
+      {
+         const float t = ys[0]; ys[0] = ys[1]; ys[1] = t;
+      }
+      for (int k = 0; k < 3; k++)
+      {
+         const float y_end = ys[k];
+         if (y_end <= y)
+            continue;
+         const float x_end = k == 2 ? l.x1 : l.x0 + (y_end - l.y0) * dxdy;
+         const float xm = 0.5f * (x + x_end);
+         if (xm < w)
+         {
+            if (xm <= 0.0f)
+               bin({ 0.0f, y, 0.0f, y_end }, up);
+            else
+               bin({ clamp(x, 0.0f, w), y, clamp(x_end, 0.0f, w), y_end }, up);
+         }
+         y = y_end;
+         x = x_end;
+      }
+   }
+
+   // Every line is listed once per tile row it crosses, with the range of
+   // tiles it touches there. Entries are bucketed by row, then sorted by
+   // their first tile so touching ranges can be merged into strips
+   const float inv_tile = 1.0f / tile_size;
+   const int tiles_x = (width_ + tile_size - 1) / tile_size;
+   ty_min_ = (int)(y_min * inv_tile);
+   ty_max_ = clipped_.empty() ? ty_min_ - 1 : (int)ceilf(y_max * inv_tile) - 1;
+   row_offsets_.assign((size_t)(ty_max_ - ty_min_ + 3), 0);
+   row_tiles_.assign((size_t)(ty_max_ - ty_min_ + 1), 0);
+   binned_.clear();
+
+   for (uint32_t index = 0; index < (uint32_t)clipped_.size(); index++)
+   {
+      line_segment l = clipped_[index];
+      if (l.y0 > l.y1)
+         l = { l.x1, l.y1, l.x0, l.y0 };
+      const float dxdy = (l.x1 - l.x0) / (l.y1 - l.y0);
+      const int ty0 = (int)(l.y0 * inv_tile);
+      const int ty1 = (int)ceilf(l.y1 * inv_tile);
+      for (int ty = ty0; ty < ty1; ty++)
+      {
+         const float ya = fmaxf(l.y0, (float)(ty * tile_size));
+         const float yb = fminf(l.y1, (float)((ty + 1) * tile_size));
+         const float xa = l.x0 + (ya - l.y0) * dxdy;
+         const float xb = l.x0 + (yb - l.y0) * dxdy;
+         int tx0 = (int)(fminf(xa, xb) * inv_tile);
+         int tx1 = (int)(fmaxf(xa, xb) * inv_tile);
+         tx0 = tx0 < tiles_x ? tx0 : tiles_x - 1;
+         tx1 = tx1 < tiles_x ? tx1 : tiles_x - 1;
+         const uint32_t row = (uint32_t)(ty - ty_min_);
+         binned_.push_back({ row, tile_key(tx0, tx1, index) });
+         row_offsets_[row + 2]++;
+         row_tiles_[row] += (uint32_t)(tx1 - tx0 + 1);
+         stats_.tiles += (uint64_t)(tx1 - tx0 + 1);
+      }
+   }
+
+   // Counting sort by row: afterwards row r owns keys_[row_offsets_[r] .. row_offsets_[r + 1]).
+   // Dense rows take their lines in any order
+   for (size_t r = 2; r < row_offsets_.size(); r++)
+      row_offsets_[r] += row_offsets_[r - 1];
+   keys_.resize(binned_.size());
+   for (const binned_line& b : binned_)
+      keys_[row_offsets_[b.row + 1]++] = b.key;
+   for (size_t r = 0; r + 1 < row_offsets_.size(); r++)
+      if (!dense_row((int)r))
+         std::sort(keys_.begin() + row_offsets_[r], keys_.begin() + row_offsets_[r + 1]);
+}
+
+// Coverage in [0, 1] from the accumulated winding-weighted area
+static SR_FORCEINLINE vec8f apply_fill_rule(vec8f v, fill_mode mode)
+{
+   if (mode == fill_mode::alternate)
+   {
+      // Distance to the nearest even winding, a triangle wave in [0, 1]
+      return v8_abs(v - v8_set1(2.0f) * v8_floor(v * v8_set1(0.5f) + v8_set1(0.5f)));
+   }
+   return v8_min(v8_abs(v), v8_set1(1.0f));
+}
+
+static uint8_t span_alpha(float winding, fill_mode mode)
+{
+   float a;
+   if (mode == fill_mode::alternate)
+      a = fabsf(winding - 2.0f * floorf(winding * 0.5f + 0.5f));
+   else
+      a = fminf(fabsf(winding), 1.0f);
+   return (uint8_t)(a * 255.0f + 0.5f);
+}
+
+void strip_rasterizer::rasterize(const line_segment* lines, size_t count, fill_mode mode, coverage_strips& out)
+{
+   out.clear();
+   stats_.lines += count;
+   if (width_ <= 0 || height_ <= 0)
+      return;
+
+   bin_lines(lines, count);
+
+   const int rows = coverage_strips::strip_height;
+   const vec8f to_byte = v8_set1(255.0f);
+
+   auto emit_spans = [&](int ty, int x0, int x1, const float* carry) {
+      if (x0 >= x1)
+         return;
+      for (int r = 0; r < rows; r++)
+      {
+         const int y = ty * tile_size + r;
+         const uint8_t a = span_alpha(carry[r], mode);
+         if (y < height_ && a)
+         {
+            out.spans.push_back({ x0, x1, y, a });
+            stats_.spans++;
+            stats_.span_pixels += (uint64_t)(x1 - x0);
+         }
+      }
+   };
+
+   // Prefix sums of `stride` accumulated cells per row into `width` alphas
+   // a row, starting from the winding in `carry`
+   auto resolve = [&](int width, int stride, float* carry) {
+      const uint32_t offset = (uint32_t)out.alphas.size();
+      out.alphas.resize(offset + (size_t)width * rows);
+      uint8_t* alpha = &out.alphas[offset];
+      for (int r = 0; r < rows; r++, alpha += width)
+      {
+         const float* cells = &acc_[(size_t)r * stride];
+         float running = carry[r];
+         for (int c = 0; c < stride; c += 8)
+         {
+            alignas(32) float sum[8];
+            alignas(32) int32_t a[8];
+            const vec8f v = v8_prefix_sum(v8_load(cells + c)) + v8_set1(running);
+            v8_store(sum, v);
+            running = sum[7];
+            v8i_store(a, v8_round_to_int(apply_fill_rule(v, mode) * to_byte));
+            const int m = width - c < 8 ? width - c : 8;
+            for (int k = 0; k < m; k++)
+               alpha[c + k] = (uint8_t)a[k];
+         }
+         carry[r] = running;
+      }
+      return offset;
+   };
+
+   const int tiles_x = (width_ + tile_size - 1) / tile_size;
+   for (int ty = ty_min_; ty <= ty_max_; ty++)
+   {
+      const uint64_t* keys = keys_.data() + row_offsets_[ty - ty_min_];
+      const size_t n = row_offsets_[ty - ty_min_ + 1] - row_offsets_[ty - ty_min_];
+      float carry[rows] = {};
+      int cursor = 0;
+
+      if (dense_row(ty - ty_min_))
+      {
+         // Edges nearly everywhere: one strip across the target, every line
+         // accumulated once, no merging and no spans
+         const int width = tiles_x * tile_size;
+         const int stride = (width + 2 + 7) & ~7;
+         acc_.assign((size_t)stride * rows, 0.0f);
+         for (size_t k = 0; k < n; k++)
+            accumulate_line(clipped_[(uint32_t)keys[k]], 0.0f, (float)(ty * tile_size), acc_.data(), stride, rows);
+         out.strips.push_back({ 0, ty * tile_size, width, resolve(width, stride, carry) });
+         stats_.strips++;
+         stats_.dense_rows++;
+         stats_.strip_pixels += (uint64_t)width * rows;
+         continue;
+      }
+
+      size_t i = 0;
+      while (i < n)
+      {
+         // A strip is a run of lines whose tile ranges touch or overlap
+         const int tx_start = key_first_tile(keys[i]);
+         int tx_end = key_last_tile(keys[i]);
+         size_t j = i + 1;
+         for (; j < n && key_first_tile(keys[j]) <= tx_end + 1; j++)
+            tx_end = tx_end > key_last_tile(keys[j]) ? tx_end : key_last_tile(keys[j]);
+
+         const int x0 = tx_start * tile_size;
+         const int width = (tx_end - tx_start + 1) * tile_size;
+         emit_spans(ty, cursor, x0, carry);
+
+         // Two spare cells take the area right of the strip; padded to 8
+         const int stride = (width + 2 + 7) & ~7;
+         acc_.assign((size_t)stride * rows, 0.0f);
+         for (size_t k = i; k < j; k++)
+            accumulate_line(clipped_[(uint32_t)keys[k]], (float)x0, (float)(ty * tile_size), acc_.data(), stride, rows);
+
+         out.strips.push_back({ x0, ty * tile_size, width, resolve(width, stride, carry) });
+         stats_.strips++;
+         stats_.strip_pixels += (uint64_t)width * rows;
+         cursor = x0 + width;
+         i = j;
+      }
+
+      emit_spans(ty, cursor, width_, carry);
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Painting
+
+// dst = color * coverage + dst * (1 - alpha * coverage) on 8 pixels
+static SR_FORCEINLINE vec8i blend_solid8(vec8i dst, vec8f coverage, const vec8f* color, vec8f color_alpha)
+{
+   const vec8i byte = v8i_set1(0xff);
+   const vec8f inv = v8_set1(1.0f) - color_alpha * coverage;
+   vec8i out = v8i_set1(0);
+   for (int c = 0; c < 4; c++)
+   {
+      const vec8f d = v8i_to_float(v8i_srli(dst, c * 8) & byte);
+      const vec8f r = v8_fmadd(color[c], coverage, d * inv);
+      out = out | v8i_slli(v8_round_to_int(r), c * 8);
+   }
+   return out;
+}
+
+// Blends `count` pixels; `alpha` gives per-pixel coverage, or null for a
+// constant `coverage`
+static void fill_run(uint32_t* dst, int count, const uint8_t* alpha, vec8f coverage, const vec8f* color, vec8f color_alpha)
+{
+   const vec8f to_unit = v8_set1(1.0f / 255.0f);
+   for (int x = 0; x < count; x += 8)
+   {
+      const int n = count - x < 8 ? count - x : 8;
+      vec8f cv = coverage;
+      if (alpha && n == 8)
+      {
+         cv = v8i_to_float(v8i_load_u8(alpha + x)) * to_unit;
+      }
+      else if (alpha)
+      {
+         alignas(8) uint8_t cov[8] = {};
+         memcpy(cov, alpha + x, n);
+         cv = v8i_to_float(v8i_load_u8(cov)) * to_unit;
+      }
+      if (n == 8)
+      {
+         v8i_storeu(dst + x, blend_solid8(v8i_loadu(dst + x), cv, color, color_alpha));
+      }
+      else
+      {
+         alignas(32) int32_t tmp[8];
+         memcpy(tmp, dst + x, n * sizeof(uint32_t));
+         v8i_store(tmp, blend_solid8(v8i_load(tmp), cv, color, color_alpha));
+         memcpy(dst + x, tmp, n * sizeof(uint32_t));
+      }
+   }
+}
+
+void fill_coverage(image_rgba8& target, const coverage_strips& coverage, uint32_t color, int dx, int dy)
+{
+   vec8f col[4];
+   for (int c = 0; c < 4; c++)
+      col[c] = v8_set1((float)((color >> (c * 8)) & 0xff));
+   const vec8f col_alpha = v8_set1((float)(color >> 24) * (1.0f / 255.0f));
+   const bool opaque = (color >> 24) == 0xff;
+   const rect_i clip = target.clip();
+   if (clip.empty())
+      return;
+
+   // Bands are in order, so a clip rectangle (a tile, a damage rectangle)
+   // only visits the strips and spans of the bands it overlaps
+   const int band_top = clip.top - dy, band_bottom = clip.bottom - dy;
+   const std::vector<coverage_strip>& strips = coverage.strips;
+   const auto first_strip = std::partition_point(strips.begin(), strips.end(), [&](const coverage_strip& s) {
+      return s.y + coverage_strips::strip_height <= band_top;
+   });
+   for (auto it = first_strip; it != strips.end() && it->y < band_bottom; ++it)
+   {
+      const coverage_strip& s = *it;
+      const int x0 = s.x + dx > clip.left ? s.x + dx : clip.left;
+      const int x1 = s.x + dx + s.width < clip.right ? s.x + dx + s.width : clip.right;
+      if (x0 >= x1)
+         continue;
+      for (int r = 0; r < coverage_strips::strip_height; r++)
+      {
+         const int y = s.y + dy + r;
+         if (y < clip.top || y >= clip.bottom)
+            continue;
+         fill_run(target.row(y) + x0, x1 - x0, coverage.strip_row(s, r) + (x0 - s.x - dx), col_alpha, col, col_alpha);
+      }
+   }
+
+   const std::vector<coverage_span>& spans = coverage.spans;
+   const int band = coverage_strips::strip_height;
+   const auto first_span = std::partition_point(spans.begin(), spans.end(), [&](const coverage_span& s) {
+      return s.y - s.y % band + band <= band_top;
+   });
+   for (auto it = first_span; it != spans.end() && it->y - it->y % band < band_bottom; ++it)
+   {
+      const coverage_span& s = *it;
+      const int y = s.y + dy;
+      const int x0 = s.x0 + dx > clip.left ? s.x0 + dx : clip.left;
+      const int x1 = s.x1 + dx < clip.right ? s.x1 + dx : clip.right;
+      if (y < clip.top || y >= clip.bottom || x0 >= x1)
+         continue;
+      uint32_t* dst = target.row(y);
+      if (opaque && s.alpha == 0xff)
+      {
+         const vec8i c = v8i_set1((int32_t)color);
+         int x = x0;
+         for (; x + 8 <= x1; x += 8)
+            v8i_storeu(dst + x, c);
+         for (; x < x1; x++)
+            dst[x] = color;
+         continue;
+      }
+      fill_run(dst + x0, x1 - x0, nullptr, v8_set1(s.alpha * (1.0f / 255.0f)), col, col_alpha);
+   }
+}
+
+}
@@ -0,0 +1,218 @@
+#pragma once
+
+// 2D path filling for the D2D content (the hourglass in
+// DXGISampleApp::RenderD2DContentIntoSurface and anything like it).
+//
+//  1. path_geometry records figures the way ID2D1GeometrySink does.
+//  2. flatten_path() transforms them to device space and turns Beziers into
+//     lines; the segment count per curve comes from Wang's formula, so flat
+//     curves get few segments and tight ones many.
+//  3. strip_rasterizer bins the lines into 4x4 tiles and accumulates exact
+//     signed area only in tiles that edges touch. Runs of touched tiles
+//     become alpha strips; the gaps between them become solid spans whose
+//     coverage is the winding carried in from the left. Prefix sums of the
+//     area accumulators run 8 pixels at a time. A tile row whose lines touch
+//     more tiles than dense_threshold of its width skips the merging and is
+//     accumulated as one strip across the target.
+//  4. fill_coverage() paints a solid color through the strips and spans.
+
+#include "sr_image.h"
+#include "sr_math.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// D2D1_FILL_MODE
+enum class fill_mode
+{
+   alternate,   // even-odd
+   winding,     // nonzero
+};
+
+enum class figure_begin
+{
+   filled,
+   hollow,
+};
+
+enum class figure_end
+{
+   open,
+   closed,
+};
+
+struct line_segment
+{
+   float x0, y0, x1, y1;
+};
+
+class path_geometry
+{
+public:
+   path_geometry();
+   path_geometry(const path_geometry& other);
+   path_geometry& operator=(const path_geometry& other);
+
+   void set_fill_mode(fill_mode mode) { fill_mode_ = mode; }
+   fill_mode get_fill_mode() const { return fill_mode_; }
+
+   void begin_figure(const float2& start, figure_begin begin = figure_begin::filled);
+   void add_line(const float2& p);
+   void add_lines(const float2* p, size_t count);
+   void add_quadratic_bezier(const float2& control, const float2& end);
+   void add_bezier(const float2& control1, const float2& control2, const float2& end);
+   void end_figure(figure_end end);
+
+   void clear();
+
+   size_t segment_count() const { return verbs_.size(); }
+
+   // Identity for realization caches: every geometry (copies included) gets
+   // its own id, and the revision changes with every edit
+   uint64_t id() const { return id_; }
+   uint32_t revision() const { return revision_; }
+
+   // Bounds of all points, control points included
+   void bounds(float2& min, float2& max) const;
+
+private:
+   friend void flatten_path(const path_geometry&, const float3x2&, float, std::vector<line_segment>&);
+   friend class path_stroker;
+
+   enum class verb : uint8_t
+   {
+      begin,          // 1 point
+      begin_hollow,   // 1 point, figure is not filled
+      line,           // 1 point
+      quadratic,      // 2 points
+      cubic,          // 3 points
+      end,            // no points, figure is open
+      end_closed,     // no points
+   };
+
+   uint64_t id_;
+   uint32_t revision_ = 0;
+   fill_mode fill_mode_ = fill_mode::alternate;
+   std::vector<verb> verbs_;
+   std::vector<float2> points_;
+};
+
+// Appends the filled figures of `path` to `out` as device-space lines. Every
+// figure is closed, as for FillGeometry. `tolerance` is the maximum distance
+// in pixels between a curve and its flattening.
+void flatten_path(const path_geometry& path, const float3x2& transform, float tolerance, std::vector<line_segment>& out);
+
+// Adds the signed area `line` (relative to the origin) covers in each cell of
+// `rows` x `stride` accumulators. A prefix sum along a row turns the cells
+// into exact winding-weighted coverage; x must lie in [0, stride - 2].
+void accumulate_line(const line_segment& line, float origin_x, float origin_y, float* acc, int stride, int rows);
+
+// Coverage of one fill: strips are 4 pixel rows tall and a multiple of 4
+// pixels wide, with one alpha byte per pixel, row-major inside the strip.
+// Spans are solid runs of one pixel row between (or right of) strips. Both
+// come in 4-row bands from top to bottom.
+struct coverage_strip
+{
+   int x, y, width;
+   uint32_t alpha_offset;
+};
+
+struct coverage_span
+{
+   int x0, x1, y;
+   uint8_t alpha;
+};
+
+struct coverage_strips
+{
+   static const int strip_height = 4;
+
+   std::vector<coverage_strip> strips;
+   std::vector<uint8_t> alphas;
+   std::vector<coverage_span> spans;
+
+   void clear()
+   {
+      strips.clear();
+      alphas.clear();
+      spans.clear();
+   }
+
+   const uint8_t* strip_row(const coverage_strip& s, int row) const { return &alphas[s.alpha_offset + (size_t)row * s.width]; }
+
+   size_t bytes() const { return strips.size() * sizeof(coverage_strip) + alphas.size() + spans.size() * sizeof(coverage_span); }
+};
+
+struct strip_stats
+{
+   uint64_t lines = 0;
+   uint64_t tiles = 0;           // (tile, line) pairs binned
+   uint64_t strips = 0;
+   uint64_t spans = 0;
+   uint64_t strip_pixels = 0;    // pixels with computed alpha
+   uint64_t span_pixels = 0;     // pixels covered by solid spans
+   uint64_t dense_rows = 0;      // tile rows accumulated across the target
+};
+
+class strip_rasterizer
+{
+public:
+   static const int tile_size = 4;
+
+   strip_rasterizer(int width = 0, int height = 0) { set_target_size(width, height); }
+
+   void set_target_size(int width, int height)
+   {
+      width_ = width;
+      height_ = height;
+   }
+
+   // Tiles touched by lines (counted once per line) over the tiles in a row
+   // above which the row is accumulated densely. 0 makes every row dense,
+   // a large value none
+   void set_dense_threshold(float threshold) { dense_threshold_ = threshold; }
+   float dense_threshold() const { return dense_threshold_; }
+
+   // Replaces `out` with the coverage of the closed polygon(s) made of `lines`
+   void rasterize(const line_segment* lines, size_t count, fill_mode mode, coverage_strips& out);
+
+   const strip_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = strip_stats(); }
+
+private:
+   void bin_lines(const line_segment* lines, size_t count);
+
+   bool dense_row(int row) const
+   {
+      return row_tiles_[row] > dense_threshold_ * (float)((width_ + tile_size - 1) / tile_size);
+   }
+
+   struct binned_line
+   {
+      uint32_t row;
+      uint64_t key;
+   };
+
+   int width_ = 0;
+   int height_ = 0;
+   float dense_threshold_ = 0.4f;
+   std::vector<line_segment> clipped_;
+
+   // Tile rows [ty_min_, ty_max_]; row r owns keys_[row_offsets_[r] .. row_offsets_[r + 1])
+   int ty_min_ = 0;
+   int ty_max_ = -1;
+   std::vector<binned_line> binned_;
+   std::vector<uint32_t> row_offsets_;
+   std::vector<uint32_t> row_tiles_;   // tiles touched per row, a tile once per line
+   std::vector<uint64_t> keys_;
+   aligned_vector<float> acc_;
+   strip_stats stats_;
+};
+
+// Source-over of a premultiplied solid color through the coverage, moved by
+// (dx, dy) whole pixels and clipped to the target's clip rectangle
+void fill_coverage(image_rgba8& target, const coverage_strips& coverage, uint32_t color, int dx = 0, int dy = 0);
+
+}
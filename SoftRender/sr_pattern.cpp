@@ -0,0 +1,321 @@
+#include "sr_pattern.h"
+#include "sr_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace sr
+{
+
+// Texel coordinate i (a whole number) brought into [0, n). The period is
+// divided out with a reciprocal; the two corrections absorb its rounding
+static float extend_coord(float i, float n, extend_mode mode)
+{
+   if (mode == extend_mode::clamp)
+      return clamp(i, 0.0f, n - 1.0f);
+
+   const float p = mode == extend_mode::wrap ? n : 2.0f * n;
+   float r = i - p * floorf(i * (1.0f / p));
+   r = r >= p ? r - p : r;
+   r = r < 0.0f ? r + p : r;
+   return mode == extend_mode::mirror && r >= n ? p - 1.0f - r : r;
+}
+
+// extend_coord on 8 lanes, same operations
+static SR_FORCEINLINE vec8f extend_coord8(vec8f i, float n, extend_mode mode)
+{
+   if (mode == extend_mode::clamp)
+      return v8_clamp(i, v8_zero(), v8_set1(n - 1.0f));
+
+   const float p = mode == extend_mode::wrap ? n : 2.0f * n;
+   const vec8f period = v8_set1(p);
+   vec8f r = i - period * v8_floor(i * v8_set1(1.0f / p));
+   r = v8_select(v8_cmpge(r, period), r - period, r);
+   r = v8_select(v8_cmplt(r, v8_zero()), r + period, r);
+   if (mode == extend_mode::mirror)
+      r = v8_select(v8_cmpge(r, v8_set1(n)), v8_set1(p - 1.0f) - r, r);
+   return r;
+}
+
+static int extend_index(int i, int n, extend_mode mode)
+{
+   switch (mode)
+   {
+   case extend_mode::clamp:
+      return i < 0 ? 0 : i >= n ? n - 1 : i;
+   case extend_mode::wrap:
+      i %= n;
+      return i < 0 ? i + n : i;
+   case extend_mode::mirror:
+      i %= 2 * n;
+      i = i < 0 ? i + 2 * n : i;
+      return i < n ? i : 2 * n - 1 - i;
+   }
+   return 0;
+}
+
+bitmap_brush::bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                           bitmap_interpolation interpolation, const float3x2& transform, float opacity)
+   : bitmap_(&bitmap), extend_x_(extend_x), extend_y_(extend_y), interpolation_(interpolation), opacity_(opacity)
+{
+   float3x2 inv;
+   degenerate_ = bitmap.width() <= 0 || bitmap.height() <= 0 || !invert(transform, inv);
+   if (degenerate_)
+      return;
+
+   ux_ = inv.m11;
+   uy_ = inv.m21;
+   u0_ = inv.dx;
+   vx_ = inv.m12;
+   vy_ = inv.m22;
+   v0_ = inv.dy;
+
+   for (int y = 0; y < bitmap.height() && opaque_; y++)
+      for (int x = 0; x < bitmap.width(); x++)
+         opaque_ = opaque_ && (bitmap.at(x, y) >> 24) == 0xff;
+
+   // A whole-pixel translation samples texel centers exactly, so both
+   // interpolation modes reduce to copying rows
+   axis_aligned_ = transform.m11 == 1.0f && transform.m12 == 0.0f && transform.m21 == 0.0f && transform.m22 == 1.0f &&
+                   transform.dx == floorf(transform.dx) && transform.dy == floorf(transform.dy) &&
+                   fabsf(transform.dx) < 1e9f && fabsf(transform.dy) < 1e9f;
+   if (axis_aligned_)
+   {
+      offset_x_ = (int)transform.dx;
+      offset_y_ = (int)transform.dy;
+      expand_rows();
+   }
+}
+
+void bitmap_brush::expand_rows()
+{
+   // wrap:   the row tiled to one period plus a chunk
+   // mirror: the row and its reverse, tiled the same way
+   // clamp:  a chunk of the first pixel, the row, a chunk of the last pixel
+   const int w = bitmap_->width(), h = bitmap_->height();
+   period_x_ = extend_x_ == extend_mode::mirror ? 2 * w : w;
+   stride_ = extend_x_ == extend_mode::clamp ? (size_t)w + 2 * expand_chunk : (size_t)period_x_ + expand_chunk;
+   expanded_.resize(stride_ * h);
+   row_transparent_.assign(h, 1);
+
+   for (int y = 0; y < h; y++)
+   {
+      const uint32_t* src = bitmap_->row(y);
+      uint32_t* dst = &expanded_[stride_ * y];
+      for (size_t i = 0; i < stride_; i++)
+      {
+         const int x = extend_x_ == extend_mode::clamp ? (int)i - expand_chunk : (int)i;
+         dst[i] = src[extend_index(x, w, extend_x_)];
+      }
+      for (int x = 0; x < w; x++)
+         row_transparent_[y] = row_transparent_[y] && src[x] == 0;
+   }
+}
+
+int bitmap_brush::source_row(int y) const
+{
+   return extend_index(y - offset_y_, bitmap_->height(), extend_y_);
+}
+
+const uint32_t* bitmap_brush::expanded_row(int y) const
+{
+   return &expanded_[stride_ * y];
+}
+
+template<class F>
+void bitmap_brush::for_each_run(const uint32_t* row, int sx, int count, F&& emit) const
+{
+   if (extend_x_ == extend_mode::clamp)
+   {
+      const int w = bitmap_->width();
+      while (count > 0)
+      {
+         int n;
+         const uint32_t* src;
+         if (sx < 0)
+         {
+            n = -sx < expand_chunk ? -sx : expand_chunk;
+            src = row;
+         }
+         else if (sx < w)
+         {
+            n = w - sx;
+            src = row + expand_chunk + sx;
+         }
+         else
+         {
+            n = expand_chunk;
+            src = row + expand_chunk + w;
+         }
+         n = n < count ? n : count;
+         emit(src, n);
+         sx += n;
+         count -= n;
+      }
+      return;
+   }
+
+   int o = sx % period_x_;
+   o = o < 0 ? o + period_x_ : o;
+   while (count > 0)
+   {
+      const int n = count < expand_chunk ? count : expand_chunk;
+      emit(row + o, n);
+      o = (o + n) % period_x_;
+      count -= n;
+   }
+}
+
+uint32_t bitmap_brush::sample(float x, float y) const
+{
+   if (degenerate_)
+      return 0;
+
+   const float w = (float)bitmap_->width(), h = (float)bitmap_->height();
+   const float u = ux_ * x + (uy_ * y + u0_);
+   const float v = vx_ * x + (vy_ * y + v0_);
+   if (interpolation_ == bitmap_interpolation::nearest_neighbor)
+      return bitmap_->at((int)extend_coord(floorf(u), w, extend_x_), (int)extend_coord(floorf(v), h, extend_y_));
+
+   const float us = u - 0.5f, vs = v - 0.5f;
+   const float x0 = floorf(us), y0 = floorf(vs);
+   const float fx = us - x0, fy = vs - y0;
+   const int ix0 = (int)extend_coord(x0, w, extend_x_), ix1 = (int)extend_coord(x0 + 1.0f, w, extend_x_);
+   const int iy0 = (int)extend_coord(y0, h, extend_y_), iy1 = (int)extend_coord(y0 + 1.0f, h, extend_y_);
+   const uint32_t t00 = bitmap_->at(ix0, iy0), t10 = bitmap_->at(ix1, iy0);
+   const uint32_t t01 = bitmap_->at(ix0, iy1), t11 = bitmap_->at(ix1, iy1);
+
+   uint32_t out = 0;
+   for (int c = 0; c < 32; c += 8)
+   {
+      const float c00 = (float)((t00 >> c) & 0xff), c10 = (float)((t10 >> c) & 0xff);
+      const float c01 = (float)((t01 >> c) & 0xff), c11 = (float)((t11 >> c) & 0xff);
+      const float top = c00 + (c10 - c00) * fx;
+      const float bottom = c01 + (c11 - c01) * fx;
+      out |= (uint32_t)(top + (bottom - top) * fy + 0.5f) << c;
+   }
+   return out;
+}
+
+void bitmap_brush::span(int x, int y, int count, uint32_t* out) const
+{
+   if (count <= 0)
+      return;
+   if (degenerate_)
+   {
+      memset(out, 0, count * sizeof(uint32_t));
+      return;
+   }
+   if (axis_aligned_)
+   {
+      for_each_run(expanded_row(source_row(y)), x - offset_x_, count, [&out](const uint32_t* src, int n) {
+         memcpy(out, src, n * sizeof(uint32_t));
+         out += n;
+      });
+      return;
+   }
+   sample_span(x, y, count, out);
+}
+
+// The operations of sample(), 8 pixels at a time; texel indices are formed
+// in float, exact below 2^24
+void bitmap_brush::sample_span(int x, int y, int count, uint32_t* out) const
+{
+   const int32_t* texels = (const int32_t*)bitmap_->data();
+   const float w = (float)bitmap_->width(), h = (float)bitmap_->height();
+   const vec8f pitch = v8_set1((float)bitmap_->pitch());
+   const float py = y + 0.5f;
+   const vec8f ux = v8_set1(ux_), vx = v8_set1(vx_);
+   const vec8f u_row = v8_set1(uy_ * py + u0_), v_row = v8_set1(vy_ * py + v0_);
+   const vec8i byte = v8i_set1(0xff);
+   const vec8f half = v8_set1(0.5f), one = v8_set1(1.0f);
+
+   for (int i = 0; i < count; i += 8)
+   {
+      const vec8f px = v8_set1((float)x + 0.5f + (float)i) + v8_ramp();
+      const vec8f u = ux * px + u_row;
+      const vec8f v = vx * px + v_row;
+
+      vec8i result;
+      if (interpolation_ == bitmap_interpolation::nearest_neighbor)
+      {
+         const vec8f tx = extend_coord8(v8_floor(u), w, extend_x_);
+         const vec8f ty = extend_coord8(v8_floor(v), h, extend_y_);
+         result = v8i_gather(texels, v8_trunc_to_int(ty * pitch + tx));
+      }
+      else
+      {
+         const vec8f us = u - half, vs = v - half;
+         const vec8f x0 = v8_floor(us), y0 = v8_floor(vs);
+         const vec8f fx = us - x0, fy = vs - y0;
+         const vec8f tx0 = extend_coord8(x0, w, extend_x_), tx1 = extend_coord8(x0 + one, w, extend_x_);
+         const vec8f row0 = extend_coord8(y0, h, extend_y_) * pitch, row1 = extend_coord8(y0 + one, h, extend_y_) * pitch;
+         const vec8i t00 = v8i_gather(texels, v8_trunc_to_int(row0 + tx0));
+         const vec8i t10 = v8i_gather(texels, v8_trunc_to_int(row0 + tx1));
+         const vec8i t01 = v8i_gather(texels, v8_trunc_to_int(row1 + tx0));
+         const vec8i t11 = v8i_gather(texels, v8_trunc_to_int(row1 + tx1));
+
+         result = v8i_set1(0);
+         for (int c = 0; c < 32; c += 8)
+         {
+            const vec8f c00 = v8i_to_float(v8i_srli(t00, c) & byte), c10 = v8i_to_float(v8i_srli(t10, c) & byte);
+            const vec8f c01 = v8i_to_float(v8i_srli(t01, c) & byte), c11 = v8i_to_float(v8i_srli(t11, c) & byte);
+            const vec8f top = c00 + (c10 - c00) * fx;
+            const vec8f bottom = c01 + (c11 - c01) * fx;
+            result = result | v8i_slli(v8_trunc_to_int(top + (bottom - top) * fy + half), c);
+         }
+      }
+
+      if (count - i >= 8)
+      {
+         v8i_storeu(out + i, result);
+         continue;
+      }
+      alignas(32) int32_t tmp[8];
+      v8i_store(tmp, result);
+      memcpy(out + i, tmp, (count - i) * sizeof(uint32_t));
+   }
+}
+
+void fill_rect(image_rgba8& target, const rect_i& rect, const bitmap_brush& brush)
+{
+   const rect_i r = intersect(rect, target.clip());
+   if (r.empty() || brush.degenerate_ || !(brush.opacity_ > 0.0f))
+      return;
+
+   const bool copy = brush.opaque_ && brush.opacity_ >= 1.0f;
+   const float opacity = brush.opacity_;
+   if (brush.axis_aligned_)
+   {
+      for (int y = r.top; y < r.bottom; y++)
+      {
+         const int sy = brush.source_row(y);
+         if (brush.row_transparent_[sy])
+            continue;
+         uint32_t* dst = target.row(y) + r.left;
+         brush.for_each_run(brush.expanded_row(sy), r.left - brush.offset_x_, r.width(), [&](const uint32_t* src, int n) {
+            if (copy)
+               memcpy(dst, src, n * sizeof(uint32_t));
+            else
+               blend_over(dst, src, n, opacity);
+            dst += n;
+         });
+      }
+      return;
+   }
+
+   aligned_vector<uint32_t> colors(copy ? 0 : r.width());
+   for (int y = r.top; y < r.bottom; y++)
+   {
+      uint32_t* dst = target.row(y) + r.left;
+      if (copy)
+      {
+         brush.sample_span(r.left, y, r.width(), dst);
+         continue;
+      }
+      brush.sample_span(r.left, y, r.width(), colors.data());
+      blend_over(dst, colors.data(), r.width(), opacity);
+   }
+}
+
+}
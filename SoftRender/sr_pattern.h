@@ -0,0 +1,95 @@
+#pragma once
+
+// Bitmap brushes for the 2D path: m_pGridPatternBitmapBrush, a 10x10 grid
+// drawn into a compatible render target, wrapped in both directions and
+// filled over the whole offscreen surface at 50% opacity every frame.
+//
+// When the brush transform is a whole-pixel translation every target row is
+// a run of one bitmap row, so the brush keeps each bitmap row pre-expanded
+// (tiled, mirrored or edge-padded to one period plus a chunk) and fills
+// emit rows as memcpy or blend_over of contiguous chunks of it. Rows that
+// are fully transparent are skipped. Any other transform goes through an
+// 8-wide sampler that maps pixel centers to the bitmap, applies the extend
+// modes and gathers texels, nearest or bilinear.
+
+#include "sr_image.h"
+#include "sr_math.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// D2D1_BITMAP_INTERPOLATION_MODE
+enum class bitmap_interpolation
+{
+   nearest_neighbor,
+   linear,
+};
+
+class bitmap_brush
+{
+public:
+   // Chunk the pre-expanded rows extend past one period, in pixels
+   static const int expand_chunk = 256;
+
+   // `bitmap` must outlive the brush and hold fewer than 2^24 pixels;
+   // `transform` maps bitmap space to the target
+   bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x = extend_mode::wrap, extend_mode extend_y = extend_mode::wrap,
+                bitmap_interpolation interpolation = bitmap_interpolation::linear, const float3x2& transform = identity3x2(),
+                float opacity = 1.0f);
+
+   const image_rgba8& bitmap() const { return *bitmap_; }
+   float opacity() const { return opacity_; }
+
+   // Whole-pixel translation: fills copy pre-expanded rows
+   bool axis_aligned() const { return axis_aligned_; }
+
+   // Brush colors (opacity not applied) of pixels [x, x + count) of row y
+   void span(int x, int y, int count, uint32_t* out) const;
+
+   // Brush color at target point (x, y), one pixel at a time; the reference
+   // for the span paths
+   uint32_t sample(float x, float y) const;
+
+   // Pre-expanded row storage, zero unless axis-aligned
+   size_t bytes() const { return expanded_.size() * sizeof(uint32_t); }
+
+private:
+   friend void fill_rect(image_rgba8& target, const rect_i& rect, const bitmap_brush& brush);
+
+   void expand_rows();
+   const uint32_t* expanded_row(int y) const;
+   int source_row(int y) const;
+   void sample_span(int x, int y, int count, uint32_t* out) const;
+
+   // Calls emit(src, n) for consecutive runs covering `count` pixels of
+   // expanded row `row` starting at bitmap column sx
+   template<class F>
+   void for_each_run(const uint32_t* row, int sx, int count, F&& emit) const;
+
+   const image_rgba8* bitmap_;
+   extend_mode extend_x_;
+   extend_mode extend_y_;
+   bitmap_interpolation interpolation_;
+   float opacity_;
+   bool opaque_ = true;
+   bool degenerate_ = false;
+
+   // Bitmap position of a target point: u = ux * x + uy * y + u0, same for v
+   float ux_ = 0, uy_ = 0, u0_ = 0;
+   float vx_ = 0, vy_ = 0, v0_ = 0;
+
+   bool axis_aligned_ = false;
+   int offset_x_ = 0, offset_y_ = 0;
+   int period_x_ = 0;
+   size_t stride_ = 0;
+   aligned_vector<uint32_t> expanded_;
+   std::vector<uint8_t> row_transparent_;
+};
+
+// FillRectangle with a bitmap brush: source-over at the brush opacity,
+// clipped to the target
+void fill_rect(image_rgba8& target, const rect_i& rect, const bitmap_brush& brush);
+
+}
@@ -0,0 +1,358 @@
+#include "sr_quantize.h"
+
+namespace sr
+{
+
+uint32_t format_size(vertex_format format)
+{
+   switch (format)
+   {
+   case vertex_format::r32g32b32a32_float: return 16;
+   case vertex_format::r32g32b32_float: return 12;
+   case vertex_format::r16g16b16a16_snorm: return 8;
+   case vertex_format::r32g32_float: return 8;
+   case vertex_format::r8g8b8a8_unorm: return 4;
+   case vertex_format::r16g16_float: return 4;
+   case vertex_format::r16g16_unorm: return 4;
+   case vertex_format::r16g16_snorm: return 4;
+   }
+   return 0;
+}
+
+position_quantization position_bounds(const void* positions, size_t stride, size_t count)
+{
+   position_quantization q;
+   if (!count)
+      return q;
+   const uint8_t* p = (const uint8_t*)positions;
+   float3 lo, hi;
+   memcpy(&lo, p, sizeof(float3));
+   hi = lo;
+   for (size_t i = 1; i < count; i++)
+   {
+      float3 v;
+      memcpy(&v, p + i * stride, sizeof(float3));
+      lo = { v.x < lo.x ? v.x : lo.x, v.y < lo.y ? v.y : lo.y, v.z < lo.z ? v.z : lo.z };
+      hi = { v.x > hi.x ? v.x : hi.x, v.y > hi.y ? v.y : hi.y, v.z > hi.z ? v.z : hi.z };
+   }
+   q.scale = scale(sub(hi, lo), 0.5f);
+   q.bias = scale(add(hi, lo), 0.5f);
+   return q;
+}
+
+float4x4 dequantize_matrix(const position_quantization& q)
+{
+   return { {
+      { q.scale.x, 0.0f, 0.0f, 0.0f },
+      { 0.0f, q.scale.y, 0.0f, 0.0f },
+      { 0.0f, 0.0f, q.scale.z, 0.0f },
+      { q.bias.x, q.bias.y, q.bias.z, 1.0f },
+   } };
+}
+
+size_t stream_input_layout(bool uvs, uv_encoding uv, bool normals, bool colors, input_element out[4])
+{
+   size_t n = 0;
+   auto element = [&](const char* semantic, vertex_format format) {
+      out[n] = { semantic, 0, format, (uint32_t)n, 0 };
+      n++;
+   };
+   element("POSITION", vertex_format::r16g16b16a16_snorm);
+   if (uvs)
+      element("TEXCOORD", uv == uv_encoding::half ? vertex_format::r16g16_float : vertex_format::r16g16_unorm);
+   if (normals)
+      element("NORMAL", vertex_format::r16g16_snorm);
+   if (colors)
+      element("COLOR", vertex_format::r8g8b8a8_unorm);
+   return n;
+}
+
+void quantize_mesh(const vertex_source& source, uv_encoding uv, quantized_mesh& out)
+{
+   const size_t n = source.count;
+   out.vertex_count = n;
+   out.uv = uv;
+   out.position = position_bounds(source.positions, source.position_stride, n);
+   out.positions.resize(4 * n);
+   out.uvs.resize(source.uvs ? 2 * n : 0);
+   out.normals.resize(source.normals ? 2 * n : 0);
+   out.colors.resize(source.colors ? 4 * n : 0);
+
+   encode_positions(source.positions, source.position_stride, n, out.position, out.positions.data());
+   if (source.uvs)
+      encode_uvs(source.uvs, source.uv_stride, n, uv, out.uvs.data());
+   if (source.normals)
+      encode_normals(source.normals, source.normal_stride, n, out.normals.data());
+   if (source.colors)
+      encode_colors(source.colors, source.color_stride, source.color_components, n, out.colors.data());
+}
+
+// ---------------------------------------------------------------------------
+// Linear streams
+
+static SR_FORCEINLINE vec8i v8i_select(vec8f mask, vec8i a, vec8i b)
+{
+   return v8_as_int(v8_select(mask, v8i_as_float(a), v8i_as_float(b)));
+}
+
+static SR_FORCEINLINE void store_lanes(int16_t* p, vec8i v) { v8i_store_16(p, v); }
+static SR_FORCEINLINE void store_lanes(uint16_t* p, vec8i v) { v8i_store_16(p, v); }
+static SR_FORCEINLINE void store_lanes(uint8_t* p, vec8i v) { v8i_store_u8(p, v); }
+static SR_FORCEINLINE vec8i load_lanes(const int16_t* p) { return v8i_load_i16(p); }
+static SR_FORCEINLINE vec8i load_lanes(const uint16_t* p) { return v8i_load_u16(p); }
+static SR_FORCEINLINE vec8i load_lanes(const uint8_t* p) { return v8i_load_u8(p); }
+
+// float_to_half() and half_to_float() 8 lanes at a time
+static SR_FORCEINLINE vec8i v8_to_half(vec8f f)
+{
+#if defined(SR_SIMD_F16C)
+   return { _mm256_cvtepu16_epi32(_mm256_cvtps_ph(f.v, _MM_FROUND_TO_NEAREST_INT)) };
+#else
+   const vec8f a = v8_abs(f);
+   const vec8i u = v8_as_int(a);
+   const vec8f nan = v8_andnot(v8_cmpeq(a, a), v8i_as_float(v8i_set1(-1)));
+   const vec8i special = v8i_set1(0x7c00) | (v8_as_int(nan) & v8i_set1(0x0200));
+   const vec8i denormal = v8_as_int(a + v8_set1(0.5f)) - v8i_set1(0x3f000000);
+   const vec8i normal = v8i_srli(u + v8i_set1((int32_t)0xc8000fffu) + (v8i_srli(u, 13) & v8i_set1(1)), 13);
+   vec8i h = v8i_select(v8_cmplt(a, v8_set1(6.103515625e-05f)), denormal, normal);
+   h = v8i_select(v8_cmpge(a, v8_set1(65536.0f)) | nan, special, h);
+   return h | v8i_srli(v8_as_int(f) & v8i_set1((int32_t)0x80000000u), 16);
+#endif
+}
+
+static SR_FORCEINLINE vec8f v8_from_half(const uint16_t* p)
+{
+#if defined(SR_SIMD_F16C)
+   return { _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)p)) };
+#else
+   const vec8i h = v8i_load_u16(p);
+   const vec8f f = v8i_as_float(v8i_slli(h & v8i_set1(0x7fff), 13)) * v8_set1(5.192296858534828e33f);
+   const vec8i special = v8_as_int(v8_cmpge(f, v8_set1(65536.0f))) & v8i_set1(0x7f800000);
+   return v8i_as_float(v8_as_int(f) | special | v8i_slli(h & v8i_set1(0x8000), 16));
+#endif
+}
+
+static const size_t block_vertices = 64;
+
+// Copies `count` strided vertices of Components floats into `out`, Width
+// floats apart, the missing components set to `fill` and the block padded
+// with zeros to a multiple of 8 floats
+template <int Components, int Width>
+static void stage(const uint8_t* src, size_t stride, size_t count, float fill, float* out)
+{
+   for (size_t i = 0; i < count; i++, src += stride, out += Width)
+   {
+      const float* v = (const float*)src;
+      for (int c = 0; c < Width; c++)
+         out[c] = c < Components ? v[c] : fill;
+   }
+   for (size_t i = count * Width; i % 8; i++, out++)
+      *out = 0.0f;
+}
+
+// Runs a strided source through stage() a block at a time and `convert`
+// over the Width floats of each vertex, 8 values to a call
+template <int Components, int Width, typename T, typename Convert>
+static void encode_linear(const void* src, size_t stride, size_t count, float fill, T* out, Convert convert)
+{
+   alignas(32) float block[block_vertices * Width + 8];
+   const uint8_t* p = (const uint8_t*)src;
+   for (size_t i = 0; i < count; i += block_vertices)
+   {
+      const size_t vertices = count - i < block_vertices ? count - i : block_vertices;
+      const size_t n = vertices * Width;
+      stage<Components, Width>(p + i * stride, stride, vertices, fill, block);
+      T* o = out + i * Width;
+      size_t j = 0;
+      for (; j + 8 <= n; j += 8)
+         convert(v8_load(block + j), o + j);
+      if (j < n)
+      {
+         T t[8];
+         convert(v8_load(block + j), t);
+         memcpy(o + j, t, (n - j) * sizeof(T));
+      }
+   }
+}
+
+// out[i] = convert(in + i) over `n` values, 8 at a time
+template <typename T, typename Convert>
+static void decode_linear(const T* in, size_t n, float* out, Convert convert)
+{
+   size_t i = 0;
+   for (; i + 8 <= n; i += 8)
+      v8_storeu(out + i, convert(in + i));
+   if (i < n)
+   {
+      T t[8] = {};
+      float o[8];
+      memcpy(t, in + i, (n - i) * sizeof(T));
+      v8_storeu(o, convert(t));
+      memcpy(out + i, o, (n - i) * sizeof(float));
+   }
+}
+
+void encode_positions(const void* positions, size_t stride, size_t count, const position_quantization& q, int16_t* out)
+{
+   // w goes in as 0 and comes out as 32767
+   const float sx = q.scale.x > 0.0f ? 32767.0f / q.scale.x : 0.0f;
+   const float sy = q.scale.y > 0.0f ? 32767.0f / q.scale.y : 0.0f;
+   const float sz = q.scale.z > 0.0f ? 32767.0f / q.scale.z : 0.0f;
+   const vec8f s = v8_set(sx, sy, sz, 0.0f, sx, sy, sz, 0.0f);
+   const vec8f b = v8_set(-q.bias.x * sx, -q.bias.y * sy, -q.bias.z * sz, 32767.0f, -q.bias.x * sx, -q.bias.y * sy, -q.bias.z * sz, 32767.0f);
+   const vec8f lo = v8_set1(-32767.0f), hi = v8_set1(32767.0f);
+   encode_linear<3, 4>(positions, stride, count, 0.0f, out, [&](vec8f v, int16_t* o) {
+      store_lanes(o, v8_round_to_int(v8_min(v8_max(v8_fmadd(v, s, b), lo), hi)));
+   });
+}
+
+void decode_positions(const int16_t* in, size_t count, const position_quantization& q, float4* out)
+{
+   const float r = 1.0f / 32767.0f;
+   const vec8f s = v8_set(q.scale.x * r, q.scale.y * r, q.scale.z * r, 0.0f, q.scale.x * r, q.scale.y * r, q.scale.z * r, 0.0f);
+   const vec8f b = v8_set(q.bias.x, q.bias.y, q.bias.z, 1.0f, q.bias.x, q.bias.y, q.bias.z, 1.0f);
+   const vec8f lo = v8_set1(-32767.0f);
+   decode_linear(in, 4 * count, &out->x, [&](const int16_t* p) {
+      return v8_fmadd(v8_max(v8i_to_float(load_lanes(p)), lo), s, b);
+   });
+}
+
+void encode_uvs(const void* uvs, size_t stride, size_t count, uv_encoding encoding, uint16_t* out)
+{
+   if (encoding == uv_encoding::half)
+   {
+      encode_linear<2, 2>(uvs, stride, count, 0.0f, out, [&](vec8f v, uint16_t* o) { store_lanes(o, v8_to_half(v)); });
+      return;
+   }
+   const vec8f s = v8_set1(65535.0f), hi = v8_set1(65535.0f);
+   encode_linear<2, 2>(uvs, stride, count, 0.0f, out, [&](vec8f v, uint16_t* o) {
+      store_lanes(o, v8_round_to_int(v8_min(v8_max(v * s, v8_zero()), hi)));
+   });
+}
+
+void decode_uvs(const uint16_t* in, size_t count, uv_encoding encoding, float2* out)
+{
+   if (encoding == uv_encoding::half)
+   {
+      decode_linear(in, 2 * count, &out->x, [&](const uint16_t* p) { return v8_from_half(p); });
+      return;
+   }
+   const vec8f s = v8_set1(1.0f / 65535.0f);
+   decode_linear(in, 2 * count, &out->x, [&](const uint16_t* p) { return v8i_to_float(load_lanes(p)) * s; });
+}
+
+void encode_colors(const void* colors, size_t stride, int components, size_t count, uint8_t* out)
+{
+   const vec8f s = v8_set1(255.0f), hi = v8_set1(255.0f);
+   auto convert = [&](vec8f v, uint8_t* o) { store_lanes(o, v8_round_to_int(v8_min(v8_max(v * s, v8_zero()), hi))); };
+   if (components == 3)
+      encode_linear<3, 4>(colors, stride, count, 1.0f, out, convert);
+   else
+      encode_linear<4, 4>(colors, stride, count, 1.0f, out, convert);
+}
+
+void decode_colors(const uint8_t* in, size_t count, float4* out)
+{
+   const vec8f s = v8_set1(1.0f / 255.0f);
+   decode_linear(in, 4 * count, &out->x, [&](const uint8_t* p) { return v8i_to_float(load_lanes(p)) * s; });
+}
+
+// ---------------------------------------------------------------------------
+// Octahedral normals, 8 vertices at a time: x in the low and y in the high
+// half of each 32-bit lane
+
+// copysign(a, b)
+static SR_FORCEINLINE vec8f v8_copysign(vec8f a, vec8f b)
+{
+   const vec8f sign = v8_set1(-0.0f);
+   return v8_andnot(sign, a) | (b & sign);
+}
+
+static SR_FORCEINLINE vec8i encode_octahedral8(vec8f nx, vec8f ny, vec8f nz)
+{
+   const vec8f zero = v8_zero(), one = v8_set1(1.0f);
+   const vec8f l1 = v8_abs(nx) + v8_abs(ny) + v8_abs(nz);
+   const vec8f inv = v8_select(v8_cmpgt(l1, zero), one / l1, zero);
+   vec8f x = nx * inv, y = ny * inv;
+   const vec8f lower = v8_cmplt(nz, zero);
+   const vec8f fx = v8_copysign(one - v8_abs(y), x), fy = v8_copysign(one - v8_abs(x), y);
+   x = v8_select(lower, fx, x);
+   y = v8_select(lower, fy, y);
+   const vec8f s = v8_set1(32767.0f), lo = v8_set1(-1.0f);
+   const vec8i qx = v8_round_to_int(v8_min(v8_max(x, lo), one) * s);
+   const vec8i qy = v8_round_to_int(v8_min(v8_max(y, lo), one) * s);
+   return (qx & v8i_set1(0xffff)) | v8i_slli(qy, 16);
+}
+
+static SR_FORCEINLINE void decode_octahedral8(vec8i q, vec8f& nx, vec8f& ny, vec8f& nz)
+{
+   const vec8f r = v8_set1(1.0f / 32767.0f), lo = v8_set1(-1.0f);
+   vec8f x = v8_max(v8i_to_float(v8i_srai(v8i_slli(q, 16), 16)) * r, lo);
+   vec8f y = v8_max(v8i_to_float(v8i_srai(q, 16)) * r, lo);
+   const vec8f z = v8_set1(1.0f) - v8_abs(x) - v8_abs(y);
+   const vec8f t = v8_max(v8_zero() - z, v8_zero());
+   x = x - v8_copysign(t, x);
+   y = y - v8_copysign(t, y);
+   const vec8f inv = v8_set1(1.0f) / v8_sqrt(x * x + y * y + z * z);
+   nx = x * inv;
+   ny = y * inv;
+   nz = z * inv;
+}
+
+void encode_normals(const void* normals, size_t stride, size_t count, int16_t* out)
+{
+   const uint8_t* p = (const uint8_t*)normals;
+   for (size_t i = 0; i < count; i += 8)
+   {
+      const int lanes = count - i < 8 ? (int)(count - i) : 8;
+      alignas(32) float n[3][8] = {};
+      for (int k = 0; k < lanes; k++)
+      {
+         float3 v;
+         memcpy(&v, p + (i + k) * stride, sizeof(float3));
+         n[0][k] = v.x;
+         n[1][k] = v.y;
+         n[2][k] = v.z;
+      }
+      const vec8i q = encode_octahedral8(v8_load(n[0]), v8_load(n[1]), v8_load(n[2]));
+      if (lanes == 8)
+      {
+         v8i_storeu(out + 2 * i, q);
+      }
+      else
+      {
+         alignas(32) int32_t t[8];
+         v8i_store(t, q);
+         memcpy(out + 2 * i, t, lanes * sizeof(int32_t));
+      }
+   }
+}
+
+void decode_normals(const int16_t* in, size_t count, float* nx, float* ny, float* nz)
+{
+   size_t i = 0;
+   vec8f x, y, z;
+   for (; i + 8 <= count; i += 8)
+   {
+      decode_octahedral8(v8i_loadu(in + 2 * i), x, y, z);
+      v8_storeu(nx + i, x);
+      v8_storeu(ny + i, y);
+      v8_storeu(nz + i, z);
+   }
+   if (i < count)
+   {
+      const size_t lanes = count - i;
+      int32_t t[8] = {};
+      memcpy(t, in + 2 * i, lanes * sizeof(int32_t));
+      decode_octahedral8(v8i_loadu(t), x, y, z);
+      float o[3][8];
+      v8_storeu(o[0], x);
+      v8_storeu(o[1], y);
+      v8_storeu(o[2], z);
+      memcpy(nx + i, o[0], lanes * sizeof(float));
+      memcpy(ny + i, o[1], lanes * sizeof(float));
+      memcpy(nz + i, o[2], lanes * sizeof(float));
+   }
+}
+
+}
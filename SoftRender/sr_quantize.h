@@ -0,0 +1,216 @@
+#pragma once
+
+// Quantized vertex streams.
+//
+// SimpleVertex in DXGISample is 20 bytes of float3 position and float2
+// texture coordinate, Test5's vertex 20 bytes of float2 position and float3
+// color, Test4's 16 bytes of float2 position and float2 texture coordinate;
+// a mesh with a normal and a color as well takes 44 to 48 bytes a vertex.
+// Here each attribute goes into its own tightly packed stream, bound to its
+// own input slot:
+//
+//   POSITION  R16G16B16A16_SNORM  8 bytes  per-mesh scale and bias
+//   TEXCOORD  R16G16_UNORM        4 bytes  [0, 1], or R16G16_FLOAT when tiled
+//   NORMAL    R16G16_SNORM        4 bytes  octahedral
+//   COLOR     R8G8B8A8_UNORM      4 bytes
+//
+// 20 bytes in all. The input assembler turns the stored values back into
+// floats; positions arrive in [-1, 1] with w = 1, and dequantize_matrix()
+// concatenated in front of World takes them back to mesh space, so the
+// vertex shader only changes for the normal, which it unfolds from the
+// octahedron with the few lines of decode_octahedral().
+//
+// On the CPU, every stream but the normals is a plain array of 16- or 8-bit
+// values whose scale and bias repeat every 2 or 4 values, so encoding and
+// decoding go straight through it 8 values at a time in vec8f without any
+// shuffling. Normals go 8 vertices at a time, the two components of a
+// vertex in one 32-bit lane, and decode to one array per component.
+// Encoders read strided floats, e.g. &s_VertexArray[0].Pos with stride
+// sizeof(SimpleVertex), copied through a small block on the stack first.
+
+#include "sr_math.h"
+#include "sr_simd.h"
+
+#include <string.h>
+
+#include <vector>
+
+namespace sr
+{
+
+// DXGI_FORMAT values, so a D3D11 caller can cast them
+enum class vertex_format : uint32_t
+{
+   r32g32b32a32_float = 2,
+   r32g32b32_float = 6,
+   r16g16b16a16_snorm = 13,
+   r32g32_float = 16,
+   r8g8b8a8_unorm = 28,
+   r16g16_float = 34,
+   r16g16_unorm = 35,
+   r16g16_snorm = 37,
+};
+
+uint32_t format_size(vertex_format format);
+
+// D3D11_INPUT_ELEMENT_DESC, per-vertex data only
+struct input_element
+{
+   const char* semantic;
+   uint32_t semantic_index;
+   vertex_format format;
+   uint32_t input_slot;
+   uint32_t offset;
+};
+
+// Mesh space position = stored snorm value * scale + bias, per axis
+struct position_quantization
+{
+   float3 scale = { 1.0f, 1.0f, 1.0f };
+   float3 bias = { 0.0f, 0.0f, 0.0f };
+};
+
+// The bounding box of `count` float3 positions mapped onto [-1, 1]
+position_quantization position_bounds(const void* positions, size_t stride, size_t count);
+
+// Scale and bias as a matrix, to go in front of World
+float4x4 dequantize_matrix(const position_quantization& q);
+
+enum class uv_encoding
+{
+   unorm16,   // clamped to [0, 1], steps of 1/65535
+   half,      // any range, 11 significant bits
+};
+
+// Strided float attributes of `count` vertices; all but positions optional
+struct vertex_source
+{
+   size_t count = 0;
+   const void* positions = nullptr;   // float3
+   size_t position_stride = 0;
+   const void* uvs = nullptr;         // float2
+   size_t uv_stride = 0;
+   const void* normals = nullptr;     // float3, unit length
+   size_t normal_stride = 0;
+   const void* colors = nullptr;      // float3 or float4 in [0, 1]
+   size_t color_stride = 0;
+   int color_components = 4;          // 3: alpha stored as 1
+};
+
+// One element per stream present, positions always, slots numbered from 0
+// in the order position, uv, normal, color, offset 0; the slot's stride is
+// format_size() of its element. Returns the element count
+size_t stream_input_layout(bool uvs, uv_encoding uv, bool normals, bool colors, input_element out[4]);
+
+struct quantized_mesh
+{
+   size_t vertex_count = 0;
+   position_quantization position;
+   uv_encoding uv = uv_encoding::unorm16;
+
+   std::vector<int16_t> positions;   // x y z 32767
+   std::vector<uint16_t> uvs;        // u v, unorm16 or half bits
+   std::vector<int16_t> normals;     // octahedral x y
+   std::vector<uint8_t> colors;      // r g b a
+
+   size_t bytes() const
+   {
+      return 2 * (positions.size() + uvs.size() + normals.size()) + colors.size();
+   }
+
+   size_t input_layout(input_element out[4]) const
+   {
+      return stream_input_layout(!uvs.empty(), uv, !normals.empty(), !colors.empty(), out);
+   }
+};
+
+void quantize_mesh(const vertex_source& source, uv_encoding uv, quantized_mesh& out);
+
+// The streams one at a time. Encoded streams hold 4 values per vertex for
+// positions and colors, 2 for uvs and normals; decoded positions have w = 1
+void encode_positions(const void* positions, size_t stride, size_t count, const position_quantization& q, int16_t* out);
+void decode_positions(const int16_t* in, size_t count, const position_quantization& q, float4* out);
+void encode_uvs(const void* uvs, size_t stride, size_t count, uv_encoding encoding, uint16_t* out);
+void decode_uvs(const uint16_t* in, size_t count, uv_encoding encoding, float2* out);
+void encode_normals(const void* normals, size_t stride, size_t count, int16_t* out);
+void decode_normals(const int16_t* in, size_t count, float* nx, float* ny, float* nz);
+void encode_colors(const void* colors, size_t stride, int components, size_t count, uint8_t* out);
+void decode_colors(const uint8_t* in, size_t count, float4* out);
+
+// ---------------------------------------------------------------------------
+// One value at a time, rounding the same way as the streams
+
+// Round to nearest even; 65520 and up to infinity, NaN to a quiet NaN
+inline uint16_t float_to_half(float f)
+{
+   uint32_t u;
+   memcpy(&u, &f, 4);
+   const uint32_t sign = u & 0x80000000u;
+   u ^= sign;
+   uint32_t h;
+   if (u >= 0x47800000u)
+   {
+      h = u > 0x7f800000u ? 0x7e00u : 0x7c00u;
+   }
+   else if (u < 0x38800000u)
+   {
+      // Below 2^-14: adding 0.5 leaves the denormal, rounded, in the low bits
+      float t;
+      memcpy(&t, &u, 4);
+      t += 0.5f;
+      memcpy(&h, &t, 4);
+      h -= 0x3f000000u;
+   }
+   else
+   {
+      // Rebias the exponent and round the 13 bits shifted out to even
+      h = (u + 0xc8000fffu + ((u >> 13) & 1)) >> 13;
+   }
+   return (uint16_t)(h | (sign >> 16));
+}
+
+inline float half_to_float(uint16_t h)
+{
+   // The magnitude moved into place and rebiased by 2^112, denormals included
+   uint32_t u = (uint32_t)(h & 0x7fff) << 13;
+   float f;
+   memcpy(&f, &u, 4);
+   f *= 5.192296858534828e33f;
+   memcpy(&u, &f, 4);
+   if (u >= 0x47800000u)
+      u |= 0x7f800000u;
+   u |= (uint32_t)(h & 0x8000) << 16;
+   memcpy(&f, &u, 4);
+   return f;
+}
+
+// n projected onto the octahedron |x| + |y| + |z| = 1, the lower half folded
+// over the upper, x and y stored. A zero vector encodes as (0, 0, 1)
+inline void encode_octahedral(const float3& n, int16_t out[2])
+{
+   const float l1 = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+   const float inv = l1 > 0.0f ? 1.0f / l1 : 0.0f;
+   float x = n.x * inv, y = n.y * inv;
+   if (n.z < 0.0f)
+   {
+      const float fx = copysignf(1.0f - fabsf(y), x);
+      y = copysignf(1.0f - fabsf(x), y);
+      x = fx;
+   }
+   out[0] = (int16_t)lrintf(clamp(x, -1.0f, 1.0f) * 32767.0f);
+   out[1] = (int16_t)lrintf(clamp(y, -1.0f, 1.0f) * 32767.0f);
+}
+
+inline float3 decode_octahedral(const int16_t in[2])
+{
+   float x = in[0] > -32767 ? (float)in[0] * (1.0f / 32767.0f) : -1.0f;
+   float y = in[1] > -32767 ? (float)in[1] * (1.0f / 32767.0f) : -1.0f;
+   const float z = 1.0f - fabsf(x) - fabsf(y);
+   const float t = z < 0.0f ? -z : 0.0f;
+   x -= copysignf(t, x);
+   y -= copysignf(t, y);
+   const float inv = 1.0f / sqrtf(x * x + y * y + z * z);
+   return { x * inv, y * inv, z * inv };
+}
+
+}
@@ -0,0 +1,120 @@
+#include "sr_raster.h"
+
+#include <math.h>
+
+namespace sr
+{
+
+bool setup_triangle(
+   const screen_vertex& v0,
+   const screen_vertex& v1,
+   const screen_vertex& v2,
+   int target_width,
+   int target_height,
+   cull_mode cull,
+   raster_triangle& tri
+   )
+{
+   const screen_vertex* in[3] = { &v0, &v1, &v2 };
+   for (int i = 0; i < 3; i++)
+   {
+      if (!(fabsf(in[i]->x) <= raster_max_coordinate) || !(fabsf(in[i]->y) <= raster_max_coordinate))
+         return false;
+   }
+
+   // Snapped to sixteenths; the snapped positions are exact in float too
+   int64_t fx[3], fy[3];
+   screen_vertex s[3];
+   for (int i = 0; i < 3; i++)
+   {
+      fx[i] = (int64_t)lrintf(in[i]->x * 16.0f);
+      fy[i] = (int64_t)lrintf(in[i]->y * 16.0f);
+      s[i] = { (float)fx[i] * (1.0f / 16.0f), (float)fy[i] * (1.0f / 16.0f), in[i]->z };
+   }
+   const screen_vertex* v[3] = { &s[0], &s[1], &s[2] };
+
+   // Twice the signed area; positive means clockwise on screen (y down)
+   const int64_t farea = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fx[2] - fx[0]) * (fy[1] - fy[0]);
+   if (farea == 0)
+      return false;
+
+   tri.front_facing = farea > 0;
+   if (cull == cull_mode::back && !tri.front_facing)
+      return false;
+   if (cull == cull_mode::front && tri.front_facing)
+      return false;
+
+   const float sign = tri.front_facing ? 1.0f : -1.0f;
+   const int64_t isign = tri.front_facing ? 1 : -1;
+   for (int e = 0; e < 3; e++)
+   {
+      const screen_vertex& p = *v[e];
+      const screen_vertex& q = *v[(e + 1) % 3];
+      float a = -(q.y - p.y) * sign;
+      float b = (q.x - p.x) * sign;
+      tri.a[e] = a;
+      tri.b[e] = b;
+      tri.c[e] = -(a * p.x + b * p.y);
+
+      // In sixteenths, relative to the edge's first vertex: the center of
+      // pixel (x, y) is at 16 x + 8, 16 y + 8
+      const int p0 = e, p1 = (e + 1) % 3;
+      const int64_t ia = -(fy[p1] - fy[p0]) * isign;
+      const int64_t ib = (fx[p1] - fx[p0]) * isign;
+      tri.top_left[e] = ia > 0 || (ia == 0 && ib > 0);
+      tri.ea[e] = 16 * ia;
+      tri.eb[e] = 16 * ib;
+      tri.ec[e] = ia * (8 - fx[p0]) + ib * (8 - fy[p0]) - (tri.top_left[e] ? 0 : 1);
+   }
+
+   float area2 = (float)farea * (1.0f / 256.0f);
+   area2 = fabsf(area2);
+   tri.area2 = area2;
+
+   // Edge (e) is opposite vertex (e + 2) % 3, so it carries that vertex's weight
+   const float inv_area = 1.0f / area2;
+   const float dz1 = s[1].z - s[0].z;
+   const float dz2 = s[2].z - s[0].z;
+   tri.z_a = (tri.a[2] * dz1 + tri.a[0] * dz2) * inv_area;
+   tri.z_b = (tri.b[2] * dz1 + tri.b[0] * dz2) * inv_area;
+   tri.z_c = s[0].z - tri.z_a * s[0].x - tri.z_b * s[0].y;
+   tri.z_min = fminf(v0.z, fminf(v1.z, v2.z));
+   tri.z_max = fmaxf(v0.z, fmaxf(v1.z, v2.z));
+
+   // Pixel i is a candidate when its center i + 0.5 lies within the extent
+   const float min_xf = fminf(s[0].x, fminf(s[1].x, s[2].x));
+   const float max_xf = fmaxf(s[0].x, fmaxf(s[1].x, s[2].x));
+   const float min_yf = fminf(s[0].y, fminf(s[1].y, s[2].y));
+   const float max_yf = fmaxf(s[0].y, fmaxf(s[1].y, s[2].y));
+
+   const float w = (float)target_width;
+   const float h = (float)target_height;
+   tri.min_x = (int)clamp(ceilf(min_xf - 0.5f), 0.0f, w);
+   tri.max_x = (int)clamp(floorf(max_xf - 0.5f) + 1.0f, 0.0f, w);
+   tri.min_y = (int)clamp(ceilf(min_yf - 0.5f), 0.0f, h);
+   tri.max_y = (int)clamp(floorf(max_yf - 0.5f) + 1.0f, 0.0f, h);
+
+   return tri.min_x < tri.max_x && tri.min_y < tri.max_y;
+}
+
+block_coverage classify_block(const raster_triangle& tri, int x0, int y0, int x1, int y1)
+{
+   bool all_inside = true;
+   for (int e = 0; e < 3; e++)
+   {
+      // Corner with the largest edge value decides "fully outside",
+      // the one with the smallest decides "fully inside"
+      const int hi_x = tri.ea[e] >= 0 ? x1 - 1 : x0;
+      const int lo_x = tri.ea[e] >= 0 ? x0 : x1 - 1;
+      const int hi_y = tri.eb[e] >= 0 ? y1 - 1 : y0;
+      const int lo_y = tri.eb[e] >= 0 ? y0 : y1 - 1;
+
+      if (edge_at(tri, e, hi_x, hi_y) < 0)
+         return block_coverage::outside;
+      if (edge_at(tri, e, lo_x, lo_y) < 0)
+         all_inside = false;
+   }
+   return all_inside ? block_coverage::inside : block_coverage::partial;
+}
+
+}
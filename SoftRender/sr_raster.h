@@ -0,0 +1,131 @@
+#pragma once
+
+// Triangle setup shared by the software rasterizer stages.
+//
+// Conventions follow D3D11: pixel centers sit at (x + 0.5, y + 0.5), y grows
+// downwards, clockwise triangles are front facing and the top-left fill rule
+// decides ownership of pixels that land exactly on an edge.
+//
+// Vertices are snapped to 1/16 pixel (D3D11 asks for 1/256; sixteenths keep
+// the per-pixel edge steps in 32 bits) and coverage is decided on integer
+// edge functions, exactly: a pixel is inside or not the same way whether it
+// is tested alone, in a row of 8 or through the corners of a block.
+
+#include "sr_simd.h"
+
+namespace sr
+{
+
+// Vertex after the viewport transform: x/y in pixels, z in [0, 1]
+struct screen_vertex
+{
+   float x, y, z;
+};
+
+enum class cull_mode
+{
+   none,
+   front,
+   back,
+};
+
+struct raster_triangle
+{
+   // Edge i is inside where a*x + b*y + c > 0, or == 0 on a top-left edge.
+   // Coefficients are oriented so the interior is always positive. For
+   // sample positions off the pixel centers; coverage of pixel centers goes
+   // through the fixed-point edges below
+   float a[3], b[3], c[3];
+   bool top_left[3];
+
+   // Edge i at the center of pixel (x, y) is ea[i] * x + eb[i] * y + ec[i]
+   // in 1/256 pixel squared, exact, with the top-left rule folded into ec:
+   // the pixel is inside when all three are >= 0
+   int64_t ea[3], eb[3], ec[3];
+
+   // Depth plane z = z_a * x + z_b * y + z_c and its range over the triangle
+   float z_a, z_b, z_c;
+   float z_min, z_max;
+
+   // Pixel bounding box clipped to the render target, [min, max)
+   int min_x, min_y, max_x, max_y;
+
+   // Twice the screen-space area, always positive after setup
+   float area2;
+   bool front_facing;
+};
+
+// Vertices farther than this many pixels from the origin are not set up;
+// the clipper's guard band is well inside it
+static const float raster_max_coordinate = 131072.0f;
+
+// Builds edge equations and the depth plane for one triangle. Returns false
+// when the triangle is culled, degenerate or falls outside the target.
+bool setup_triangle(
+   const screen_vertex& v0,
+   const screen_vertex& v1,
+   const screen_vertex& v2,
+   int target_width,
+   int target_height,
+   cull_mode cull,
+   raster_triangle& tri
+   );
+
+// Fixed-point edge value at the center of pixel (x, y); inside when >= 0
+inline int64_t edge_at(const raster_triangle& tri, int edge, int x, int y)
+{
+   return tri.ea[edge] * x + tri.eb[edge] * y + tri.ec[edge];
+}
+
+inline bool pixel_inside(const raster_triangle& tri, int x, int y)
+{
+   return (edge_at(tri, 0, x, y) | edge_at(tri, 1, x, y) | edge_at(tri, 2, x, y)) >= 0;
+}
+
+inline float depth_at(const raster_triangle& tri, float x, float y)
+{
+   return tri.z_a * x + tri.z_b * y + tri.z_c;
+}
+
+// Coverage mask (bit i = pixel x + i) for 8 horizontally adjacent pixel centers
+// starting at (x, y). Pixels outside the triangle bounding box are not masked
+// here; callers clip against the box themselves.
+SR_FORCEINLINE int coverage_row8(const raster_triangle& tri, int x, int y)
+{
+   // Each edge steps by at most 2^26 a pixel within the coordinate limit, so
+   // a start value clamped to +-2^29 keeps its sign over the 8 pixels and
+   // the lanes stay in 32 bits. Outside is a set sign bit on any edge
+   vec8i any_negative = v8i_set1(0);
+   for (int e = 0; e < 3; e++)
+   {
+      int64_t v = edge_at(tri, e, x, y);
+      v = v > (1 << 29) ? (1 << 29) : v < -(1 << 29) ? -(1 << 29) : v;
+      const int32_t s = (int32_t)tri.ea[e];
+      const int32_t v0 = (int32_t)v;
+      any_negative = any_negative | v8i_set(v0, v0 + s, v0 + 2 * s, v0 + 3 * s, v0 + 4 * s, v0 + 5 * s, v0 + 6 * s, v0 + 7 * s);
+   }
+   return ~v8_movemask(v8i_as_float(any_negative)) & 0xff;
+}
+
+// Depth plane at the 8 pixel centers (x .. x + 7, y), unclamped. Every
+// stage that compares depths goes through this, so they agree to the bit
+SR_FORCEINLINE vec8f depth_row8(const raster_triangle& tri, int x, int y)
+{
+   const vec8f px = v8_set1((float)x + 0.5f) + v8_ramp();
+   const vec8f row = v8_fmadd(v8_set1(tri.z_b), v8_set1((float)y + 0.5f), v8_set1(tri.z_c));
+   return v8_fmadd(v8_set1(tri.z_a), px, row);
+}
+
+// Result of testing an axis-aligned block of pixel centers against the triangle
+enum class block_coverage
+{
+   outside,
+   partial,
+   inside,
+};
+
+// Classifies the pixel centers of the block [x0, x1) x [y0, y1) by evaluating
+// the edges at the extreme corner of each edge.
+block_coverage classify_block(const raster_triangle& tri, int x0, int y0, int x1, int y1);
+
+}
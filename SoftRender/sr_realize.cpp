@@ -0,0 +1,209 @@
+#include "sr_realize.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace sr
+{
+
+static uint32_t float_bits(float f)
+{
+   uint32_t u;
+   memcpy(&u, &f, sizeof(u));
+   return u;
+}
+
+bool realization_cache::shape_key::operator==(const shape_key& o) const
+{
+   // Bitwise, so a key never matches a transform it was not built with
+   return id == o.id && revision == o.revision &&
+          float_bits(m11) == float_bits(o.m11) && float_bits(m12) == float_bits(o.m12) &&
+          float_bits(m21) == float_bits(o.m21) && float_bits(m22) == float_bits(o.m22) &&
+          float_bits(tolerance) == float_bits(o.tolerance);
+}
+
+size_t realization_cache::shape_key_hash::operator()(const shape_key& k) const
+{
+   uint64_t h = k.id * 0x9e3779b97f4a7c15ull ^ k.revision;
+   for (float f : { k.m11, k.m12, k.m21, k.m22, k.tolerance })
+      h = (h ^ float_bits(f)) * 0xff51afd7ed558ccdull;
+   return (size_t)(h ^ (h >> 32));
+}
+
+void realization_cache::set_budget(size_t bytes)
+{
+   budget_ = bytes;
+   if (bytes_ > budget_)
+      evict(nullptr);
+}
+
+void realization_cache::clear()
+{
+   shapes_.clear();
+   bytes_ = 0;
+}
+
+void realization_cache::fill(image_rgba8& target, const path_geometry& geometry, const float3x2& transform, uint32_t color, float tolerance)
+{
+   stats_.fills++;
+
+   const shape_key key = { geometry.id(), geometry.revision(), transform.m11, transform.m12, transform.m21, transform.m22, tolerance };
+   auto it = shapes_.find(key);
+   if (it == shapes_.end())
+   {
+      stats_.edge_misses++;
+      it = shapes_.emplace(key, shape()).first;
+      shape& s = it->second;
+      const float3x2 linear = { transform.m11, transform.m12, transform.m21, transform.m22, 0.0f, 0.0f };
+      flatten_path(geometry, linear, tolerance, s.edges);
+      s.edges.shrink_to_fit();
+      s.min = { INFINITY, INFINITY };
+      s.max = { -INFINITY, -INFINITY };
+      for (const line_segment& l : s.edges)
+      {
+         s.min = { fminf(s.min.x, fminf(l.x0, l.x1)), fminf(s.min.y, fminf(l.y0, l.y1)) };
+         s.max = { fmaxf(s.max.x, fmaxf(l.x0, l.x1)), fmaxf(s.max.y, fmaxf(l.y0, l.y1)) };
+      }
+      s.last_used = ++clock_;
+      account(s, sizeof(shape) + s.edges.size() * sizeof(line_segment));
+   }
+   else
+   {
+      stats_.edge_hits++;
+   }
+
+   shape& s = it->second;
+   s.last_used = ++clock_;
+   if (s.edges.empty())
+      return;
+
+   const float dx = transform.dx, dy = transform.dy;
+   const rect_i& clip = target.clip();
+   if (s.max.x + dx <= (float)clip.left || s.max.y + dy <= (float)clip.top || s.min.x + dx >= (float)clip.right || s.min.y + dy >= (float)clip.bottom)
+   {
+      stats_.culled++;
+      return;
+   }
+
+   const fill_mode mode = geometry.get_fill_mode();
+   if (s.max.x - s.min.x > (float)max_mask_size || s.max.y - s.min.y > (float)max_mask_size)
+   {
+      fill_edges(target, s, dx, dy, mode, color);
+      return;
+   }
+
+   // Whole pixels move the mask; the rest selects the phase
+   const int steps = subpixel_steps_ > 0 ? subpixel_steps_ : 1;
+   const float fx = floorf(dx), fy = floorf(dy);
+   int ix = (int)fx, iy = (int)fy;
+   int phase_x = (int)lroundf((dx - fx) * steps);
+   int phase_y = (int)lroundf((dy - fy) * steps);
+   if (subpixel_steps_ <= 0 && (dx != fx || dy != fy))
+   {
+      fill_edges(target, s, dx, dy, mode, color);
+      return;
+   }
+   if (phase_x == steps)
+   {
+      phase_x = 0;
+      ix++;
+   }
+   if (phase_y == steps)
+   {
+      phase_y = 0;
+      iy++;
+   }
+
+   const mask& m = realize_mask(s, phase_x, phase_y, mode);
+   fill_coverage(target, m.coverage, color, ix + m.origin_x, iy + m.origin_y);
+}
+
+void realization_cache::fill_edges(image_rgba8& target, const shape& s, float dx, float dy, fill_mode mode, uint32_t color)
+{
+   stats_.edge_fills++;
+   lines_.resize(s.edges.size());
+   for (size_t i = 0; i < s.edges.size(); i++)
+   {
+      const line_segment& l = s.edges[i];
+      lines_[i] = { l.x0 + dx, l.y0 + dy, l.x1 + dx, l.y1 + dy };
+   }
+   raster_.set_target_size(target.width(), target.height());
+   raster_.rasterize(lines_.data(), lines_.size(), mode, coverage_);
+   fill_coverage(target, coverage_, color);
+}
+
+const realization_cache::mask& realization_cache::realize_mask(shape& s, int phase_x, int phase_y, fill_mode mode)
+{
+   for (const mask& m : s.masks)
+   {
+      if (m.phase_x == phase_x && m.phase_y == phase_y && m.mode == mode)
+      {
+         stats_.mask_hits++;
+         return m;
+      }
+   }
+   stats_.mask_misses++;
+
+   // One spare pixel on each axis takes the phase
+   const int origin_x = (int)floorf(s.min.x), origin_y = (int)floorf(s.min.y);
+   const int width = (int)ceilf(s.max.x) - origin_x + 1;
+   const int height = (int)ceilf(s.max.y) - origin_y + 1;
+   const int steps = subpixel_steps_ > 0 ? subpixel_steps_ : 1;
+   const float ox = (float)phase_x / steps - (float)origin_x;
+   const float oy = (float)phase_y / steps - (float)origin_y;
+   lines_.resize(s.edges.size());
+   for (size_t i = 0; i < s.edges.size(); i++)
+   {
+      const line_segment& l = s.edges[i];
+      lines_[i] = { l.x0 + ox, l.y0 + oy, l.x1 + ox, l.y1 + oy };
+   }
+
+   s.masks.push_back({ phase_x, phase_y, mode, origin_x, origin_y, coverage_strips() });
+   mask& m = s.masks.back();
+   raster_.set_target_size(width, height);
+   raster_.rasterize(lines_.data(), lines_.size(), mode, m.coverage);
+   m.coverage.strips.shrink_to_fit();
+   m.coverage.alphas.shrink_to_fit();
+   m.coverage.spans.shrink_to_fit();
+   account(s, sizeof(mask) + m.coverage.bytes());
+   return m;
+}
+
+void realization_cache::account(shape& s, size_t added)
+{
+   s.bytes += added;
+   bytes_ += added;
+   if (bytes_ > budget_)
+      evict(&s);
+}
+
+void realization_cache::evict(const shape* keep)
+{
+   // Down to 3/4 of the budget, so a full cache does not sort on every miss.
+   // The realization being drawn stays even if it alone is over budget
+   const size_t target = budget_ - budget_ / 4;
+   std::vector<std::pair<uint64_t, const shape_key*>> order;
+   order.reserve(shapes_.size());
+   for (const auto& e : shapes_)
+   {
+      if (&e.second != keep)
+         order.push_back({ e.second.last_used, &e.first });
+   }
+   std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, const shape_key*>& a, const std::pair<uint64_t, const shape_key*>& b) {
+      return a.first < b.first;
+   });
+
+   for (const auto& o : order)
+   {
+      if (bytes_ <= target)
+         break;
+      auto it = shapes_.find(*o.second);
+      bytes_ -= it->second.bytes;
+      shapes_.erase(it);
+      stats_.evictions++;
+   }
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+// Geometry realizations: the CPU counterpart of ID2D1GeometryRealization for
+// paths that are filled again and again, like the hourglass that
+// DXGISampleApp::RenderD2DContentIntoSurface fills twice every frame.
+//
+// A realization is keyed by the geometry (id and revision), the 2x2 part of
+// the transform and the flattening tolerance, so one realization serves every
+// translation. It holds the flattened edges, which replay exactly at any
+// offset, and coverage masks per 1/subpixel_steps pixel phase of the
+// translation, which replay at any whole-pixel offset with no rasterization.
+// With phases disabled, fractional translations replay the edges instead.
+// Least recently used realizations go when the memory budget is exceeded.
+
+#include "sr_path.h"
+
+#include <unordered_map>
+
+namespace sr
+{
+
+struct realization_stats
+{
+   uint64_t fills = 0;
+   uint64_t edge_hits = 0;
+   uint64_t edge_misses = 0;     // == geometries flattened
+   uint64_t mask_hits = 0;
+   uint64_t mask_misses = 0;     // == masks rasterized
+   uint64_t edge_fills = 0;      // rasterized from the edges into the target
+   uint64_t culled = 0;          // entirely outside the clip
+   uint64_t evictions = 0;
+
+   double mask_hit_rate() const { return mask_hits + mask_misses ? (double)mask_hits / (double)(mask_hits + mask_misses) : 0.0; }
+};
+
+class realization_cache
+{
+public:
+   // Larger shapes are not worth a mask and replay their edges
+   static const int max_mask_size = 2048;
+
+   explicit realization_cache(size_t budget_bytes = 32u << 20) : budget_(budget_bytes) {}
+
+   // Masks snap the translation to 1/steps pixel (at most half a step off).
+   // 0 keeps fills exact: only whole-pixel translations use masks
+   void set_subpixel_steps(int steps) { subpixel_steps_ = steps; clear(); }
+   int subpixel_steps() const { return subpixel_steps_; }
+
+   void set_budget(size_t bytes);
+   size_t budget() const { return budget_; }
+   size_t bytes() const { return bytes_; }
+   size_t realization_count() const { return shapes_.size(); }
+
+   // FillGeometry with a premultiplied solid color. Reuses or creates the
+   // realization of `geometry` under the 2x2 part of `transform`
+   void fill(image_rgba8& target, const path_geometry& geometry, const float3x2& transform, uint32_t color, float tolerance = 0.25f);
+
+   void clear();
+
+   const realization_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = realization_stats(); }
+
+private:
+   struct shape_key
+   {
+      uint64_t id;
+      uint32_t revision;
+      float m11, m12, m21, m22;
+      float tolerance;
+
+      bool operator==(const shape_key& o) const;
+   };
+
+   struct shape_key_hash
+   {
+      size_t operator()(const shape_key& k) const;
+   };
+
+   struct mask
+   {
+      int phase_x, phase_y;   // translation phase in 1/subpixel_steps() pixel
+      fill_mode mode;
+      int origin_x, origin_y; // mask (0, 0) relative to the whole-pixel translation
+      coverage_strips coverage;
+   };
+
+   struct shape
+   {
+      std::vector<line_segment> edges;   // translation not applied
+      float2 min, max;
+      std::vector<mask> masks;
+      size_t bytes = 0;
+      uint64_t last_used = 0;
+   };
+
+   void fill_edges(image_rgba8& target, const shape& s, float dx, float dy, fill_mode mode, uint32_t color);
+   const mask& realize_mask(shape& s, int phase_x, int phase_y, fill_mode mode);
+   void account(shape& s, size_t added);
+   void evict(const shape* keep);
+
+   size_t budget_;
+   int subpixel_steps_ = 4;
+   size_t bytes_ = 0;
+   uint64_t clock_ = 0;
+   std::unordered_map<shape_key, shape, shape_key_hash> shapes_;
+   strip_rasterizer raster_;
+   std::vector<line_segment> lines_;
+   coverage_strips coverage_;
+   realization_stats stats_;
+};
+
+}
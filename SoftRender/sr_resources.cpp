@@ -0,0 +1,280 @@
+#include "sr_resources.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace sr
+{
+
+static uint32_t float_bits(float f)
+{
+   // -0 and 0 are the same color
+   if (f == 0.0f)
+      f = 0.0f;
+   uint32_t u;
+   memcpy(&u, &f, sizeof(u));
+   return u;
+}
+
+static uint64_t mix(uint64_t h, uint64_t v)
+{
+   return (h ^ v) * 0xff51afd7ed558ccdull;
+}
+
+// ---------------------------------------------------------------------------
+// Backends
+
+std::unique_ptr<solid_color_brush> software_backend::create_solid_brush(const color_f& color)
+{
+   return std::unique_ptr<solid_color_brush>(new solid_color_brush{ color, premultiplied_rgba8(color) });
+}
+
+std::unique_ptr<gradient_stops> software_backend::create_gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size)
+{
+   return std::unique_ptr<gradient_stops>(new gradient_stops(stops, count, extend, lut_size));
+}
+
+std::unique_ptr<bitmap_brush> software_backend::create_bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                                                    bitmap_interpolation interpolation, const float3x2& transform, float opacity)
+{
+   return std::unique_ptr<bitmap_brush>(new bitmap_brush(bitmap, extend_x, extend_y, interpolation, transform, opacity));
+}
+
+bool mock_backend::record(resource_kind kind)
+{
+   log_.push_back(kind);
+   if (fail_next_ > 0)
+   {
+      fail_next_--;
+      failed_++;
+      return false;
+   }
+   created_[(int)kind]++;
+   return true;
+}
+
+std::unique_ptr<solid_color_brush> mock_backend::create_solid_brush(const color_f& color)
+{
+   if (!record(resource_kind::solid_brush))
+      return nullptr;
+   return software_backend::create_solid_brush(color);
+}
+
+std::unique_ptr<gradient_stops> mock_backend::create_gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size)
+{
+   if (!record(resource_kind::gradient_stops))
+      return nullptr;
+   return software_backend::create_gradient_stops(stops, count, extend, lut_size);
+}
+
+std::unique_ptr<bitmap_brush> mock_backend::create_bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                                                bitmap_interpolation interpolation, const float3x2& transform, float opacity)
+{
+   if (!record(resource_kind::bitmap_brush))
+      return nullptr;
+   return software_backend::create_bitmap_brush(bitmap, extend_x, extend_y, interpolation, transform, opacity);
+}
+
+// ---------------------------------------------------------------------------
+// Keys
+
+size_t resource_cache::solid_key_hash::operator()(const solid_key& k) const
+{
+   uint64_t h = 0x9e3779b97f4a7c15ull;
+   for (uint32_t v : { k.r, k.g, k.b, k.a })
+      h = mix(h, v);
+   return (size_t)(h ^ (h >> 32));
+}
+
+bool resource_cache::bitmap_key::operator==(const bitmap_key& o) const
+{
+   return bitmap == o.bitmap && extend_x == o.extend_x && extend_y == o.extend_y && interpolation == o.interpolation &&
+          memcmp(transform, o.transform, sizeof(transform)) == 0 && opacity == o.opacity;
+}
+
+size_t resource_cache::bitmap_key_hash::operator()(const bitmap_key& k) const
+{
+   uint64_t h = (uint64_t)(uintptr_t)k.bitmap * 0x9e3779b97f4a7c15ull;
+   h = mix(h, (uint64_t)k.extend_x | (uint64_t)k.extend_y << 8 | (uint64_t)k.interpolation << 16);
+   for (uint32_t v : k.transform)
+      h = mix(h, v);
+   h = mix(h, k.opacity);
+   return (size_t)(h ^ (h >> 32));
+}
+
+static uint64_t hash_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size)
+{
+   uint64_t h = mix(0x9e3779b97f4a7c15ull, (uint64_t)extend | (uint64_t)lut_size << 8);
+   for (size_t i = 0; i < count; i++)
+   {
+      const gradient_stop& s = stops[i];
+      h = mix(h, float_bits(s.position));
+      h = mix(h, (uint64_t)float_bits(s.color.r) | (uint64_t)float_bits(s.color.g) << 32);
+      h = mix(h, (uint64_t)float_bits(s.color.b) | (uint64_t)float_bits(s.color.a) << 32);
+   }
+   return h ^ (h >> 32);
+}
+
+static bool same_stops(const std::vector<gradient_stop>& a, const gradient_stop* b, size_t count)
+{
+   if (a.size() != count)
+      return false;
+   for (size_t i = 0; i < count; i++)
+   {
+      if (float_bits(a[i].position) != float_bits(b[i].position) ||
+          float_bits(a[i].color.r) != float_bits(b[i].color.r) || float_bits(a[i].color.g) != float_bits(b[i].color.g) ||
+          float_bits(a[i].color.b) != float_bits(b[i].color.b) || float_bits(a[i].color.a) != float_bits(b[i].color.a))
+         return false;
+   }
+   return true;
+}
+
+// ---------------------------------------------------------------------------
+// Cache
+
+void resource_cache::count_request(bool hit, bool failed)
+{
+   for (resource_counters* c : { &frame_, &total_ })
+   {
+      c->requests++;
+      c->hits += hit;
+      c->created += !hit && !failed;
+      c->failed += failed;
+   }
+}
+
+const solid_color_brush* resource_cache::solid_brush(const color_f& color)
+{
+   const solid_key key = { float_bits(color.r), float_bits(color.g), float_bits(color.b), float_bits(color.a) };
+   auto it = solids_.find(key);
+   if (it != solids_.end())
+   {
+      it->second.last_used = frame_index_;
+      count_request(true, false);
+      return it->second.object.get();
+   }
+
+   std::unique_ptr<solid_color_brush> brush = backend_->create_solid_brush(color);
+   count_request(false, !brush);
+   if (!brush)
+      return nullptr;
+   entry<solid_color_brush>& e = solids_[key];
+   e.object = std::move(brush);
+   e.last_used = frame_index_;
+   return e.object.get();
+}
+
+const gradient_stops* resource_cache::stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size)
+{
+   const uint64_t h = hash_stops(stops, count, extend, lut_size);
+   const auto range = gradients_.equal_range(h);
+   for (auto it = range.first; it != range.second; ++it)
+   {
+      gradient_entry& e = it->second;
+      if (e.extend == extend && e.lut_size == lut_size && same_stops(e.stops, stops, count))
+      {
+         e.last_used = frame_index_;
+         count_request(true, false);
+         return e.object.get();
+      }
+   }
+
+   std::unique_ptr<gradient_stops> created = backend_->create_gradient_stops(stops, count, extend, lut_size);
+   count_request(false, !created);
+   if (!created)
+      return nullptr;
+   gradient_entry e;
+   e.object = std::move(created);
+   e.last_used = frame_index_;
+   e.stops.assign(stops, stops + count);
+   e.extend = extend;
+   e.lut_size = lut_size;
+   return gradients_.emplace(h, std::move(e))->second.object.get();
+}
+
+const bitmap_brush* resource_cache::bitmap(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                           bitmap_interpolation interpolation, const float3x2& transform, float opacity)
+{
+   const bitmap_key key = { &bitmap, extend_x, extend_y, interpolation,
+                            { float_bits(transform.m11), float_bits(transform.m12), float_bits(transform.m21),
+                              float_bits(transform.m22), float_bits(transform.dx), float_bits(transform.dy) },
+                            float_bits(opacity) };
+   auto it = bitmaps_.find(key);
+   if (it != bitmaps_.end())
+   {
+      it->second.last_used = frame_index_;
+      count_request(true, false);
+      return it->second.object.get();
+   }
+
+   std::unique_ptr<bitmap_brush> brush = backend_->create_bitmap_brush(bitmap, extend_x, extend_y, interpolation, transform, opacity);
+   count_request(false, !brush);
+   if (!brush)
+      return nullptr;
+   entry<bitmap_brush>& e = bitmaps_[key];
+   e.object = std::move(brush);
+   e.last_used = frame_index_;
+   return e.object.get();
+}
+
+void resource_cache::forget(const image_rgba8& bitmap)
+{
+   for (auto it = bitmaps_.begin(); it != bitmaps_.end();)
+      it = it->first.bitmap == &bitmap ? bitmaps_.erase(it) : std::next(it);
+}
+
+void resource_cache::clear()
+{
+   solids_.clear();
+   gradients_.clear();
+   bitmaps_.clear();
+}
+
+void resource_cache::begin_frame()
+{
+   frame_ = resource_counters();
+   if (size() > max_resources_)
+      evict();
+   frame_index_++;
+}
+
+void resource_cache::evict()
+{
+   // Down to 3/4 of the limit, so a full cache does not sort every frame.
+   // Resources of the frame that just ended stay even if that is over
+   struct candidate
+   {
+      uint64_t last_used;
+      resource_kind kind;
+      decltype(solids_)::iterator solid;
+      decltype(gradients_)::iterator gradient;
+      decltype(bitmaps_)::iterator bitmap;
+   };
+   std::vector<candidate> order;
+   order.reserve(size());
+   for (auto it = solids_.begin(); it != solids_.end(); ++it)
+      order.push_back({ it->second.last_used, resource_kind::solid_brush, it, {}, {} });
+   for (auto it = gradients_.begin(); it != gradients_.end(); ++it)
+      order.push_back({ it->second.last_used, resource_kind::gradient_stops, {}, it, {} });
+   for (auto it = bitmaps_.begin(); it != bitmaps_.end(); ++it)
+      order.push_back({ it->second.last_used, resource_kind::bitmap_brush, {}, {}, it });
+   std::sort(order.begin(), order.end(), [](const candidate& a, const candidate& b) { return a.last_used < b.last_used; });
+
+   const size_t target = max_resources_ - max_resources_ / 4;
+   for (const candidate& c : order)
+   {
+      if (size() <= target || c.last_used >= frame_index_)
+         break;
+      if (c.kind == resource_kind::solid_brush)
+         solids_.erase(c.solid);
+      else if (c.kind == resource_kind::gradient_stops)
+         gradients_.erase(c.gradient);
+      else
+         bitmaps_.erase(c.bitmap);
+      frame_.evictions++;
+      total_.evictions++;
+   }
+}
+
+}
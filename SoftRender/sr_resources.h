@@ -0,0 +1,187 @@
+#pragma once
+
+// Brush interning for the 2D path. Test1's D2DDraw and the Update functions
+// of test2 and Test3 call CreateSolidColorBrush inside the draw function
+// every frame, and DXGISample's CreateD2DDeviceResources creates every
+// gradient stop collection and brush again whenever it runs.
+//
+// resource_cache hands out one shared object per value: solid brushes keyed
+// by color, gradient stop collections by stop list, extend mode and LUT size,
+// and bitmap brushes by bitmap, extend modes, interpolation, transform and
+// opacity. A repeated request is a hash lookup that returns the existing
+// object. Objects are made by a resource_backend; software_backend builds
+// the real brushes and mock_backend counts and logs what it is asked for
+// (and can fail on request), so interning can be checked without drawing.
+// Per-frame counters show whether a steady frame creates anything.
+
+#include "sr_gradient.h"
+#include "sr_pattern.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace sr
+{
+
+// ID2D1SolidColorBrush
+struct solid_color_brush
+{
+   color_f color;
+   uint32_t pixel;   // premultiplied RGBA8, for the solid fills
+};
+
+enum class resource_kind
+{
+   solid_brush,
+   gradient_stops,
+   bitmap_brush,
+};
+
+// The ID2D1RenderTarget::Create* calls. Returning null is a failed creation
+class resource_backend
+{
+public:
+   virtual ~resource_backend() = default;
+
+   virtual std::unique_ptr<solid_color_brush> create_solid_brush(const color_f& color) = 0;
+   virtual std::unique_ptr<gradient_stops> create_gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size) = 0;
+   virtual std::unique_ptr<bitmap_brush> create_bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                                             bitmap_interpolation interpolation, const float3x2& transform, float opacity) = 0;
+};
+
+class software_backend : public resource_backend
+{
+public:
+   std::unique_ptr<solid_color_brush> create_solid_brush(const color_f& color) override;
+   std::unique_ptr<gradient_stops> create_gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size) override;
+   std::unique_ptr<bitmap_brush> create_bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                                     bitmap_interpolation interpolation, const float3x2& transform, float opacity) override;
+};
+
+// Software brushes plus a record of every creation, for headless checks
+class mock_backend : public software_backend
+{
+public:
+   std::unique_ptr<solid_color_brush> create_solid_brush(const color_f& color) override;
+   std::unique_ptr<gradient_stops> create_gradient_stops(const gradient_stop* stops, size_t count, extend_mode extend, int lut_size) override;
+   std::unique_ptr<bitmap_brush> create_bitmap_brush(const image_rgba8& bitmap, extend_mode extend_x, extend_mode extend_y,
+                                                     bitmap_interpolation interpolation, const float3x2& transform, float opacity) override;
+
+   // The next `count` creations fail (D2DERR_RECREATE_TARGET and friends)
+   void fail_next(int count) { fail_next_ = count; }
+
+   uint64_t created(resource_kind kind) const { return created_[(int)kind]; }
+   uint64_t failed() const { return failed_; }
+   const std::vector<resource_kind>& log() const { return log_; }
+   void reset() { *this = mock_backend(); }
+
+private:
+   bool record(resource_kind kind);
+
+   int fail_next_ = 0;
+   uint64_t created_[3] = {};
+   uint64_t failed_ = 0;
+   std::vector<resource_kind> log_;
+};
+
+struct resource_counters
+{
+   uint64_t requests = 0;
+   uint64_t hits = 0;
+   uint64_t created = 0;
+   uint64_t failed = 0;
+   uint64_t evictions = 0;
+};
+
+class resource_cache
+{
+public:
+   // `backend` must outlive the cache. Beyond max_resources, resources not
+   // used for the longest go at begin_frame()
+   explicit resource_cache(resource_backend& backend, size_t max_resources = 4096) : backend_(&backend), max_resources_(max_resources) {}
+
+   // Starts a frame: resets frame() and evicts if over the limit. Resources
+   // used in the frame that just ended are never evicted, so a pointer stays
+   // valid as long as it is requested again every frame
+   void begin_frame();
+
+   // Null only when the backend fails; failures are not interned
+   const solid_color_brush* solid_brush(const color_f& color);
+   const gradient_stops* stops(const gradient_stop* stops, size_t count, extend_mode extend = extend_mode::clamp, int lut_size = 256);
+   const bitmap_brush* bitmap(const image_rgba8& bitmap, extend_mode extend_x = extend_mode::wrap, extend_mode extend_y = extend_mode::wrap,
+                              bitmap_interpolation interpolation = bitmap_interpolation::linear,
+                              const float3x2& transform = identity3x2(), float opacity = 1.0f);
+
+   // Bitmap brushes are keyed by the bitmap's address; drop them before the
+   // bitmap changes or goes away
+   void forget(const image_rgba8& bitmap);
+
+   // Device loss: everything is created again on next use
+   void clear();
+
+   size_t size() const { return solids_.size() + gradients_.size() + bitmaps_.size(); }
+   uint64_t frame_index() const { return frame_index_; }
+   const resource_counters& frame() const { return frame_; }
+   const resource_counters& total() const { return total_; }
+   void reset_stats() { frame_ = total_ = resource_counters(); }
+
+private:
+   struct solid_key
+   {
+      uint32_t r, g, b, a;   // float bits
+
+      bool operator==(const solid_key& o) const { return r == o.r && g == o.g && b == o.b && a == o.a; }
+   };
+
+   struct solid_key_hash
+   {
+      size_t operator()(const solid_key& k) const;
+   };
+
+   struct bitmap_key
+   {
+      const image_rgba8* bitmap;
+      extend_mode extend_x, extend_y;
+      bitmap_interpolation interpolation;
+      uint32_t transform[6];   // float bits
+      uint32_t opacity;
+
+      bool operator==(const bitmap_key& o) const;
+   };
+
+   struct bitmap_key_hash
+   {
+      size_t operator()(const bitmap_key& k) const;
+   };
+
+   template<class T>
+   struct entry
+   {
+      std::unique_ptr<T> object;
+      uint64_t last_used;
+   };
+
+   // Gradients are keyed by a hash of the stop list and compared stop by
+   // stop, so lookups do not copy the list
+   struct gradient_entry : entry<gradient_stops>
+   {
+      std::vector<gradient_stop> stops;
+      extend_mode extend;
+      int lut_size;
+   };
+
+   void count_request(bool hit, bool failed);
+   void evict();
+
+   resource_backend* backend_;
+   size_t max_resources_;
+   uint64_t frame_index_ = 0;
+   std::unordered_map<solid_key, entry<solid_color_brush>, solid_key_hash> solids_;
+   std::unordered_multimap<uint64_t, gradient_entry> gradients_;
+   std::unordered_map<bitmap_key, entry<bitmap_brush>, bitmap_key_hash> bitmaps_;
+   resource_counters frame_;
+   resource_counters total_;
+};
+
+}
@@ -0,0 +1,378 @@
+#include "sr_scene.h"
+
+#include <math.h>
+
+namespace sr
+{
+
+// ---------------------------------------------------------------------------
+// display_list
+
+bool draw_command::operator==(const draw_command& o) const
+{
+   if (kind != o.kind || bounds.left != o.bounds.left || bounds.top != o.bounds.top ||
+       bounds.right != o.bounds.right || bounds.bottom != o.bounds.bottom)
+      return false;
+
+   switch (kind)
+   {
+   case draw_kind::fill_rect:
+      return color == o.color && rect.left == o.rect.left && rect.top == o.rect.top &&
+             rect.right == o.rect.right && rect.bottom == o.rect.bottom;
+   case draw_kind::fill_geometry:
+      return color == o.color && geometry_id == o.geometry_id && geometry_revision == o.geometry_revision &&
+             transform.m11 == o.transform.m11 && transform.m12 == o.transform.m12 &&
+             transform.m21 == o.transform.m21 && transform.m22 == o.transform.m22 &&
+             transform.dx == o.transform.dx && transform.dy == o.transform.dy;
+   case draw_kind::draw_image:
+      return image == o.image && x == o.x && y == o.y && opacity == o.opacity;
+   case draw_kind::fill_gradient:
+      return gradient == o.gradient;
+   case draw_kind::fill_bitmap:
+      return bitmap == o.bitmap;
+   case draw_kind::push_layer:
+      return opacity == o.opacity;
+   case draw_kind::pop_layer:
+      return true;
+   case draw_kind::draw_text:
+      return color == o.color && text_hash == o.text_hash && text_length == o.text_length &&
+             format.font == o.format.font && format.size == o.format.size && format.alignment == o.format.alignment &&
+             format.paragraph == o.format.paragraph && format.word_wrap == o.format.word_wrap &&
+             rect.left == o.rect.left && rect.top == o.rect.top && rect.right == o.rect.right && rect.bottom == o.rect.bottom &&
+             transform.m11 == o.transform.m11 && transform.m12 == o.transform.m12 &&
+             transform.m21 == o.transform.m21 && transform.m22 == o.transform.m22 &&
+             transform.dx == o.transform.dx && transform.dy == o.transform.dy;
+   }
+   return false;
+}
+
+void display_list::fill_rect(const rect_f& rect, uint32_t color)
+{
+   draw_command c = {};
+   c.kind = draw_kind::fill_rect;
+   c.color = color;
+   c.rect = rect;
+   c.bounds = enclosing_pixels(rect);
+   commands_.push_back(c);
+}
+
+void display_list::fill_rect(const rect_i& rect, const gradient_brush& brush)
+{
+   draw_command c = {};
+   c.kind = draw_kind::fill_gradient;
+   c.gradient = &brush;
+   c.bounds = rect;
+   commands_.push_back(c);
+}
+
+void display_list::fill_rect(const rect_i& rect, const bitmap_brush& brush)
+{
+   draw_command c = {};
+   c.kind = draw_kind::fill_bitmap;
+   c.bitmap = &brush;
+   c.bounds = rect;
+   commands_.push_back(c);
+}
+
+void display_list::fill_geometry(const path_geometry& geometry, const float3x2& transform, uint32_t color)
+{
+   draw_command c = {};
+   c.kind = draw_kind::fill_geometry;
+   c.color = color;
+   c.geometry = &geometry;
+   c.geometry_id = geometry.id();
+   c.geometry_revision = geometry.revision();
+   c.transform = transform;
+
+   // The control points bound the curves; one more pixel each side covers
+   // the realization's subpixel snapping
+   float2 min, max;
+   geometry.bounds(min, max);
+   c.bounds = { 0, 0, 0, 0 };
+   if (min.x <= max.x)
+   {
+      rect_f r = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+      for (const float2& p : { min, max, float2{ min.x, max.y }, float2{ max.x, min.y } })
+      {
+         const float2 q = transform_point(p, transform);
+         r = { fminf(r.left, q.x), fminf(r.top, q.y), fmaxf(r.right, q.x), fmaxf(r.bottom, q.y) };
+      }
+      const rect_i b = enclosing_pixels(r);
+      c.bounds = { b.left - 1, b.top - 1, b.right + 1, b.bottom + 1 };
+   }
+   commands_.push_back(c);
+}
+
+void display_list::draw_image(const image_rgba8& image, int x, int y, float opacity)
+{
+   draw_command c = {};
+   c.kind = draw_kind::draw_image;
+   c.image = &image;
+   c.x = x;
+   c.y = y;
+   c.opacity = opacity;
+   c.bounds = { x, y, x + image.width(), y + image.height() };
+   commands_.push_back(c);
+}
+
+void display_list::draw_text(const char* text, size_t length, const text_format& format, const rect_f& box, const float3x2& transform,
+                             uint32_t color)
+{
+   draw_command c = {};
+   c.kind = draw_kind::draw_text;
+   c.color = color;
+   c.rect = box;
+   c.format = format;
+   c.transform = transform;
+   c.text_offset = (uint32_t)text_.size();
+   c.text_length = (uint32_t)length;
+   text_.append(text, length);
+
+   uint64_t h = 0xcbf29ce484222325ull;
+   for (size_t i = 0; i < length; i++)
+      h = (h ^ (uint8_t)text[i]) * 0x100000001b3ull;
+   c.text_hash = h;
+
+   // Ink bounds of the laid out glyphs; two more pixels each side cover pen
+   // snapping and antialiasing
+   c.bounds = { 0, 0, 0, 0 };
+   if (format.font)
+   {
+      const font_face& font = *format.font;
+      const float s = format.size / font.metrics().units_per_em;
+      rect_f r = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+      for (const positioned_glyph& g : layouts_.get(text, length, format, box).glyphs)
+      {
+         const glyph_metrics& m = font.glyph(g.glyph);
+         if (m.min.x > m.max.x)
+            continue;
+         r = { fminf(r.left, g.x + m.min.x * s), fminf(r.top, g.y + m.min.y * s),
+               fmaxf(r.right, g.x + m.max.x * s), fmaxf(r.bottom, g.y + m.max.y * s) };
+      }
+      if (r.left <= r.right)
+      {
+         rect_f d = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+         for (const float2& p : { float2{ r.left, r.top }, float2{ r.right, r.top }, float2{ r.left, r.bottom }, float2{ r.right, r.bottom } })
+         {
+            const float2 q = transform_point(p, transform);
+            d = { fminf(d.left, q.x), fminf(d.top, q.y), fmaxf(d.right, q.x), fmaxf(d.bottom, q.y) };
+         }
+         const rect_i b = enclosing_pixels(d);
+         c.bounds = { b.left - 2, b.top - 2, b.right + 2, b.bottom + 2 };
+      }
+   }
+   commands_.push_back(c);
+}
+
+const rect_i display_list::infinite_layer_bounds = { -(1 << 30), -(1 << 30), 1 << 30, 1 << 30 };
+
+void display_list::push_layer(float opacity, const rect_i& content_bounds)
+{
+   draw_command c = {};
+   c.kind = draw_kind::push_layer;
+   c.opacity = opacity;
+   c.bounds = content_bounds;
+   commands_.push_back(c);
+}
+
+void display_list::pop_layer()
+{
+   draw_command c = {};
+   c.kind = draw_kind::pop_layer;
+   c.bounds = { 0, 0, 0, 0 };
+   commands_.push_back(c);
+}
+
+// ---------------------------------------------------------------------------
+// Damage
+
+static int64_t union_growth(const rect_i& a, const rect_i& b)
+{
+   return bounding_union(a, b).area() - a.area() - b.area();
+}
+
+// Adds `r` to a set of disjoint rectangles, merging everything it overlaps
+static void add_damage(std::vector<rect_i>& rects, rect_i r)
+{
+   if (r.empty())
+      return;
+   for (size_t i = 0; i < rects.size();)
+   {
+      if (!intersect(rects[i], r).empty())
+      {
+         r = bounding_union(r, rects[i]);
+         rects[i] = rects.back();
+         rects.pop_back();
+         i = 0;
+      }
+      else
+      {
+         i++;
+      }
+   }
+   rects.push_back(r);
+
+   // Too many: merge the pair that wastes the fewest pixels
+   while ((int)rects.size() > retained_scene::max_damage_rects)
+   {
+      size_t best_a = 0, best_b = 1;
+      int64_t best = INT64_MAX;
+      for (size_t a = 0; a < rects.size(); a++)
+      {
+         for (size_t b = a + 1; b < rects.size(); b++)
+         {
+            const int64_t g = union_growth(rects[a], rects[b]);
+            if (g < best)
+            {
+               best = g;
+               best_a = a;
+               best_b = b;
+            }
+         }
+      }
+      const rect_i merged = bounding_union(rects[best_a], rects[best_b]);
+      rects[best_b] = rects.back();
+      rects.pop_back();
+      rects.erase(rects.begin() + best_a);
+      add_damage(rects, merged);
+   }
+}
+
+// ---------------------------------------------------------------------------
+// retained_scene
+
+retained_scene::retained_scene(int width, int height, uint32_t background)
+   : background_(background)
+{
+   resize(width, height);
+}
+
+void retained_scene::resize(int width, int height)
+{
+   surface_.resize(width, height);
+   rect_raster_.set_target_size(width, height);
+   invalidate_all();
+}
+
+void retained_scene::set_background(uint32_t color)
+{
+   if (color != background_)
+   {
+      background_ = color;
+      invalidate_all();
+   }
+}
+
+void retained_scene::invalidate(const rect_i& rect)
+{
+   add_damage(pending_, intersect(rect, surface_.bounds()));
+}
+
+void retained_scene::replay(const display_list& list, const draw_command& c)
+{
+   switch (c.kind)
+   {
+   case draw_kind::fill_rect:
+   {
+      const rect_f& r = c.rect;
+      const line_segment lines[4] = {
+         { r.left, r.top, r.right, r.top },
+         { r.right, r.top, r.right, r.bottom },
+         { r.right, r.bottom, r.left, r.bottom },
+         { r.left, r.bottom, r.left, r.top },
+      };
+      rect_raster_.rasterize(lines, 4, fill_mode::winding, rect_coverage_);
+      fill_coverage(surface_, rect_coverage_, c.color);
+      break;
+   }
+   case draw_kind::fill_geometry:
+      realizations_.fill(surface_, *c.geometry, c.transform, c.color);
+      break;
+   case draw_kind::draw_image:
+      sr::draw_image(surface_, *c.image, c.x, c.y, c.opacity);
+      break;
+   case draw_kind::fill_gradient:
+      sr::fill_rect(surface_, c.bounds, *c.gradient);
+      break;
+   case draw_kind::fill_bitmap:
+      sr::fill_rect(surface_, c.bounds, *c.bitmap);
+      break;
+   case draw_kind::draw_text:
+      text_.draw_text(surface_, list.text(c), c.text_length, c.format, c.rect, c.transform, c.color);
+      text_.flush();
+      break;
+   case draw_kind::push_layer:
+   case draw_kind::pop_layer:
+      break;
+   }
+}
+
+void retained_scene::present(const display_list& list)
+{
+   const std::vector<draw_command>& cur = list.commands();
+   const rect_i all = surface_.bounds();
+
+   // Walk both lists in order. A single inserted or removed command only
+   // damages itself; anything else damages the old and the new bounds
+   frame_ = scene_frame_stats();
+   frame_.commands = (int)cur.size();
+   size_t i = 0, j = 0;
+   while (i < cur.size() || j < previous_.size())
+   {
+      if (i < cur.size() && j < previous_.size() && cur[i] == previous_[j])
+      {
+         i++;
+         j++;
+         continue;
+      }
+      if (i + 1 < cur.size() && j < previous_.size() && cur[i + 1] == previous_[j])
+      {
+         add_damage(pending_, intersect(cur[i++].bounds, all));
+         frame_.changed++;
+         continue;
+      }
+      if (j + 1 < previous_.size() && i < cur.size() && cur[i] == previous_[j + 1])
+      {
+         add_damage(pending_, intersect(previous_[j++].bounds, all));
+         frame_.changed++;
+         continue;
+      }
+      if (i < cur.size())
+         add_damage(pending_, intersect(cur[i++].bounds, all));
+      if (j < previous_.size())
+         add_damage(pending_, intersect(previous_[j++].bounds, all));
+      frame_.changed++;
+   }
+
+   previous_ = cur;
+   damage_.swap(pending_);
+   pending_.clear();
+   stats_.frames++;
+   if (damage_.empty())
+   {
+      stats_.frames_skipped++;
+      return;
+   }
+
+   for (const rect_i& d : damage_)
+   {
+      surface_.set_clip(d);
+      surface_.clear(background_);
+      for (const draw_command& c : cur)
+      {
+         if (!intersect(c.bounds, d).empty())
+         {
+            replay(list, c);
+            frame_.commands_replayed++;
+         }
+      }
+      frame_.pixels_redrawn += d.area();
+   }
+   surface_.reset_clip();
+
+   frame_.damage_rects = (int)damage_.size();
+   stats_.commands_replayed += frame_.commands_replayed;
+   stats_.pixels_redrawn += (uint64_t)frame_.pixels_redrawn;
+}
+
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+// Retained 2D content for the offscreen surface. OnRender redraws the grid,
+// the bitmaps, the text and the two hourglasses into m_pOffscreenTexture every
+// frame although none of it changes; here the frame is recorded into a
+// display_list instead, and retained_scene compares it with the previous one.
+// Only the rectangles covering commands that changed, appeared or went away
+// are cleared and replayed, and a frame with no changes touches no pixels.
+//
+// Commands refer to their geometries, images and brushes; an image edited
+// in place, or a brush changed or replaced at the same address, has to be
+// invalidated by the caller. Text is copied into the list.
+
+#include "sr_gradient.h"
+#include "sr_pattern.h"
+#include "sr_realize.h"
+#include "sr_text.h"
+
+#include <string>
+#include <vector>
+
+namespace sr
+{
+
+enum class draw_kind : uint8_t
+{
+   fill_rect,
+   fill_geometry,
+   draw_image,
+   fill_gradient,
+   fill_bitmap,
+   draw_text,
+   push_layer,
+   pop_layer,
+};
+
+struct draw_command
+{
+   draw_kind kind;
+   uint32_t color;                       // premultiplied, fill_rect / fill_geometry / draw_text
+   rect_f rect;                          // fill_rect; layout box for draw_text
+   const path_geometry* geometry;        // fill_geometry
+   uint64_t geometry_id;
+   uint32_t geometry_revision;
+   float3x2 transform;
+   const image_rgba8* image;             // draw_image
+   int x, y;
+   float opacity;                        // draw_image, push_layer
+   const gradient_brush* gradient;       // fill_gradient, over `bounds`
+   const bitmap_brush* bitmap;           // fill_bitmap, over `bounds`
+   text_format format;                   // draw_text, with `transform`
+   uint32_t text_offset, text_length;    // into display_list::text()
+   uint64_t text_hash;
+   rect_i bounds;                        // pixels the command may touch; push_layer: content bounds
+
+   // True when both draw the same pixels
+   bool operator==(const draw_command& o) const;
+   bool operator!=(const draw_command& o) const { return !(*this == o); }
+};
+
+class display_list
+{
+public:
+   void clear()
+   {
+      commands_.clear();
+      text_.clear();
+   }
+
+   void fill_rect(const rect_f& rect, uint32_t color);
+   void fill_rect(const rect_i& rect, const gradient_brush& brush);
+   void fill_rect(const rect_i& rect, const bitmap_brush& brush);
+   void fill_geometry(const path_geometry& geometry, const float3x2& transform, uint32_t color);
+   void draw_image(const image_rgba8& image, int x, int y, float opacity = 1.0f);
+   void draw_text(const char* text, size_t length, const text_format& format, const rect_f& box, const float3x2& transform, uint32_t color);
+
+   // PushLayer / PopLayer: what is drawn up to the matching pop_layer() is
+   // clipped to `content_bounds` and composited at `opacity`. Only
+   // layer_compositor (sr_layers.h) draws layers; retained_scene and
+   // tile_renderer draw their contents as if there were none
+   void push_layer(float opacity, const rect_i& content_bounds = infinite_layer_bounds);
+   void pop_layer();
+
+   static const rect_i infinite_layer_bounds;
+
+   const std::vector<draw_command>& commands() const { return commands_; }
+   size_t size() const { return commands_.size(); }
+
+   // UTF-8 text of a draw_text command
+   const char* text(const draw_command& c) const { return text_.data() + c.text_offset; }
+
+private:
+   std::vector<draw_command> commands_;
+   std::string text_;
+   layout_cache layouts_;   // for the bounds of text
+};
+
+struct scene_frame_stats
+{
+   int commands = 0;
+   int changed = 0;               // commands added, removed or modified
+   int damage_rects = 0;
+   int commands_replayed = 0;     // summed over the damage rectangles
+   int64_t pixels_redrawn = 0;
+};
+
+struct scene_stats
+{
+   uint64_t frames = 0;
+   uint64_t frames_skipped = 0;   // nothing changed, nothing drawn
+   uint64_t commands_replayed = 0;
+   uint64_t pixels_redrawn = 0;
+};
+
+class retained_scene
+{
+public:
+   // More damage is merged into fewer, larger rectangles
+   static const int max_damage_rects = 8;
+
+   retained_scene(int width = 0, int height = 0, uint32_t background = 0);
+
+   void resize(int width, int height);
+   void set_background(uint32_t color);
+
+   void invalidate(const rect_i& rect);
+   void invalidate_all() { invalidate(surface_.bounds()); }
+
+   // Brings the surface up to date with `list`
+   void present(const display_list& list);
+
+   const image_rgba8& surface() const { return surface_; }
+   realization_cache& realizations() { return realizations_; }
+
+   // Rectangles redrawn by the last present()
+   const std::vector<rect_i>& damage() const { return damage_; }
+   const scene_frame_stats& last_frame() const { return frame_; }
+   const scene_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = scene_stats(); }
+
+   text_renderer& text() { return text_; }
+
+private:
+   void replay(const display_list& list, const draw_command& c);
+
+   image_rgba8 surface_;
+   uint32_t background_;
+   realization_cache realizations_;
+   text_renderer text_;
+   strip_rasterizer rect_raster_;
+   coverage_strips rect_coverage_;
+   std::vector<draw_command> previous_;
+   std::vector<rect_i> pending_;
+   std::vector<rect_i> damage_;
+   scene_frame_stats frame_;
+   scene_stats stats_;
+};
+
+}
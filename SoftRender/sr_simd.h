@@ -0,0 +1,625 @@
+#pragma once
+
+// 8-wide float/int vector used by the software rasterizer kernels, and a
+// 4-wide float vector for the matrix math in sr_math.h.
+//
+// AVX2 maps one vec8f onto a __m256, SSE2 splits it into two __m128 halves and
+// everything else runs the scalar fallback. vec4f is one __m128 on both x86
+// backends and one float32x4_t on AArch64 NEON. Define SR_NO_SIMD to force
+// the scalar path (handy to check a kernel against the reference result).
+
+#include "sr_common.h"
+
+#include <math.h>
+#include <string.h>
+
+#if !defined(SR_NO_SIMD) && defined(__AVX2__)
+#define SR_SIMD_AVX2 1
+#include <immintrin.h>
+#elif !defined(SR_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SR_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SR_SIMD_SCALAR 1
+#endif
+
+#if !defined(SR_NO_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+#define SR_HAS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// 128-bit integer SSE2 is available on both x86 SIMD backends
+#if defined(SR_SIMD_AVX2) || defined(SR_SIMD_SSE2)
+#define SR_HAS_SSE2 1
+#endif
+
+// FMA3 ships with every AVX2 part; gcc/clang still want -mfma before they emit it
+#if defined(SR_SIMD_AVX2) && (defined(__FMA__) || defined(_MSC_VER))
+#define SR_SIMD_FMA 1
+#endif
+
+// Likewise F16C, the half <-> float conversions, with -mf16c
+#if defined(SR_SIMD_AVX2) && (defined(__F16C__) || defined(_MSC_VER))
+#define SR_SIMD_F16C 1
+#endif
+
+namespace sr
+{
+
+#if defined(SR_SIMD_AVX2)
+
+struct vec8f { __m256 v; };
+struct vec8i { __m256i v; };
+
+SR_FORCEINLINE vec8f v8_zero() { return { _mm256_setzero_ps() }; }
+SR_FORCEINLINE vec8f v8_set1(float f) { return { _mm256_set1_ps(f) }; }
+SR_FORCEINLINE vec8f v8_set(float a, float b, float c, float d, float e, float f, float g, float h) { return { _mm256_setr_ps(a, b, c, d, e, f, g, h) }; }
+SR_FORCEINLINE vec8f v8_load(const float* p) { return { _mm256_load_ps(p) }; }
+SR_FORCEINLINE vec8f v8_loadu(const float* p) { return { _mm256_loadu_ps(p) }; }
+SR_FORCEINLINE void v8_store(float* p, vec8f a) { _mm256_store_ps(p, a.v); }
+SR_FORCEINLINE void v8_storeu(float* p, vec8f a) { _mm256_storeu_ps(p, a.v); }
+
+SR_FORCEINLINE vec8f operator+(vec8f a, vec8f b) { return { _mm256_add_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator-(vec8f a, vec8f b) { return { _mm256_sub_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator*(vec8f a, vec8f b) { return { _mm256_mul_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator/(vec8f a, vec8f b) { return { _mm256_div_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator&(vec8f a, vec8f b) { return { _mm256_and_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator|(vec8f a, vec8f b) { return { _mm256_or_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f operator^(vec8f a, vec8f b) { return { _mm256_xor_ps(a.v, b.v) }; }
+
+// a * b + c
+SR_FORCEINLINE vec8f v8_fmadd(vec8f a, vec8f b, vec8f c)
+{
+#if defined(SR_SIMD_FMA)
+   return { _mm256_fmadd_ps(a.v, b.v, c.v) };
+#else
+   return { _mm256_add_ps(_mm256_mul_ps(a.v, b.v), c.v) };
+#endif
+}
+
+SR_FORCEINLINE vec8f v8_min(vec8f a, vec8f b) { return { _mm256_min_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f v8_max(vec8f a, vec8f b) { return { _mm256_max_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec8f v8_sqrt(vec8f a) { return { _mm256_sqrt_ps(a.v) }; }
+SR_FORCEINLINE vec8f v8_floor(vec8f a) { return { _mm256_floor_ps(a.v) }; }
+SR_FORCEINLINE vec8f v8_abs(vec8f a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+
+SR_FORCEINLINE vec8f v8_cmplt(vec8f a, vec8f b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+SR_FORCEINLINE vec8f v8_cmple(vec8f a, vec8f b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+SR_FORCEINLINE vec8f v8_cmpgt(vec8f a, vec8f b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+SR_FORCEINLINE vec8f v8_cmpge(vec8f a, vec8f b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+SR_FORCEINLINE vec8f v8_cmpeq(vec8f a, vec8f b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+
+// mask ? a : b
+SR_FORCEINLINE vec8f v8_select(vec8f mask, vec8f a, vec8f b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+SR_FORCEINLINE vec8f v8_andnot(vec8f mask, vec8f a) { return { _mm256_andnot_ps(mask.v, a.v) }; }
+SR_FORCEINLINE int v8_movemask(vec8f a) { return _mm256_movemask_ps(a.v); }
+
+// Lanes viewed as two float4s: copy each group's w into its x/y/z/w
+SR_FORCEINLINE vec8f v8_broadcast_w(vec8f a) { return { _mm256_permute_ps(a.v, 0xff) }; }
+
+// Inclusive prefix sum across the 8 lanes: shift-and-add inside each 128-bit
+// half, then add the low half's total to the high half
+SR_FORCEINLINE vec8f v8_prefix_sum(vec8f a)
+{
+   __m256 x = a.v;
+   x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 4)));
+   x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+   const __m256 low_total = _mm256_permute_ps(x, 0xff);
+   return { _mm256_add_ps(x, _mm256_permute2f128_ps(low_total, low_total, 0x08)) };
+}
+
+SR_FORCEINLINE vec8i v8i_set1(int32_t i) { return { _mm256_set1_epi32(i) }; }
+SR_FORCEINLINE vec8i v8i_load(const int32_t* p) { return { _mm256_load_si256((const __m256i*)p) }; }
+SR_FORCEINLINE vec8i v8i_loadu(const void* p) { return { _mm256_loadu_si256((const __m256i*)p) }; }
+// 8 bytes zero-extended to 8 lanes
+SR_FORCEINLINE vec8i v8i_load_u8(const uint8_t* p) { return { _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)p)) }; }
+// 8 16-bit values zero- or sign-extended to 8 lanes
+SR_FORCEINLINE vec8i v8i_load_u16(const uint16_t* p) { return { _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)p)) }; }
+SR_FORCEINLINE vec8i v8i_load_i16(const int16_t* p) { return { _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)p)) }; }
+SR_FORCEINLINE void v8i_store(int32_t* p, vec8i a) { _mm256_store_si256((__m256i*)p, a.v); }
+SR_FORCEINLINE void v8i_storeu(void* p, vec8i a) { _mm256_storeu_si256((__m256i*)p, a.v); }
+// The low 16 bits of each lane, 16 bytes unaligned
+SR_FORCEINLINE void v8i_store_16(void* p, vec8i a)
+{
+   const __m256i s = _mm256_srai_epi32(_mm256_slli_epi32(a.v, 16), 16);
+   _mm_storeu_si128((__m128i*)p, _mm_packs_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+}
+// Lanes in 0..255 as 8 bytes
+SR_FORCEINLINE void v8i_store_u8(uint8_t* p, vec8i a)
+{
+   const __m128i w = _mm_packs_epi32(_mm256_castsi256_si128(a.v), _mm256_extracti128_si256(a.v, 1));
+   _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+}
+SR_FORCEINLINE vec8i operator+(vec8i a, vec8i b) { return { _mm256_add_epi32(a.v, b.v) }; }
+SR_FORCEINLINE vec8i operator-(vec8i a, vec8i b) { return { _mm256_sub_epi32(a.v, b.v) }; }
+SR_FORCEINLINE vec8i operator*(vec8i a, vec8i b) { return { _mm256_mullo_epi32(a.v, b.v) }; }
+SR_FORCEINLINE vec8i operator&(vec8i a, vec8i b) { return { _mm256_and_si256(a.v, b.v) }; }
+SR_FORCEINLINE vec8i operator|(vec8i a, vec8i b) { return { _mm256_or_si256(a.v, b.v) }; }
+SR_FORCEINLINE vec8i operator^(vec8i a, vec8i b) { return { _mm256_xor_si256(a.v, b.v) }; }
+SR_FORCEINLINE vec8i v8i_srli(vec8i a, int n) { return { _mm256_srli_epi32(a.v, n) }; }
+SR_FORCEINLINE vec8i v8i_slli(vec8i a, int n) { return { _mm256_slli_epi32(a.v, n) }; }
+SR_FORCEINLINE vec8i v8i_srai(vec8i a, int n) { return { _mm256_srai_epi32(a.v, n) }; }
+SR_FORCEINLINE vec8i v8i_min(vec8i a, vec8i b) { return { _mm256_min_epi32(a.v, b.v) }; }
+SR_FORCEINLINE vec8i v8i_max(vec8i a, vec8i b) { return { _mm256_max_epi32(a.v, b.v) }; }
+SR_FORCEINLINE vec8i v8i_cmpeq(vec8i a, vec8i b) { return { _mm256_cmpeq_epi32(a.v, b.v) }; }
+
+// round-to-nearest conversion (current MXCSR mode) and truncation
+SR_FORCEINLINE vec8i v8_round_to_int(vec8f a) { return { _mm256_cvtps_epi32(a.v) }; }
+SR_FORCEINLINE vec8i v8_trunc_to_int(vec8f a) { return { _mm256_cvttps_epi32(a.v) }; }
+SR_FORCEINLINE vec8f v8i_to_float(vec8i a) { return { _mm256_cvtepi32_ps(a.v) }; }
+SR_FORCEINLINE vec8f v8i_as_float(vec8i a) { return { _mm256_castsi256_ps(a.v) }; }
+SR_FORCEINLINE vec8i v8_as_int(vec8f a) { return { _mm256_castps_si256(a.v) }; }
+
+SR_FORCEINLINE vec8i v8i_set(int32_t a, int32_t b, int32_t c, int32_t d, int32_t e, int32_t f, int32_t g, int32_t h) { return { _mm256_setr_epi32(a, b, c, d, e, f, g, h) }; }
+
+// base[idx[i]] per lane
+SR_FORCEINLINE vec8f v8_gather(const float* base, vec8i idx) { return { _mm256_i32gather_ps(base, idx.v, 4) }; }
+SR_FORCEINLINE vec8i v8i_gather(const int32_t* base, vec8i idx) { return { _mm256_i32gather_epi32((const int*)base, idx.v, 4) }; }
+
+// a[idx[i] & 7] per lane
+SR_FORCEINLINE vec8f v8_permute(vec8f a, vec8i idx) { return { _mm256_permutevar8x32_ps(a.v, idx.v) }; }
+
+SR_FORCEINLINE float v8_hmin(vec8f a)
+{
+   __m128 m = _mm_min_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+   m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+SR_FORCEINLINE float v8_hmax(vec8f a)
+{
+   __m128 m = _mm_max_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+   m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+SR_FORCEINLINE float v8_hsum(vec8f a)
+{
+   __m128 m = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+   m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_add_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+#elif defined(SR_SIMD_SSE2)
+
+struct vec8f { __m128 lo, hi; };
+struct vec8i { __m128i lo, hi; };
+
+#define SR_V8_OP2(name, intrin) \
+   SR_FORCEINLINE vec8f name(vec8f a, vec8f b) { return { intrin(a.lo, b.lo), intrin(a.hi, b.hi) }; }
+#define SR_V8I_OP2(name, intrin) \
+   SR_FORCEINLINE vec8i name(vec8i a, vec8i b) { return { intrin(a.lo, b.lo), intrin(a.hi, b.hi) }; }
+
+SR_FORCEINLINE vec8f v8_zero() { return { _mm_setzero_ps(), _mm_setzero_ps() }; }
+SR_FORCEINLINE vec8f v8_set1(float f) { return { _mm_set1_ps(f), _mm_set1_ps(f) }; }
+SR_FORCEINLINE vec8f v8_set(float a, float b, float c, float d, float e, float f, float g, float h) { return { _mm_setr_ps(a, b, c, d), _mm_setr_ps(e, f, g, h) }; }
+SR_FORCEINLINE vec8f v8_load(const float* p) { return { _mm_load_ps(p), _mm_load_ps(p + 4) }; }
+SR_FORCEINLINE vec8f v8_loadu(const float* p) { return { _mm_loadu_ps(p), _mm_loadu_ps(p + 4) }; }
+SR_FORCEINLINE void v8_store(float* p, vec8f a) { _mm_store_ps(p, a.lo); _mm_store_ps(p + 4, a.hi); }
+SR_FORCEINLINE void v8_storeu(float* p, vec8f a) { _mm_storeu_ps(p, a.lo); _mm_storeu_ps(p + 4, a.hi); }
+
+SR_V8_OP2(operator+, _mm_add_ps)
+SR_V8_OP2(operator-, _mm_sub_ps)
+SR_V8_OP2(operator*, _mm_mul_ps)
+SR_V8_OP2(operator/, _mm_div_ps)
+SR_V8_OP2(operator&, _mm_and_ps)
+SR_V8_OP2(operator|, _mm_or_ps)
+SR_V8_OP2(operator^, _mm_xor_ps)
+SR_V8_OP2(v8_min, _mm_min_ps)
+SR_V8_OP2(v8_max, _mm_max_ps)
+SR_V8_OP2(v8_cmplt, _mm_cmplt_ps)
+SR_V8_OP2(v8_cmple, _mm_cmple_ps)
+SR_V8_OP2(v8_cmpgt, _mm_cmpgt_ps)
+SR_V8_OP2(v8_cmpge, _mm_cmpge_ps)
+SR_V8_OP2(v8_cmpeq, _mm_cmpeq_ps)
+
+SR_FORCEINLINE vec8f v8_fmadd(vec8f a, vec8f b, vec8f c) { return a * b + c; }
+SR_FORCEINLINE vec8f v8_sqrt(vec8f a) { return { _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+SR_FORCEINLINE vec8f v8_abs(vec8f a) { __m128 s = _mm_set1_ps(-0.0f); return { _mm_andnot_ps(s, a.lo), _mm_andnot_ps(s, a.hi) }; }
+SR_FORCEINLINE vec8f v8_andnot(vec8f mask, vec8f a) { return { _mm_andnot_ps(mask.lo, a.lo), _mm_andnot_ps(mask.hi, a.hi) }; }
+SR_FORCEINLINE vec8f v8_select(vec8f mask, vec8f a, vec8f b) { return (mask & a) | v8_andnot(mask, b); }
+SR_FORCEINLINE int v8_movemask(vec8f a) { return _mm_movemask_ps(a.lo) | (_mm_movemask_ps(a.hi) << 4); }
+SR_FORCEINLINE vec8f v8_broadcast_w(vec8f a) { return { _mm_shuffle_ps(a.lo, a.lo, 0xff), _mm_shuffle_ps(a.hi, a.hi, 0xff) }; }
+
+SR_FORCEINLINE __m128 v4_prefix_sum(__m128 x)
+{
+   x = _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 4)));
+   return _mm_add_ps(x, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(x), 8)));
+}
+SR_FORCEINLINE vec8f v8_prefix_sum(vec8f a)
+{
+   const __m128 lo = v4_prefix_sum(a.lo);
+   return { lo, _mm_add_ps(v4_prefix_sum(a.hi), _mm_shuffle_ps(lo, lo, 0xff)) };
+}
+
+SR_FORCEINLINE vec8i v8i_set1(int32_t i) { return { _mm_set1_epi32(i), _mm_set1_epi32(i) }; }
+SR_FORCEINLINE vec8i v8i_load(const int32_t* p) { return { _mm_load_si128((const __m128i*)p), _mm_load_si128((const __m128i*)(p + 4)) }; }
+SR_FORCEINLINE vec8i v8i_loadu(const void* p) { return { _mm_loadu_si128((const __m128i*)p), _mm_loadu_si128((const __m128i*)p + 1) }; }
+SR_FORCEINLINE vec8i v8i_load_u8(const uint8_t* p)
+{
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i w = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)p), zero);
+   return { _mm_unpacklo_epi16(w, zero), _mm_unpackhi_epi16(w, zero) };
+}
+SR_FORCEINLINE vec8i v8i_load_u16(const uint16_t* p)
+{
+   const __m128i x = _mm_loadu_si128((const __m128i*)p), zero = _mm_setzero_si128();
+   return { _mm_unpacklo_epi16(x, zero), _mm_unpackhi_epi16(x, zero) };
+}
+SR_FORCEINLINE vec8i v8i_load_i16(const int16_t* p)
+{
+   const __m128i x = _mm_loadu_si128((const __m128i*)p);
+   return { _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16) };
+}
+SR_FORCEINLINE void v8i_store(int32_t* p, vec8i a) { _mm_store_si128((__m128i*)p, a.lo); _mm_store_si128((__m128i*)(p + 4), a.hi); }
+SR_FORCEINLINE void v8i_storeu(void* p, vec8i a) { _mm_storeu_si128((__m128i*)p, a.lo); _mm_storeu_si128((__m128i*)p + 1, a.hi); }
+SR_FORCEINLINE void v8i_store_16(void* p, vec8i a)
+{
+   const __m128i lo = _mm_srai_epi32(_mm_slli_epi32(a.lo, 16), 16), hi = _mm_srai_epi32(_mm_slli_epi32(a.hi, 16), 16);
+   _mm_storeu_si128((__m128i*)p, _mm_packs_epi32(lo, hi));
+}
+SR_FORCEINLINE void v8i_store_u8(uint8_t* p, vec8i a)
+{
+   const __m128i w = _mm_packs_epi32(a.lo, a.hi);
+   _mm_storel_epi64((__m128i*)p, _mm_packus_epi16(w, w));
+}
+SR_V8I_OP2(operator+, _mm_add_epi32)
+SR_V8I_OP2(operator-, _mm_sub_epi32)
+SR_V8I_OP2(operator&, _mm_and_si128)
+SR_V8I_OP2(operator|, _mm_or_si128)
+SR_V8I_OP2(operator^, _mm_xor_si128)
+SR_V8I_OP2(v8i_cmpeq, _mm_cmpeq_epi32)
+SR_FORCEINLINE vec8i v8i_srli(vec8i a, int n) { return { _mm_srli_epi32(a.lo, n), _mm_srli_epi32(a.hi, n) }; }
+SR_FORCEINLINE vec8i v8i_slli(vec8i a, int n) { return { _mm_slli_epi32(a.lo, n), _mm_slli_epi32(a.hi, n) }; }
+SR_FORCEINLINE vec8i v8i_srai(vec8i a, int n) { return { _mm_srai_epi32(a.lo, n), _mm_srai_epi32(a.hi, n) }; }
+
+// SSE2 has no 32-bit mullo/min/max; go through memory, these are off the hot paths
+SR_FORCEINLINE vec8i operator*(vec8i a, vec8i b)
+{
+   alignas(16) int32_t x[8], y[8];
+   v8i_store(x, a); v8i_store(y, b);
+   for (int i = 0; i < 8; i++) x[i] = (int32_t)((uint32_t)x[i] * (uint32_t)y[i]);
+   return v8i_load(x);
+}
+SR_FORCEINLINE vec8i v8i_min(vec8i a, vec8i b)
+{
+   __m128i l = _mm_cmplt_epi32(a.lo, b.lo), h = _mm_cmplt_epi32(a.hi, b.hi);
+   return { _mm_or_si128(_mm_and_si128(l, a.lo), _mm_andnot_si128(l, b.lo)), _mm_or_si128(_mm_and_si128(h, a.hi), _mm_andnot_si128(h, b.hi)) };
+}
+SR_FORCEINLINE vec8i v8i_max(vec8i a, vec8i b)
+{
+   __m128i l = _mm_cmpgt_epi32(a.lo, b.lo), h = _mm_cmpgt_epi32(a.hi, b.hi);
+   return { _mm_or_si128(_mm_and_si128(l, a.lo), _mm_andnot_si128(l, b.lo)), _mm_or_si128(_mm_and_si128(h, a.hi), _mm_andnot_si128(h, b.hi)) };
+}
+
+SR_FORCEINLINE vec8i v8_round_to_int(vec8f a) { return { _mm_cvtps_epi32(a.lo), _mm_cvtps_epi32(a.hi) }; }
+SR_FORCEINLINE vec8i v8_trunc_to_int(vec8f a) { return { _mm_cvttps_epi32(a.lo), _mm_cvttps_epi32(a.hi) }; }
+SR_FORCEINLINE vec8f v8i_to_float(vec8i a) { return { _mm_cvtepi32_ps(a.lo), _mm_cvtepi32_ps(a.hi) }; }
+SR_FORCEINLINE vec8f v8i_as_float(vec8i a) { return { _mm_castsi128_ps(a.lo), _mm_castsi128_ps(a.hi) }; }
+SR_FORCEINLINE vec8i v8_as_int(vec8f a) { return { _mm_castps_si128(a.lo), _mm_castps_si128(a.hi) }; }
+
+SR_FORCEINLINE vec8i v8i_set(int32_t a, int32_t b, int32_t c, int32_t d, int32_t e, int32_t f, int32_t g, int32_t h) { return { _mm_setr_epi32(a, b, c, d), _mm_setr_epi32(e, f, g, h) }; }
+
+SR_FORCEINLINE vec8f v8_gather(const float* base, vec8i idx)
+{
+   alignas(16) int32_t i[8];
+   v8i_store(i, idx);
+   return v8_set(base[i[0]], base[i[1]], base[i[2]], base[i[3]], base[i[4]], base[i[5]], base[i[6]], base[i[7]]);
+}
+
+SR_FORCEINLINE vec8i v8i_gather(const int32_t* base, vec8i idx)
+{
+   alignas(16) int32_t i[8];
+   v8i_store(i, idx);
+   return v8i_set(base[i[0]], base[i[1]], base[i[2]], base[i[3]], base[i[4]], base[i[5]], base[i[6]], base[i[7]]);
+}
+
+SR_FORCEINLINE vec8f v8_permute(vec8f a, vec8i idx)
+{
+   alignas(16) float f[8];
+   v8_store(f, a);
+   return v8_gather(f, idx & v8i_set1(7));
+}
+
+SR_FORCEINLINE vec8f v8_floor(vec8f a)
+{
+   // truncate, then step down where truncation rounded towards zero from below
+   vec8f t = v8i_to_float(v8_trunc_to_int(a));
+   return t - (v8_cmpgt(t, a) & v8_set1(1.0f));
+}
+
+SR_FORCEINLINE float v8_hmin(vec8f a)
+{
+   __m128 m = _mm_min_ps(a.lo, a.hi);
+   m = _mm_min_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_min_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+SR_FORCEINLINE float v8_hmax(vec8f a)
+{
+   __m128 m = _mm_max_ps(a.lo, a.hi);
+   m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+SR_FORCEINLINE float v8_hsum(vec8f a)
+{
+   __m128 m = _mm_add_ps(a.lo, a.hi);
+   m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+   m = _mm_add_ss(m, _mm_shuffle_ps(m, m, 1));
+   return _mm_cvtss_f32(m);
+}
+
+#undef SR_V8_OP2
+#undef SR_V8I_OP2
+
+#else // SR_SIMD_SCALAR
+
+struct vec8f { float f[8]; };
+struct vec8i { int32_t i[8]; };
+
+#define SR_V8_MAP(expr) vec8f r; for (int k = 0; k < 8; k++) r.f[k] = (expr); return r
+#define SR_V8I_MAP(expr) vec8i r; for (int k = 0; k < 8; k++) r.i[k] = (expr); return r
+#define SR_V8_MASK(cond) vec8f r; for (int k = 0; k < 8; k++) { uint32_t m = (cond) ? 0xffffffffu : 0u; memcpy(&r.f[k], &m, 4); } return r
+
+inline uint32_t v8_bits(float f) { uint32_t u; memcpy(&u, &f, 4); return u; }
+inline float v8_from_bits(uint32_t u) { float f; memcpy(&f, &u, 4); return f; }
+
+inline vec8f v8_zero() { SR_V8_MAP(0.0f); }
+inline vec8f v8_set1(float f) { SR_V8_MAP(f); }
+inline vec8f v8_set(float a, float b, float c, float d, float e, float f, float g, float h) { return { { a, b, c, d, e, f, g, h } }; }
+inline vec8f v8_load(const float* p) { SR_V8_MAP(p[k]); }
+inline vec8f v8_loadu(const float* p) { SR_V8_MAP(p[k]); }
+inline void v8_store(float* p, vec8f a) { for (int k = 0; k < 8; k++) p[k] = a.f[k]; }
+inline void v8_storeu(float* p, vec8f a) { for (int k = 0; k < 8; k++) p[k] = a.f[k]; }
+
+inline vec8f operator+(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] + b.f[k]); }
+inline vec8f operator-(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] - b.f[k]); }
+inline vec8f operator*(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] * b.f[k]); }
+inline vec8f operator/(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] / b.f[k]); }
+inline vec8f operator&(vec8f a, vec8f b) { SR_V8_MAP(v8_from_bits(v8_bits(a.f[k]) & v8_bits(b.f[k]))); }
+inline vec8f operator|(vec8f a, vec8f b) { SR_V8_MAP(v8_from_bits(v8_bits(a.f[k]) | v8_bits(b.f[k]))); }
+inline vec8f operator^(vec8f a, vec8f b) { SR_V8_MAP(v8_from_bits(v8_bits(a.f[k]) ^ v8_bits(b.f[k]))); }
+inline vec8f v8_fmadd(vec8f a, vec8f b, vec8f c) { SR_V8_MAP(a.f[k] * b.f[k] + c.f[k]); }
+inline vec8f v8_min(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] < b.f[k] ? a.f[k] : b.f[k]); }
+inline vec8f v8_max(vec8f a, vec8f b) { SR_V8_MAP(a.f[k] > b.f[k] ? a.f[k] : b.f[k]); }
+inline vec8f v8_sqrt(vec8f a) { SR_V8_MAP(sqrtf(a.f[k])); }
+inline vec8f v8_floor(vec8f a) { SR_V8_MAP(floorf(a.f[k])); }
+inline vec8f v8_abs(vec8f a) { SR_V8_MAP(fabsf(a.f[k])); }
+
+inline vec8f v8_cmplt(vec8f a, vec8f b) { SR_V8_MASK(a.f[k] < b.f[k]); }
+inline vec8f v8_cmple(vec8f a, vec8f b) { SR_V8_MASK(a.f[k] <= b.f[k]); }
+inline vec8f v8_cmpgt(vec8f a, vec8f b) { SR_V8_MASK(a.f[k] > b.f[k]); }
+inline vec8f v8_cmpge(vec8f a, vec8f b) { SR_V8_MASK(a.f[k] >= b.f[k]); }
+inline vec8f v8_cmpeq(vec8f a, vec8f b) { SR_V8_MASK(a.f[k] == b.f[k]); }
+
+inline vec8f v8_andnot(vec8f mask, vec8f a) { SR_V8_MAP(v8_from_bits(~v8_bits(mask.f[k]) & v8_bits(a.f[k]))); }
+inline vec8f v8_select(vec8f mask, vec8f a, vec8f b) { SR_V8_MAP((v8_bits(mask.f[k]) >> 31) ? a.f[k] : b.f[k]); }
+inline int v8_movemask(vec8f a) { int m = 0; for (int k = 0; k < 8; k++) m |= (int)(v8_bits(a.f[k]) >> 31) << k; return m; }
+inline vec8f v8_broadcast_w(vec8f a) { SR_V8_MAP(a.f[k | 3]); }
+inline vec8f v8_prefix_sum(vec8f a) { for (int k = 1; k < 8; k++) a.f[k] += a.f[k - 1]; return a; }
+
+inline vec8i v8i_set1(int32_t v) { SR_V8I_MAP(v); }
+inline vec8i v8i_load(const int32_t* p) { SR_V8I_MAP(p[k]); }
+inline vec8i v8i_loadu(const void* p) { vec8i r; memcpy(r.i, p, 32); return r; }
+inline vec8i v8i_load_u8(const uint8_t* p) { SR_V8I_MAP((int32_t)p[k]); }
+inline vec8i v8i_load_u16(const uint16_t* p) { SR_V8I_MAP((int32_t)p[k]); }
+inline vec8i v8i_load_i16(const int16_t* p) { SR_V8I_MAP((int32_t)p[k]); }
+inline void v8i_store(int32_t* p, vec8i a) { for (int k = 0; k < 8; k++) p[k] = a.i[k]; }
+inline void v8i_storeu(void* p, vec8i a) { memcpy(p, a.i, 32); }
+inline void v8i_store_16(void* p, vec8i a) { uint16_t t[8]; for (int k = 0; k < 8; k++) t[k] = (uint16_t)a.i[k]; memcpy(p, t, 16); }
+inline void v8i_store_u8(uint8_t* p, vec8i a) { for (int k = 0; k < 8; k++) p[k] = (uint8_t)a.i[k]; }
+inline vec8i operator+(vec8i a, vec8i b) { SR_V8I_MAP((int32_t)((uint32_t)a.i[k] + (uint32_t)b.i[k])); }
+inline vec8i operator-(vec8i a, vec8i b) { SR_V8I_MAP((int32_t)((uint32_t)a.i[k] - (uint32_t)b.i[k])); }
+inline vec8i operator*(vec8i a, vec8i b) { SR_V8I_MAP((int32_t)((uint32_t)a.i[k] * (uint32_t)b.i[k])); }
+inline vec8i operator&(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] & b.i[k]); }
+inline vec8i operator|(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] | b.i[k]); }
+inline vec8i operator^(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] ^ b.i[k]); }
+inline vec8i v8i_srli(vec8i a, int n) { SR_V8I_MAP((int32_t)((uint32_t)a.i[k] >> n)); }
+inline vec8i v8i_slli(vec8i a, int n) { SR_V8I_MAP((int32_t)((uint32_t)a.i[k] << n)); }
+inline vec8i v8i_srai(vec8i a, int n) { SR_V8I_MAP(a.i[k] >> n); }
+inline vec8i v8i_min(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] < b.i[k] ? a.i[k] : b.i[k]); }
+inline vec8i v8i_max(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] > b.i[k] ? a.i[k] : b.i[k]); }
+inline vec8i v8i_cmpeq(vec8i a, vec8i b) { SR_V8I_MAP(a.i[k] == b.i[k] ? -1 : 0); }
+
+inline vec8i v8i_set(int32_t a, int32_t b, int32_t c, int32_t d, int32_t e, int32_t f, int32_t g, int32_t h) { return { { a, b, c, d, e, f, g, h } }; }
+inline vec8f v8_gather(const float* base, vec8i idx) { SR_V8_MAP(base[idx.i[k]]); }
+inline vec8i v8i_gather(const int32_t* base, vec8i idx) { SR_V8I_MAP(base[idx.i[k]]); }
+inline vec8f v8_permute(vec8f a, vec8i idx) { SR_V8_MAP(a.f[idx.i[k] & 7]); }
+inline vec8i v8_round_to_int(vec8f a) { SR_V8I_MAP((int32_t)lrintf(a.f[k])); }
+inline vec8i v8_trunc_to_int(vec8f a) { SR_V8I_MAP((int32_t)a.f[k]); }
+inline vec8f v8i_to_float(vec8i a) { SR_V8_MAP((float)a.i[k]); }
+inline vec8f v8i_as_float(vec8i a) { SR_V8_MAP(v8_from_bits((uint32_t)a.i[k])); }
+inline vec8i v8_as_int(vec8f a) { SR_V8I_MAP((int32_t)v8_bits(a.f[k])); }
+
+inline float v8_hmin(vec8f a) { float m = a.f[0]; for (int k = 1; k < 8; k++) m = a.f[k] < m ? a.f[k] : m; return m; }
+inline float v8_hmax(vec8f a) { float m = a.f[0]; for (int k = 1; k < 8; k++) m = a.f[k] > m ? a.f[k] : m; return m; }
+inline float v8_hsum(vec8f a) { float s = 0.0f; for (int k = 0; k < 8; k++) s += a.f[k]; return s; }
+
+#undef SR_V8_MAP
+#undef SR_V8I_MAP
+#undef SR_V8_MASK
+
+#endif
+
+// Shared helpers built on the primitives above
+
+SR_FORCEINLINE vec8f v8_ramp() { return v8_set(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+SR_FORCEINLINE vec8f v8_true() { return v8_cmpeq(v8_zero(), v8_zero()); }
+SR_FORCEINLINE vec8f v8_clamp(vec8f a, vec8f lo, vec8f hi) { return v8_min(v8_max(a, lo), hi); }
+
+// Expands the low 8 bits of a movemask-style integer back into lane masks
+SR_FORCEINLINE vec8f v8_lane_mask(int mask)
+{
+   alignas(32) static const int32_t bits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+   const vec8i b = v8i_load(bits);
+   return v8i_as_float(v8i_cmpeq(v8i_set1(mask) & b, b));
+}
+
+// ---------------------------------------------------------------------------
+// vec4f: one float4 or one matrix row. v4_shuffle<i, j, k, l>(a, b) is
+// { a[i], a[j], b[k], b[l] }, as _mm_shuffle_ps
+
+#if defined(SR_HAS_SSE2)
+
+struct vec4f { __m128 v; };
+
+SR_FORCEINLINE vec4f v4_zero() { return { _mm_setzero_ps() }; }
+SR_FORCEINLINE vec4f v4_set1(float f) { return { _mm_set1_ps(f) }; }
+SR_FORCEINLINE vec4f v4_set(float x, float y, float z, float w) { return { _mm_setr_ps(x, y, z, w) }; }
+SR_FORCEINLINE vec4f v4_loadu(const float* p) { return { _mm_loadu_ps(p) }; }
+SR_FORCEINLINE void v4_storeu(float* p, vec4f a) { _mm_storeu_ps(p, a.v); }
+// x, y, z with w = 0, and back, touching only 3 floats
+SR_FORCEINLINE vec4f v4_load3(const float* p) { return { _mm_movelh_ps(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)p), _mm_load_ss(p + 2)) }; }
+SR_FORCEINLINE void v4_store3(float* p, vec4f a) { _mm_storel_pi((__m64*)p, a.v); _mm_store_ss(p + 2, _mm_movehl_ps(a.v, a.v)); }
+
+SR_FORCEINLINE vec4f operator+(vec4f a, vec4f b) { return { _mm_add_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator-(vec4f a, vec4f b) { return { _mm_sub_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator*(vec4f a, vec4f b) { return { _mm_mul_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator/(vec4f a, vec4f b) { return { _mm_div_ps(a.v, b.v) }; }
+
+// a * b + c
+SR_FORCEINLINE vec4f v4_fmadd(vec4f a, vec4f b, vec4f c)
+{
+#if defined(SR_SIMD_FMA)
+   return { _mm_fmadd_ps(a.v, b.v, c.v) };
+#else
+   return { _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v) };
+#endif
+}
+
+SR_FORCEINLINE vec4f v4_min(vec4f a, vec4f b) { return { _mm_min_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_max(vec4f a, vec4f b) { return { _mm_max_ps(a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_sqrt(vec4f a) { return { _mm_sqrt_ps(a.v) }; }
+SR_FORCEINLINE float v4_x(vec4f a) { return _mm_cvtss_f32(a.v); }
+
+template<int i, int j, int k, int l>
+SR_FORCEINLINE vec4f v4_shuffle(vec4f a, vec4f b) { return { _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(l, k, j, i)) }; }
+
+SR_FORCEINLINE float v4_hsum(vec4f a)
+{
+   const __m128 s = _mm_add_ps(a.v, _mm_movehl_ps(a.v, a.v));
+   return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+}
+
+SR_FORCEINLINE void v4_transpose(vec4f& r0, vec4f& r1, vec4f& r2, vec4f& r3)
+{
+   _MM_TRANSPOSE4_PS(r0.v, r1.v, r2.v, r3.v);
+}
+
+#elif defined(SR_HAS_NEON)
+
+struct vec4f { float32x4_t v; };
+
+SR_FORCEINLINE vec4f v4_zero() { return { vdupq_n_f32(0.0f) }; }
+SR_FORCEINLINE vec4f v4_set1(float f) { return { vdupq_n_f32(f) }; }
+SR_FORCEINLINE vec4f v4_set(float x, float y, float z, float w)
+{
+   const float f[4] = { x, y, z, w };
+   return { vld1q_f32(f) };
+}
+SR_FORCEINLINE vec4f v4_loadu(const float* p) { return { vld1q_f32(p) }; }
+SR_FORCEINLINE void v4_storeu(float* p, vec4f a) { vst1q_f32(p, a.v); }
+SR_FORCEINLINE vec4f v4_load3(const float* p) { return { vcombine_f32(vld1_f32(p), vset_lane_f32(p[2], vdup_n_f32(0.0f), 0)) }; }
+SR_FORCEINLINE void v4_store3(float* p, vec4f a) { vst1_f32(p, vget_low_f32(a.v)); vst1q_lane_f32(p + 2, a.v, 2); }
+
+SR_FORCEINLINE vec4f operator+(vec4f a, vec4f b) { return { vaddq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator-(vec4f a, vec4f b) { return { vsubq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator*(vec4f a, vec4f b) { return { vmulq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f operator/(vec4f a, vec4f b) { return { vdivq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_fmadd(vec4f a, vec4f b, vec4f c) { return { vfmaq_f32(c.v, a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_min(vec4f a, vec4f b) { return { vminq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_max(vec4f a, vec4f b) { return { vmaxq_f32(a.v, b.v) }; }
+SR_FORCEINLINE vec4f v4_sqrt(vec4f a) { return { vsqrtq_f32(a.v) }; }
+SR_FORCEINLINE float v4_x(vec4f a) { return vgetq_lane_f32(a.v, 0); }
+
+// No general two-register shuffle: insert lane by lane
+template<int i, int j, int k, int l>
+SR_FORCEINLINE vec4f v4_shuffle(vec4f a, vec4f b)
+{
+   float32x4_t r = vdupq_n_f32(vgetq_lane_f32(a.v, i));
+   r = vsetq_lane_f32(vgetq_lane_f32(a.v, j), r, 1);
+   r = vsetq_lane_f32(vgetq_lane_f32(b.v, k), r, 2);
+   return { vsetq_lane_f32(vgetq_lane_f32(b.v, l), r, 3) };
+}
+
+SR_FORCEINLINE float v4_hsum(vec4f a) { return vaddvq_f32(a.v); }
+
+SR_FORCEINLINE void v4_transpose(vec4f& r0, vec4f& r1, vec4f& r2, vec4f& r3)
+{
+   const float32x4x2_t t0 = vtrnq_f32(r0.v, r1.v), t1 = vtrnq_f32(r2.v, r3.v);
+   r0.v = vcombine_f32(vget_low_f32(t0.val[0]), vget_low_f32(t1.val[0]));
+   r1.v = vcombine_f32(vget_low_f32(t0.val[1]), vget_low_f32(t1.val[1]));
+   r2.v = vcombine_f32(vget_high_f32(t0.val[0]), vget_high_f32(t1.val[0]));
+   r3.v = vcombine_f32(vget_high_f32(t0.val[1]), vget_high_f32(t1.val[1]));
+}
+
+#else
+
+struct vec4f { float f[4]; };
+
+#define SR_V4_MAP(expr) vec4f r; for (int k = 0; k < 4; k++) r.f[k] = (expr); return r
+
+inline vec4f v4_zero() { SR_V4_MAP(0.0f); }
+inline vec4f v4_set1(float f) { SR_V4_MAP(f); }
+inline vec4f v4_set(float x, float y, float z, float w) { return { { x, y, z, w } }; }
+inline vec4f v4_loadu(const float* p) { SR_V4_MAP(p[k]); }
+inline void v4_storeu(float* p, vec4f a) { for (int k = 0; k < 4; k++) p[k] = a.f[k]; }
+inline vec4f v4_load3(const float* p) { return { { p[0], p[1], p[2], 0.0f } }; }
+inline void v4_store3(float* p, vec4f a) { for (int k = 0; k < 3; k++) p[k] = a.f[k]; }
+
+inline vec4f operator+(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] + b.f[k]); }
+inline vec4f operator-(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] - b.f[k]); }
+inline vec4f operator*(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] * b.f[k]); }
+inline vec4f operator/(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] / b.f[k]); }
+inline vec4f v4_fmadd(vec4f a, vec4f b, vec4f c) { SR_V4_MAP(a.f[k] * b.f[k] + c.f[k]); }
+inline vec4f v4_min(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] < b.f[k] ? a.f[k] : b.f[k]); }
+inline vec4f v4_max(vec4f a, vec4f b) { SR_V4_MAP(a.f[k] > b.f[k] ? a.f[k] : b.f[k]); }
+inline vec4f v4_sqrt(vec4f a) { SR_V4_MAP(sqrtf(a.f[k])); }
+inline float v4_x(vec4f a) { return a.f[0]; }
+
+template<int i, int j, int k, int l>
+inline vec4f v4_shuffle(vec4f a, vec4f b) { return { { a.f[i], a.f[j], b.f[k], b.f[l] } }; }
+
+inline float v4_hsum(vec4f a) { return (a.f[0] + a.f[2]) + (a.f[1] + a.f[3]); }
+
+inline void v4_transpose(vec4f& r0, vec4f& r1, vec4f& r2, vec4f& r3)
+{
+   vec4f* r[4] = { &r0, &r1, &r2, &r3 };
+   for (int i = 0; i < 4; i++)
+   {
+      for (int j = i + 1; j < 4; j++)
+      {
+         const float t = r[i]->f[j];
+         r[i]->f[j] = r[j]->f[i];
+         r[j]->f[i] = t;
+      }
+   }
+}
+
+#undef SR_V4_MAP
+
+#endif
+
+template<int i>
+SR_FORCEINLINE vec4f v4_splat(vec4f a) { return v4_shuffle<i, i, i, i>(a, a); }
+
+inline const char* simd_backend_name()
+{
+#if defined(SR_SIMD_AVX2)
+   return "AVX2";
+#elif defined(SR_SIMD_SSE2)
+   return "SSE2";
+#elif defined(SR_HAS_NEON)
+   return "scalar, NEON vec4f";
+#else
+   return "scalar";
+#endif
+}
+
+}
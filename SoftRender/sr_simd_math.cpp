@@ -0,0 +1,115 @@
+#include "sr_simd_math.h"
+
+namespace sr
+{
+
+// Runs `f` over `count` values: two vec8f per step, then one, then the
+// last few through a zero-padded vec8f
+template <typename F>
+static void map1(const float* x, size_t count, float* out, F f)
+{
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16)
+   {
+      const vec8f a = f(v8_loadu(x + i)), b = f(v8_loadu(x + i + 8));
+      v8_storeu(out + i, a);
+      v8_storeu(out + i + 8, b);
+   }
+   for (; i + 8 <= count; i += 8)
+      v8_storeu(out + i, f(v8_loadu(x + i)));
+   if (i < count)
+   {
+      alignas(32) float t[8] = {};
+      memcpy(t, x + i, (count - i) * sizeof(float));
+      v8_store(t, f(v8_load(t)));
+      memcpy(out + i, t, (count - i) * sizeof(float));
+   }
+}
+
+void sin_batch(const float* x, size_t count, float* out)
+{
+   map1(x, count, out, [](vec8f v) { return v8_sin(v); });
+}
+
+void cos_batch(const float* x, size_t count, float* out)
+{
+   map1(x, count, out, [](vec8f v) { return v8_cos(v); });
+}
+
+void exp_batch(const float* x, size_t count, float* out)
+{
+   map1(x, count, out, [](vec8f v) { return v8_exp(v); });
+}
+
+void log_batch(const float* x, size_t count, float* out)
+{
+   map1(x, count, out, [](vec8f v) { return v8_log(v); });
+}
+
+void sincos_batch(const float* x, size_t count, float* s, float* c)
+{
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16)
+   {
+      vec8f s0, c0, s1, c1;
+      v8_sincos(v8_loadu(x + i), s0, c0);
+      v8_sincos(v8_loadu(x + i + 8), s1, c1);
+      v8_storeu(s + i, s0);
+      v8_storeu(s + i + 8, s1);
+      v8_storeu(c + i, c0);
+      v8_storeu(c + i + 8, c1);
+   }
+   for (; i < count; i += 8)
+   {
+      const size_t n = count - i < 8 ? count - i : 8;
+      alignas(32) float t[8] = {}, ts[8], tc[8];
+      memcpy(t, x + i, n * sizeof(float));
+      vec8f sv, cv;
+      v8_sincos(v8_load(t), sv, cv);
+      v8_store(ts, sv);
+      v8_store(tc, cv);
+      memcpy(s + i, ts, n * sizeof(float));
+      memcpy(c + i, tc, n * sizeof(float));
+   }
+}
+
+void atan2_batch(const float* y, const float* x, size_t count, float* out)
+{
+   size_t i = 0;
+   for (; i + 16 <= count; i += 16)
+   {
+      const vec8f a = v8_atan2(v8_loadu(y + i), v8_loadu(x + i));
+      const vec8f b = v8_atan2(v8_loadu(y + i + 8), v8_loadu(x + i + 8));
+      v8_storeu(out + i, a);
+      v8_storeu(out + i + 8, b);
+   }
+   for (; i < count; i += 8)
+   {
+      const size_t n = count - i < 8 ? count - i : 8;
+      alignas(32) float ty[8] = {}, tx[8] = {};
+      memcpy(ty, y + i, n * sizeof(float));
+      memcpy(tx, x + i, n * sizeof(float));
+      v8_store(ty, v8_atan2(v8_load(ty), v8_load(tx)));
+      memcpy(out + i, ty, n * sizeof(float));
+   }
+}
+
+// Sines and cosines 8 at a time into a small buffer, then the matrices
+void rotation_y_batch(const float* angles, size_t count, float4x4* out)
+{
+   alignas(32) float s[8], c[8];
+   for (size_t i = 0; i < count; i += 8)
+   {
+      const size_t n = count - i < 8 ? count - i : 8;
+      alignas(32) float t[8] = {};
+      memcpy(t, angles + i, n * sizeof(float));
+      vec8f sv, cv;
+      v8_sincos(v8_load(t), sv, cv);
+      v8_store(s, sv);
+      v8_store(c, cv);
+      for (size_t k = 0; k < n; k++)
+         out[i + k] = { { { c[k], 0.0f, -s[k], 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { s[k], 0.0f, c[k], 0.0f }, { 0.0f, 0.0f, 0.0f, 1.0f } } };
+   }
+}
+
+}
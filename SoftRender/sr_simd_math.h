@@ -0,0 +1,185 @@
+#pragma once
+
+// Polynomial sin, cos, sincos, atan2, exp and log on vec8f, and batch
+// versions over arrays. d3dmath.h's sincosf is two libm calls, each with its
+// own range reduction and branches; animating thousands of objects a frame
+// spends most of its time there.
+//
+// The kernels take one vec8f: 8 lanes on AVX2, two 4-lane halves on SSE2,
+// a loop on the scalar fallback. The batch functions run two vec8f (16
+// lanes) per step, like transform_positions_soa, so two independent
+// polynomial chains overlap. There is no 16-lane AVX-512 backend.
+//
+// Largest error against the exact result, measured by bench_simd_math
+// (which prints the full table; libm's float functions stay within 0.56):
+//
+//    sin, cos, sincos   1.5 ULP on [-pi, pi], every float checked (1.48).
+//                       Beyond, 1.6 ULP to 1e5 with FMA; without, the
+//                       reduction rounds, 1e-7 absolute for |x| <= 8192
+//                       (so more ULPs near the zeros) and up to 1e-6 at 1e5
+//    atan2              3 ULP, 2.7e-7 radians
+//    exp                1 ULP, denormal results included; 0 below -104,
+//                       inf above 88.72
+//    log                1 ULP, denormals included
+//
+// Special values: NaN in gives NaN out, log(0) = -inf, log(x < 0) = NaN,
+// exp(inf) = inf. atan2 gives +-pi for x < 0 and y = +-0 but treats -0 in x
+// as +0, and the sin and cos of +-inf are NaN.
+
+#include "sr_math.h"
+#include "sr_simd.h"
+
+#include <float.h>
+
+namespace sr
+{
+
+// x = k pi/2 + r with |r| <= pi/4. pi/2 is split in four (Cody-Waite) so
+// the first two products are exact for |k| < 2^13; the fourth part keeps r
+// accurate next to the zeros, where it is smallest
+SR_FORCEINLINE vec8f v8_reduce_half_pi(vec8f x, vec8i& k)
+{
+   k = v8_round_to_int(x * v8_set1(0.636619772f));
+   const vec8f kf = v8i_to_float(k);
+   vec8f r = v8_fmadd(kf, v8_set1(-1.5703125f), x);
+   r = v8_fmadd(kf, v8_set1(-4.837512969970703125e-4f), r);
+   r = v8_fmadd(kf, v8_set1(-7.54979012640e-8f), r);
+   return v8_fmadd(kf, v8_set1(1.71512451e-15f), r);
+}
+
+// Minimax polynomials on [-pi/4, pi/4] (Cephes sinf/cosf), on |x| with the
+// sign of x put back on the sine
+SR_FORCEINLINE void v8_sincos(vec8f x, vec8f& s, vec8f& c)
+{
+   vec8i k;
+   const vec8f r = v8_reduce_half_pi(v8_abs(x), k);
+   const vec8f z = r * r;
+
+   vec8f ps = v8_fmadd(z, v8_set1(-1.9515295891e-4f), v8_set1(8.3321608736e-3f));
+   ps = v8_fmadd(ps, z, v8_set1(-1.6666654611e-1f));
+   ps = v8_fmadd(ps * z, r, r);
+
+   vec8f pc = v8_fmadd(z, v8_set1(2.443315711809948e-5f), v8_set1(-1.388731625493765e-3f));
+   pc = v8_fmadd(pc, z, v8_set1(4.166664568298827e-2f));
+   // 1 - z/2 rounds by up to half an ULP; (1 - t) - z/2 is that rounding
+   // exactly (both subtractions are of nearby values), taken back out
+   const vec8f half_z = z * v8_set1(0.5f), t = v8_set1(1.0f) - half_z;
+   pc = t + v8_fmadd(pc * z, z, (v8_set1(1.0f) - t) - half_z);
+
+   // Odd quadrants swap the two; sin changes sign in quadrants 2 and 3,
+   // cos in 1 and 2
+   const vec8i one = v8i_set1(1), two = v8i_set1(2);
+   const vec8f swap = v8i_as_float(v8i_cmpeq(k & one, one));
+   const vec8f nan = v8_andnot(v8_cmpeq(x - x, v8_zero()), v8_true());   // all ones for inf and NaN
+   s = (v8_select(swap, pc, ps) ^ v8i_as_float(v8i_slli(k & two, 30)) ^ (x & v8_set1(-0.0f))) | nan;
+   c = (v8_select(swap, ps, pc) ^ v8i_as_float(v8i_slli((k + one) & two, 30))) | nan;
+}
+
+SR_FORCEINLINE vec8f v8_sin(vec8f x)
+{
+   vec8f s, c;
+   v8_sincos(x, s, c);
+   return s;
+}
+
+SR_FORCEINLINE vec8f v8_cos(vec8f x)
+{
+   vec8f s, c;
+   v8_sincos(x, s, c);
+   return c;
+}
+
+// atan of min(|x|, |y|) / max(|x|, |y|) in [0, 1], moved to
+// [-tan(pi/8), tan(pi/8)] by atan t = pi/4 + atan((t - 1) / (t + 1)), then
+// put back in the right octant
+SR_FORCEINLINE vec8f v8_atan2(vec8f y, vec8f x)
+{
+   const vec8f ax = v8_abs(x), ay = v8_abs(y);
+   const vec8f hi = v8_max(ax, ay), lo = v8_min(ax, ay);
+   const vec8f t = v8_andnot(v8_cmpeq(hi, v8_zero()), lo / hi);
+   const vec8f big = v8_cmpgt(t, v8_set1(0.414213562f));
+   const vec8f u = v8_select(big, (t - v8_set1(1.0f)) / (t + v8_set1(1.0f)), t);
+   const vec8f z = u * u;
+
+   vec8f p = v8_fmadd(z, v8_set1(8.05374449538e-2f), v8_set1(-1.38776856032e-1f));
+   p = v8_fmadd(p, z, v8_set1(1.99777106478e-1f));
+   p = v8_fmadd(p, z, v8_set1(-3.33329491539e-1f));
+   vec8f a = v8_fmadd(p * z, u, u) + (big & v8_set1(0.785398163f));
+
+   a = v8_select(v8_cmpgt(ay, ax), v8_set1(1.570796327f) - a, a);
+   a = v8_select(v8_cmplt(x, v8_zero()), v8_set1(3.141592654f) - a, a);
+   const vec8f nan = v8_andnot(v8_cmpeq(x, x) & v8_cmpeq(y, y), v8_true());
+   return (a ^ (y & v8_set1(-0.0f))) | nan;
+}
+
+// e^x = 2^k e^r with r = x - k ln 2 in [-ln 2 / 2, ln 2 / 2]. 2^k goes on in
+// two halves so that results near FLT_MAX and in the denormals come out
+SR_FORCEINLINE vec8f v8_exp(vec8f x)
+{
+   const vec8f xc = v8_clamp(x, v8_set1(-104.0f), v8_set1(88.8f));
+   const vec8i k = v8_round_to_int(xc * v8_set1(1.44269504089f));
+   const vec8f kf = v8i_to_float(k);
+   vec8f r = v8_fmadd(kf, v8_set1(-0.693359375f), xc);
+   r = v8_fmadd(kf, v8_set1(2.12194440e-4f), r);
+   const vec8f z = r * r;
+
+   vec8f p = v8_fmadd(r, v8_set1(1.9875691500e-4f), v8_set1(1.3981999507e-3f));
+   p = v8_fmadd(p, r, v8_set1(8.3334519073e-3f));
+   p = v8_fmadd(p, r, v8_set1(4.1665795894e-2f));
+   p = v8_fmadd(p, r, v8_set1(1.6666665459e-1f));
+   p = v8_fmadd(p, r, v8_set1(5.0000001201e-1f));
+   const vec8f e = v8_fmadd(p, z, r) + v8_set1(1.0f);
+
+   const vec8i k1 = v8_trunc_to_int(kf * v8_set1(0.5f)), k2 = k - k1;
+   const vec8i bias = v8i_set1(127);
+   const vec8f y = e * v8i_as_float(v8i_slli(k1 + bias, 23)) * v8i_as_float(v8i_slli(k2 + bias, 23));
+   return v8_select(v8_cmpeq(x, x), y, x);
+}
+
+// x = 2^e m with m in [sqrt(1/2), sqrt(2)), log x = e ln 2 + log(1 + f)
+// with f = m - 1 (Cephes logf). Denormals are scaled up by 2^23 first
+SR_FORCEINLINE vec8f v8_log(vec8f x)
+{
+   const vec8f tiny = v8_cmplt(x, v8_set1(FLT_MIN));
+   const vec8i bits = v8_as_int(v8_select(tiny, x * v8_set1(8388608.0f), x));
+   vec8f m = v8i_as_float((bits & v8i_set1(0x007fffff)) | v8i_set1(0x3f800000));
+   vec8f e = v8i_to_float(v8i_srli(bits, 23) - v8i_set1(127)) - (tiny & v8_set1(23.0f));
+   const vec8f big = v8_cmpgt(m, v8_set1(1.41421356f));
+   m = v8_select(big, m * v8_set1(0.5f), m);
+   e = e + (big & v8_set1(1.0f));
+   const vec8f f = m - v8_set1(1.0f);
+   const vec8f z = f * f;
+
+   vec8f p = v8_fmadd(f, v8_set1(7.0376836292e-2f), v8_set1(-1.1514610310e-1f));
+   p = v8_fmadd(p, f, v8_set1(1.1676998740e-1f));
+   p = v8_fmadd(p, f, v8_set1(-1.2420140846e-1f));
+   p = v8_fmadd(p, f, v8_set1(1.4249322787e-1f));
+   p = v8_fmadd(p, f, v8_set1(-1.6668057665e-1f));
+   p = v8_fmadd(p, f, v8_set1(2.0000714765e-1f));
+   p = v8_fmadd(p, f, v8_set1(-2.4999993993e-1f));
+   p = v8_fmadd(p, f, v8_set1(3.3333331174e-1f));
+   vec8f y = p * f * z;
+   y = v8_fmadd(e, v8_set1(-2.12194440e-4f), y);
+   y = v8_fmadd(z, v8_set1(-0.5f), y);
+   y = v8_fmadd(e, v8_set1(0.693359375f), f + y);
+
+   const vec8f inf = v8_set1(INFINITY);
+   y = v8_select(v8_cmpeq(x, inf), inf, y);
+   y = v8_select(v8_cmpeq(x, v8_zero()), v8_zero() - inf, y);
+   return v8_select(v8_cmpge(x, v8_zero()), y, v8_set1(NAN));
+}
+
+// ---------------------------------------------------------------------------
+// Batches: `count` values, any alignment; out may be the input
+
+void sin_batch(const float* x, size_t count, float* out);
+void cos_batch(const float* x, size_t count, float* out);
+void sincos_batch(const float* x, size_t count, float* s, float* c);
+void atan2_batch(const float* y, const float* x, size_t count, float* out);
+void exp_batch(const float* x, size_t count, float* out);
+void log_batch(const float* x, size_t count, float* out);
+
+// rotation_y (D3DMatrixRotationY) for `count` angles in radians
+void rotation_y_batch(const float* angles, size_t count, float4x4* out);
+
+}
@@ -0,0 +1,220 @@
+#include "sr_sprite.h"
+
+#include <string.h>
+
+namespace sr
+{
+
+size_t sprite_input_layout(input_element out[3])
+{
+   out[0] = { "POSITION", 0, vertex_format::r32g32_float, 0, 0 };
+   out[1] = { "TEXCOORD", 0, vertex_format::r32g32_float, 0, 8 };
+   out[2] = { "COLOR", 0, vertex_format::r8g8b8a8_unorm, 0, 16 };
+   return 3;
+}
+
+void sprite_quad_indices(uint16_t* out, uint32_t quads)
+{
+   for (uint32_t q = 0; q < quads; q++)
+   {
+      const uint16_t v = (uint16_t)(4 * q);
+      out[0] = v;
+      out[1] = (uint16_t)(v + 1);
+      out[2] = (uint16_t)(v + 2);
+      out[3] = (uint16_t)(v + 2);
+      out[4] = (uint16_t)(v + 1);
+      out[5] = (uint16_t)(v + 3);
+      out += 6;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// memory_sprite_backend
+
+uint8_t* memory_sprite_backend::map(bool discard)
+{
+   if (discard)
+      in_use_ = 0;
+   return memory_dynamic_buffer::map(discard);
+}
+
+void memory_sprite_backend::draw(const void* texture, uint32_t base_vertex, uint32_t quad_count)
+{
+   overwrites_ += base_vertex < in_use_;
+   const uint32_t end = base_vertex + 4 * quad_count;
+   in_use_ = end > in_use_ ? end : in_use_;
+   draws_.push_back({ texture, base_vertex, quad_count });
+}
+
+// ---------------------------------------------------------------------------
+// sprite_batch
+
+void sprite_batch::begin(sprite_sort sort)
+{
+   sort_ = sort;
+   sprites_.clear();
+   keys_.clear();
+   textures_.clear();
+   texture_ids_.clear();
+}
+
+uint32_t sprite_batch::texture_index(const void* handle)
+{
+   if (last_id_ < textures_.size() && handle == last_handle_)
+      return last_id_;
+   auto it = texture_ids_.find(handle);
+   if (it == texture_ids_.end())
+   {
+      it = texture_ids_.emplace(handle, (uint32_t)textures_.size()).first;
+      textures_.push_back(handle);
+   }
+   last_handle_ = handle;
+   last_id_ = it->second;
+   return last_id_;
+}
+
+// Float bits that compare as unsigned integers the way the floats compare
+static uint32_t depth_key(float depth)
+{
+   uint32_t u;
+   memcpy(&u, &depth, 4);
+   return u & 0x80000000u ? ~u : u | 0x80000000u;
+}
+
+void sprite_batch::submit(const sprite_texture& texture, const rect_f& source, const float3x2& m, uint32_t color, float depth)
+{
+   const uint32_t id = texture_index(texture.handle);
+   const float w = source.right - source.left, h = source.bottom - source.top;
+   const float iw = texture.width > 0 ? 1.0f / texture.width : 0.0f;
+   const float ih = texture.height > 0 ? 1.0f / texture.height : 0.0f;
+
+   queued_sprite s;
+   s.x = m.dx;
+   s.y = m.dy;
+   s.ax = w * m.m11;
+   s.ay = w * m.m12;
+   s.bx = h * m.m21;
+   s.by = h * m.m22;
+   s.u0 = source.left * iw;
+   s.v0 = source.top * ih;
+   s.u1 = source.right * iw;
+   s.v1 = source.bottom * ih;
+   s.color = color;
+   s.texture = id;
+   sprites_.push_back(s);
+
+   if (sort_ == sprite_sort::texture)
+      keys_.push_back(id);
+   else if (sort_ != sprite_sort::deferred)
+   {
+      const uint32_t d = sort_ == sprite_sort::back_to_front ? ~depth_key(depth) : depth_key(depth);
+      keys_.push_back((uint64_t)d << 32 | id);
+   }
+}
+
+// Stable LSD radix sort of the keys, 8 bits a pass, skipping the bytes every
+// key has the same: texture ids alone usually take one pass
+void sprite_batch::sort()
+{
+   const size_t n = keys_.size();
+   order_.resize(n);
+   for (size_t i = 0; i < n; i++)
+      order_[i] = (uint32_t)i;
+
+   uint32_t counts[8][256];
+   memset(counts, 0, sizeof(counts));
+   for (size_t i = 0; i < n; i++)
+   {
+      const uint64_t k = keys_[i];
+      for (int b = 0; b < 8; b++)
+         counts[b][(k >> (8 * b)) & 0xff]++;
+   }
+
+   keys_tmp_.resize(n);
+   order_tmp_.resize(n);
+   for (int b = 0; b < 8; b++)
+   {
+      uint32_t* c = counts[b];
+      if (c[(keys_[0] >> (8 * b)) & 0xff] == n)
+         continue;
+      uint32_t sum = 0;
+      for (int d = 0; d < 256; d++)
+      {
+         const uint32_t t = c[d];
+         c[d] = sum;
+         sum += t;
+      }
+      for (size_t i = 0; i < n; i++)
+      {
+         const uint32_t at = c[(keys_[i] >> (8 * b)) & 0xff]++;
+         keys_tmp_[at] = keys_[i];
+         order_tmp_[at] = order_[i];
+      }
+      keys_.swap(keys_tmp_);
+      order_.swap(order_tmp_);
+   }
+}
+
+bool sprite_batch::end()
+{
+   const uint32_t n = (uint32_t)sprites_.size();
+   stats_.frames++;
+   stats_.sprites += n;
+   stats_.textures += textures_.size();
+   const bool sorted = sort_ != sprite_sort::deferred && n > 0;
+   if (sorted)
+      sort();
+
+   if (n == 0)
+      return true;
+
+   // One vertex more than the quads take, so the first can start on a whole
+   // vertex. A lap that starts while earlier uploads are mapped waits for
+   // them to go up
+   const size_t count = 4 * (size_t)n + 1;
+   size_t offset;
+   sprite_vertex* v = ring_->allocate<sprite_vertex>(count, offset);
+   if (!v && ring_->allocator().wraps(count * sizeof(sprite_vertex), alignof(sprite_vertex)))
+   {
+      ring_->flush();
+      v = ring_->allocate<sprite_vertex>(count, offset);
+   }
+   if (!v)
+   {
+      sprites_.clear();
+      return false;
+   }
+   const size_t skip = (sizeof(sprite_vertex) - offset % sizeof(sprite_vertex)) % sizeof(sprite_vertex);
+   v = (sprite_vertex*)((uint8_t*)v + skip);
+   const uint32_t base = (uint32_t)((offset + skip) / sizeof(sprite_vertex));
+
+   // One pass writes the vertices and cuts them into draws
+   draws_.clear();
+   uint32_t run_start = 0, run_texture = 0;
+   for (uint32_t k = 0; k < n; k++)
+   {
+      const queued_sprite& s = sprites_[sorted ? order_[k] : k];
+      if (k == 0 || s.texture != run_texture || k - run_start == sprite_max_quads_per_draw)
+      {
+         if (k > 0)
+            draws_.push_back({ textures_[run_texture], base + 4 * run_start, k - run_start });
+         run_start = k;
+         run_texture = s.texture;
+      }
+      v[0] = { s.x, s.y, s.u0, s.v0, s.color };
+      v[1] = { s.x + s.ax, s.y + s.ay, s.u1, s.v0, s.color };
+      v[2] = { s.x + s.bx, s.y + s.by, s.u0, s.v1, s.color };
+      v[3] = { s.x + s.ax + s.bx, s.y + s.ay + s.by, s.u1, s.v1, s.color };
+      v += 4;
+   }
+   draws_.push_back({ textures_[run_texture], base + 4 * run_start, n - run_start });
+   ring_->flush();
+
+   for (const sprite_draw& d : draws_)
+      backend_->draw(d.texture, d.base_vertex, d.quad_count);
+   stats_.draws += draws_.size();
+   sprites_.clear();
+   return true;
+}
+
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+// Sprite batching. d3d11_engine::draw in Test4 binds one texture and one
+// immutable 6-vertex quad and issues Draw(numVerts); a second image would
+// take its own vertex buffer, its own state setup and its own draw.
+//
+// sprite_batch takes any number of sprites between begin() and end(): a
+// texture (an atlas page or a whole image), the texel rectangle on it, a
+// transform and a color. end() sorts them by texture, or by depth and then
+// texture, writes four vertices per sprite into a dynamic vertex buffer
+// through upload_ring, and issues one draw per run of sprites sharing a
+// texture. The index buffer is static: the same 6 indices per quad, 16-bit,
+// each draw offset by its base vertex, so a draw holds at most
+// sprite_max_quads_per_draw sprites.
+//
+// The ring may be shared with the frame's other uploads; whoever owns it
+// ends its frames and retires them. end() takes one allocation for all the
+// frame's sprites, starting on a whole vertex so draws can use a base
+// vertex, flushes it and draws: no-overwrite maps, a discard when the lap
+// starts, and one map for the frame unless the lap starts in it.
+//
+// sprite_backend stands for the device context's draws;
+// memory_sprite_backend is also the vertex buffer, in memory, and records
+// the draws, so batching runs and can be checked without a device.
+
+#include "sr_image.h"
+#include "sr_quantize.h"
+#include "sr_upload.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace sr
+{
+
+// POSITION R32G32_FLOAT, TEXCOORD R32G32_FLOAT, COLOR R8G8B8A8_UNORM in
+// slot 0. x and y are what the sprite's transform makes of its texel
+// rectangle: Test4's vertex shader passes clip space straight through, so
+// there the transform ends with the pixel to clip space mapping
+struct sprite_vertex
+{
+   float x, y;
+   float u, v;
+   uint32_t color;
+};
+
+// The elements of sprite_vertex. Returns the element count
+size_t sprite_input_layout(input_element out[3]);
+
+// Vertices 0 1 2 3 are the top-left, top-right, bottom-left and bottom-right
+// corners of the texel rectangle; the quad is triangles 0 1 2 and 2 1 3,
+// clockwise when the transform does not mirror it
+static const uint32_t sprite_max_quads_per_draw = 16384;
+
+// 6 * quads indices for the static index buffer, quads at most
+// sprite_max_quads_per_draw
+void sprite_quad_indices(uint16_t* out, uint32_t quads);
+
+struct sprite_texture
+{
+   const void* handle = nullptr;   // ID3D11ShaderResourceView* or the like
+   int width = 0;
+   int height = 0;
+};
+
+enum class sprite_sort
+{
+   deferred,        // submission order, consecutive sprites on one texture share a draw
+   texture,         // grouped by texture, submission order within each
+   back_to_front,   // larger depth first, then by texture
+   front_to_back,   // smaller depth first, then by texture
+};
+
+// The device context's side of the batch, with the ring's buffer bound as
+// vertex buffer 0 at offset 0
+class sprite_backend
+{
+public:
+   virtual ~sprite_backend() = default;
+
+   // PSSetShaderResources with `texture`, then
+   // DrawIndexed(6 * quad_count, 0, base_vertex)
+   virtual void draw(const void* texture, uint32_t base_vertex, uint32_t quad_count) = 0;
+};
+
+struct sprite_draw
+{
+   const void* texture;
+   uint32_t base_vertex;
+   uint32_t quad_count;
+};
+
+// The vertex buffer in memory, `size` bytes, and every draw recorded.
+// Within a lap the ring only moves forwards, so a draw from vertices drawn
+// from since the last discard means they were written over: counted
+class memory_sprite_backend : public memory_dynamic_buffer, public sprite_backend
+{
+public:
+   explicit memory_sprite_backend(size_t size) : memory_dynamic_buffer(size) {}
+
+   uint8_t* map(bool discard) override;
+   void draw(const void* texture, uint32_t base_vertex, uint32_t quad_count) override;
+
+   const sprite_vertex* vertices() const { return (const sprite_vertex*)data(); }
+   const std::vector<sprite_draw>& draws() const { return draws_; }
+   void clear_draws() { draws_.clear(); }
+
+   uint64_t overwrites() const { return overwrites_; }
+
+private:
+   std::vector<sprite_draw> draws_;
+   uint32_t in_use_ = 0;   // vertices 0 .. in_use_ drawn from since the last discard
+   uint64_t overwrites_ = 0;
+};
+
+struct sprite_stats
+{
+   uint64_t frames = 0;
+   uint64_t sprites = 0;
+   uint64_t draws = 0;
+   uint64_t textures = 0;   // distinct textures, summed over frames
+};
+
+class sprite_batch
+{
+public:
+   // `ring` and `backend` must outlive the batch. The ring must have room for
+   // a frame's sprites, 4 vertices each, and one vertex more
+   sprite_batch(upload_ring& ring, sprite_backend& backend) : ring_(&ring), backend_(&backend) {}
+
+   void begin(sprite_sort sort = sprite_sort::texture);
+
+   // `source` is in texels of `texture`; the sprite is that rectangle moved
+   // to the origin, then through `transform`. `color` is RGBA8, premultiplied
+   // when the blend state is
+   void submit(const sprite_texture& texture, const rect_f& source, const float3x2& transform, uint32_t color = 0xffffffffu,
+               float depth = 0.0f);
+
+   // Sorts, writes the vertices, flushes the ring and draws. False when the
+   // ring is full or fails to map; the sprites are dropped
+   bool end();
+
+   const sprite_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = sprite_stats(); }
+
+private:
+   // The edges of the texel rectangle already through the transform
+   struct queued_sprite
+   {
+      float x, y;           // top-left corner
+      float ax, ay;         // to the top-right corner
+      float bx, by;         // to the bottom-left corner
+      float u0, v0, u1, v1;
+      uint32_t color;
+      uint32_t texture;     // index into textures_
+   };
+
+   uint32_t texture_index(const void* handle);
+   void sort();
+
+   upload_ring* ring_;
+   sprite_backend* backend_;
+   sprite_sort sort_ = sprite_sort::texture;
+
+   std::vector<queued_sprite> sprites_;
+   std::vector<uint64_t> keys_, keys_tmp_;
+   std::vector<uint32_t> order_, order_tmp_;
+   std::vector<sprite_draw> draws_;   // of the frame being written
+
+   std::vector<const void*> textures_;
+   std::unordered_map<const void*, uint32_t> texture_ids_;
+   const void* last_handle_ = nullptr;
+   uint32_t last_id_ = 0;
+
+   sprite_stats stats_;
+};
+
+}
@@ -0,0 +1,621 @@
+#include "sr_stroke.h"
+
+#include <math.h>
+
+namespace sr
+{
+
+static const float pi = 3.14159265358979f;
+static const int max_split_depth = 10;
+
+static float2 add(const float2& a, const float2& b) { return { a.x + b.x, a.y + b.y }; }
+static float2 sub(const float2& a, const float2& b) { return { a.x - b.x, a.y - b.y }; }
+static float2 scale(const float2& a, float s) { return { a.x * s, a.y * s }; }
+static float2 mad(const float2& a, const float2& b, float s) { return { a.x + b.x * s, a.y + b.y * s }; }
+static float2 lerp(const float2& a, const float2& b, float t) { return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t }; }
+static float dot(const float2& a, const float2& b) { return a.x * b.x + a.y * b.y; }
+static float cross(const float2& a, const float2& b) { return a.x * b.y - a.y * b.x; }
+static float length(const float2& a) { return sqrtf(a.x * a.x + a.y * a.y); }
+
+// Left of the direction of travel (counterclockwise in y-up terms)
+static float2 normal(const float2& t) { return { -t.y, t.x }; }
+
+static bool unit(const float2& v, float2& out)
+{
+   const float l = length(v);
+   if (!(l > 1e-12f))
+      return false;
+   out = scale(v, 1.0f / l);
+   return true;
+}
+
+static float2 cubic_point(const float2* c, float t)
+{
+   const float u = 1.0f - t;
+   const float b0 = u * u * u, b1 = 3 * u * u * t, b2 = 3 * u * t * t, b3 = t * t * t;
+   return { b0 * c[0].x + b1 * c[1].x + b2 * c[2].x + b3 * c[3].x, b0 * c[0].y + b1 * c[1].y + b2 * c[2].y + b3 * c[3].y };
+}
+
+// A third of the derivative
+static float2 cubic_velocity(const float2* c, float t)
+{
+   const float u = 1.0f - t;
+   const float2 a = sub(c[1], c[0]), b = sub(c[2], c[1]), d = sub(c[3], c[2]);
+   return { u * u * a.x + 2 * u * t * b.x + t * t * d.x, u * u * a.y + 2 * u * t * b.y + t * t * d.y };
+}
+
+static void split_cubic(const float2* c, float t, float2* left, float2* right)
+{
+   const float2 ab = lerp(c[0], c[1], t), bc = lerp(c[1], c[2], t), cd = lerp(c[2], c[3], t);
+   const float2 abc = lerp(ab, bc, t), bcd = lerp(bc, cd, t);
+   const float2 m = lerp(abc, bcd, t);
+   left[0] = c[0]; left[1] = ab; left[2] = abc; left[3] = m;
+   right[0] = m; right[1] = bcd; right[2] = cd; right[3] = c[3];
+}
+
+// End tangents fall back to the next distinct control point
+static bool cubic_tangents(const float2* c, float2& t0, float2& t1)
+{
+   return (unit(sub(c[1], c[0]), t0) || unit(sub(c[2], c[0]), t0) || unit(sub(c[3], c[0]), t0)) &&
+          (unit(sub(c[3], c[2]), t1) || unit(sub(c[3], c[1]), t1) || unit(sub(c[3], c[0]), t1));
+}
+
+// Signed curvature at an end, from the control arm `a` and the second
+// difference `b` (positive when turning left)
+static float end_curvature(const float2& a, const float2& b)
+{
+   // B' = 3a, B'' = 6b
+   const float l = length(a);
+   return l > 1e-12f ? cross(a, b) * 2.0f / (3.0f * l * l * l) : 0.0f;
+}
+
+// Gauss-Legendre on each of 16 intervals; len[i] is the length up to t = i / 16
+struct arc_table
+{
+   static const int intervals = 16;
+   float len[intervals + 1];
+
+   void build(const float2* c)
+   {
+      static const float x[3] = { -0.7745967f, 0.0f, 0.7745967f };
+      static const float w[3] = { 5.0f / 9.0f, 8.0f / 9.0f, 5.0f / 9.0f };
+      const float h = 1.0f / intervals;
+      len[0] = 0.0f;
+      for (int i = 0; i < intervals; i++)
+      {
+         float s = 0.0f;
+         for (int k = 0; k < 3; k++)
+            s += w[k] * length(cubic_velocity(c, h * (i + 0.5f + 0.5f * x[k])));
+         len[i + 1] = len[i] + s * 1.5f * h;
+      }
+   }
+
+   float t_at(float l) const
+   {
+      int i = 0;
+      while (i < intervals - 1 && len[i + 1] < l)
+         i++;
+      const float d = len[i + 1] - len[i];
+      const float f = d > 0.0f ? (l - len[i]) / d : 0.0f;
+      return clamp((i + f) / intervals, 0.0f, 1.0f);
+   }
+};
+
+// ---------------------------------------------------------------------------
+// Output
+
+void path_stroker::line_to(const float2& p)
+{
+   out_->add_line(p);
+   stats_.lines++;
+}
+
+// Circular arc around `c` from c + from (|from| is the radius), `sweep`
+// radians counterclockwise in y-up terms, at most a quarter turn per cubic
+void path_stroker::arc(const float2& c, const float2& from, float sweep)
+{
+   const int n = (int)ceilf(fabsf(sweep) / (0.5f * pi) - 1e-3f);
+   if (n <= 0)
+      return;
+   const float step = sweep / (float)n;
+   const float k = 4.0f / 3.0f * tanf(step * 0.25f);
+   const float cs = cosf(step), sn = sinf(step);
+   float2 u = from;
+   for (int i = 0; i < n; i++)
+   {
+      const float2 v = { u.x * cs - u.y * sn, u.x * sn + u.y * cs };
+      out_->add_bezier(mad(add(c, u), normal(u), k), mad(add(c, v), normal(v), -k), add(c, v));
+      stats_.curves++;
+      u = v;
+   }
+}
+
+// From e + h * normal(t) round the front to e - h * normal(t)
+void path_stroker::cap(const float2& e, const float2& t, cap_style style)
+{
+   const float h = half_width_;
+   const float2 n = scale(normal(t), h);
+   const float2 b = sub(e, n);
+   switch (style)
+   {
+   case cap_style::flat:
+      line_to(b);
+      break;
+   case cap_style::square:
+      line_to(mad(add(e, n), t, h));
+      line_to(mad(b, t, h));
+      line_to(b);
+      break;
+   case cap_style::round:
+      arc(e, n, -pi);
+      break;
+   case cap_style::triangle:
+      line_to(mad(e, t, h));
+      line_to(b);
+      break;
+   }
+}
+
+// From v + h * normal(t0) to v + h * normal(t1)
+void path_stroker::join(const float2& v, const float2& t0, const float2& t1)
+{
+   const float h = half_width_;
+   const float c = cross(t0, t1), d = dot(t0, t1);
+   const float2 n0 = normal(t0), n1 = normal(t1);
+   const float2 b = mad(v, n1, h);
+   if (fabsf(c) < 1e-4f && d > 0.0f)
+      return;
+
+   // Turning left: this is the inner side. Turning back on itself both
+   // sides are outer and go round the front
+   const bool reverse = fabsf(c) < 1e-4f;
+   if (c > 0.0f && !reverse)
+   {
+      line_to(v);
+      line_to(b);
+      return;
+   }
+
+   switch (style_->join)
+   {
+   case line_join::bevel:
+      line_to(b);
+      break;
+   case line_join::round:
+      arc(v, scale(n0, h), reverse ? -pi : atan2f(c, d));
+      break;
+   case line_join::miter:
+   case line_join::miter_or_bevel:
+   {
+      // Tip distance over h is sqrt(2 / (1 + cos(turn)))
+      const float limit = style_->miter_limit > 1.0f ? style_->miter_limit : 1.0f;
+      if (1.0f + d > 2.0f / (limit * limit))
+      {
+         line_to(mad(v, add(n0, n1), h / (1.0f + d)));
+         line_to(b);
+      }
+      else if (style_->join == line_join::miter_or_bevel)
+      {
+         line_to(b);
+      }
+      else
+      {
+         // Cut square to the bisector, `limit` half widths from the vertex
+         float2 u;
+         if (!unit(add(n0, n1), u))
+            u = t0;
+         const float s = h * (limit - dot(n0, u)) / dot(t0, u);
+         line_to(mad(mad(v, n0, h), t0, s));
+         line_to(mad(b, t1, -s));
+         line_to(b);
+      }
+      break;
+   }
+   }
+}
+
+void path_stroker::offset_cubic(const float2* c, int depth)
+{
+   const float h = half_width_;
+   float2 t0, t1, tm;
+   if (!cubic_tangents(c, t0, t1))
+      return;
+   bool split = false;
+   if (depth < max_split_depth && unit(cubic_velocity(c, 0.5f), tm))
+      split = dot(t0, tm) < 0.7071f || dot(tm, t1) < 0.7071f;
+
+   float2 a[4];
+   if (!split || depth >= max_split_depth)
+   {
+      // O' = B' * (1 - h * curvature) along the left normal
+      const float s0 = 1.0f - h * end_curvature(sub(c[1], c[0]), add(sub(c[2], scale(c[1], 2.0f)), c[0]));
+      const float s1 = 1.0f - h * end_curvature(sub(c[3], c[2]), add(sub(c[3], scale(c[2], 2.0f)), c[1]));
+      a[0] = mad(c[0], normal(t0), h);
+      a[3] = mad(c[3], normal(t1), h);
+
+      // Tighter than h at both ends: this side of the piece runs backwards
+      // inside the stroke, and a straight line stays inside too
+      if (s0 <= 0.0f && s1 <= 0.0f)
+      {
+         line_to(a[3]);
+         return;
+      }
+      a[1] = mad(a[0], sub(c[1], c[0]), fmaxf(s0, 0.0f));
+      a[2] = mad(a[3], sub(c[2], c[3]), fmaxf(s1, 0.0f));
+
+      if (depth < max_split_depth)
+      {
+         const float tol2 = tolerance_ * tolerance_;
+         for (int i = 1; i <= 3 && !split; i++)
+         {
+            const float t = 0.25f * (float)i;
+            float2 tt;
+            if (!unit(cubic_velocity(c, t), tt))
+               continue;
+            // Across the offset only: sliding along it is harmless
+            const float e = dot(sub(cubic_point(a, t), cubic_point(c, t)), normal(tt)) - h;
+            split = e * e > tol2;
+         }
+      }
+      if (!split || depth >= max_split_depth)
+      {
+         out_->add_bezier(a[1], a[2], a[3]);
+         stats_.curves++;
+         return;
+      }
+   }
+
+   float2 left[4], right[4];
+   split_cubic(c, 0.5f, left, right);
+   stats_.splits++;
+   offset_cubic(left, depth + 1);
+
+   // A cusp at the split point turns like a vertex
+   float2 l0, l1, r0, r1;
+   if (cubic_tangents(left, l0, l1) && cubic_tangents(right, r0, r1))
+      join(left[3], l1, r0);
+   offset_cubic(right, depth + 1);
+}
+
+// The left offset of `segs` (of the reversed path when `reverse`), from
+// the offset start of the first segment, with joins in between
+void path_stroker::side(const segment* segs, size_t count, bool reverse)
+{
+   const float h = half_width_;
+   float2 prev_t = { 0.0f, 0.0f };
+   for (size_t i = 0; i < count; i++)
+   {
+      segment s = segs[reverse ? count - 1 - i : i];
+      if (reverse)
+      {
+         const float2 p0 = s.p[0], p1 = s.p[1];
+         s.p[0] = s.p[3]; s.p[1] = s.p[2]; s.p[2] = p1; s.p[3] = p0;
+         const float2 t0 = s.t0;
+         s.t0 = scale(s.t1, -1.0f);
+         s.t1 = scale(t0, -1.0f);
+      }
+      if (i > 0)
+         join(s.p[0], prev_t, s.t0);
+      if (s.line)
+         line_to(mad(s.p[3], normal(s.t1), h));
+      else
+         offset_cubic(s.p, 0);
+      prev_t = s.t1;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Figures
+
+void path_stroker::add_open(const segment* segs, size_t count, cap_style start, cap_style end)
+{
+   const segment& first = segs[0];
+   const segment& last = segs[count - 1];
+   out_->begin_figure(mad(first.p[0], normal(first.t0), half_width_));
+   side(segs, count, false);
+   cap(last.p[3], last.t1, end);
+   side(segs, count, true);
+   cap(first.p[0], scale(first.t0, -1.0f), start);
+   out_->end_figure(figure_end::closed);
+}
+
+void path_stroker::add_closed(const segment* segs, size_t count)
+{
+   const segment& first = segs[0];
+   const segment& last = segs[count - 1];
+   out_->begin_figure(mad(first.p[0], normal(first.t0), half_width_));
+   side(segs, count, false);
+   join(first.p[0], last.t1, first.t0);
+   out_->end_figure(figure_end::closed);
+
+   const float2 first_back = scale(first.t0, -1.0f), last_back = scale(last.t1, -1.0f);
+   out_->begin_figure(mad(last.p[3], normal(last_back), half_width_));
+   side(segs, count, true);
+   join(last.p[3], first_back, last_back);
+   out_->end_figure(figure_end::closed);
+}
+
+// Zero-length figure or dash: just the caps, facing along `t`
+void path_stroker::add_dot(const float2& p, const float2& t, cap_style start, cap_style end)
+{
+   if (start == cap_style::flat && end == cap_style::flat)
+      return;
+   out_->begin_figure(mad(p, normal(t), half_width_));
+   cap(p, t, end);
+   cap(p, scale(t, -1.0f), start);
+   out_->end_figure(figure_end::closed);
+}
+
+void path_stroker::add_figure(const float2& start, bool closed, bool dot)
+{
+   stats_.figures++;
+   if (figure_.empty())
+   {
+      // D2D draws the caps of a zero-length open figure
+      if (dot && !closed)
+         add_dot(start, { 1.0f, 0.0f }, style_->start_cap, style_->end_cap);
+      return;
+   }
+   if (!pattern_.empty())
+      add_dashes(closed);
+   else if (closed)
+      add_closed(figure_.data(), figure_.size());
+   else
+      add_open(figure_.data(), figure_.size(), style_->start_cap, style_->end_cap);
+}
+
+// Walks the figure by arc length, cutting the dashes out of its segments.
+// Figures start the pattern afresh; a closed figure that starts and ends
+// inside a dash has its last dash continue into its first
+void path_stroker::add_dashes(bool closed)
+{
+   const size_t n = pattern_.size();
+   float period = 0.0f;
+   for (float d : pattern_)
+      period += d;
+   float phase = fmodf(style_->dash_offset * 2.0f * half_width_, period);
+   if (phase < 0.0f)
+      phase += period;
+   size_t k = 0;
+   while (phase > 0.0f && phase >= pattern_[k])
+   {
+      phase -= pattern_[k];
+      k = (k + 1) % n;
+   }
+   float remaining = pattern_[k] - phase;
+   bool on = (k & 1) == 0;
+
+   const cap_style first_cap = closed ? style_->dash_cap : style_->start_cap;
+   const cap_style last_cap = closed ? style_->dash_cap : style_->end_cap;
+   bool at_start = on;           // the open piece began at the figure start
+   bool deferred = false;        // first_ holds the closed figure's first dash
+   bool whole = on;              // no dash ended yet
+   piece_.clear();
+   first_.clear();
+
+   for (const segment& seg : figure_)
+   {
+      arc_table table;
+      float total;
+      if (seg.line)
+         total = length(sub(seg.p[3], seg.p[0]));
+      else
+      {
+         table.build(seg.p);
+         total = table.len[arc_table::intervals];
+      }
+      auto t_at = [&](float l) { return seg.line ? (total > 0.0f ? l / total : 0.0f) : table.t_at(l); };
+
+      float s = 0.0f;
+      for (;;)
+      {
+         const float step = fminf(remaining, total - s);
+         if (on && step > 0.0f)
+         {
+            const float ta = t_at(s), tb = t_at(s + step);
+            segment piece;
+            piece.line = seg.line;
+            if (seg.line)
+            {
+               piece.p[0] = lerp(seg.p[0], seg.p[3], ta);
+               piece.p[3] = lerp(seg.p[0], seg.p[3], tb);
+               piece.t0 = piece.t1 = seg.t0;
+            }
+            else
+            {
+               float2 head[4], tail[4];
+               split_cubic(seg.p, tb, head, tail);
+               if (ta > 0.0f)
+                  split_cubic(head, ta / tb, tail, piece.p);
+               else
+                  for (int i = 0; i < 4; i++)
+                     piece.p[i] = head[i];
+               if (!cubic_tangents(piece.p, piece.t0, piece.t1))
+               {
+                  piece.t0 = seg.t0;
+                  piece.t1 = seg.t1;
+               }
+            }
+            piece_.push_back(piece);
+         }
+         if (remaining > total - s)
+         {
+            remaining -= total - s;
+            break;
+         }
+         s += remaining;
+
+         // The current dash or gap ends at s
+         if (on)
+         {
+            if (piece_.empty())
+            {
+               // Zero-length dash
+               const float t = t_at(s);
+               float2 dir;
+               if (seg.line || !unit(cubic_velocity(seg.p, t), dir))
+                  dir = t < 0.5f ? seg.t0 : seg.t1;
+               add_dot(seg.line ? lerp(seg.p[0], seg.p[3], t) : cubic_point(seg.p, t), dir, at_start ? first_cap : style_->dash_cap,
+                       style_->dash_cap);
+            }
+            else if (closed && at_start)
+            {
+               first_.swap(piece_);
+               deferred = true;
+            }
+            else
+               add_open(piece_.data(), piece_.size(), at_start ? first_cap : style_->dash_cap, style_->dash_cap);
+            stats_.dashes++;
+            piece_.clear();
+            at_start = false;
+            whole = false;
+         }
+         k = (k + 1) % n;
+         remaining = pattern_[k];
+         on = !on;
+      }
+   }
+
+   if (on && !piece_.empty())
+   {
+      stats_.dashes++;
+      if (whole && closed)
+         add_closed(piece_.data(), piece_.size());
+      else if (deferred)
+      {
+         piece_.insert(piece_.end(), first_.begin(), first_.end());
+         add_open(piece_.data(), piece_.size(), style_->dash_cap, style_->dash_cap);
+         deferred = false;
+      }
+      else
+         add_open(piece_.data(), piece_.size(), at_start ? first_cap : style_->dash_cap, last_cap);
+   }
+   if (deferred)
+      add_open(first_.data(), first_.size(), style_->dash_cap, style_->dash_cap);
+}
+
+void path_stroker::stroke(const path_geometry& path, float width, const stroke_style& style, const float3x2& transform, float tolerance,
+                          path_geometry& out)
+{
+   typedef path_geometry::verb verb;
+   out.clear();
+   out.set_fill_mode(fill_mode::winding);
+   stats_.strokes++;
+
+   // Largest stretch of the 2x2 part
+   const float a = transform.m11 * transform.m11 + transform.m12 * transform.m12 + transform.m21 * transform.m21 + transform.m22 * transform.m22;
+   const float det = transform.m11 * transform.m22 - transform.m12 * transform.m21;
+   const float stretch = sqrtf(0.5f * (a + sqrtf(fmaxf(a * a - 4.0f * det * det, 0.0f))));
+   if (!(width > 0.0f) || !(stretch > 0.0f))
+      return;
+
+   out_ = &out;
+   style_ = &style;
+   half_width_ = 0.5f * width;
+   tolerance_ = tolerance / stretch;
+
+   static const float dash[] = { 2, 2 };
+   static const float dot[] = { 0, 2 };
+   static const float dash_dot[] = { 2, 2, 0, 2 };
+   static const float dash_dot_dot[] = { 2, 2, 0, 2, 0, 2 };
+   pattern_.clear();
+   switch (style.dash)
+   {
+   case dash_style::solid: break;
+   case dash_style::dash: pattern_.assign(dash, dash + 2); break;
+   case dash_style::dot: pattern_.assign(dot, dot + 2); break;
+   case dash_style::dash_dot: pattern_.assign(dash_dot, dash_dot + 4); break;
+   case dash_style::dash_dot_dot: pattern_.assign(dash_dot_dot, dash_dot_dot + 6); break;
+   case dash_style::custom:
+      pattern_ = style.dashes;
+      // An odd count repeats, as in SVG
+      if (pattern_.size() & 1)
+         pattern_.insert(pattern_.end(), style.dashes.begin(), style.dashes.end());
+      break;
+   }
+   float period = 0.0f;
+   for (float& d : pattern_)
+   {
+      d = fmaxf(d, 0.0f) * width;
+      period += d;
+   }
+   if (!(period > 0.0f))
+      pattern_.clear();
+
+   const float2* pts = path.points_.data();
+   float2 start = { 0, 0 }, cur = { 0, 0 };
+   bool open = false, dot_figure = false;
+
+   auto add_line = [&](const float2& p) {
+      dot_figure = true;
+      segment s;
+      if (!unit(sub(p, cur), s.t0))
+         return;
+      s.t1 = s.t0;
+      s.p[0] = cur;
+      s.p[1] = cur;
+      s.p[2] = p;
+      s.p[3] = p;
+      s.line = true;
+      figure_.push_back(s);
+      stats_.segments++;
+   };
+   auto add_cubic = [&](const float2& c1, const float2& c2, const float2& p) {
+      dot_figure = true;
+      segment s;
+      s.p[0] = cur;
+      s.p[1] = c1;
+      s.p[2] = c2;
+      s.p[3] = p;
+      s.line = false;
+      if (!cubic_tangents(s.p, s.t0, s.t1))
+         return;
+      figure_.push_back(s);
+      stats_.segments++;
+   };
+
+   for (verb v : path.verbs_)
+   {
+      switch (v)
+      {
+      case verb::begin:
+      case verb::begin_hollow:
+         if (open)
+            add_figure(start, false, dot_figure);
+         start = cur = *pts++;
+         figure_.clear();
+         open = true;
+         dot_figure = false;
+         break;
+      case verb::line:
+         add_line(*pts);
+         cur = *pts++;
+         break;
+      case verb::quadratic:
+         // Elevated to a cubic
+         add_cubic(lerp(cur, pts[0], 2.0f / 3.0f), lerp(pts[1], pts[0], 2.0f / 3.0f), pts[1]);
+         cur = pts[1];
+         pts += 2;
+         break;
+      case verb::cubic:
+         add_cubic(pts[0], pts[1], pts[2]);
+         cur = pts[2];
+         pts += 3;
+         break;
+      case verb::end:
+      case verb::end_closed:
+         if (v == verb::end_closed)
+            add_line(start);
+         add_figure(start, v == verb::end_closed, dot_figure);
+         figure_.clear();
+         open = false;
+         break;
+      }
+   }
+   if (open)
+      add_figure(start, false, dot_figure);
+   figure_.clear();
+   out_ = nullptr;
+}
+
+}
@@ -0,0 +1,650 @@
+#include "sr_text.h"
+#include "sr_simd.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace sr
+{
+
+// ---------------------------------------------------------------------------
+// Layout
+
+// Next code point of UTF-8 `s`; malformed bytes decode as themselves
+static uint32_t next_codepoint(const char* s, size_t length, size_t& i)
+{
+   const uint8_t c = (uint8_t)s[i++];
+   int extra = c >= 0xf0 ? 3 : c >= 0xe0 ? 2 : c >= 0xc0 ? 1 : 0;
+   if (extra == 0 || i + extra > length)
+      return c;
+   uint32_t cp = c & (0x3f >> extra);
+   for (; extra > 0; extra--)
+      cp = cp << 6 | ((uint8_t)s[i++] & 0x3f);
+   return cp;
+}
+
+void layout_text(const char* text, size_t length, const text_format& format, const rect_f& box, text_layout& out)
+{
+   out.glyphs.clear();
+   out.lines = 0;
+   if (!format.font)
+      return;
+
+   const font_face& font = *format.font;
+   const font_metrics& m = font.metrics();
+   const float scale = format.size / m.units_per_em;
+
+   struct item
+   {
+      uint32_t codepoint;
+      uint16_t glyph;
+      float advance;
+   };
+   std::vector<item> items;
+   for (size_t i = 0; i < length;)
+   {
+      const uint32_t cp = next_codepoint(text, length, i);
+      const uint16_t g = font.glyph_index(cp);
+      items.push_back({ cp, g, font.glyph(g).advance * scale });
+   }
+
+   // Greedy lines; spaces at the end of a line do not count towards its width
+   struct line
+   {
+      size_t begin, end;
+      float width;
+   };
+   std::vector<line> lines;
+   const float max_width = box.right - box.left;
+   size_t begin = 0;
+   while (begin <= items.size())
+   {
+      float pen = 0.0f, width = 0.0f;
+      size_t end = begin, last_space = SIZE_MAX;
+      for (; end < items.size() && items[end].codepoint != '\n'; end++)
+      {
+         const item& it = items[end];
+         if (it.codepoint == ' ')
+         {
+            last_space = end;
+         }
+         else
+         {
+            if (format.word_wrap && pen + it.advance > max_width && last_space != SIZE_MAX)
+               break;
+            width = pen + it.advance;
+         }
+         pen += it.advance;
+      }
+
+      if (end < items.size() && items[end].codepoint != '\n')
+      {
+         // Wrapped: the line ends before the last space
+         end = last_space;
+         width = 0.0f;
+         float x = 0.0f;
+         for (size_t k = begin; k < end; k++)
+         {
+            x += items[k].advance;
+            width = items[k].codepoint != ' ' ? x : width;
+         }
+      }
+      lines.push_back({ begin, end, width });
+      begin = end + 1;
+   }
+
+   const float line_height = (m.ascent + m.descent + m.line_gap) * scale;
+   const float total = line_height * lines.size();
+   float top = box.top;
+   if (format.paragraph == paragraph_alignment::center)
+      top = box.top + (box.bottom - box.top - total) * 0.5f;
+   else if (format.paragraph == paragraph_alignment::far)
+      top = box.bottom - total;
+
+   for (size_t l = 0; l < lines.size(); l++)
+   {
+      float x = box.left;
+      if (format.alignment == text_alignment::center)
+         x = box.left + (max_width - lines[l].width) * 0.5f;
+      else if (format.alignment == text_alignment::trailing)
+         x = box.right - lines[l].width;
+      const float baseline = top + line_height * l + m.ascent * scale;
+      for (size_t k = lines[l].begin; k < lines[l].end; k++)
+      {
+         if (items[k].codepoint != ' ')
+            out.glyphs.push_back({ items[k].glyph, x, baseline });
+         x += items[k].advance;
+      }
+   }
+   out.lines = (int)lines.size();
+}
+
+bool layout_cache::key::operator==(const key& o) const
+{
+   return font == o.font && size == o.size && alignment == o.alignment && paragraph == o.paragraph &&
+          word_wrap == o.word_wrap && memcmp(&box, &o.box, sizeof(box)) == 0 && text == o.text;
+}
+
+size_t layout_cache::key_hash::operator()(const key& k) const
+{
+   uint64_t h = std::hash<std::string>()(k.text);
+   uint32_t bits[5];
+   memcpy(bits, &k.size, sizeof(float));
+   memcpy(bits + 1, &k.box, sizeof(k.box));
+   for (uint32_t b : bits)
+      h = (h ^ b) * 0x100000001b3ull;
+   h = (h ^ k.font) * 0x100000001b3ull;
+   return (size_t)(h ^ ((uint64_t)k.alignment << 8 | (uint64_t)k.paragraph << 4 | (uint64_t)k.word_wrap));
+}
+
+const text_layout& layout_cache::get(const char* text, size_t length, const text_format& format, const rect_f& box)
+{
+   key k = { std::string(text, length), format.font ? format.font->id() : 0, format.size, format.alignment,
+             format.paragraph, format.word_wrap, box };
+   auto it = layouts_.find(k);
+   if (it != layouts_.end())
+   {
+      stats_.hits++;
+      it->second.last_used = ++clock_;
+      return it->second.layout;
+   }
+
+   stats_.misses++;
+   if (layouts_.size() >= max_layouts_)
+      evict();
+   entry& e = layouts_[std::move(k)];
+   e.last_used = ++clock_;
+   layout_text(text, length, format, box, e.layout);
+   return e.layout;
+}
+
+void layout_cache::evict()
+{
+   // Least recently used first, down to 3/4 of the limit so a full cache
+   // does not sort on every miss
+   const size_t target = max_layouts_ - max_layouts_ / 4;
+   std::vector<std::pair<uint64_t, const key*>> order;
+   order.reserve(layouts_.size());
+   for (const auto& e : layouts_)
+      order.push_back({ e.second.last_used, &e.first });
+   std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, const key*>& a, const std::pair<uint64_t, const key*>& b) {
+      return a.first < b.first;
+   });
+   for (size_t i = 0; i < order.size() && layouts_.size() > target; i++)
+   {
+      layouts_.erase(*order[i].second);
+      stats_.evictions++;
+   }
+}
+
+// ---------------------------------------------------------------------------
+// Atlas
+
+bool glyph_atlas::key::operator==(const key& o) const
+{
+   return font == o.font && size == o.size && glyph == o.glyph && phase == o.phase && memcmp(m, o.m, sizeof(m)) == 0;
+}
+
+size_t glyph_atlas::key_hash::operator()(const key& k) const
+{
+   uint32_t size_bits;
+   memcpy(&size_bits, &k.size, sizeof(size_bits));
+   uint64_t h = k.font * 0x9e3779b97f4a7c15ull;
+   h ^= ((uint64_t)size_bits << 32 | (uint64_t)k.glyph << 16 | (uint16_t)k.phase) * 0xc2b2ae3d27d4eb4full;
+   uint32_t m_bits[4];
+   memcpy(m_bits, k.m, sizeof(m_bits));
+   for (uint32_t b : m_bits)
+      h = (h ^ b) * 0x100000001b3ull;
+   return (size_t)(h ^ (h >> 29));
+}
+
+glyph_atlas::glyph_atlas(int size) : size_(size), pixels_((size_t)size * size, 0)
+{
+}
+
+void glyph_atlas::reset()
+{
+   memset(pixels_.data(), 0, pixels_.size());
+   shelves_.clear();
+   shelf_bottom_ = 0;
+   glyphs_.clear();
+   stats_.resets++;
+}
+
+// Shelf packing: the first shelf tall enough (but not much taller) with
+// room left, else a new shelf. One pixel of gutter keeps glyphs apart
+bool glyph_atlas::allocate(int width, int height, int& x, int& y)
+{
+   width++;
+   height++;
+   for (shelf& s : shelves_)
+   {
+      if (height <= s.height && height * 3 >= s.height * 2 && s.x + width <= size_)
+      {
+         x = s.x;
+         y = s.y;
+         s.x += width;
+         return true;
+      }
+   }
+   if (width > size_ || shelf_bottom_ + height > size_)
+      return false;
+   shelves_.push_back({ shelf_bottom_, height, width });
+   x = 0;
+   y = shelf_bottom_;
+   shelf_bottom_ += height;
+   return true;
+}
+
+const atlas_glyph* glyph_atlas::coverage_glyph(const font_face& font, uint16_t glyph, float size, int phase)
+{
+   return transformed_glyph(font, glyph, size, identity3x2(), phase, 0);
+}
+
+// Pixel box of the glyph's outline box through `to_pixels`
+static rect_i glyph_pixel_box(const glyph_metrics& gm, const float3x2& to_pixels)
+{
+   float2 lo = { INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY };
+   const float2 corners[4] = { { gm.min.x, gm.min.y }, { gm.max.x, gm.min.y }, { gm.min.x, gm.max.y }, { gm.max.x, gm.max.y } };
+   for (const float2& c : corners)
+   {
+      const float2 d = transform_point(c, to_pixels);
+      lo = { fminf(lo.x, d.x), fminf(lo.y, d.y) };
+      hi = { fmaxf(hi.x, d.x), fmaxf(hi.y, d.y) };
+   }
+   return { (int)floorf(lo.x), (int)floorf(lo.y), (int)ceilf(hi.x), (int)ceilf(hi.y) };
+}
+
+// Font units to pixels relative to the pen position, pen phase included
+static float3x2 glyph_to_pixels(const font_face& font, float size, const float3x2& transform, int phase_x, int phase_y)
+{
+   const float scale = size / font.metrics().units_per_em;
+   const float3x2 linear = { transform.m11, transform.m12, transform.m21, transform.m22, 0.0f, 0.0f };
+   return mul(mul(scale3x2(scale, scale), linear),
+              translation3x2((float)phase_x / glyph_atlas::subpixel_steps, (float)phase_y / glyph_atlas::subpixel_steps));
+}
+
+bool glyph_atlas::too_large(const font_face& font, uint16_t glyph, float size, const float3x2& transform) const
+{
+   const glyph_metrics& gm = font.glyph(glyph);
+   if (gm.min.x > gm.max.x)
+      return false;
+   const rect_i box = glyph_pixel_box(gm, glyph_to_pixels(font, size, transform, 0, 0));
+   return (box.width() + 1) * 4 > size_ || (box.height() + 1) * 4 > size_;
+}
+
+const atlas_glyph* glyph_atlas::transformed_glyph(const font_face& font, uint16_t glyph, float size, const float3x2& transform,
+                                                  int phase_x, int phase_y)
+{
+   const key k = { font.id(), size, glyph, (int16_t)(phase_x + phase_y * subpixel_steps),
+                   { transform.m11, transform.m12, transform.m21, transform.m22 } };
+   const auto it = glyphs_.find(k);
+   if (it != glyphs_.end())
+   {
+      stats_.hits++;
+      return &it->second;
+   }
+   return rasterize(k, font, glyph_to_pixels(font, size, transform, phase_x, phase_y));
+}
+
+const atlas_glyph* glyph_atlas::rasterize(const key& k, const font_face& font, const float3x2& to_pixels)
+{
+   const glyph_metrics& gm = font.glyph(k.glyph);
+   atlas_glyph g = {};
+   if (gm.min.x <= gm.max.x)
+   {
+      const rect_i box = glyph_pixel_box(gm, to_pixels);
+      g.offset_x = box.left;
+      g.offset_y = box.top;
+      g.width = box.width();
+      g.height = box.height();
+      if (!allocate(g.width, g.height, g.x, g.y))
+         return nullptr;
+
+      // Same rasterizer as FillGeometry, with the glyph box as the target
+      const path_geometry& outline = font.outline(k.glyph);
+      lines_.clear();
+      flatten_path(outline, mul(to_pixels, translation3x2((float)-g.offset_x, (float)-g.offset_y)), 0.25f, lines_);
+      raster_.set_target_size(g.width, g.height);
+      raster_.rasterize(lines_.data(), lines_.size(), outline.get_fill_mode(), coverage_);
+      for (const coverage_strip& s : coverage_.strips)
+      {
+         for (int r = 0; r < coverage_strips::strip_height && s.y + r < g.height; r++)
+         {
+            const int width = s.x + s.width < g.width ? s.width : g.width - s.x;
+            memcpy(&pixels_[(size_t)(g.y + s.y + r) * size_ + g.x + s.x], coverage_.strip_row(s, r), width);
+         }
+      }
+      for (const coverage_span& s : coverage_.spans)
+         memset(&pixels_[(size_t)(g.y + s.y) * size_ + g.x + s.x0], s.alpha, s.x1 - s.x0);
+   }
+   stats_.rasterized++;
+   return &(glyphs_[k] = g);
+}
+
+// Distance from (px, py) to the segment, squared
+static float distance_squared(const line_segment& l, float px, float py)
+{
+   const float dx = l.x1 - l.x0, dy = l.y1 - l.y0;
+   const float len2 = dx * dx + dy * dy;
+   float t = len2 > 0.0f ? ((px - l.x0) * dx + (py - l.y0) * dy) / len2 : 0.0f;
+   t = clamp(t, 0.0f, 1.0f);
+   const float ex = l.x0 + dx * t - px, ey = l.y0 + dy * t - py;
+   return ex * ex + ey * ey;
+}
+
+const atlas_glyph* glyph_atlas::distance_field(const font_face& font, uint16_t glyph)
+{
+   const key k = { font.id(), 0.0f, glyph, -1, { 1.0f, 0.0f, 0.0f, 1.0f } };
+   const auto it = glyphs_.find(k);
+   if (it != glyphs_.end())
+   {
+      stats_.hits++;
+      return &it->second;
+   }
+
+   const glyph_metrics& gm = font.glyph(glyph);
+   const float scale = (float)sdf_size / font.metrics().units_per_em;
+   atlas_glyph g = {};
+   if (gm.min.x <= gm.max.x)
+   {
+      g.offset_x = (int)floorf(gm.min.x * scale) - sdf_spread;
+      g.offset_y = (int)floorf(gm.min.y * scale) - sdf_spread;
+      g.width = (int)ceilf(gm.max.x * scale) + sdf_spread - g.offset_x;
+      g.height = (int)ceilf(gm.max.y * scale) + sdf_spread - g.offset_y;
+      if (!allocate(g.width, g.height, g.x, g.y))
+         return nullptr;
+
+      lines_.clear();
+      flatten_path(font.outline(glyph), mul(scale3x2(scale, scale), translation3x2((float)-g.offset_x, (float)-g.offset_y)), 0.1f, lines_);
+      const bool even_odd = font.outline(glyph).get_fill_mode() == fill_mode::alternate;
+      const float to_value = 127.0f / sdf_spread;
+      for (int y = 0; y < g.height; y++)
+      {
+         uint8_t* dst = &pixels_[(size_t)(g.y + y) * size_ + g.x];
+         const float py = y + 0.5f;
+         for (int x = 0; x < g.width; x++)
+         {
+            // Nearest edge, and the winding from a ray to the right for the sign
+            const float px = x + 0.5f;
+            float best = INFINITY;
+            int winding = 0;
+            for (const line_segment& l : lines_)
+            {
+               best = fminf(best, distance_squared(l, px, py));
+               if ((l.y0 <= py) != (l.y1 <= py))
+               {
+                  const float cx = l.x0 + (py - l.y0) * (l.x1 - l.x0) / (l.y1 - l.y0);
+                  if (cx > px)
+                     winding += l.y1 > l.y0 ? 1 : -1;
+               }
+            }
+            const bool inside = even_odd ? (winding & 1) != 0 : winding != 0;
+            const float d = (inside ? 1.0f : -1.0f) * sqrtf(best);
+            dst[x] = (uint8_t)clamp(128.0f + d * to_value + 0.5f, 0.0f, 255.0f);
+         }
+      }
+   }
+   stats_.distance_fields++;
+   return &(glyphs_[k] = g);
+}
+
+// ---------------------------------------------------------------------------
+// Rendering
+
+void draw_glyph_quads(image_rgba8& target, const glyph_atlas& atlas, const glyph_quad* quads, size_t count)
+{
+   const rect_i& clip = target.clip();
+   for (size_t i = 0; i < count; i++)
+   {
+      const glyph_quad& q = quads[i];
+      const rect_i r = intersect({ q.x, q.y, q.x + q.width, q.y + q.height }, clip);
+      if (r.empty())
+         continue;
+      for (int y = r.top; y < r.bottom; y++)
+         blend_mask(target.row(y) + r.left, atlas.row(q.atlas_y + y - q.y) + q.atlas_x + (r.left - q.x), r.width(), q.color);
+   }
+}
+
+// Pixels [x0, x1) of a row whose atlas position p + x * dp stays within
+// [lo, hi] (on one axis), narrowed from the range passed in
+static void limit_row(float p, float dp, float lo, float hi, float& x0, float& x1)
+{
+   if (dp == 0.0f)
+   {
+      if (p < lo || p > hi)
+         x1 = x0;
+      return;
+   }
+   float a = (lo - p) / dp, b = (hi - p) / dp;
+   if (a > b)
+      std::swap(a, b);
+   x0 = fmaxf(x0, floorf(a));
+   x1 = fminf(x1, ceilf(b) + 1.0f);
+}
+
+void draw_sdf_quads(image_rgba8& target, const glyph_atlas& atlas, const sdf_quad* quads, size_t count, std::vector<uint8_t>& coverage)
+{
+   const rect_i& clip = target.clip();
+   const int atlas_size = atlas.size();
+   for (size_t i = 0; i < count; i++)
+   {
+      const sdf_quad& q = quads[i];
+      const rect_i r = intersect(q.bounds, clip);
+      if (r.empty())
+         continue;
+      if (coverage.size() < (size_t)q.bounds.width() + 8)
+         coverage.resize(q.bounds.width() + 8);
+
+      // Texel centers sit at half-integers; samples clamp to the glyph's
+      // rectangle, whose border is far outside the outline
+      const float u_min = q.atlas_x + 0.5f, u_max = q.atlas_x + q.width - 0.5f;
+      const float v_min = q.atlas_y + 0.5f, v_max = q.atlas_y + q.height - 0.5f;
+      const vec8f u_lo = v8_set1(u_min), u_hi = v8_set1(u_max), v_lo = v8_set1(v_min), v_hi = v8_set1(v_max);
+      const vec8f du = v8_set1(q.to_atlas.m11), dv = v8_set1(q.to_atlas.m12);
+      const vec8f half = v8_set1(0.5f), center = v8_set1(128.0f), zero = v8_zero(), one = v8_set1(1.0f);
+      const vec8f to_pixels = v8_set1(q.pixels_per_texel * glyph_atlas::sdf_spread / 127.0f);
+      const int u_last = q.atlas_x + q.width - 1, v_last = q.atlas_y + q.height - 1;
+
+      // Rows step from the quad's left edge, not the clip's, so a glyph
+      // drawn in pieces (tiles) gets the same pixels as drawn whole
+      const int ox = q.bounds.left;
+      for (int y = r.top; y < r.bottom; y++)
+      {
+         // Only the pixels that map into the glyph's rectangle
+         const float2 p = transform_point({ ox + 0.5f, y + 0.5f }, q.to_atlas);
+         float xa = (float)(r.left - ox), xb = (float)(r.right - ox);
+         limit_row(p.x, q.to_atlas.m11, u_min, u_max, xa, xb);
+         limit_row(p.y, q.to_atlas.m12, v_min, v_max, xa, xb);
+         const int x0 = (int)xa, x1 = (int)xb;
+         if (x0 >= x1)
+            continue;
+
+         const vec8f pu = v8_set1(p.x), pv = v8_set1(p.y);
+         bool any = false;
+         for (int x = x0; x < x1; x += 8)
+         {
+            const vec8f xs = v8_set1((float)x) + v8_ramp();
+            const vec8f u = v8_clamp(pu + du * xs, u_lo, u_hi) - half;
+            const vec8f v = v8_clamp(pv + dv * xs, v_lo, v_hi) - half;
+            const vec8f uf = v8_floor(u), vf = v8_floor(v);
+            alignas(32) int32_t iu[8], iv[8];
+            v8i_store(iu, v8_trunc_to_int(uf));
+            v8i_store(iv, v8_trunc_to_int(vf));
+
+            // Bytes do not gather; fetch the four texels per pixel here
+            alignas(32) float t00[8], t10[8], t01[8], t11[8];
+            for (int k = 0; k < 8; k++)
+            {
+               const uint8_t* r0 = atlas.pixels() + (size_t)iv[k] * atlas_size;
+               const uint8_t* r1 = iv[k] < v_last ? r0 + atlas_size : r0;
+               const int u1 = iu[k] < u_last ? iu[k] + 1 : iu[k];
+               t00[k] = r0[iu[k]];
+               t10[k] = r0[u1];
+               t01[k] = r1[iu[k]];
+               t11[k] = r1[u1];
+            }
+            const vec8f fu = u - uf, fv = v - vf;
+            const vec8f a = v8_load(t00), b = v8_load(t10), c = v8_load(t01), d = v8_load(t11);
+            const vec8f top = a + (b - a) * fu;
+            const vec8f bottom = c + (d - c) * fu;
+            const vec8f dist = (top + (bottom - top) * fv - center) * to_pixels;
+            const vec8f cov = v8_clamp(half + dist, zero, one);
+
+            alignas(32) int32_t bytes[8];
+            v8i_store(bytes, v8_trunc_to_int(cov * v8_set1(255.0f) + half));
+            for (int k = 0; k < 8; k++)
+               coverage[x + k] = (uint8_t)bytes[k];
+            any = any || v8_movemask(v8_cmpgt(cov, zero)) != 0;
+         }
+         if (any)
+            blend_mask(target.row(y) + ox + x0, coverage.data() + x0, x1 - x0, q.color);
+      }
+   }
+}
+
+bool text_renderer::emit(const text_layout& layout, const text_format& format, const float3x2& transform, uint32_t color,
+                         std::vector<glyph_quad>& quads, std::vector<sdf_quad>& sdf_quads)
+{
+   const font_face& font = *format.font;
+
+   // Translation and uniform scale: coverage glyphs at the scaled size
+   if (transform.m12 == 0.0f && transform.m21 == 0.0f && transform.m11 == transform.m22 && transform.m11 > 0.0f)
+   {
+      const float size = format.size * transform.m11;
+      for (const positioned_glyph& pg : layout.glyphs)
+      {
+         const float2 p = transform_point({ pg.x, pg.y }, transform);
+         const float q = floorf(p.x * glyph_atlas::subpixel_steps + 0.5f);
+         const int x = (int)floorf(q / glyph_atlas::subpixel_steps);
+         const int phase = (int)q - x * glyph_atlas::subpixel_steps;
+         const int y = (int)floorf(p.y + 0.5f);
+         const atlas_glyph* g = atlas_.coverage_glyph(font, pg.glyph, size, phase);
+         if (!g)
+            return false;
+         stats_.glyphs++;
+         if (g->width == 0)
+            continue;
+         quads.push_back({ x + g->offset_x, y + g->offset_y, g->x, g->y, g->width, g->height, color });
+         stats_.quads++;
+      }
+      return true;
+   }
+
+   // Anything else: coverage through the transform at quarter-pixel phases
+   // on both axes, or the distance fields for glyphs too large for that
+   const float texel = format.size / glyph_atlas::sdf_size;
+   const float pixels_per_texel = texel * sqrtf(fabsf(transform.m11 * transform.m22 - transform.m12 * transform.m21));
+   for (const positioned_glyph& pg : layout.glyphs)
+   {
+      if (!atlas_.too_large(font, pg.glyph, format.size, transform))
+      {
+         const float2 p = transform_point({ pg.x, pg.y }, transform);
+         const float qx = floorf(p.x * glyph_atlas::subpixel_steps + 0.5f);
+         const float qy = floorf(p.y * glyph_atlas::subpixel_steps + 0.5f);
+         const int x = (int)floorf(qx / glyph_atlas::subpixel_steps);
+         const int y = (int)floorf(qy / glyph_atlas::subpixel_steps);
+         const atlas_glyph* g = atlas_.transformed_glyph(font, pg.glyph, format.size, transform,
+                                                         (int)qx - x * glyph_atlas::subpixel_steps, (int)qy - y * glyph_atlas::subpixel_steps);
+         if (!g)
+            return false;
+         stats_.glyphs++;
+         if (g->width == 0)
+            continue;
+         quads.push_back({ x + g->offset_x, y + g->offset_y, g->x, g->y, g->width, g->height, color });
+         stats_.quads++;
+         continue;
+      }
+
+      const atlas_glyph* g = atlas_.distance_field(font, pg.glyph);
+      if (!g)
+         return false;
+      stats_.glyphs++;
+      if (g->width == 0)
+         continue;
+
+      const float3x2 to_device = mul(mul(scale3x2(texel, texel),
+                                         translation3x2(pg.x + (g->offset_x - g->x) * texel, pg.y + (g->offset_y - g->y) * texel)),
+                                     transform);
+      sdf_quad q;
+      if (!invert(to_device, q.to_atlas))
+         continue;
+      float2 lo = { INFINITY, INFINITY }, hi = { -INFINITY, -INFINITY };
+      const float2 corners[4] = { { (float)g->x, (float)g->y }, { (float)(g->x + g->width), (float)g->y },
+                                  { (float)g->x, (float)(g->y + g->height) }, { (float)(g->x + g->width), (float)(g->y + g->height) } };
+      for (const float2& c : corners)
+      {
+         const float2 d = transform_point(c, to_device);
+         lo = { fminf(lo.x, d.x), fminf(lo.y, d.y) };
+         hi = { fmaxf(hi.x, d.x), fmaxf(hi.y, d.y) };
+      }
+      q.bounds = enclosing_pixels({ lo.x, lo.y, hi.x, hi.y });
+      q.atlas_x = g->x;
+      q.atlas_y = g->y;
+      q.width = g->width;
+      q.height = g->height;
+      q.pixels_per_texel = pixels_per_texel;
+      q.color = color;
+      sdf_quads.push_back(q);
+      stats_.sdf_quads++;
+   }
+   return true;
+}
+
+void text_renderer::draw_text(image_rgba8& target, const char* text, size_t length, const text_format& format, const rect_f& box,
+                              const float3x2& transform, uint32_t color)
+{
+   if (!format.font)
+      return;
+   if (target_ != &target)
+      flush();
+   target_ = &target;
+   stats_.draws++;
+
+   const text_layout& layout = layouts_.get(text, length, format, box);
+   const size_t quads = quads_.size(), sdf_quads = sdf_quads_.size();
+   if (emit(layout, format, transform, color, quads_, sdf_quads_))
+      return;
+
+   // The atlas filled up: draw what came before this call, start a new
+   // atlas and emit the whole layout again
+   quads_.resize(quads);
+   sdf_quads_.resize(sdf_quads);
+   flush();
+   target_ = &target;
+   atlas_.reset();
+   emit(layout, format, transform, color, quads_, sdf_quads_);
+}
+
+bool text_renderer::record_text(const char* text, size_t length, const text_format& format, const rect_f& box, const float3x2& transform,
+                                uint32_t color, std::vector<glyph_quad>& quads, std::vector<sdf_quad>& sdf_quads)
+{
+   if (!format.font)
+      return true;
+   stats_.draws++;
+
+   const text_layout& layout = layouts_.get(text, length, format, box);
+   const size_t quad_count = quads.size(), sdf_count = sdf_quads.size();
+   if (emit(layout, format, transform, color, quads, sdf_quads))
+      return true;
+   quads.resize(quad_count);
+   sdf_quads.resize(sdf_count);
+   return false;
+}
+
+void text_renderer::flush()
+{
+   if (target_)
+   {
+      draw_glyph_quads(*target_, atlas_, quads_.data(), quads_.size());
+      draw_sdf_quads(*target_, atlas_, sdf_quads_.data(), sdf_quads_.size(), coverage_);
+      stats_.flushes++;
+   }
+   quads_.clear();
+   sdf_quads_.clear();
+   target_ = nullptr;
+}
+
+}
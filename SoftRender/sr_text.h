@@ -0,0 +1,285 @@
+#pragma once
+
+// DrawText for the 2D path. OnRender and RenderD2DContentIntoSurface draw
+// the same "Hello, World!" with the same text format every frame, once
+// unrotated and once under a 45 degree rotation.
+//
+//  1. layout_text() does what IDWriteTextLayout does for the sample: maps
+//     characters to glyphs, wraps words to the layout box and aligns lines.
+//     layout_cache keeps layouts keyed by string, format and box.
+//  2. glyph_atlas rasterizes each glyph once per size and quarter-pixel
+//     horizontal phase into an 8-bit coverage atlas (shelf packed). Under a
+//     rotation, skew or non-uniform scale the glyph is rasterized through
+//     that transform, once per quarter-pixel phase on both axes, keyed by
+//     the transform's linear part: the sample's 45 degree text is as exact
+//     as unrotated text and costs a blit per glyph after the first frame.
+//     Transformed glyphs too large to cache sensibly fall back to one signed
+//     distance field per glyph.
+//  3. text_renderer turns layouts into quads: whole-pixel atlas blits, or
+//     distance-field quads for those large glyphs. Quads are queued and
+//     drawn in one pass per flush.
+
+#include "sr_font.h"
+#include "sr_image.h"
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace sr
+{
+
+// DWRITE_TEXT_ALIGNMENT
+enum class text_alignment
+{
+   leading,
+   trailing,
+   center,
+};
+
+// DWRITE_PARAGRAPH_ALIGNMENT
+enum class paragraph_alignment
+{
+   near,
+   far,
+   center,
+};
+
+// IDWriteTextFormat
+struct text_format
+{
+   const font_face* font = nullptr;
+   float size = 12.0f;                     // em size in pixels (DIPs)
+   text_alignment alignment = text_alignment::leading;
+   paragraph_alignment paragraph = paragraph_alignment::near;
+   bool word_wrap = true;                  // DWRITE_WORD_WRAPPING_WRAP
+};
+
+// A glyph with its pen position on the baseline
+struct positioned_glyph
+{
+   uint16_t glyph;
+   float x, y;
+};
+
+struct text_layout
+{
+   std::vector<positioned_glyph> glyphs;
+   int lines = 0;
+};
+
+// Lays out UTF-8 `text` in `box`. Lines break at '\n' and, with word wrap,
+// at spaces before a word that would cross the right edge
+void layout_text(const char* text, size_t length, const text_format& format, const rect_f& box, text_layout& out);
+
+struct layout_cache_stats
+{
+   uint64_t hits = 0;
+   uint64_t misses = 0;
+   uint64_t evictions = 0;
+};
+
+class layout_cache
+{
+public:
+   explicit layout_cache(size_t max_layouts = 4096) : max_layouts_(max_layouts) {}
+
+   const text_layout& get(const char* text, size_t length, const text_format& format, const rect_f& box);
+   void clear() { layouts_.clear(); }
+
+   size_t size() const { return layouts_.size(); }
+   const layout_cache_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = layout_cache_stats(); }
+
+private:
+   struct key
+   {
+      std::string text;
+      uint64_t font;
+      float size;
+      text_alignment alignment;
+      paragraph_alignment paragraph;
+      bool word_wrap;
+      rect_f box;
+
+      bool operator==(const key& o) const;
+   };
+
+   struct key_hash
+   {
+      size_t operator()(const key& k) const;
+   };
+
+   struct entry
+   {
+      text_layout layout;
+      uint64_t last_used;
+   };
+
+   void evict();
+
+   size_t max_layouts_;
+   uint64_t clock_ = 0;
+   std::unordered_map<key, entry, key_hash> layouts_;
+   layout_cache_stats stats_;
+};
+
+// Where a glyph image lives in the atlas. (offset_x, offset_y) is the atlas
+// rectangle's top-left relative to the pen position: whole pixels for
+// coverage glyphs, distance-field texels for SDF glyphs
+struct atlas_glyph
+{
+   int x, y, width, height;
+   int offset_x, offset_y;
+};
+
+struct glyph_atlas_stats
+{
+   uint64_t hits = 0;
+   uint64_t rasterized = 0;      // coverage glyphs added
+   uint64_t distance_fields = 0; // SDF glyphs added
+   uint64_t resets = 0;
+};
+
+class glyph_atlas
+{
+public:
+   static const int subpixel_steps = 4;   // horizontal phases per pixel
+   static const int sdf_size = 48;        // em size the distance fields are built at
+   static const int sdf_spread = 6;       // distance range, texels either side of the edge
+
+   explicit glyph_atlas(int size = 1024);
+
+   // Coverage of `glyph` at `size` pixels and pen phase / subpixel_steps;
+   // null when the atlas is full (reset() and ask again)
+   const atlas_glyph* coverage_glyph(const font_face& font, uint16_t glyph, float size, int phase);
+
+   // Same through the linear part of `transform` (its translation is
+   // ignored), with pen phases on both axes. Null when the atlas is full
+   const atlas_glyph* transformed_glyph(const font_face& font, uint16_t glyph, float size, const float3x2& transform, int phase_x,
+                                        int phase_y);
+
+   // Whether transformed_glyph() would take more than a sixteenth of the
+   // atlas; those are drawn from the distance field
+   bool too_large(const font_face& font, uint16_t glyph, float size, const float3x2& transform) const;
+
+   // Distance field of `glyph`: 128 on the outline, 127 / sdf_spread per
+   // texel inside (up) or outside (down); null when the atlas is full
+   const atlas_glyph* distance_field(const font_face& font, uint16_t glyph);
+
+   void reset();
+
+   int size() const { return size_; }
+   const uint8_t* pixels() const { return pixels_.data(); }
+   const uint8_t* row(int y) const { return pixels_.data() + (size_t)y * size_; }
+   size_t glyph_count() const { return glyphs_.size(); }
+   size_t bytes() const { return pixels_.size(); }
+   const glyph_atlas_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = glyph_atlas_stats(); }
+
+private:
+   struct key
+   {
+      uint64_t font;
+      float size;      // 0 for distance fields
+      uint16_t glyph;
+      int16_t phase;   // x + y * subpixel_steps; -1 for distance fields
+      float m[4];      // linear part of the transform, identity for plain coverage
+
+      bool operator==(const key& o) const;
+   };
+
+   struct key_hash
+   {
+      size_t operator()(const key& k) const;
+   };
+
+   struct shelf
+   {
+      int y, height, x;
+   };
+
+   bool allocate(int width, int height, int& x, int& y);
+   const atlas_glyph* rasterize(const key& k, const font_face& font, const float3x2& to_pixels);
+
+   int size_;
+   aligned_vector<uint8_t> pixels_;
+   std::vector<shelf> shelves_;
+   int shelf_bottom_ = 0;
+   std::unordered_map<key, atlas_glyph, key_hash> glyphs_;
+   std::vector<line_segment> lines_;
+   strip_rasterizer raster_;
+   coverage_strips coverage_;
+   glyph_atlas_stats stats_;
+};
+
+// A coverage glyph placed at whole-pixel position (x, y)
+struct glyph_quad
+{
+   int x, y;
+   int atlas_x, atlas_y, width, height;
+   uint32_t color;
+};
+
+// A distance-field glyph under an arbitrary transform: `bounds` are the
+// device pixels it may touch, `to_atlas` maps device points to atlas texels
+struct sdf_quad
+{
+   rect_i bounds;
+   float3x2 to_atlas;
+   int atlas_x, atlas_y, width, height;
+   float pixels_per_texel;
+   uint32_t color;
+};
+
+struct text_stats
+{
+   uint64_t draws = 0;
+   uint64_t glyphs = 0;
+   uint64_t quads = 0;
+   uint64_t sdf_quads = 0;
+   uint64_t flushes = 0;
+};
+
+class text_renderer
+{
+public:
+   explicit text_renderer(int atlas_size = 1024) : atlas_(atlas_size) {}
+
+   // DrawText with a premultiplied solid color. Quads are queued; they are
+   // drawn by flush(), which also runs when the target changes or the atlas
+   // has to be reset
+   void draw_text(image_rgba8& target, const char* text, size_t length, const text_format& format, const rect_f& box,
+                  const float3x2& transform, uint32_t color);
+   void flush();
+
+   // Lays out the text and adds its glyphs to the atlas like draw_text, but
+   // appends the quads to `quads` / `sdf_quads` instead of queuing them.
+   // False when the atlas is full: nothing is appended, and quads recorded
+   // so far have to be drawn before the atlas is reset
+   bool record_text(const char* text, size_t length, const text_format& format, const rect_f& box, const float3x2& transform,
+                    uint32_t color, std::vector<glyph_quad>& quads, std::vector<sdf_quad>& sdf_quads);
+
+   glyph_atlas& atlas() { return atlas_; }
+   layout_cache& layouts() { return layouts_; }
+   const text_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = text_stats(); }
+
+private:
+   bool emit(const text_layout& layout, const text_format& format, const float3x2& transform, uint32_t color,
+             std::vector<glyph_quad>& quads, std::vector<sdf_quad>& sdf_quads);
+
+   glyph_atlas atlas_;
+   layout_cache layouts_;
+   image_rgba8* target_ = nullptr;
+   std::vector<glyph_quad> quads_;
+   std::vector<sdf_quad> sdf_quads_;
+   std::vector<uint8_t> coverage_;
+   text_stats stats_;
+};
+
+// Draws queued quads onto `target`, clipped to its clip rectangle
+void draw_glyph_quads(image_rgba8& target, const glyph_atlas& atlas, const glyph_quad* quads, size_t count);
+void draw_sdf_quads(image_rgba8& target, const glyph_atlas& atlas, const sdf_quad* quads, size_t count, std::vector<uint8_t>& coverage);
+
+}
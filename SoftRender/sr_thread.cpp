@@ -0,0 +1,84 @@
+#include "sr_thread.h"
+
+namespace sr
+{
+
+thread_pool::thread_pool(int threads)
+{
+   if (threads <= 0)
+      threads = (int)std::thread::hardware_concurrency();
+   if (threads <= 0)
+      threads = 1;
+   for (int i = 1; i < threads; i++)
+      workers_.emplace_back([this, i] { work(i); });
+}
+
+thread_pool::~thread_pool()
+{
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      quit_ = true;
+   }
+   start_.notify_all();
+   for (std::thread& t : workers_)
+      t.join();
+}
+
+void thread_pool::drain(int thread)
+{
+   for (int item = next_++; item < count_; item = next_++)
+      (*job_)(item, thread);
+}
+
+void thread_pool::work(int thread)
+{
+   uint64_t seen = 0;
+   for (;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock(mutex_);
+         start_.wait(lock, [&] { return quit_ || generation_ != seen; });
+         if (quit_)
+            return;
+         seen = generation_;
+      }
+
+      drain(thread);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (--busy_ == 0)
+         done_.notify_one();
+   }
+}
+
+void thread_pool::run(int count, const std::function<void(int item, int thread)>& fn)
+{
+   if (count <= 0)
+      return;
+
+   // Not worth waking anyone for a single item
+   if (workers_.empty() || count == 1)
+   {
+      for (int i = 0; i < count; i++)
+         fn(i, 0);
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(mutex_);
+      job_ = &fn;
+      count_ = count;
+      next_ = 0;
+      busy_ = (int)workers_.size();
+      generation_++;
+   }
+   start_.notify_all();
+
+   drain(0);
+
+   std::unique_lock<std::mutex> lock(mutex_);
+   done_.wait(lock, [&] { return busy_ == 0; });
+   job_ = nullptr;
+}
+
+}
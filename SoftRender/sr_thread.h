@@ -0,0 +1,53 @@
+#pragma once
+
+// Worker threads for the parallel passes. run() hands out items one at a
+// time from a shared counter to the workers and the calling thread, so
+// uneven items (a busy tile next to an empty one) balance themselves, and
+// returns when every item is done.
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace sr
+{
+
+class thread_pool
+{
+public:
+   // `threads` counts the calling thread; 0 uses every hardware thread
+   explicit thread_pool(int threads = 0);
+   ~thread_pool();
+
+   thread_pool(const thread_pool&) = delete;
+   thread_pool& operator=(const thread_pool&) = delete;
+
+   int threads() const { return (int)workers_.size() + 1; }
+
+   // Calls fn(item, thread) for every item in [0, count), with thread in
+   // [0, threads()) naming the thread that runs it (for per-thread scratch).
+   // Not reentrant
+   void run(int count, const std::function<void(int item, int thread)>& fn);
+
+private:
+   void work(int thread);
+   void drain(int thread);
+
+   std::vector<std::thread> workers_;
+   std::mutex mutex_;
+   std::condition_variable start_;
+   std::condition_variable done_;
+   uint64_t generation_ = 0;
+   int busy_ = 0;
+   bool quit_ = false;
+
+   const std::function<void(int, int)>* job_ = nullptr;
+   int count_ = 0;
+   std::atomic<int> next_{ 0 };
+};
+
+}
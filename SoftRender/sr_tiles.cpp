@@ -0,0 +1,211 @@
+#include "sr_tiles.h"
+
+#include <math.h>
+
+namespace sr
+{
+
+tile_renderer::tile_renderer(thread_pool& pool, int tile_size)
+   : pool_(&pool), tile_size_(tile_size)
+{
+}
+
+void tile_renderer::rasterize(image_rgba8& target, const display_list& list)
+{
+   const std::vector<draw_command>& commands = list.commands();
+   to_rasterize_.clear();
+   for (size_t i = 0; i < commands.size(); i++)
+   {
+      const draw_kind kind = commands[i].kind;
+      prepared_[i].coverage = -1;
+      if ((kind == draw_kind::fill_rect || kind == draw_kind::fill_geometry) && !prepared_[i].bounds.empty())
+      {
+         prepared_[i].coverage = (int)to_rasterize_.size();
+         to_rasterize_.push_back((uint32_t)i);
+      }
+   }
+   if (coverage_.size() < to_rasterize_.size())
+      coverage_.resize(to_rasterize_.size());
+
+   for (thread_scratch& s : scratch_)
+      s.raster.set_target_size(target.width(), target.height());
+
+   pool_->run((int)to_rasterize_.size(), [&](int item, int thread) {
+      const draw_command& c = commands[to_rasterize_[item]];
+      thread_scratch& s = scratch_[thread];
+      s.lines.clear();
+      fill_mode mode = fill_mode::winding;
+      if (c.kind == draw_kind::fill_rect)
+      {
+         const rect_f& r = c.rect;
+         s.lines.push_back({ r.left, r.top, r.right, r.top });
+         s.lines.push_back({ r.right, r.top, r.right, r.bottom });
+         s.lines.push_back({ r.right, r.bottom, r.left, r.bottom });
+         s.lines.push_back({ r.left, r.bottom, r.left, r.top });
+      }
+      else
+      {
+         flatten_path(*c.geometry, c.transform, 0.25f, s.lines);
+         mode = c.geometry->get_fill_mode();
+      }
+      s.raster.rasterize(s.lines.data(), s.lines.size(), mode, coverage_[item]);
+   });
+   stats_.rasterized += to_rasterize_.size();
+}
+
+void tile_renderer::render(image_rgba8& target, const display_list& list)
+{
+   const std::vector<draw_command>& commands = list.commands();
+   const rect_i clip = target.clip();
+   stats_.frames++;
+   stats_.commands += commands.size();
+   if (clip.empty() || commands.empty())
+      return;
+
+   scratch_.resize(pool_->threads());
+   prepared_.resize(commands.size());
+   for (size_t i = 0; i < commands.size(); i++)
+      prepared_[i].bounds = commands[i].kind == draw_kind::push_layer ? rect_i{ 0, 0, 0, 0 } : intersect(commands[i].bounds, clip);
+   rasterize(target, list);
+
+   // Text, in order. Its bounds come from the quads it made
+   quads_.clear();
+   sdf_quads_.clear();
+   size_t first = 0;
+   for (size_t i = 0; i < commands.size(); i++)
+   {
+      const draw_command& c = commands[i];
+      if (c.kind != draw_kind::draw_text)
+         continue;
+
+      prepared& p = prepared_[i];
+      size_t quads = quads_.size(), sdf_quads = sdf_quads_.size();
+      bool recorded = text_.record_text(list.text(c), c.text_length, c.format, c.rect, c.transform, c.color, quads_, sdf_quads_);
+      if (!recorded)
+      {
+         // The atlas is full: draw everything before this command with the
+         // atlas as it is, then start over with an empty one
+         draw(target, list, first, i);
+         first = i;
+         quads_.clear();
+         sdf_quads_.clear();
+         quads = sdf_quads = 0;
+         text_.atlas().reset();
+         recorded = text_.record_text(list.text(c), c.text_length, c.format, c.rect, c.transform, c.color, quads_, sdf_quads_);
+      }
+
+      // Nothing recorded means more glyphs than the whole atlas holds
+      p.quads = (uint32_t)quads;
+      p.quad_count = (uint32_t)(quads_.size() - quads);
+      p.sdf_quads = (uint32_t)sdf_quads;
+      p.sdf_count = (uint32_t)(sdf_quads_.size() - sdf_quads);
+      rect_i bounds = { 0, 0, 0, 0 };
+      for (size_t k = quads; k < quads_.size(); k++)
+      {
+         const glyph_quad& q = quads_[k];
+         bounds = bounding_union(bounds, { q.x, q.y, q.x + q.width, q.y + q.height });
+      }
+      for (size_t k = sdf_quads; k < sdf_quads_.size(); k++)
+         bounds = bounding_union(bounds, sdf_quads_[k].bounds);
+      p.bounds = intersect(bounds, clip);
+   }
+   draw(target, list, first, commands.size());
+}
+
+void tile_renderer::draw(image_rgba8& target, const display_list& list, size_t first, size_t last)
+{
+   const std::vector<draw_command>& commands = list.commands();
+   const rect_i clip = target.clip();
+   const int ts = tile_size_;
+   const int tiles_x = (clip.width() + ts - 1) / ts, tiles_y = (clip.height() + ts - 1) / ts;
+   const int tiles = tiles_x * tiles_y;
+   stats_.passes++;
+
+   // Count, then place: tile t's commands end up in submission order in
+   // bins_[bin_offsets_[t] .. bin_offsets_[t + 1])
+   auto tile_range = [&](const rect_i& b, int& tx0, int& ty0, int& tx1, int& ty1) {
+      tx0 = (b.left - clip.left) / ts;
+      ty0 = (b.top - clip.top) / ts;
+      tx1 = (b.right - 1 - clip.left) / ts;
+      ty1 = (b.bottom - 1 - clip.top) / ts;
+   };
+   bin_offsets_.assign((size_t)tiles + 1, 0);
+   for (size_t i = first; i < last; i++)
+   {
+      const rect_i& b = prepared_[i].bounds;
+      if (b.empty())
+         continue;
+      int tx0, ty0, tx1, ty1;
+      tile_range(b, tx0, ty0, tx1, ty1);
+      for (int ty = ty0; ty <= ty1; ty++)
+         for (int tx = tx0; tx <= tx1; tx++)
+            bin_offsets_[ty * tiles_x + tx + 1]++;
+   }
+   for (int t = 0; t < tiles; t++)
+      bin_offsets_[t + 1] += bin_offsets_[t];
+   bins_.resize(bin_offsets_[tiles]);
+   stats_.binned += bins_.size();
+
+   // bin_offsets_[t] is used as tile t's cursor, which leaves it at the end
+   // of tile t; shifting by one restores the starts
+   for (size_t i = first; i < last; i++)
+   {
+      const rect_i& b = prepared_[i].bounds;
+      if (b.empty())
+         continue;
+      int tx0, ty0, tx1, ty1;
+      tile_range(b, tx0, ty0, tx1, ty1);
+      for (int ty = ty0; ty <= ty1; ty++)
+         for (int tx = tx0; tx <= tx1; tx++)
+            bins_[bin_offsets_[ty * tiles_x + tx]++] = (uint32_t)i;
+   }
+   for (int t = tiles; t > 0; t--)
+      bin_offsets_[t] = bin_offsets_[t - 1];
+   bin_offsets_[0] = 0;
+
+   busy_tiles_.clear();
+   for (int t = 0; t < tiles; t++)
+   {
+      if (bin_offsets_[t + 1] > bin_offsets_[t])
+         busy_tiles_.push_back((uint32_t)t);
+   }
+   stats_.tiles_drawn += busy_tiles_.size();
+
+   pool_->run((int)busy_tiles_.size(), [&](int item, int thread) {
+      const int t = (int)busy_tiles_[item];
+      const int x = clip.left + (t % tiles_x) * ts, y = clip.top + (t / tiles_x) * ts;
+      image_rgba8 view = image_rgba8::view(target);
+      view.set_clip(intersect({ x, y, x + ts, y + ts }, clip));
+      for (uint32_t k = bin_offsets_[t]; k < bin_offsets_[t + 1]; k++)
+         play(view, commands[bins_[k]], prepared_[bins_[k]], scratch_[thread]);
+   });
+}
+
+void tile_renderer::play(image_rgba8& view, const draw_command& c, const prepared& p, thread_scratch& scratch)
+{
+   switch (c.kind)
+   {
+   case draw_kind::fill_rect:
+   case draw_kind::fill_geometry:
+      fill_coverage(view, coverage_[p.coverage], c.color);
+      break;
+   case draw_kind::draw_image:
+      draw_image(view, *c.image, c.x, c.y, c.opacity);
+      break;
+   case draw_kind::fill_gradient:
+      fill_rect(view, c.bounds, *c.gradient);
+      break;
+   case draw_kind::fill_bitmap:
+      fill_rect(view, c.bounds, *c.bitmap);
+      break;
+   case draw_kind::draw_text:
+      draw_glyph_quads(view, text_.atlas(), quads_.data() + p.quads, p.quad_count);
+      draw_sdf_quads(view, text_.atlas(), sdf_quads_.data() + p.sdf_quads, p.sdf_count, scratch.sdf_coverage);
+      break;
+   case draw_kind::push_layer:
+   case draw_kind::pop_layer:
+      break;
+   }
+}
+
+}
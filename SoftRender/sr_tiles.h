@@ -0,0 +1,94 @@
+#pragma once
+
+// Tile-parallel playback of a display list. RenderD2DContentIntoSurface
+// issues its draws in order on one thread; here a recorded frame is drawn in
+// three passes:
+//
+//  1. Prepare: fills and geometries are flattened and rasterized to coverage
+//     once each, spread over the pool (one strip_rasterizer per thread);
+//     text is laid out and its glyphs added to the atlas, in order, on the
+//     calling thread.
+//  2. Bin: every command goes into the list of each screen tile its bounds
+//     overlap, in submission order.
+//  3. Draw: threads take whole tiles and play their lists through a view of
+//     the target clipped to the tile.
+//
+// A tile's commands run in painter's order and every kernel's output for a
+// pixel depends only on the command, so the frame is the same pixel for
+// pixel for any number of threads. When the glyph atlas fills up the list is
+// split: what was recorded so far is drawn, the atlas reset, and preparing
+// continues.
+
+#include "sr_scene.h"
+#include "sr_thread.h"
+
+#include <vector>
+
+namespace sr
+{
+
+struct tile_stats
+{
+   uint64_t frames = 0;
+   uint64_t passes = 0;          // bin + draw passes (more than frames when the atlas filled)
+   uint64_t commands = 0;
+   uint64_t rasterized = 0;      // fills and geometries turned into coverage
+   uint64_t binned = 0;          // (tile, command) pairs
+   uint64_t tiles_drawn = 0;     // tiles with at least one command
+};
+
+class tile_renderer
+{
+public:
+   // `pool` must outlive the renderer
+   explicit tile_renderer(thread_pool& pool, int tile_size = 128);
+
+   void set_tile_size(int size) { tile_size_ = size; }
+   int tile_size() const { return tile_size_; }
+
+   // Draws `list` over `target`, within its clip rectangle
+   void render(image_rgba8& target, const display_list& list);
+
+   text_renderer& text() { return text_; }
+   const tile_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = tile_stats(); }
+
+private:
+   // What pass 1 made for a command
+   struct prepared
+   {
+      rect_i bounds;        // clipped to the target
+      int coverage;         // index into coverage_, or -1
+      uint32_t quads, quad_count;
+      uint32_t sdf_quads, sdf_count;
+   };
+
+   struct thread_scratch
+   {
+      strip_rasterizer raster;
+      std::vector<line_segment> lines;
+      std::vector<uint8_t> sdf_coverage;
+   };
+
+   void rasterize(image_rgba8& target, const display_list& list);
+   void draw(image_rgba8& target, const display_list& list, size_t first, size_t last);
+   void play(image_rgba8& view, const draw_command& c, const prepared& p, thread_scratch& scratch);
+
+   thread_pool* pool_;
+   int tile_size_;
+   text_renderer text_;
+   std::vector<prepared> prepared_;
+   std::vector<coverage_strips> coverage_;
+   std::vector<uint32_t> to_rasterize_;
+   std::vector<glyph_quad> quads_;
+   std::vector<sdf_quad> sdf_quads_;
+   std::vector<thread_scratch> scratch_;
+
+   // Pass 2: tile t owns bins_[bin_offsets_[t] .. bin_offsets_[t + 1])
+   std::vector<uint32_t> bin_offsets_;
+   std::vector<uint32_t> bins_;
+   std::vector<uint32_t> busy_tiles_;
+   tile_stats stats_;
+};
+
+}
@@ -0,0 +1,138 @@
+#include "sr_upload.h"
+
+namespace sr
+{
+
+// ---------------------------------------------------------------------------
+// ring_allocator
+
+ring_allocator::ring_allocator(size_t capacity, uint32_t frames_in_flight)
+   : capacity_(capacity), frames_in_flight_(frames_in_flight), head_(capacity)
+{
+   // head_ at the end: the first allocation starts a lap
+}
+
+bool ring_allocator::wraps(size_t size, size_t alignment) const
+{
+   const size_t aligned = (head_ + alignment - 1) & ~(alignment - 1);
+   return head_ == capacity_ || aligned > capacity_ || size > capacity_ - aligned;
+}
+
+bool ring_allocator::place(size_t size, size_t alignment, size_t& offset, size_t& skipped) const
+{
+   // Either aligned at the head, or at 0 with the rest of the lap wasted;
+   // nothing is wasted when nothing is in flight
+   const bool wrap = wraps(size, alignment);
+   offset = wrap ? 0 : (head_ + alignment - 1) & ~(alignment - 1);
+   skipped = wrap ? (in_use() ? capacity_ - head_ : 0) : offset - head_;
+   return size <= capacity_ && skipped + size <= capacity_ - in_use();
+}
+
+bool ring_allocator::fits(size_t size, size_t alignment) const
+{
+   size_t offset, skipped;
+   return place(size, alignment, offset, skipped);
+}
+
+bool ring_allocator::allocate(size_t size, size_t alignment, ring_allocation& out)
+{
+   const bool wrap = wraps(size, alignment);
+   size_t offset, skipped;
+   if (!place(size, alignment, offset, skipped))
+   {
+      stats_.failures++;
+      return false;
+   }
+
+   head_ = offset + size;
+   consumed_ += skipped + size;
+   out.offset = offset;
+   out.discard = wrap;
+
+   stats_.allocations++;
+   stats_.requested += size;
+   stats_.discards += wrap;
+   (wrap ? stats_.wrap_waste : stats_.padding) += skipped;
+   stats_.peak_in_use = in_use() > stats_.peak_in_use ? in_use() : stats_.peak_in_use;
+   return true;
+}
+
+uint64_t ring_allocator::end_frame()
+{
+   const uint64_t fence = ++fence_;
+   marks_.push_back({ fence, consumed_ });
+   stats_.frames++;
+   if (frames_in_flight_ && fence > frames_in_flight_)
+      retire(fence - frames_in_flight_);
+   return fence;
+}
+
+void ring_allocator::retire(uint64_t fence)
+{
+   while (!marks_.empty() && marks_.front().fence <= fence)
+   {
+      released_ = marks_.front().consumed;
+      retired_ = marks_.front().fence;
+      marks_.pop_front();
+   }
+}
+
+void ring_allocator::reset()
+{
+   if (!marks_.empty())
+      retired_ = marks_.back().fence;
+   marks_.clear();
+   released_ = consumed_;
+   head_ = capacity_;
+}
+
+// ---------------------------------------------------------------------------
+// memory_dynamic_buffer
+
+uint8_t* memory_dynamic_buffer::map(bool discard)
+{
+   maps_++;
+   discards_ += discard;
+   return data_.data();
+}
+
+// ---------------------------------------------------------------------------
+// upload_ring
+
+void* upload_ring::allocate(size_t size, size_t alignment, size_t& offset)
+{
+   // Mapped before anything is taken from the ring, with discard when this
+   // allocation starts the lap, so a failed map leaves the ring as it was.
+   // A full ring is not mapped at all
+   const bool wrap = allocator_.wraps(size, alignment);
+   if (mapped_ && wrap)
+      return nullptr;
+   if (!mapped_ && allocator_.fits(size, alignment))
+   {
+      mapped_ = buffer_->map(wrap);
+      if (!mapped_)
+         return nullptr;
+   }
+   ring_allocation a;
+   if (!allocator_.allocate(size, alignment, a))
+      return nullptr;
+   offset = a.offset;
+   return mapped_ + a.offset;
+}
+
+void upload_ring::flush()
+{
+   if (mapped_)
+   {
+      buffer_->unmap();
+      mapped_ = nullptr;
+   }
+}
+
+uint64_t upload_ring::end_frame()
+{
+   flush();
+   return allocator_.end_frame();
+}
+
+}
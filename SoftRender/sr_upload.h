@@ -0,0 +1,183 @@
+#pragma once
+
+// Per-frame uploads through one large dynamic buffer. Test1's
+// InitializeD3DTriangle creates a D3D11_USAGE_DYNAMIC vertex buffer with
+// D3D11_CPU_ACCESS_WRITE and never writes it again, and DXGISample sets
+// World, View and Projection through ID3D10Effect variables every frame, a
+// small upload per matrix.
+//
+// ring_allocator hands out aligned byte ranges of a buffer of fixed size
+// in order, like a bump allocator that wraps. It only does the arithmetic,
+// so it runs and can be checked without a device. end_frame() closes a
+// frame and returns its fence; the bytes of a frame are reused only once
+// retire() says the GPU is done with that fence, or once frames_in_flight
+// later frames have ended (DXGI's maximum frame latency, 3 by default).
+// An allocation that does not fit before the end of the buffer goes to
+// offset 0, leaving the tail unused, and is flagged `discard`: the lap
+// starts with D3D11_MAP_WRITE_DISCARD, every other allocation maps with
+// D3D11_MAP_WRITE_NO_OVERWRITE. When the frames still in flight leave no
+// room, allocate() fails and changes nothing.
+//
+// upload_ring puts the allocator over a dynamic_buffer (ID3D11Buffer and
+// its context): it maps on the first allocation after flush(), with
+// discard when that allocation starts the lap, before taking it from the
+// ring, so a failed map loses nothing. It hands out pointers into the
+// mapping, so a frame's vertices and constants are written in place and go
+// up as one upload, usually one map a frame. flush() unmaps before the
+// draws that read them. Constant buffer ranges are bound with VSSetConstantBuffers1,
+// whose offsets are in multiples of 16 constants: allocate them with
+// constant_alignment.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+namespace sr
+{
+
+// Bytes between D3D11.1 constant buffer offsets
+static const size_t constant_alignment = 256;
+
+struct ring_allocation
+{
+   size_t offset;
+   bool discard;   // first allocation of a lap
+};
+
+struct ring_stats
+{
+   uint64_t allocations = 0;
+   uint64_t failures = 0;
+   uint64_t frames = 0;
+   uint64_t discards = 0;
+   uint64_t requested = 0;    // bytes asked for
+   uint64_t padding = 0;      // bytes skipped to align
+   uint64_t wrap_waste = 0;   // bytes left at the end of a lap
+   size_t peak_in_use = 0;
+};
+
+class ring_allocator
+{
+public:
+   // frames_in_flight 0: only retire() frees
+   explicit ring_allocator(size_t capacity, uint32_t frames_in_flight = 3);
+
+   // `alignment` a power of two. False when `size` does not fit in the space
+   // the frames in flight leave
+   bool allocate(size_t size, size_t alignment, ring_allocation& out);
+
+   // Whether that allocation would start a lap, and whether it would succeed
+   bool wraps(size_t size, size_t alignment) const;
+   bool fits(size_t size, size_t alignment) const;
+
+   // Closes the current frame and returns its fence
+   uint64_t end_frame();
+
+   // The GPU is done with every frame up to `fence`
+   void retire(uint64_t fence);
+
+   // Everything in flight is done, e.g. after device loss or a full flush.
+   // The next allocation starts a lap
+   void reset();
+
+   size_t capacity() const { return capacity_; }
+   size_t in_use() const { return (size_t)(consumed_ - released_); }
+   uint64_t retired() const { return retired_; }
+   uint64_t frame() const { return fence_ + 1; }
+   const ring_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = ring_stats(); }
+
+private:
+   struct frame_mark
+   {
+      uint64_t fence;
+      uint64_t consumed;   // consumed_ when the frame ended
+   };
+
+   // Where allocate() would put `size` bytes and the bytes it would skip;
+   // false when they do not fit
+   bool place(size_t size, size_t alignment, size_t& offset, size_t& skipped) const;
+
+   size_t capacity_;
+   uint32_t frames_in_flight_;
+   size_t head_;              // next free byte
+   uint64_t consumed_ = 0;    // bytes taken since construction, padding and waste included
+   uint64_t released_ = 0;    // of those, bytes of retired frames
+   uint64_t fence_ = 0;       // of the last frame ended
+   uint64_t retired_ = 0;
+   std::deque<frame_mark> marks_;   // frames ended and not retired, oldest first
+   ring_stats stats_;
+};
+
+// ID3D11Buffer with D3D11_USAGE_DYNAMIC and D3D11_CPU_ACCESS_WRITE and its
+// device context
+class dynamic_buffer
+{
+public:
+   virtual ~dynamic_buffer() = default;
+
+   // Map with D3D11_MAP_WRITE_DISCARD when `discard`, with
+   // D3D11_MAP_WRITE_NO_OVERWRITE otherwise: the whole buffer. Null on failure
+   virtual uint8_t* map(bool discard) = 0;
+   virtual void unmap() = 0;
+};
+
+// The buffer in memory, counting maps
+class memory_dynamic_buffer : public dynamic_buffer
+{
+public:
+   explicit memory_dynamic_buffer(size_t size) : data_(size) {}
+
+   uint8_t* map(bool discard) override;
+   void unmap() override {}
+
+   const uint8_t* data() const { return data_.data(); }
+   uint64_t maps() const { return maps_; }
+   uint64_t discards() const { return discards_; }
+
+private:
+   std::vector<uint8_t> data_;
+   uint64_t maps_ = 0;
+   uint64_t discards_ = 0;
+};
+
+class upload_ring
+{
+public:
+   // `buffer` must outlive the ring and hold `capacity` bytes
+   upload_ring(dynamic_buffer& buffer, size_t capacity, uint32_t frames_in_flight = 3)
+      : buffer_(&buffer), allocator_(capacity, frames_in_flight)
+   {
+   }
+
+   // Where to write `size` bytes, valid until flush(); `offset` is where
+   // they are in the buffer. Null when the ring is full, when the map fails,
+   // and when the allocation would start a lap while there are writes since
+   // the last flush(): the discard would drop them, so flush(), draw what
+   // was written and ask again
+   void* allocate(size_t size, size_t alignment, size_t& offset);
+
+   template<class T>
+   T* allocate(size_t count, size_t& offset, size_t alignment = alignof(T))
+   {
+      return (T*)allocate(count * sizeof(T), alignment, offset);
+   }
+
+   // Unmaps, before the draws that read what was written
+   void flush();
+
+   // flush() and ring_allocator::end_frame()
+   uint64_t end_frame();
+   void retire(uint64_t fence) { allocator_.retire(fence); }
+
+   const ring_allocator& allocator() const { return allocator_; }
+
+private:
+   dynamic_buffer* buffer_;
+   ring_allocator allocator_;
+   uint8_t* mapped_ = nullptr;
+};
+
+}
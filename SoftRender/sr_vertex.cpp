@@ -0,0 +1,196 @@
+#include "sr_vertex.h"
+
+#include <string.h>
+
+namespace sr
+{
+
+void transform_positions_soa(
+   const float4x4& m,
+   const float* px,
+   const float* py,
+   const float* pz,
+   size_t count,
+   float* ox,
+   float* oy,
+   float* oz,
+   float* ow
+   )
+{
+   const vec8f m00 = v8_set1(m.m[0][0]), m01 = v8_set1(m.m[0][1]), m02 = v8_set1(m.m[0][2]), m03 = v8_set1(m.m[0][3]);
+   const vec8f m10 = v8_set1(m.m[1][0]), m11 = v8_set1(m.m[1][1]), m12 = v8_set1(m.m[1][2]), m13 = v8_set1(m.m[1][3]);
+   const vec8f m20 = v8_set1(m.m[2][0]), m21 = v8_set1(m.m[2][1]), m22 = v8_set1(m.m[2][2]), m23 = v8_set1(m.m[2][3]);
+   const vec8f m30 = v8_set1(m.m[3][0]), m31 = v8_set1(m.m[3][1]), m32 = v8_set1(m.m[3][2]), m33 = v8_set1(m.m[3][3]);
+
+   size_t i = 0;
+
+   // Two independent vec8f chains per step keep both FMA ports busy
+   for (; i + 16 <= count; i += 16)
+   {
+      const vec8f x0 = v8_loadu(px + i), x1 = v8_loadu(px + i + 8);
+      const vec8f y0 = v8_loadu(py + i), y1 = v8_loadu(py + i + 8);
+      const vec8f z0 = v8_loadu(pz + i), z1 = v8_loadu(pz + i + 8);
+
+      v8_storeu(ox + i, v8_fmadd(x0, m00, v8_fmadd(y0, m10, v8_fmadd(z0, m20, m30))));
+      v8_storeu(ox + i + 8, v8_fmadd(x1, m00, v8_fmadd(y1, m10, v8_fmadd(z1, m20, m30))));
+      v8_storeu(oy + i, v8_fmadd(x0, m01, v8_fmadd(y0, m11, v8_fmadd(z0, m21, m31))));
+      v8_storeu(oy + i + 8, v8_fmadd(x1, m01, v8_fmadd(y1, m11, v8_fmadd(z1, m21, m31))));
+      v8_storeu(oz + i, v8_fmadd(x0, m02, v8_fmadd(y0, m12, v8_fmadd(z0, m22, m32))));
+      v8_storeu(oz + i + 8, v8_fmadd(x1, m02, v8_fmadd(y1, m12, v8_fmadd(z1, m22, m32))));
+      v8_storeu(ow + i, v8_fmadd(x0, m03, v8_fmadd(y0, m13, v8_fmadd(z0, m23, m33))));
+      v8_storeu(ow + i + 8, v8_fmadd(x1, m03, v8_fmadd(y1, m13, v8_fmadd(z1, m23, m33))));
+   }
+
+   for (; i + 8 <= count; i += 8)
+   {
+      const vec8f x = v8_loadu(px + i), y = v8_loadu(py + i), z = v8_loadu(pz + i);
+      v8_storeu(ox + i, v8_fmadd(x, m00, v8_fmadd(y, m10, v8_fmadd(z, m20, m30))));
+      v8_storeu(oy + i, v8_fmadd(x, m01, v8_fmadd(y, m11, v8_fmadd(z, m21, m31))));
+      v8_storeu(oz + i, v8_fmadd(x, m02, v8_fmadd(y, m12, v8_fmadd(z, m22, m32))));
+      v8_storeu(ow + i, v8_fmadd(x, m03, v8_fmadd(y, m13, v8_fmadd(z, m23, m33))));
+   }
+
+   for (; i < count; i++)
+   {
+      const float4 r = transform_point({ px[i], py[i], pz[i] }, m);
+      ox[i] = r.x;
+      oy[i] = r.y;
+      oz[i] = r.z;
+      ow[i] = r.w;
+   }
+}
+
+vertex_stage::vertex_stage(uint32_t cache_entries)
+   : transform_(identity4x4())
+{
+   uint32_t n = 1;
+   while (n < cache_entries)
+      n <<= 1;
+   cache_.assign(n, cache_entry{ 0, 0, 0 });
+   cache_mask_ = n - 1;
+}
+
+void vertex_stage::set_transforms(const float4x4& world, const float4x4& view, const float4x4& projection)
+{
+   transform_ = mul(mul(world, view), projection);
+}
+
+void vertex_stage::draw_indexed(
+   const void* vertices,
+   size_t stride,
+   const uint16_t* indices,
+   size_t index_count,
+   clip_vertices& out,
+   std::vector<uint32_t>& out_indices
+   )
+{
+   draw_indexed_impl((const uint8_t*)vertices, stride, indices, index_count, out, out_indices);
+}
+
+void vertex_stage::draw_indexed(
+   const void* vertices,
+   size_t stride,
+   const uint32_t* indices,
+   size_t index_count,
+   clip_vertices& out,
+   std::vector<uint32_t>& out_indices
+   )
+{
+   draw_indexed_impl((const uint8_t*)vertices, stride, indices, index_count, out, out_indices);
+}
+
+template<class Index>
+void vertex_stage::draw_indexed_impl(
+   const uint8_t* vertices,
+   size_t stride,
+   const Index* indices,
+   size_t index_count,
+   clip_vertices& out,
+   std::vector<uint32_t>& out_indices
+   )
+{
+   // A new draw id invalidates every cache entry without touching them;
+   // on wrap-around the tags have to be reset for real
+   if (++draw_id_ == 0)
+   {
+      for (cache_entry& e : cache_)
+         e.draw = 0;
+      draw_id_ = 1;
+   }
+
+   stats_.draws++;
+   stats_.indices += index_count;
+   out_indices.resize(index_count);
+   out.resize(0);
+   size_t out_count = 0;
+   pending_count_ = 0;
+
+   // Locals so the compiler does not reload members after every uint32 store
+   cache_entry* const cache = cache_.data();
+   const uint32_t mask = cache_mask_;
+   const uint32_t draw = draw_id_;
+   uint32_t* const remap = out_indices.data();
+   uint64_t misses = 0;
+
+   for (size_t i = 0; i < index_count; i++)
+   {
+      const uint32_t v = (uint32_t)indices[i];
+      cache_entry& e = cache[(v ^ (v >> 13)) & mask];
+
+      if (e.draw == draw && e.vertex == v)
+      {
+         remap[i] = e.slot;
+         continue;
+      }
+
+      // Miss: the vertex gets the next output slot; its position is produced
+      // when the pending batch is flushed
+      misses++;
+      const uint32_t slot = (uint32_t)(out_count + pending_count_);
+      e.vertex = v;
+      e.slot = slot;
+      e.draw = draw;
+      remap[i] = slot;
+      pending_[pending_count_++] = v;
+
+      if (pending_count_ == batch_size)
+         flush(vertices, stride, out, out_count);
+   }
+
+   stats_.misses += misses;
+   stats_.hits += index_count - misses;
+
+   if (pending_count_)
+      flush(vertices, stride, out, out_count);
+   out.resize(out_count);
+}
+
+void vertex_stage::flush(const uint8_t* vertices, size_t stride, clip_vertices& out, size_t& out_count)
+{
+   // AoS -> SoA gather of the pending positions
+   for (int k = 0; k < pending_count_; k++)
+   {
+      float p[3];
+      memcpy(p, vertices + (size_t)pending_[k] * stride, sizeof(p));
+      gather_x_[k] = p[0];
+      gather_y_[k] = p[1];
+      gather_z_[k] = p[2];
+   }
+
+   if (out.size() < out_count + batch_size)
+   {
+      size_t grow = out.size() * 2;
+      out.resize(grow > out_count + batch_size ? grow : out_count + batch_size);
+   }
+
+   // Round up to whole vectors: the gather buffers and the output have room
+   // for a full batch, so the padding lanes are harmless
+   const size_t n = ((size_t)pending_count_ + 7) & ~(size_t)7;
+   transform_positions_soa(transform_, gather_x_, gather_y_, gather_z_, n,
+      &out.x[out_count], &out.y[out_count], &out.z[out_count], &out.w[out_count]);
+
+   out_count += pending_count_;
+   pending_count_ = 0;
+}
+
+}
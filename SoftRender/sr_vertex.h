@@ -0,0 +1,137 @@
+#pragma once
+
+// CPU vertex stage: position transform to clip space.
+//
+// DXGISample's VS multiplies every vertex by World, View and Projection in
+// turn, and DrawIndexed runs it again for each reference to a shared vertex.
+// Here the three matrices are concatenated once per draw, positions are
+// transformed in structure-of-arrays form 16 at a time (two vec8f per step),
+// and an index-driven post-transform cache makes sure a vertex referenced by
+// several triangles is transformed only once while it stays in the cache.
+
+#include "sr_math.h"
+#include "sr_simd.h"
+
+#include <vector>
+
+namespace sr
+{
+
+// Clip-space positions, one array per component
+struct clip_vertices
+{
+   aligned_vector<float> x, y, z, w;
+
+   size_t size() const { return x.size(); }
+
+   void resize(size_t n)
+   {
+      x.resize(n);
+      y.resize(n);
+      z.resize(n);
+      w.resize(n);
+   }
+
+   float4 get(size_t i) const { return { x[i], y[i], z[i], w[i] }; }
+};
+
+// out = (p, 1) * m for `count` positions stored as separate x/y/z arrays.
+// Input and output pointers need no particular alignment.
+void transform_positions_soa(
+   const float4x4& m,
+   const float* px,
+   const float* py,
+   const float* pz,
+   size_t count,
+   float* ox,
+   float* oy,
+   float* oz,
+   float* ow
+   );
+
+struct vertex_cache_stats
+{
+   uint64_t draws = 0;
+   uint64_t indices = 0;
+   uint64_t hits = 0;
+   uint64_t misses = 0;   // == vertices actually transformed
+
+   double hit_rate() const { return indices ? (double)hits / (double)indices : 0.0; }
+};
+
+class vertex_stage
+{
+public:
+   // cache_entries is rounded up to a power of two
+   explicit vertex_stage(uint32_t cache_entries = 4096);
+
+   // Concatenates the chain once; every vertex of the next draws then costs
+   // a single matrix multiply
+   void set_transforms(const float4x4& world, const float4x4& view, const float4x4& projection);
+   void set_transform(const float4x4& world_view_projection) { transform_ = world_view_projection; }
+   const float4x4& transform() const { return transform_; }
+
+   // Transforms the vertices referenced by `indices`. `vertices` points at the
+   // position (three floats) of the first vertex of an interleaved buffer, for
+   // example &s_VertexArray[0].Pos with stride sizeof(SimpleVertex).
+   //
+   // `out` receives each transformed vertex once, in first-use order, and
+   // `out_indices` the index list remapped into `out`.
+   void draw_indexed(
+      const void* vertices,
+      size_t stride,
+      const uint16_t* indices,
+      size_t index_count,
+      clip_vertices& out,
+      std::vector<uint32_t>& out_indices
+      );
+
+   void draw_indexed(
+      const void* vertices,
+      size_t stride,
+      const uint32_t* indices,
+      size_t index_count,
+      clip_vertices& out,
+      std::vector<uint32_t>& out_indices
+      );
+
+   const vertex_cache_stats& stats() const { return stats_; }
+   void reset_stats() { stats_ = vertex_cache_stats(); }
+
+private:
+   static const int batch_size = 64;
+
+   struct cache_entry
+   {
+      uint32_t vertex;
+      uint32_t slot;
+      uint32_t draw;
+   };
+
+   template<class Index>
+   void draw_indexed_impl(
+      const uint8_t* vertices,
+      size_t stride,
+      const Index* indices,
+      size_t index_count,
+      clip_vertices& out,
+      std::vector<uint32_t>& out_indices
+      );
+
+   void flush(const uint8_t* vertices, size_t stride, clip_vertices& out, size_t& out_count);
+
+   float4x4 transform_;
+   std::vector<cache_entry> cache_;
+   uint32_t cache_mask_;
+   uint32_t draw_id_ = 0;
+
+   int pending_count_ = 0;
+   uint32_t pending_[batch_size];
+   alignas(32) float gather_x_[batch_size];
+   alignas(32) float gather_y_[batch_size];
+   alignas(32) float gather_z_[batch_size];
+
+   vertex_cache_stats stats_;
+};
+
+}